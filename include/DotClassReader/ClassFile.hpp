@@ -55,6 +55,7 @@ class ClassFile : FileReader {
     int getMethodArgsLength(std::string className, std::string methodName);
     std::string getClassName();
     std::map<std::string, std::string> getSuper(std::string class_name);
+    std::map<std::string, std::vector<std::string>> getInterfaces();
 };
 
 #endif
\ No newline at end of file
@@ -40,6 +40,8 @@ class ConstantPool : FileReader {
     IntFloatReference getValueByIndex(int index);
     std::string getNameAndTypeByIndex(int index);
     std::string getFieldByIndex(int index);
+    std::string getFieldClassByIndex(int index);
+    std::string getFieldDescriptorByIndex(int index);
     std::string getClassNameFromMethodByIndex(int index);
     std::vector<std::string> getExternalClasses(std::string this_class);
     int getMethodIndexByName(std::string);
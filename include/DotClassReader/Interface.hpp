@@ -19,6 +19,7 @@ class Interface : FileReader {
     void seek();
     void show();
     std::vector<int> getITF();
+    std::vector<std::string> getITFNames();
     void setITF(std::string);
     int itfCount();
 };
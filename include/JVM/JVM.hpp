@@ -3,11 +3,12 @@
 
 #include <DotClassReader/ClassFile.hpp>
 #include <JVM/structures/FieldMap.hpp>
-#include <JVM/structures/StackFrame.hpp>
+#include <JVM/VMOptions.hpp>
+#include <JVM/structures/Heap.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
 #include <MethodExecuter/MethodExecuter.hpp>
 
 #include <functional>
-#include <stack>
 #include <vector>
 
 /**
@@ -17,19 +18,31 @@
  */
 class JVM {
   private:
-    std::stack<StackFrame> stack_per_thread;
+    Heap heap;
     ClassFile *class_loader;
     ClassFields convertFieldIntoMap(std::vector<FieldInfoCte>);
     ClassMethods convertMethodIntoMap(std::vector<MethodInfoCte>);
+    RuntimeClass &
+    linkClass(std::string class_name,
+              std::map<std::string, RuntimeClass> &classes,
+              std::map<std::string, std::vector<FieldInfoCte> *> &fields,
+              std::map<std::string, ClassMethods> &methods);
+    void load(std::map<std::string, ClassFields> &field_map,
+              std::map<std::string, ClassMethods> &method_map,
+              std::map<std::string, RuntimeClass> &classes);
     std::string class_name;
     std::map<std::string, std::string> super_class;
+    std::map<std::string, std::vector<std::string>> interfaces;
+    VMOptions options;
 
   public:
-    JVM(ClassFile *cl);
+    JVM(ClassFile *cl, VMOptions options);
     void Run();
-    void executeByteCode(std::vector<unsigned char> code,
+    void Compile(const std::string &output);
+    void executeByteCode(MethodInfoCte &method,
                          std::map<std::string, ClassFields> *cf,
-                         std::map<std::string, ClassMethods> *cm);
+                         std::map<std::string, ClassMethods> *cm,
+                         std::map<std::string, RuntimeClass> *classes);
 };
 
 #endif
\ No newline at end of file
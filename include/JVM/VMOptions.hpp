@@ -0,0 +1,161 @@
+#ifndef _VMOptions_H_
+#define _VMOptions_H_
+
+#include <string>
+
+/// Labels as values (computed goto) are a GNU extension, clang supports it too
+#if defined(__GNUC__)
+#define HAS_COMPUTED_GOTO
+#endif
+
+/// The JitCompiler emits x86-64 code for the System V ABI and maps it with
+/// mmap, its entry handler needs computed goto
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__unix__)
+#define HAS_JIT
+#endif
+
+/**
+ * VMOptions holds the -X and -XX options given after the .class file on the
+ * command line and is handed to the JVM and to every MethodExecuter.
+ */
+struct VMOptions {
+    ///
+    /// Instruction dispatch engine of the interpreter: a switch over the
+    /// opcode or direct threading, where each handler jumps straight to the
+    /// handler of the next instruction
+    ///
+    enum Dispatch { Switch, Threaded };
+    Dispatch dispatch;
+
+    ///
+    /// Size in bytes of the VM stack that holds the frames of the
+    /// interpreter, set with -Xss. Calls that do not fit raise
+    /// java/lang/StackOverflowError
+    ///
+    unsigned long stack_size;
+
+    ///
+    /// Inlining of trivial statically bound calls when methods reach tier 1
+    /// (-XX:+Inline / -XX:-Inline), the largest callee in bytecode bytes
+    /// (-XX:MaxInlineSize=) and -XX:+PrintInlining, which reports every
+    /// inlined call site on stderr
+    ///
+    bool inline_calls;
+    int max_inline_size;
+    bool print_inlining;
+
+    ///
+    /// Compilation of hot methods to machine code (-Xjit, the default where
+    /// the JIT is supported) or interpretation only (-Xint)
+    ///
+    bool jit;
+
+    ///
+    /// Tiered execution: methods start in the interpreter as decoded (tier
+    /// 0), are decoded again with their trivial calls inlined (tier 1) when
+    /// their invocations reach tier1_threshold (-XX:Tier1Threshold=) or one
+    /// of their loops goes back tier1_back_edge_threshold times
+    /// (-XX:Tier1BackEdgeThreshold=), and are compiled (tier 2) at
+    /// compile_threshold invocations (-XX:CompileThreshold=) or
+    /// back_edge_threshold iterations of a loop (-XX:BackEdgeThreshold=).
+    /// -XX:+PrintTiers reports every promotion on stderr
+    ///
+    int tier1_threshold;
+    int tier1_back_edge_threshold;
+    int compile_threshold;
+    int back_edge_threshold;
+    bool print_tiers;
+
+    ///
+    /// Promotions are built by compiler_count background threads
+    /// (-XX:CICompilerCount=) while the interpreter goes on, the default
+    /// with more than one core, or by the interpreter thread when it
+    /// promotes the method (-XX:-BackgroundCompilation or -Xbatch).
+    /// -XX:+CITime prints the counters of the compile broker at exit
+    ///
+    bool background_compilation;
+    int compiler_count;
+    bool print_compile_counters;
+
+    ///
+    /// Optimized versions speculate on the classes instantiated so far and
+    /// on the receivers seen by calls, and are invalidated when that
+    /// changes. A method invalidated per_method_trap_limit times
+    /// (-XX:PerMethodTrapLimit=) no longer speculates.
+    /// -XX:+PrintDeoptimization reports every invalidation with its reason
+    /// and every frame sent back to the interpreter, and counts them at exit
+    ///
+    unsigned per_method_trap_limit;
+    bool print_deoptimization;
+
+    ///
+    /// Type feedback recorded by the baseline version of methods
+    /// (-XX:+ProfileInterpreter, the default, or -XX:-ProfileInterpreter):
+    /// receiver classes of virtual calls, classes tested by casts, array
+    /// elements, branches taken and switch cases. -XX:+PrintMethodData
+    /// prints it at exit
+    ///
+    bool profile_interpreter;
+    bool print_method_data;
+
+    ///
+    /// Shared object built by sb-2019 --aot, loaded when the VM starts with
+    /// -XX:AOTLibrary=. Its methods run their compiled code from their
+    /// first call instead of being interpreted
+    ///
+    std::string aot_library;
+
+    ///
+    /// Hot loops record the instructions one of their iterations runs,
+    /// following its calls, and compile them into a trace
+    /// (-XX:+UseTraceJIT) instead of promoting their method, which calls
+    /// still do. A trace takes at most max_trace_length instructions
+    /// (-XX:MaxTraceLength=). -XX:+PrintTraces reports every trace recorded,
+    /// aborted or dropped and prints how often each one was entered and
+    /// left through a guard at exit
+    ///
+    bool trace_jit;
+    int max_trace_length;
+    bool print_traces;
+
+    ///
+    /// Optimized versions of methods that only work on primitive values are
+    /// translated into a register-based IR in SSA form (-XX:+UseIR), run
+    /// through the passes of ir_passes (-XX:IRPasses=, names separated by
+    /// commas, all of them by default) and lowered back into bytecode for
+    /// the interpreter and the JIT. With -XX:+InterpretIR, which implies
+    /// -XX:+UseIR, the interpreter runs the IR itself until they are
+    /// compiled. -XX:+PrintIR prints every function and what the passes did
+    ///
+    bool use_ir;
+    bool interpret_ir;
+    std::string ir_passes;
+    bool print_ir;
+
+    ///
+    /// The threaded interpreter runs the instruction sequences of
+    /// JVM_SUPERINSTRUCTIONS in one dispatch (-XX:+UseSuperinstructions, the
+    /// default, or -XX:-UseSuperinstructions). -XX:+PrintBytecodeNGrams
+    /// counts the instructions the interpreter dispatches, one by one, and
+    /// prints at exit the sequences of 2 up to ngram_length instructions
+    /// (-XX:NGramLength=) run the most, with the dispatches the
+    /// superinstructions take away
+    ///
+    bool use_superinstructions;
+    bool print_ngrams;
+    int ngram_length;
+
+    ///
+    /// The threaded interpreter keeps the top one or two values of the
+    /// operand stack in locals, with handlers of JVM_CACHED_HANDLERS for
+    /// each state of them (-XX:+UseStackCaching, the default, or
+    /// -XX:-UseStackCaching)
+    ///
+    bool use_stack_caching;
+
+    VMOptions();
+    bool parse(std::string option);
+    static std::string usage();
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef _DoubleLong_H_
+#define _DoubleLong_H_
+
 #include <JVM/structures/Types.hpp>
 
 struct DoubleLong {
@@ -7,3 +10,5 @@ struct DoubleLong {
         long l;
     } val;
 };
+
+#endif
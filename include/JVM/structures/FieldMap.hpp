@@ -2,10 +2,10 @@
 #define _FIELDMAP_H_
 
 #include <DotClassReader/MethodInfo.hpp>
-#include <JVM/structures/ContextEntry.hpp>
+#include <JVM/structures/Slot.hpp>
 #include <map>
 #include <string>
 
-typedef std::map<std::string, std::shared_ptr<ContextEntry>> ClassFields;
+typedef std::map<std::string, Slot> ClassFields;
 typedef std::map<std::string, MethodInfoCte> ClassMethods;
-#endif
\ No newline at end of file
+#endif
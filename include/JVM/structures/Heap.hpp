@@ -0,0 +1,155 @@
+#ifndef _Heap_H_
+#define _Heap_H_
+
+#include <JVM/structures/ContextEntry.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
+#include <algorithm>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+///
+/// Owner of every object, array and string created while the program runs.
+/// Slots only keep raw pointers to the entries, which live until the JVM is
+/// destroyed (there is no garbage collector)
+///
+class Heap {
+  private:
+    std::vector<ContextEntry *> entries;
+    ///
+    /// Memory the entries were constructed in, a block can hold many entries
+    ///
+    std::vector<void *> blocks;
+
+    ///
+    /// Constructs a ContextEntry followed by bytes zeroed bytes in one block
+    ///
+    template <typename... Args>
+    ContextEntry *construct(size_t bytes, Args &&... args) {
+        void *memory = ::operator new(sizeof(ContextEntry) + bytes);
+        blocks.push_back(memory);
+        auto entry = new (memory) ContextEntry(std::forward<Args>(args)...);
+        std::fill_n(reinterpret_cast<char *>(entry + 1), bytes, 0);
+        entries.push_back(entry);
+        return entry;
+    }
+
+    ///
+    /// Type of the elements of arrays of element (a field descriptor)
+    ///
+    static Type elementType(const std::string &element) {
+        if (element[0] == '[' || element[0] == 'L') {
+            return L;
+        }
+        return TypeMap.at(element);
+    }
+
+    ///
+    /// Bytes after the ContextEntry of an array, rounded up so the next
+    /// entry of a block stays aligned
+    ///
+    static size_t elementBytes(Type type, int length) {
+        size_t bytes = static_cast<size_t>(length) * elementSize(type);
+        return (bytes + sizeof(Slot) - 1) / sizeof(Slot) * sizeof(Slot);
+    }
+
+    ///
+    /// Bytes taken by the array of descriptor and all of its sub arrays
+    ///
+    static size_t multiArrayBytes(const std::string &descriptor,
+                                  const Slot *counts, int dimensions) {
+        auto element = descriptor.substr(1);
+        size_t bytes = sizeof(ContextEntry) +
+                       elementBytes(elementType(element), counts[0].i);
+        if (dimensions > 1) {
+            bytes += counts[0].i *
+                     multiArrayBytes(element, counts + 1, dimensions - 1);
+        }
+        return bytes;
+    }
+
+    ///
+    /// Constructs the array of descriptor at memory, each of its rows right
+    /// after it, and moves memory past them
+    ///
+    ContextEntry *placeMultiArray(char *&memory, const std::string &descriptor,
+                                  const Slot *counts, int dimensions) {
+        auto element = descriptor.substr(1);
+        Type type    = elementType(element);
+        auto array   = new (memory) ContextEntry(element, type, counts[0].i);
+        entries.push_back(array);
+        memory += sizeof(ContextEntry) + elementBytes(type, counts[0].i);
+        if (dimensions > 1) {
+            for (int index = 0; index < array->length; index++) {
+                array->at<ContextEntry *>(index) = placeMultiArray(
+                    memory, element, counts + 1, dimensions - 1);
+            }
+        }
+        return array;
+    }
+
+  public:
+    Heap() = default;
+    Heap(const Heap &) = delete;
+    Heap(Heap &&) = default;
+
+    ~Heap() {
+        for (auto entry : entries) {
+            entry->~ContextEntry();
+        }
+        for (auto block : blocks) {
+            ::operator delete(block);
+        }
+    }
+
+    ///
+    /// java/lang/String instance holding value
+    ///
+    ContextEntry *allocate(std::string value) { return construct(0, value); }
+
+    ///
+    /// Array of length elements of type, all zero (or null). class_name is
+    /// the element class of arrays of references
+    ///
+    ContextEntry *allocateArray(std::string class_name, Type type,
+                                int length) {
+        if (length < 0) {
+            throw JavaException("java/lang/NegativeArraySizeException",
+                                std::to_string(length));
+        }
+        return construct(static_cast<size_t>(length) * elementSize(type),
+                         class_name, type, length);
+    }
+
+    ///
+    /// Array of arrays for multianewarray, counts has one non negative length
+    /// per dimension being created. Rectangular arrays are laid out in a
+    /// single block, each row right after the array (or row) holding it, so
+    /// rows are contiguous in memory. The rows are still arrays of their own,
+    /// referenced from the outer array, so they can be shared or replaced
+    ///
+    ContextEntry *allocateMultiArray(const std::string &descriptor,
+                                     const Slot *counts, int dimensions) {
+        size_t bytes = multiArrayBytes(descriptor, counts, dimensions);
+        auto memory  = static_cast<char *>(::operator new(bytes));
+        blocks.push_back(memory);
+        std::fill_n(memory, bytes, 0);
+        return placeMultiArray(memory, descriptor, counts, dimensions);
+    }
+
+    ///
+    /// Instance of runtime_class with all of its fields set to zero or null.
+    /// Library classes have no RuntimeClass and no fields
+    ///
+    ContextEntry *allocateObject(const RuntimeClass *runtime_class,
+                                 std::string class_name) {
+        int slots = runtime_class ? runtime_class->instance_slots : 0;
+        return construct(slots * sizeof(Slot), runtime_class, class_name);
+    }
+};
+
+static_assert(sizeof(ContextEntry) % sizeof(Slot) == 0,
+              "fields and elements after a ContextEntry must be aligned");
+
+#endif
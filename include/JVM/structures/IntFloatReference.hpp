@@ -1,3 +1,6 @@
+#ifndef _IntFloatReference_H_
+#define _IntFloatReference_H_
+
 #include <JVM/structures/Types.hpp>
 
 struct IntFloatReference {
@@ -8,3 +11,5 @@ struct IntFloatReference {
     } val;
     std::string str_value;
 };
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _JavaException_H_
+#define _JavaException_H_
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+class ContextEntry;
+
+///
+/// Super classes of the library throwables the interpreter raises itself,
+/// merged with the super classes of the loaded classes so catch clauses
+/// over RuntimeException, Exception or Throwable match them
+///
+static const std::map<std::string, std::string> ThrowableHierarchy = {
+    {"java/lang/Throwable", "java/lang/Object"},
+    {"java/lang/Exception", "java/lang/Throwable"},
+    {"java/lang/Error", "java/lang/Throwable"},
+    {"java/lang/RuntimeException", "java/lang/Exception"},
+    {"java/lang/ArithmeticException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayStoreException", "java/lang/RuntimeException"},
+    {"java/lang/ClassCastException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalArgumentException", "java/lang/RuntimeException"},
+    {"java/lang/IllegalStateException", "java/lang/RuntimeException"},
+    {"java/lang/IndexOutOfBoundsException", "java/lang/RuntimeException"},
+    {"java/lang/ArrayIndexOutOfBoundsException",
+     "java/lang/IndexOutOfBoundsException"},
+    {"java/lang/NegativeArraySizeException", "java/lang/RuntimeException"},
+    {"java/lang/NullPointerException", "java/lang/RuntimeException"},
+    {"java/lang/UnsupportedOperationException", "java/lang/RuntimeException"},
+    {"java/lang/VirtualMachineError", "java/lang/Error"},
+    {"java/lang/StackOverflowError", "java/lang/VirtualMachineError"},
+    {"java/lang/OutOfMemoryError", "java/lang/VirtualMachineError"},
+    {"java/lang/LinkageError", "java/lang/Error"},
+    {"java/lang/UnsatisfiedLinkError", "java/lang/LinkageError"},
+    {"java/lang/IncompatibleClassChangeError", "java/lang/LinkageError"},
+    {"java/lang/NoSuchFieldError", "java/lang/IncompatibleClassChangeError"},
+    {"java/lang/NoSuchMethodError", "java/lang/IncompatibleClassChangeError"},
+    {"java/lang/AbstractMethodError", "java/lang/IncompatibleClassChangeError"},
+};
+
+/**
+ * JavaException carries a Java throwable through the C++ code of the
+ * interpreter until it reaches a frame with a matching exception handler.
+ * Errors detected by the VM (division by zero, null references, array
+ * bounds ...) only have the class name and message, their object is created
+ * when a handler catches them. athrow passes the thrown object itself.
+ */
+class JavaException : public std::runtime_error {
+  public:
+    std::string class_name;
+    std::string message;
+    ContextEntry *object;
+
+    JavaException(std::string class_name, std::string message = "",
+                  ContextEntry *object = nullptr)
+        : std::runtime_error(describe(class_name, message)) {
+        this->class_name = class_name;
+        this->message    = message;
+        this->object     = object;
+    }
+
+    ///
+    /// Text printed for an uncaught exception, as Throwable.toString
+    ///
+    static std::string describe(std::string class_name, std::string message) {
+        for (auto &c : class_name) {
+            c = c == '/' ? '.' : c;
+        }
+        return message.empty() ? class_name : class_name + ": " + message;
+    }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef _RuntimeClass_H_
+#define _RuntimeClass_H_
+
+#include <constants/MethodInfoCte.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+///
+/// Entry of a vtable: a method and the class that declares it, the one its
+/// code is decoded against
+///
+struct VirtualMethod {
+    MethodInfoCte *method;
+    std::string declaring_class;
+};
+
+struct RuntimeClass;
+
+///
+/// Entry of an itable: the methods a class runs for the methods of one
+/// interface it implements, in the order of the vtable of the interface
+///
+struct InterfaceTable {
+    const RuntimeClass *interface;
+    std::vector<VirtualMethod> methods;
+};
+
+///
+/// A loaded class after linking. Every instance field, inherited ones
+/// included, gets a fixed offset in the slot array of the objects: the
+/// fields of the super class come first, so an offset resolved against a
+/// class is valid for all of its subclasses. Each field takes one slot,
+/// long and double included. The vtable follows the same rule: it starts
+/// with the vtable of the super class, overriding methods replace the entry
+/// they override and new virtual methods are appended, so the index of a
+/// method is the same in every subclass. The itable has an entry for each
+/// interface the class implements, directly, through its superinterfaces
+/// or through its super classes. For an interface it lists the
+/// superinterfaces
+///
+struct RuntimeClass {
+    std::string name;
+    const RuntimeClass *super; // nullptr when the super class is not loaded
+    std::vector<const RuntimeClass *> subclasses; // direct ones
+    std::map<std::string, int> field_offsets;
+    int instance_slots;
+    std::vector<VirtualMethod> vtable;
+    std::map<std::string, int> vtable_index; // by name and descriptor
+    std::vector<InterfaceTable> itable;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _Slot_H_
+#define _Slot_H_
+
+#include <cstdint>
+
+class ContextEntry;
+
+///
+/// One 64-bit cell of a local variable array or operand stack. Values are
+/// stored unboxed, references are plain pointers to heap entries (nullptr is
+/// the Java null). long and double are category 2: they take two consecutive
+/// slots and the value lives in the lower one, as the JVM spec counts them.
+///
+union Slot {
+    int64_t j;
+    int32_t i;
+    float f;
+    double d;
+    ContextEntry *ref;
+};
+
+static_assert(sizeof(Slot) == 8, "Slot must be 64 bits wide");
+
+#endif
@@ -1,23 +1,25 @@
 #ifndef _StackFrame_H_
 #define _StackFrame_H_
 
-#include <JVM/structures/ContextEntry.hpp>
-#include <stack>
-#include <string>
+#include <JVM/structures/Slot.hpp>
 
+struct DecodedMethod;
+
+///
+/// Header of one method invocation inside the VM stack. The frame is laid
+/// out as [local variables][StackFrame][operand stack], lva points to the
+/// first local and stack to the bottom of the operand stack. The first
+/// locals of a callee are the arguments left on the operand stack of its
+/// caller, frames overlap there. sp and pc keep where the method stopped
+/// while one of its callees runs
+///
 struct StackFrame {
-    // lva (local variable array)
-    // in both cases below first pair element is value type and second is its
-    // byte value
-    std::vector<std::shared_ptr<ContextEntry>> lva;
-    std::stack<std::shared_ptr<ContextEntry>> operand_stack;
-    ~StackFrame() {}
-    StackFrame(std::vector<std::shared_ptr<ContextEntry>> localVariableArray) {
-        lva = std::vector<std::shared_ptr<ContextEntry>>(
-            localVariableArray.size());
-        lva           = localVariableArray;
-        operand_stack = std::stack<std::shared_ptr<ContextEntry>>();
-    }
+    StackFrame *caller;
+    DecodedMethod *method;
+    Slot *lva;
+    Slot *stack;
+    Slot *sp;
+    int pc;
 };
 
 #endif
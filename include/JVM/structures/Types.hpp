@@ -18,8 +18,30 @@ int static category(Type t) {
     return 1;
 }
 
+///
+/// Bytes taken by each element of an array of type t
+///
+int static elementSize(Type t) {
+    switch (t) {
+    case B:
+    case Z:
+        return 1;
+    case C:
+    case S:
+        return 2;
+    case F:
+    case I:
+        return 4;
+    case D:
+    case J:
+        return 8;
+    default:
+        return sizeof(void *);
+    }
+}
+
 static const std::map<int, Type> ATypeMap = std::map<int, Type>{
-    {4, B}, {5, C}, {6, F}, {7, D}, {8, B}, {9, S}, {10, I}, {11, J},
+    {4, Z}, {5, C}, {6, F}, {7, D}, {8, B}, {9, S}, {10, I}, {11, J},
 };
 /*B = byte
   C = char
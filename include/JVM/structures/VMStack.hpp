@@ -0,0 +1,70 @@
+#ifndef _VMStack_H_
+#define _VMStack_H_
+
+#include <JVM/structures/JavaException.hpp>
+#include <JVM/structures/Slot.hpp>
+#include <JVM/structures/StackFrame.hpp>
+#include <MethodExecuter/Instruction.hpp>
+#include <memory>
+
+/**
+ * VMStack is the contiguous block where the interpreter pushes its frames.
+ * Calling a method only moves pointers inside it, and running out of room
+ * throws java/lang/StackOverflowError instead of overflowing the C++ stack.
+ */
+class VMStack {
+  private:
+    std::unique_ptr<Slot[]> storage;
+    Slot *limit;
+
+  public:
+    ///
+    /// Reserves size bytes, rounded down to whole slots
+    ///
+    explicit VMStack(unsigned long size)
+        : storage(new Slot[size / sizeof(Slot)]) {
+        limit = storage.get() + size / sizeof(Slot);
+    }
+
+    Slot *bottom() { return storage.get(); }
+
+    ///
+    /// Whether a frame of method with its local variables starting at lva
+    /// fits in the stack
+    ///
+    bool fits(const DecodedMethod *method, const Slot *lva) const {
+        auto frame = reinterpret_cast<const StackFrame *>(
+            lva + method->max_locals);
+        return reinterpret_cast<const Slot *>(frame + 1) + method->max_stack <=
+               limit;
+    }
+
+    ///
+    /// Whether the slots below end are all inside the stack
+    ///
+    bool contains(const Slot *end) const { return end <= limit; }
+
+    ///
+    /// Pushes the frame of method with its local variables starting at lva,
+    /// right above the frame of caller (nullptr for the first one)
+    ///
+    StackFrame *push(StackFrame *caller, DecodedMethod *method, Slot *lva) {
+        if (!fits(method, lva)) {
+            throw JavaException("java/lang/StackOverflowError");
+        }
+        auto frame = reinterpret_cast<StackFrame *>(lva + method->max_locals);
+        auto stack = reinterpret_cast<Slot *>(frame + 1);
+        frame->caller = caller;
+        frame->method = method;
+        frame->lva    = lva;
+        frame->stack  = stack;
+        frame->sp     = stack;
+        frame->pc     = 0;
+        return frame;
+    }
+};
+
+static_assert(sizeof(StackFrame) % sizeof(Slot) == 0,
+              "StackFrame must take whole slots of the VM stack");
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef _AotCompiler_H_
+#define _AotCompiler_H_
+
+#include <DotClassReader/ConstantPool.hpp>
+#include <JVM/structures/FieldMap.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
+#include <MethodExecuter/AotLibrary.hpp>
+#include <MethodExecuter/Instruction.hpp>
+
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * AotCompiler translates the methods of the loaded classes to C++ ahead of
+ * time (sb-2019 --aot Foo.class -o Foo.so) and builds them into a shared
+ * object with the host compiler, which the VM loads with -XX:AOTLibrary=.
+ *
+ * Each method becomes a function with the signature of the code of the
+ * JitCompiler, working on the same frame as the interpreter: the locals at
+ * lva and the operand stack at sp, one label per instruction of its
+ * baseline version and a jump table from instruction indexes to labels, so
+ * the interpreter enters it at any instruction. It translates the same
+ * instructions the JitCompiler does, plus switches, and leaves the others
+ * (calls, returns, allocation, strings...) and every slow path to the
+ * interpreter the same way, before changing anything. Fields are reached
+ * through links the VM resolves when it loads the library, so the classes
+ * may be laid out differently then, and a method whose bytecode changed
+ * since is interpreted.
+ */
+class AotCompiler {
+  private:
+    struct Link {
+        int kind; // AotLink::Kind
+        std::string class_name;
+        std::string name;
+    };
+    std::map<std::string, ConstantPool *> cp;
+    std::map<std::string, ClassFields> *cf;
+    std::map<std::string, RuntimeClass> *classes;
+    std::map<std::string, std::string> super_class;
+    std::vector<Link> links;
+    std::map<std::string, int> link_index; // by kind, class and name
+    std::ostringstream functions;
+    std::ostringstream methods; // entries of the method table
+    int method_count = 0;
+    int link(int kind, const std::string &class_name, const std::string &name);
+    int fieldLink(const FieldRef &field);
+    int staticLink(const FieldRef &field);
+    bool emit(std::ostream &out, const Instruction &ins, int pc);
+
+  public:
+    AotCompiler(std::map<std::string, ConstantPool *> cp,
+                std::map<std::string, ClassFields> *cf,
+                std::map<std::string, RuntimeClass> *classes,
+                std::map<std::string, std::string> super_class);
+    bool add(const MethodInfoCte &method, const std::string &class_name);
+    int methodCount() const;
+    std::string source() const;
+    void build(const std::string &output) const;
+};
+
+#endif
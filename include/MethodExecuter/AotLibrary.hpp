@@ -0,0 +1,82 @@
+#ifndef _AotLibrary_H_
+#define _AotLibrary_H_
+
+#include <MethodExecuter/Instruction.hpp>
+#include <constants/AttributeCode.hpp>
+#include <constants/MethodInfoCte.hpp>
+
+#include <functional>
+#include <map>
+#include <string>
+
+///
+/// Field a library built by the AotCompiler uses, resolved by the VM when it
+/// loads the library: the slot of an instance field in the objects of
+/// class_name, or the address of a static field
+///
+struct AotLink {
+    enum Kind { Field, Static };
+    int kind;
+    const char *class_name;
+    const char *name;
+};
+
+///
+/// Method compiled ahead of time: its compiled code, which instructions of
+/// its baseline version it runs ('1' for each one, '0' for the ones left to
+/// the interpreter) and the hash of the bytecode it was compiled from
+///
+struct AotMethod {
+    const char *class_name;
+    const char *name;
+    const char *descriptor;
+    unsigned code_hash;
+    CompiledCode entry;
+    const char *compiled;
+};
+
+///
+/// Table a library exports as aot_image. The generated source declares the
+/// same structures, format changes whenever they do. The sizes and offsets
+/// of the VM the library was built for are checked when it is loaded, and
+/// resolved holds the value of each link once it is
+///
+struct AotImage {
+    enum { Format = 1 };
+    int format;
+    int slot_size;
+    int entry_size;    // sizeof(ContextEntry)
+    int length_offset; // of ContextEntry::length
+    int links_count;
+    const AotLink *links;
+    void **resolved;
+    int methods_count;
+    const AotMethod *methods;
+};
+
+/**
+ * AotLibrary is a shared object built by the AotCompiler, loaded with
+ * -XX:AOTLibrary= when the VM starts. Its methods are looked up as they are
+ * decoded and run their compiled code from the first call, as long as
+ * their bytecode is still the one they were compiled from.
+ */
+class AotLibrary {
+  private:
+    void *handle          = nullptr;
+    const AotImage *image = nullptr;
+    std::map<std::string, const AotMethod *> methods; // class.name+descriptor
+
+  public:
+    typedef std::function<void *(const AotLink &)> Resolver;
+    AotLibrary() = default;
+    AotLibrary(const AotLibrary &) = delete;
+    AotLibrary &operator=(const AotLibrary &) = delete;
+    ~AotLibrary();
+    void open(const std::string &path, Resolver resolve);
+    const AotMethod *find(const std::string &class_name,
+                          const MethodInfoCte &method) const;
+    static unsigned codeHash(const AttributeCode &code);
+    static int lengthOffset();
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef _BytecodeDecoder_H_
+#define _BytecodeDecoder_H_
+
+#include <DotClassReader/ConstantPool.hpp>
+#include <MethodExecuter/Instruction.hpp>
+#include <constants/AttributeCode.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * BytecodeDecoder walks the Code attribute of a method once and translates
+ * the raw bytes into a vector of Instruction. Operands are read and sign
+ * extended, wide prefixes are folded into the instruction they modify, the
+ * short load/store forms (iload_0, astore_3 ...) become the generic ones with
+ * the index as operand, constant pool indexes are resolved against the
+ * ConstantPool of the declaring class and branch offsets are rewritten as
+ * indexes into the instruction vector.
+ */
+class BytecodeDecoder {
+  private:
+    ConstantPool *cp;
+    std::string class_name;
+    std::vector<unsigned char> code;
+    int pos;
+    unsigned char u1();
+    unsigned short u2();
+    int s1();
+    int s2();
+    int s4();
+    const FieldRef *fieldRef(DecodedMethod *dm, int index);
+    const MethodRef *methodRef(DecodedMethod *dm, int index);
+    const std::string *classRef(DecodedMethod *dm, int index);
+    void decodeSwitch(DecodedMethod *dm, Instruction &ins);
+    void resolveTargets(DecodedMethod *dm);
+
+  public:
+    BytecodeDecoder(ConstantPool *cp, std::string class_name);
+    std::shared_ptr<DecodedMethod> decode(const AttributeCode &attribute);
+    static int countArgs(std::string args);
+    static int countArgSlots(std::string args);
+    static void numberLoops(DecodedMethod *dm);
+    static std::vector<bool> blockStarts(const DecodedMethod &method);
+};
+
+#endif
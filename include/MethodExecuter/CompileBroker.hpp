@@ -0,0 +1,94 @@
+#ifndef _CompileBroker_H_
+#define _CompileBroker_H_
+
+#include <JVM/VMOptions.hpp>
+#include <MethodExecuter/Inliner.hpp>
+#include <MethodExecuter/Instruction.hpp>
+#include <MethodExecuter/JitCompiler.hpp>
+#include <MethodExecuter/LockFreeQueue.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+///
+/// Promotion of one method to the next tier. It is built by a worker of the
+/// CompileBroker and installed by the thread running the interpreter
+///
+struct CompileTask {
+    DecodedMethod *method;  // baseline version of the method promoted
+    DecodedMethod *version; // compiled for tier 2
+    int tier;               // of method once the task is installed
+    unsigned back_edges;    // iterations of the loop that made it hot
+    std::vector<Instruction> code;            // of version, when submitted
+    Speculation speculation;                  // taken for tier 1
+    std::shared_ptr<DecodedMethod> optimized; // built for tier 1
+    JitCode jit;                              // built for tier 2
+    bool failed = false;
+    std::string error;
+};
+
+///
+/// Counters of the CompileBroker, readable from any thread
+///
+struct CompileCounters {
+    std::atomic<long> tasks{0};        // built
+    std::atomic<int> queued{0};        // submitted and not started yet
+    std::atomic<int> longest_queue{0}; // largest value of queued
+    std::atomic<long> micros{0};       // spent building tasks
+    std::atomic<long> code_bytes{0};   // of the machine code installed
+};
+
+/**
+ * CompileBroker takes the promotions of hot methods off the thread running
+ * the interpreter. Tasks are pushed to a lock-free queue that a pool of
+ * worker threads pops, and built tasks come back through a second one. The
+ * interpreter keeps running the current version of the method meanwhile
+ * and installs the built tasks between two instructions, so it never sees
+ * a method half promoted. With no worker (-Xbatch) tasks are built right
+ * away by the thread that submits them.
+ *
+ * A tier 1 task decodes the method again through the optimize function,
+ * which only reads the loaded classes and the Speculation the task took
+ * when it was submitted. A tier 2 task compiles a copy of the
+ * instructions made when it was submitted, as the interpreter goes on
+ * rewriting the originals into their quick forms. Each worker has its own
+ * JitCompiler, so compiled code lives as long as the broker.
+ */
+class CompileBroker {
+  private:
+    typedef std::function<std::shared_ptr<DecodedMethod>(
+        const CompileTask &)>
+        Optimizer;
+    Optimizer optimize;
+    int worker_count;
+    LockFreeQueue<CompileTask *> submitted;
+    LockFreeQueue<CompileTask *> built;
+    std::vector<std::thread> workers;
+    std::mutex idle_mutex; // only for idle workers to sleep
+    std::condition_variable idle;
+    std::atomic<bool> stopping;
+#ifdef HAS_JIT
+    JitCompiler batch_jit; // of the tasks built by the submitting thread
+#endif
+    void work();
+    void build(CompileTask *task, JitCompiler *jit);
+
+  public:
+    CompileCounters counters;
+
+    CompileBroker(const VMOptions &options, Optimizer optimize);
+    CompileBroker(const CompileBroker &) = delete;
+    CompileBroker &operator=(const CompileBroker &) = delete;
+    ~CompileBroker();
+    bool submit(CompileTask *task);
+    bool hasBuilt() const;
+    CompileTask *nextBuilt();
+};
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef _Inliner_H_
+#define _Inliner_H_
+
+#include <DotClassReader/ConstantPool.hpp>
+#include <JVM/VMOptions.hpp>
+#include <JVM/structures/FieldMap.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
+#include <MethodExecuter/Instruction.hpp>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+///
+/// What a method is optimized for beyond the loaded classes: the classes
+/// instantiated so far and, by instruction index, the invokevirtual sites
+/// of its baseline version that have only seen one receiver class
+///
+struct Speculation {
+    std::set<const RuntimeClass *> instantiated;
+    std::map<int, const RuntimeClass *> receivers;
+};
+
+/**
+ * Inliner replaces, in a freshly decoded method, the calls to trivial
+ * methods (getters, setters, constructors that only set fields...) by a
+ * copy of the decoded code of the callee. A call site is inlined when:
+ *
+ * - it is an invokestatic, invokespecial or invokevirtual of a method of a
+ *   loaded class whose target is known without looking at the receiver.
+ *   For invokevirtual that means the class of the Methodref and all of its
+ *   loaded subclasses share the same vtable entry. Every class is loaded
+ *   before main runs, so no later class can override it. Otherwise the
+ *   Speculation may bind it: when the instantiated ones among these
+ *   classes share the entry, the site is inlined with a Dependency on it,
+ *   and when the site only saw one receiver class, the inlined code starts
+ *   with a guard_class on that class. Both are undone by deoptimization;
+ * - the callee is neither abstract, native nor synchronized and its code
+ *   takes at most VMOptions::max_inline_size bytes of bytecode;
+ * - the callee calls nothing but java/lang/Object.<init>, which does
+ *   nothing and becomes a pop. So it is never recursive and the inlined code
+ *   has no call left to inline;
+ * - the callee has no exception table and no tableswitch, lookupswitch,
+ *   jsr, ret, monitorenter or monitorexit instruction;
+ * - each return of the callee leaves only its value on the operand stack.
+ *
+ * The inlined code pops the arguments into locals past the ones of the
+ * caller (a nullcheck stands for the NullPointerException of a null
+ * receiver), uses them as its own locals and jumps to the instruction
+ * after the call where it returned. An exception thrown in the inlined code
+ * is handled as if the call threw it. Each instruction of the caller maps
+ * to the one of the decoded method it comes from, the first instruction of
+ * an inlined call maps to the call (DecodedMethod::interpreter_index).
+ */
+class Inliner {
+  private:
+    ///
+    /// Method a call site runs, the class that declares it and the
+    /// speculation it depends on, if any
+    ///
+    struct Binding {
+        MethodInfoCte *method = nullptr;
+        std::string class_name;
+        bool dependent = false; // on dependency
+        Dependency dependency;
+        const RuntimeClass *guard = nullptr; // only receiver class seen
+    };
+    std::map<std::string, ConstantPool *> cp;
+    std::map<std::string, ClassMethods> *cm;
+    const std::map<std::string, std::string> *super_class;
+    std::map<std::string, RuntimeClass> *classes;
+    VMOptions options;
+    std::atomic<int> inlined_calls; // methods are inlined by compile threads
+    MethodInfoCte *lookup(std::string &class_name, const MethodRef &ref);
+    Binding bind(const Instruction &ins, int index,
+                 const Speculation &speculation);
+    std::shared_ptr<DecodedMethod> body(MethodInfoCte &method,
+                                        const std::string &class_name);
+
+  public:
+    Inliner(std::map<std::string, ConstantPool *> cp,
+            std::map<std::string, ClassMethods> *cm,
+            const std::map<std::string, std::string> *super_class,
+            std::map<std::string, RuntimeClass> *classes, VMOptions options);
+    void inlineCalls(DecodedMethod *method, const std::string &name,
+                     const Speculation &speculation);
+    int inlinedCalls() const;
+};
+
+#endif
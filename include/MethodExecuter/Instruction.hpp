@@ -0,0 +1,471 @@
+#ifndef _Instruction_H_
+#define _Instruction_H_
+
+#include <JVM/structures/DoubleLong.hpp>
+#include <JVM/structures/IntFloatReference.hpp>
+#include <JVM/structures/Slot.hpp>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+///
+/// Every JVM opcode handled by the decoder, as (mnemonic, byte value) pairs.
+/// The list is expanded with different X macros to build the Opcode enum and
+/// the mnemonic table, so both always agree with each other.
+///
+#define JVM_OPCODES(X)                                                         \
+    X(nop, 0x00)                                                               \
+    X(aconst_null, 0x01)                                                       \
+    X(iconst_m1, 0x02)                                                         \
+    X(iconst_0, 0x03)                                                          \
+    X(iconst_1, 0x04)                                                          \
+    X(iconst_2, 0x05)                                                          \
+    X(iconst_3, 0x06)                                                          \
+    X(iconst_4, 0x07)                                                          \
+    X(iconst_5, 0x08)                                                          \
+    X(lconst_0, 0x09)                                                          \
+    X(lconst_1, 0x0a)                                                          \
+    X(fconst_0, 0x0b)                                                          \
+    X(fconst_1, 0x0c)                                                          \
+    X(fconst_2, 0x0d)                                                          \
+    X(dconst_0, 0x0e)                                                          \
+    X(dconst_1, 0x0f)                                                          \
+    X(bipush, 0x10)                                                            \
+    X(sipush, 0x11)                                                            \
+    X(ldc, 0x12)                                                               \
+    X(ldc_w, 0x13)                                                             \
+    X(ldc2_w, 0x14)                                                            \
+    X(iload, 0x15)                                                             \
+    X(lload, 0x16)                                                             \
+    X(fload, 0x17)                                                             \
+    X(dload, 0x18)                                                             \
+    X(aload, 0x19)                                                             \
+    X(iload_0, 0x1a)                                                           \
+    X(iload_1, 0x1b)                                                           \
+    X(iload_2, 0x1c)                                                           \
+    X(iload_3, 0x1d)                                                           \
+    X(lload_0, 0x1e)                                                           \
+    X(lload_1, 0x1f)                                                           \
+    X(lload_2, 0x20)                                                           \
+    X(lload_3, 0x21)                                                           \
+    X(fload_0, 0x22)                                                           \
+    X(fload_1, 0x23)                                                           \
+    X(fload_2, 0x24)                                                           \
+    X(fload_3, 0x25)                                                           \
+    X(dload_0, 0x26)                                                           \
+    X(dload_1, 0x27)                                                           \
+    X(dload_2, 0x28)                                                           \
+    X(dload_3, 0x29)                                                           \
+    X(aload_0, 0x2a)                                                           \
+    X(aload_1, 0x2b)                                                           \
+    X(aload_2, 0x2c)                                                           \
+    X(aload_3, 0x2d)                                                           \
+    X(iaload, 0x2e)                                                            \
+    X(laload, 0x2f)                                                            \
+    X(faload, 0x30)                                                            \
+    X(daload, 0x31)                                                            \
+    X(aaload, 0x32)                                                            \
+    X(baload, 0x33)                                                            \
+    X(caload, 0x34)                                                            \
+    X(saload, 0x35)                                                            \
+    X(istore, 0x36)                                                            \
+    X(lstore, 0x37)                                                            \
+    X(fstore, 0x38)                                                            \
+    X(dstore, 0x39)                                                            \
+    X(astore, 0x3a)                                                            \
+    X(istore_0, 0x3b)                                                          \
+    X(istore_1, 0x3c)                                                          \
+    X(istore_2, 0x3d)                                                          \
+    X(istore_3, 0x3e)                                                          \
+    X(lstore_0, 0x3f)                                                          \
+    X(lstore_1, 0x40)                                                          \
+    X(lstore_2, 0x41)                                                          \
+    X(lstore_3, 0x42)                                                          \
+    X(fstore_0, 0x43)                                                          \
+    X(fstore_1, 0x44)                                                          \
+    X(fstore_2, 0x45)                                                          \
+    X(fstore_3, 0x46)                                                          \
+    X(dstore_0, 0x47)                                                          \
+    X(dstore_1, 0x48)                                                          \
+    X(dstore_2, 0x49)                                                          \
+    X(dstore_3, 0x4a)                                                          \
+    X(astore_0, 0x4b)                                                          \
+    X(astore_1, 0x4c)                                                          \
+    X(astore_2, 0x4d)                                                          \
+    X(astore_3, 0x4e)                                                          \
+    X(iastore, 0x4f)                                                           \
+    X(lastore, 0x50)                                                           \
+    X(fastore, 0x51)                                                           \
+    X(dastore, 0x52)                                                           \
+    X(aastore, 0x53)                                                           \
+    X(bastore, 0x54)                                                           \
+    X(castore, 0x55)                                                           \
+    X(sastore, 0x56)                                                           \
+    X(pop, 0x57)                                                               \
+    X(pop2, 0x58)                                                              \
+    X(dup, 0x59)                                                               \
+    X(dup_x1, 0x5a)                                                            \
+    X(dup_x2, 0x5b)                                                            \
+    X(dup2, 0x5c)                                                              \
+    X(dup2_x1, 0x5d)                                                           \
+    X(dup2_x2, 0x5e)                                                           \
+    X(swap, 0x5f)                                                              \
+    X(iadd, 0x60)                                                              \
+    X(ladd, 0x61)                                                              \
+    X(fadd, 0x62)                                                              \
+    X(dadd, 0x63)                                                              \
+    X(isub, 0x64)                                                              \
+    X(lsub, 0x65)                                                              \
+    X(fsub, 0x66)                                                              \
+    X(dsub, 0x67)                                                              \
+    X(imul, 0x68)                                                              \
+    X(lmul, 0x69)                                                              \
+    X(fmul, 0x6a)                                                              \
+    X(dmul, 0x6b)                                                              \
+    X(idiv, 0x6c)                                                              \
+    X(ldiv, 0x6d)                                                              \
+    X(fdiv, 0x6e)                                                              \
+    X(ddiv, 0x6f)                                                              \
+    X(irem, 0x70)                                                              \
+    X(lrem, 0x71)                                                              \
+    X(frem, 0x72)                                                              \
+    X(drem, 0x73)                                                              \
+    X(ineg, 0x74)                                                              \
+    X(lneg, 0x75)                                                              \
+    X(fneg, 0x76)                                                              \
+    X(dneg, 0x77)                                                              \
+    X(ishl, 0x78)                                                              \
+    X(lshl, 0x79)                                                              \
+    X(ishr, 0x7a)                                                              \
+    X(lshr, 0x7b)                                                              \
+    X(iushr, 0x7c)                                                             \
+    X(lushr, 0x7d)                                                             \
+    X(iand, 0x7e)                                                              \
+    X(land, 0x7f)                                                              \
+    X(ior, 0x80)                                                               \
+    X(lor, 0x81)                                                               \
+    X(ixor, 0x82)                                                              \
+    X(lxor, 0x83)                                                              \
+    X(iinc, 0x84)                                                              \
+    X(i2l, 0x85)                                                               \
+    X(i2f, 0x86)                                                               \
+    X(i2d, 0x87)                                                               \
+    X(l2i, 0x88)                                                               \
+    X(l2f, 0x89)                                                               \
+    X(l2d, 0x8a)                                                               \
+    X(f2i, 0x8b)                                                               \
+    X(f2l, 0x8c)                                                               \
+    X(f2d, 0x8d)                                                               \
+    X(d2i, 0x8e)                                                               \
+    X(d2l, 0x8f)                                                               \
+    X(d2f, 0x90)                                                               \
+    X(i2b, 0x91)                                                               \
+    X(i2c, 0x92)                                                               \
+    X(i2s, 0x93)                                                               \
+    X(lcmp, 0x94)                                                              \
+    X(fcmpl, 0x95)                                                             \
+    X(fcmpg, 0x96)                                                             \
+    X(dcmpl, 0x97)                                                             \
+    X(dcmpg, 0x98)                                                             \
+    X(ifeq, 0x99)                                                              \
+    X(ifne, 0x9a)                                                              \
+    X(iflt, 0x9b)                                                              \
+    X(ifge, 0x9c)                                                              \
+    X(ifgt, 0x9d)                                                              \
+    X(ifle, 0x9e)                                                              \
+    X(if_icmpeq, 0x9f)                                                         \
+    X(if_icmpne, 0xa0)                                                         \
+    X(if_icmplt, 0xa1)                                                         \
+    X(if_icmpge, 0xa2)                                                         \
+    X(if_icmpgt, 0xa3)                                                         \
+    X(if_icmple, 0xa4)                                                         \
+    X(if_acmpeq, 0xa5)                                                         \
+    X(if_acmpne, 0xa6)                                                         \
+    X(goto, 0xa7)                                                              \
+    X(jsr, 0xa8)                                                               \
+    X(ret, 0xa9)                                                               \
+    X(tableswitch, 0xaa)                                                       \
+    X(lookupswitch, 0xab)                                                      \
+    X(ireturn, 0xac)                                                           \
+    X(lreturn, 0xad)                                                           \
+    X(freturn, 0xae)                                                           \
+    X(dreturn, 0xaf)                                                           \
+    X(areturn, 0xb0)                                                           \
+    X(return, 0xb1)                                                            \
+    X(getstatic, 0xb2)                                                         \
+    X(putstatic, 0xb3)                                                         \
+    X(getfield, 0xb4)                                                          \
+    X(putfield, 0xb5)                                                          \
+    X(invokevirtual, 0xb6)                                                     \
+    X(invokespecial, 0xb7)                                                     \
+    X(invokestatic, 0xb8)                                                      \
+    X(invokeinterface, 0xb9)                                                   \
+    X(invokedynamic, 0xba)                                                     \
+    X(new, 0xbb)                                                               \
+    X(newarray, 0xbc)                                                          \
+    X(anewarray, 0xbd)                                                         \
+    X(arraylength, 0xbe)                                                       \
+    X(athrow, 0xbf)                                                            \
+    X(checkcast, 0xc0)                                                         \
+    X(instanceof, 0xc1)                                                        \
+    X(monitorenter, 0xc2)                                                      \
+    X(monitorexit, 0xc3)                                                       \
+    X(wide, 0xc4)                                                              \
+    X(multianewarray, 0xc5)                                                    \
+    X(ifnull, 0xc6)                                                            \
+    X(ifnonnull, 0xc7)                                                         \
+    X(goto_w, 0xc8)                                                            \
+    X(jsr_w, 0xc9)
+
+///
+/// Opcodes of the _quick forms the interpreter rewrites an instruction into
+/// the first time it runs, once its constant pool reference is resolved. The
+/// quick form carries the result of the resolution in the instruction, so it
+/// does no lookup at all. nullcheck and guard_class are not quick forms,
+/// the Inliner emits them for the receiver of an inlined call, and neither
+/// is deoptimize, which replaces the instructions of an optimized version
+/// that was invalidated. trace_enter, trace_return and trace_exit only
+/// appear in the code of a Trace, which always runs compiled. They are
+/// numbered past 0xff so they never clash with an opcode read from a class
+/// file.
+///
+#define JVM_QUICK_OPCODES(X)                                                   \
+    X(ldc_quick, 0x100)                                                        \
+    X(ldc2_w_quick, 0x101)                                                     \
+    X(getstatic_quick, 0x102)                                                  \
+    X(putstatic_quick, 0x103)                                                  \
+    X(getfield_quick, 0x104)                                                   \
+    X(putfield_quick, 0x105)                                                   \
+    X(invoke_quick, 0x106)                                                     \
+    X(invokestatic_quick, 0x107)                                               \
+    X(new_quick, 0x108)                                                        \
+    X(invokevirtual_mono, 0x109)                                               \
+    X(invokevirtual_poly, 0x10a)                                               \
+    X(invokevirtual_mega, 0x10b)                                               \
+    X(nullcheck, 0x10c)                                                        \
+    X(guard_class, 0x10d)                                                      \
+    X(deoptimize, 0x10e)                                                       \
+    X(trace_enter, 0x10f)                                                      \
+    X(trace_return, 0x110)                                                     \
+    X(trace_exit, 0x111)
+
+enum Opcode : unsigned short {
+#define OPCODE_ENUM(name, code) op_##name = code,
+    JVM_OPCODES(OPCODE_ENUM) JVM_QUICK_OPCODES(OPCODE_ENUM)
+#undef OPCODE_ENUM
+};
+
+///
+/// Returns the mnemonic of an opcode, "unknown" if it is not in the list
+///
+const char *opcodeName(unsigned short opcode);
+
+///
+/// Fieldref resolved at decode time: owner class, field name and descriptor
+///
+struct FieldRef {
+    std::string class_name;
+    std::string name;
+    std::string descriptor;
+    int slots; // 2 for long and double, else 1
+};
+
+///
+/// Methodref resolved at decode time. kind tells which runtime path handles
+/// the call, so the interpreter no longer compares class names per invoke
+///
+struct MethodRef {
+    enum Kind { User, JavaObject, PrintStream, StringBuilder, Throwable };
+    Kind kind;
+    std::string class_name;
+    std::string name;
+    std::string descriptor;
+    std::string name_and_type; // key into ClassMethods (name + descriptor)
+    std::string args;          // descriptor text between the parentheses
+    int args_count;            // number of declared parameters
+    int arg_slots;             // slots taken by the parameters, no receiver
+    int return_slots;          // 0 for void, 2 for long and double, else 1
+};
+
+///
+/// Loadable constant (ldc, ldc_w, ldc2_w) copied out of the constant pool
+///
+struct ConstantRef {
+    IntFloatReference value; // ldc and ldc_w
+    DoubleLong wide_value;   // ldc2_w
+};
+
+///
+/// tableswitch and lookupswitch share this table: for tableswitch keys is
+/// empty and the key of targets[i] is low + i
+///
+struct SwitchTable {
+    int low;
+    std::vector<int> keys;
+    std::vector<int> targets;
+    int default_target;
+};
+
+///
+/// Entry of the exception table, with instruction indexes instead of byte
+/// offsets. The handler covers the instructions from start up to, but not
+/// including, end. catch_type is empty for finally blocks (any throwable)
+///
+struct ExceptionHandler {
+    int start;
+    int end;
+    int handler;
+    std::string catch_type;
+};
+
+struct DecodedMethod;
+struct IrFunction;
+struct MethodInfoCte;
+struct MethodProfile;
+struct RuntimeClass;
+struct Trace;
+
+///
+/// Inline cache of an invokevirtual or invokeinterface call site: the
+/// methods selected for the receiver classes seen there, most recent last.
+/// The site runs as invokevirtual_mono while it has seen one class, as
+/// invokevirtual_poly up to Polymorphic classes and as invokevirtual_mega
+/// after that. index is the method in the vtable of the class of the
+/// Methodref or, when interface is set, in the itable entry of interface
+///
+struct InlineCache {
+    enum { Polymorphic = 4 };
+    const MethodRef *method;
+    const RuntimeClass *interface; // nullptr for invokevirtual
+    int index;                     // -1 if the method was not resolved
+    int size;
+    const RuntimeClass *classes[Polymorphic];
+    DecodedMethod *targets[Polymorphic];
+};
+
+///
+/// One pre-decoded instruction. Operands are already assembled (wide folded
+/// in, signed immediates extended), constant pool entries point to resolved
+/// references and branch targets are absolute indexes in the instruction
+/// array instead of byte offsets. Quickening replaces opcode and ref (and
+/// sets a and b) with the resolved operands of the _quick form
+///
+struct Instruction {
+    unsigned short opcode;
+    int bci;    // offset of the original instruction in the Code attribute
+    int a;      // local index, immediate, atype, dimensions or field slot
+                // (depth of the reference for nullcheck and guard_class,
+                // slots sp moves for trace_enter, locals of the returning
+                // frame for trace_return)
+    int b;      // iinc constant, invokeinterface count or slots of a field
+                // (or of the value returned by trace_return)
+    int target; // branch target as instruction index, -1 if not a branch
+                // (b is the loop of a branch going back, see numberLoops)
+    union {
+        const FieldRef *field;
+        const MethodRef *method;
+        const ConstantRef *constant;
+        const SwitchTable *table;
+        const std::string *class_name;
+        const void *ptr;
+        Slot value;                        // ldc_quick and ldc2_w_quick
+        Slot *static_slot;                 // get/putstatic_quick
+        DecodedMethod *callee;             // invoke_quick
+        InlineCache *cache;                // invokevirtual_mono, poly, mega
+        const RuntimeClass *runtime_class; // new_quick and guard_class
+    } ref;
+    const void *handler; // handler label used by the threaded dispatch
+    int profile; // index in the MethodProfile of the method, -1 if none
+    unsigned short fused; // Superinstruction starting here, or super_none
+    unsigned char cache; // CacheState the handler is entered in
+    unsigned char variant; // CacheVariant of the handler
+};
+
+///
+/// Where compiled code stops: the operand stack pointer and the index of the
+/// instruction the interpreter has to run next
+///
+struct CompiledExit {
+    Slot *sp;
+    int pc;
+};
+
+///
+/// Machine code of a method built by the JitCompiler. It runs the method
+/// from the instruction at pc, with the locals at lva and the operand stack
+/// pointer sp, until it reaches an instruction it leaves to the interpreter
+///
+typedef CompiledExit (*CompiledCode)(Slot *lva, Slot *sp, int pc);
+
+///
+/// Assumption an optimized version was built on: an invokevirtual inlined
+/// because every instantiated class that is runtime_class or one of its
+/// subclasses runs method for the entry index of its vtable. An instance of
+/// a class that runs another method breaks it
+///
+struct Dependency {
+    const RuntimeClass *runtime_class; // of the Methodref
+    int index;
+    const MethodInfoCte *method;
+    int bci; // of the call
+};
+
+///
+/// Result of the decode pass over one Code attribute. The deques own the
+/// resolved references pointed by the instructions and keep their addresses
+/// stable while they grow
+///
+struct DecodedMethod {
+    std::string class_name;
+    unsigned short max_stack;
+    unsigned short max_locals;
+    int arg_slots; // slots of the parameters, receiver included
+    std::vector<Instruction> code;
+    std::deque<FieldRef> fields;
+    std::deque<MethodRef> methods;
+    std::deque<ConstantRef> constants;
+    std::deque<SwitchTable> switches;
+    std::deque<std::string> classes;
+    std::deque<InlineCache> caches; // of the invokevirtual call sites
+    std::vector<ExceptionHandler> handlers; // in exception table order
+    // bodies of the inlined callees, which own the references of the
+    // instructions copied into code
+    std::vector<std::shared_ptr<DecodedMethod>> inlined;
+    bool threaded = false; // handler of every instruction already set
+    CompiledCode compiled = nullptr;
+    // tiered execution, see MethodExecuter::promote. The counter of the
+    // invocations and the tier are kept by the baseline version, decoded
+    // as is, and calls go to its optimized version once there is one
+    MethodInfoCte *info = nullptr;
+    MethodProfile *profile = nullptr; // gathered by the baseline version
+    DecodedMethod *baseline = this;
+    std::shared_ptr<DecodedMethod> optimized; // inlined and compiled
+    int tier       = 0;
+    bool promoting = false; // to the next tier by the compile broker
+    unsigned invocations      = 0;
+    unsigned invocation_limit = 0; // to the next tier
+    // iterations of a loop of this version after which the loop is hot,
+    // see MethodExecuter::hotLoop
+    unsigned back_edge_limit = 0;
+    std::vector<unsigned> back_edges; // taken per loop of this version
+    // deoptimization, see MethodExecuter::deoptimize. For each instruction
+    // of an optimized version, the instruction of the baseline version
+    // that starts from the same locals and operand stack, -1 inside inlined
+    // code. Empty when both versions have the same code
+    std::vector<int> interpreter_index;
+    std::vector<Dependency> dependencies;
+    unsigned deoptimizations = 0; // of the baseline version
+    // traces of the loops of this version, see MethodExecuter::runTrace.
+    // For each instruction the trace it enters and its index there, empty
+    // until there is one
+    std::vector<std::pair<Trace *, int>> trace_entries;
+    // IR the code of an optimized version was lowered from, see IrLowering
+    std::shared_ptr<IrFunction> ir;
+    // times the interpreter dispatched each instruction, empty unless
+    // -XX:+PrintBytecodeNGrams counts them
+    std::vector<unsigned> dispatches;
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef _Ir_H_
+#define _Ir_H_
+
+#include <JVM/structures/Slot.hpp>
+#include <MethodExecuter/Instruction.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+///
+/// Opcodes of the IR that are not JVM opcodes: a constant, a parameter read
+/// from the locals of the frame, a phi and a copy of another value. They are
+/// numbered past the quick opcodes
+///
+enum IrOpcode : unsigned short {
+    ir_const = 0x200,
+    ir_param,
+    ir_phi,
+    ir_copy,
+};
+
+///
+/// Type of the value an IrValue defines, Void for branches, returns and
+/// putstatic. boolean, byte, char and short are Int as on the operand stack
+///
+enum class IrType : unsigned char { Void, Int, Long, Float, Double };
+
+///
+/// One instruction of the IR, which defines the value it computes (static
+/// single assignment). Arithmetic, conversions, comparisons, branches,
+/// returns and static field accesses keep the JVM opcode they come from,
+/// with their operands in args as the values they pop. The args of a phi
+/// are in the order of the predecessors of its block
+///
+struct IrValue {
+    unsigned short opcode; // a JVM opcode or an IrOpcode
+    IrType type;
+    int block; // -1 once removed
+    int bci;
+    std::vector<int> args;
+    Slot constant;         // of ir_const
+    int local;             // first local of ir_param
+    const FieldRef *field; // of getstatic and putstatic
+    Slot *static_slot;     // of field, resolved by the IrInterpreter
+};
+
+///
+/// Basic block: phis first, then straight-line code up to the branch or
+/// return it ends with. A conditional branch goes to succs[0] when taken
+/// and to succs[1] otherwise
+///
+struct IrBlock {
+    int start; // index in the decoded code of its first instruction, or -1
+    std::vector<int> code;
+    std::vector<int> preds;
+    std::vector<int> succs;
+};
+
+/**
+ * IrFunction is the register-based form of a decoded method, in static
+ * single assignment: basic blocks of IrValues that read the values they
+ * use instead of pushing and popping them. It is built by the IrBuilder,
+ * optimized by the PassManager and consumed by the IrInterpreter, which
+ * runs it, and by the IrLowering, which turns it back into instructions for
+ * the interpreter and the JitCompiler.
+ *
+ * blocks[0] is the entry, which reads the parameters and goes to the block
+ * of the first instruction. Values removed keep their index, so the index
+ * of a value is its name for the life of the function.
+ */
+struct IrFunction {
+    std::string name;
+    int arg_slots;
+    int return_slots;
+    std::vector<IrValue> values;
+    std::vector<IrBlock> blocks;
+
+    int newBlock(int start);
+    int add(int block, unsigned short opcode, IrType type,
+            std::vector<int> args, int bci);
+    int constant(int block, IrType type, Slot value, int bci);
+    void remove(int value);
+    void replaceUses(const std::vector<int> &replacement);
+    void removeEdge(int from, int to);
+    void removeUnreachable();
+    std::vector<int> order() const;
+    std::vector<int> dominators(const std::vector<int> &order) const;
+    bool dominates(const std::vector<int> &idom, int a, int b) const;
+    std::vector<int> useCounts() const;
+    int size() const;
+    void print(std::ostream &out) const;
+};
+
+int irSlots(IrType type);
+bool irIsBranch(unsigned short opcode);
+bool irIsReturn(unsigned short opcode);
+bool irCanThrow(const IrFunction &function, const IrValue &value);
+bool irIsPure(const IrFunction &function, const IrValue &value);
+Slot irEvaluate(unsigned short opcode, const Slot *args);
+bool irTaken(unsigned short opcode, const Slot *args);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _IrBuilder_H_
+#define _IrBuilder_H_
+
+#include <MethodExecuter/Instruction.hpp>
+#include <MethodExecuter/Ir.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * IrBuilder translates a decoded method into an IrFunction. The method is
+ * split into basic blocks at branch targets and after branches and
+ * returns, and each block is run symbolically in reverse postorder over a
+ * copy of the locals and of the operand stack that holds values instead of
+ * slots. A block with one predecessor starts from the state the
+ * predecessor ends with, a block with more starts with a phi for each
+ * local and operand one of them defines. Stores to locals become copies,
+ * which copy propagation removes along with the phis that merge a single
+ * value.
+ *
+ * Only methods working on primitive values are translated: constants,
+ * locals, arithmetic, conversions, comparisons, branches, returns and
+ * static fields of primitive type. A method with an exception table,
+ * calls, objects, arrays, references, switches or subroutines is not.
+ */
+class IrBuilder {
+  private:
+    enum { Undefined = -1, Upper = -2 }; // upper half of a long or double
+    ///
+    /// Locals and operand stack of a block, one value index per slot
+    ///
+    struct State {
+        std::vector<int> locals;
+        std::vector<int> stack;
+    };
+    ///
+    /// Where a phi takes its value from in the state of each predecessor
+    ///
+    struct PhiSource {
+        int phi;
+        int block;
+        bool stack;
+        int index;
+    };
+    const DecodedMethod &method;
+    IrFunction *function;
+    std::vector<int> block_at;    // starting at each instruction, or -1
+    std::vector<State> exits;     // of each block
+    std::vector<bool> translated; // blocks whose exit is known
+    std::vector<PhiSource> phis;
+    std::string failure;
+    bool fail(const std::string &reason);
+    bool supported(const Instruction &ins) const;
+    bool addParameters(State &state);
+    void findBlocks();
+    bool entryState(int block, State &state);
+    int pop(std::vector<int> &stack);
+    void push(std::vector<int> &stack, int value);
+    void store(std::vector<int> &locals, int local, int value);
+    bool translate(int block, State &state);
+    bool resolvePhis();
+
+  public:
+    IrBuilder(const DecodedMethod &method);
+    std::unique_ptr<IrFunction> build(const std::string &name);
+    const std::string &reason() const { return failure; }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef _IrInterpreter_H_
+#define _IrInterpreter_H_
+
+#include <JVM/structures/Slot.hpp>
+#include <MethodExecuter/Ir.hpp>
+
+#include <functional>
+#include <vector>
+
+/**
+ * IrInterpreter runs an IrFunction as it is, without lowering it: each
+ * value is a register set once per run of its block, and the phis of a
+ * block are all set at once from the arguments of the edge it is entered
+ * by. Static fields are looked up once through static_field, then read and
+ * written in place. With -XX:+InterpretIR it runs the optimized versions
+ * that have an IrFunction.
+ */
+class IrInterpreter {
+  private:
+    std::function<Slot *(const FieldRef &)> static_field;
+    Slot *field(IrValue &value);
+
+  public:
+    IrInterpreter(std::function<Slot *(const FieldRef &)> static_field);
+    Slot run(IrFunction &function, const Slot *lva);
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _IrLowering_H_
+#define _IrLowering_H_
+
+#include <MethodExecuter/Instruction.hpp>
+#include <MethodExecuter/Ir.hpp>
+
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * IrLowering turns an IrFunction back into the code of a DecodedMethod,
+ * which the interpreter runs and the JitCompiler compiles as any other.
+ *
+ * A value used once, by a value of its own block, is computed where it is
+ * used, straight on the operand stack, when moving it there changes
+ * nothing: it neither throws nor reads a field. Constants are pushed
+ * again by each of their uses. Every other value is stored in a local. The
+ * locals are assigned from the values live at the same time (a value and
+ * the phi it is an argument of, or an iadd of a constant and the value it
+ * adds to, share their local when they can, the second becoming an iinc)
+ * and the parameters keep the locals they are passed in. A phi is set by a
+ * copy at the end of each predecessor, the critical edges being split
+ * first, and blocks are laid out in reverse postorder, without the gotos
+ * to the next block.
+ *
+ * The lowered code shares nothing with the locals of the bytecode, so
+ * frames are never moved between the two (no on-stack replacement or
+ * deoptimization at any of its instructions).
+ */
+class IrLowering {
+  private:
+    IrFunction &function;
+    DecodedMethod &method;
+    std::vector<int> uses;
+    std::vector<bool> inlined; // computed where they are used
+    std::vector<int> local;    // of each value stored in a local, or -1
+    std::vector<std::set<int>> interference; // values live at the same time
+    std::vector<int> block_start; // index in code of the first instruction
+    std::vector<std::pair<int, int>> jumps; // instructions and target blocks
+    std::vector<Instruction> code;
+    int depth;     // of the operand stack
+    int max_depth; // of the operand stack
+    std::string failure;
+    void splitCriticalEdges();
+    void selectInlined();
+    bool stored(int value) const;
+    void operands(int value, std::vector<int> &leaves) const;
+    std::vector<std::set<int>> liveOut(const std::vector<int> &order) const;
+    void interfere(int value, const std::set<int> &live);
+    void buildInterference(const std::vector<int> &order);
+    void assignLocals();
+    Instruction &emit(unsigned short opcode, int bci, int pushed, int popped);
+    void emitConstant(const IrValue &value);
+    void emitLoad(int value);
+    void emitValue(int value);
+    void emitStatement(int value);
+    void emitCopies(int from, int to);
+    void emitTerminator(int block, int next);
+
+  public:
+    IrLowering(IrFunction &function, DecodedMethod &method);
+    bool lower();
+    const std::string &reason() const { return failure; }
+};
+
+#endif
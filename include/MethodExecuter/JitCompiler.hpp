@@ -0,0 +1,63 @@
+#ifndef _JitCompiler_H_
+#define _JitCompiler_H_
+
+#include <MethodExecuter/Instruction.hpp>
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+class X86Assembler;
+
+///
+/// Machine code built for the instructions of a method, with the ones that
+/// got a template
+///
+struct JitCode {
+    CompiledCode entry = nullptr;
+    size_t size        = 0; // in bytes
+    std::vector<bool> compiled;
+};
+
+/**
+ * JitCompiler is a baseline compiler from decoded methods to x86-64 code.
+ * Each instruction becomes a fixed template of machine code working on the
+ * frame of the interpreter: the locals at lva (kept in rbx) and the operand
+ * stack at sp (kept in r12), so the interpreter and compiled code can take
+ * over from each other at any instruction. A jump table maps instruction
+ * indexes to their templates.
+ *
+ * Only simple instructions (constants, loads and stores, arithmetic,
+ * branches, quickened field accesses, array accesses and the frames of the
+ * calls inlined in a Trace) get a template.
+ * Calls, returns, allocation, switches, instructions not quickened yet and
+ * the slow paths of the others (a null reference, an index out of bounds,
+ * a division by zero...) leave the compiled code before changing anything,
+ * so the interpreter runs the instruction itself, throwing if needed, and
+ * then enters the compiled code again. Compiled code never calls into C++.
+ *
+ * A JitCompiler keeps the code it mapped until it is destroyed and compiles
+ * one method at a time, threads need one each. Compiled code is installed
+ * in a method apart, from the thread running the interpreter.
+ */
+class JitCompiler {
+  private:
+    std::vector<std::pair<void *, size_t>> regions; // mapped code
+    std::vector<std::pair<int, int>> branches; // rel32 and target index
+    std::vector<std::pair<int, int>> exits;    // rel32 and index to leave at
+    bool emit(X86Assembler &as, const Instruction &ins, int pc);
+    void branch(X86Assembler &as, int cond, int target);
+    void exitIf(X86Assembler &as, int cond, int pc);
+    void leave(X86Assembler &as, int pc, int epilogue);
+
+  public:
+    JitCompiler() = default;
+    JitCompiler(const JitCompiler &) = delete;
+    JitCompiler &operator=(const JitCompiler &) = delete;
+    ~JitCompiler();
+    bool compile(const std::vector<Instruction> &code, JitCode &result);
+    static void install(DecodedMethod *method, const JitCode &code,
+                        const void *entry);
+};
+
+#endif
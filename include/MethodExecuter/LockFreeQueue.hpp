@@ -0,0 +1,99 @@
+#ifndef _LockFreeQueue_H_
+#define _LockFreeQueue_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+/**
+ * LockFreeQueue is a bounded queue any number of threads can push to and
+ * pop from without locks (the array based queue of Dmitry Vyukov). Each
+ * cell carries a sequence number that tells whether it is free for the
+ * push of the current lap or holds a value for the pop of the current lap,
+ * so pushes and pops only race on the head and tail counters, which they
+ * advance with a compare and swap.
+ */
+template <typename T> class LockFreeQueue {
+  private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    // on their own cache lines, pushes and pops do not share them
+    alignas(64) std::atomic<size_t> tail;
+    alignas(64) std::atomic<size_t> head;
+
+  public:
+    ///
+    /// Queue of capacity values, capacity must be a power of two
+    ///
+    explicit LockFreeQueue(size_t capacity)
+        : cells(new Cell[capacity]), mask(capacity - 1), tail(0), head(0) {
+        for (size_t k = 0; k < capacity; k++) {
+            cells[k].sequence.store(k, std::memory_order_relaxed);
+        }
+    }
+
+    ///
+    /// Appends value, false if the queue is full
+    ///
+    bool push(const T &value) {
+        size_t position = tail.load(std::memory_order_relaxed);
+        for (;;) {
+            auto &cell   = cells[position & mask];
+            size_t ready = cell.sequence.load(std::memory_order_acquire);
+            auto lap     = static_cast<ptrdiff_t>(ready - position);
+            if (lap == 0) {
+                if (tail.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(position + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                position = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ///
+    /// Takes the oldest value into value, false if the queue is empty
+    ///
+    bool pop(T &value) {
+        size_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            auto &cell   = cells[position & mask];
+            size_t ready = cell.sequence.load(std::memory_order_acquire);
+            auto lap     = static_cast<ptrdiff_t>(ready - (position + 1));
+            if (lap == 0) {
+                if (head.compare_exchange_weak(position, position + 1,
+                                               std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(position + mask + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (lap < 0) {
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    ///
+    /// Values in the queue, only a hint while other threads use it
+    ///
+    size_t size() const {
+        size_t pushed = tail.load(std::memory_order_relaxed);
+        size_t popped = head.load(std::memory_order_relaxed);
+        return pushed > popped ? pushed - popped : 0;
+    }
+};
+
+#endif
@@ -2,17 +2,50 @@
 #define _MethodExecuter_H_
 
 #include <DotClassReader/ConstantPool.hpp>
+#include <JVM/VMOptions.hpp>
 #include <JVM/structures/ContextEntry.hpp>
 #include <JVM/structures/FieldMap.hpp>
+#include <JVM/structures/Heap.hpp>
+#include <JVM/structures/Slot.hpp>
+#include <JVM/structures/JavaException.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
 #include <JVM/structures/StackFrame.hpp>
 #include <JVM/structures/Types.hpp>
+#include <JVM/structures/VMStack.hpp>
+#include <MethodExecuter/AotLibrary.hpp>
+#include <MethodExecuter/CompileBroker.hpp>
+#include <MethodExecuter/Inliner.hpp>
+#include <MethodExecuter/Instruction.hpp>
+#include <MethodExecuter/IrInterpreter.hpp>
+#include <MethodExecuter/JitCompiler.hpp>
+#include <MethodExecuter/MethodProfile.hpp>
+#include <MethodExecuter/NativeMethods.hpp>
+#include <MethodExecuter/StackCache.hpp>
+#include <MethodExecuter/Superinstructions.hpp>
+#include <MethodExecuter/TraceRecorder.hpp>
 
 #include <functional>
+#include <map>
 #include <memory>
-#include <stack>
+#include <ostream>
+#include <set>
 #include <string>
 #include <vector>
 
+///
+/// invokevirtual site bound by class hierarchy analysis to the only method
+/// its receivers can run, with what is needed to turn it back into a
+/// virtual call
+///
+struct DevirtualizedCall {
+    Instruction *instruction;
+    const MethodRef *method;
+    const RuntimeClass *runtime_class; // of the Methodref
+    int index;                         // in the vtable of runtime_class
+    DecodedMethod *target;
+    const void *handler; // of invokevirtual, for the threaded dispatch
+};
+
 /**
  * The MethodExecute class is responsible for receiving all of the relevant
  * .class file information regarding the execution of the bytecode (like
@@ -20,31 +53,107 @@
  */
 class MethodExecuter {
   private:
-    std::vector<unsigned char> bytecode;
-    bool isInvokeSpecialInstruction(unsigned char byte);
-    bool isNewInstruction(unsigned char byte);
-    bool isDupInstruction(unsigned char byte);
     std::map<std::string, ConstantPool *> cp;
     // Pair (classname, value)
     std::map<std::string, ClassMethods> *cm;
     std::map<std::string, ClassFields> *cf;
-    std::stack<std::pair<std::string, int>> local_operand_stack;
-    unsigned int countArgs(std::string);
-    std::function<int(std::string, std::string)> getArgsLen;
     std::string class_name;
-    std::string str;
     std::map<std::string, std::string> super_class;
+    std::map<std::string, RuntimeClass> *classes;
+    Heap *heap;
+    NativeMethods natives;
+    VMStack stack;
+    VMOptions options;
+    Inliner inliner;
+    IrInterpreter ir_interpreter;
+#ifdef HAS_JIT
+    const void *jit_entry;    // handler of compiled instructions
+    const void *record_entry; // of the instructions a trace records
+    const void *trace_entry;  // of the instructions entering a trace
+    TraceRecorder recorder;
+    JitCompiler trace_jit;
+    std::vector<std::unique_ptr<Trace>> traces;
+    // recordings aborted by loop, as its version and header
+    std::map<std::pair<const DecodedMethod *, int>, int> trace_aborts;
+#endif
+    TraceCounters trace_counters;
+    const void *deopt_entry; // handler of invalidated instructions
+    const void *count_entry; // of the instructions -XX:+PrintBytecodeNGrams
+                             // counts
+    int methods_at_tier[3] = {0, 0, 0};
+    std::set<const RuntimeClass *> instantiated;
+    std::vector<DevirtualizedCall> devirtualized;
+    // baseline versions whose optimized version has dependencies
+    std::vector<DecodedMethod *> speculating;
+    // optimized versions frames may still run after their invalidation
+    std::vector<std::shared_ptr<DecodedMethod>> invalidated;
+    // their code and dispatches when -XX:+PrintBytecodeNGrams counts them
+    std::vector<std::shared_ptr<DecodedMethod>> counted_versions;
+    unsigned deoptimizations    = 0;
+    unsigned deoptimized_frames = 0;
+    std::vector<const MethodInfoCte *> profiled; // in decoding order
+    AotLibrary aot;
+    // last, its workers stop before what they use is destroyed
+    CompileBroker broker;
+    std::shared_ptr<DecodedMethod>
+    decodeCode(MethodInfoCte &method, const std::string &class_name,
+               const Speculation *speculation);
+    void optimizeIr(DecodedMethod *method, const std::string &name);
+    DecodedMethod *decode(MethodInfoCte &method,
+                          const std::string &class_name);
+    void limitTier(DecodedMethod *method);
+    void promote(DecodedMethod *method, unsigned back_edges);
+    void reachTier(DecodedMethod *method, unsigned back_edges);
+    void installCompiled();
+    StackFrame *hotLoop(StackFrame *frame, Slot *sp, const Instruction &branch);
+    bool traceLoop(StackFrame *frame, const Instruction &branch);
+    void recordStep(StackFrame *frame, int pc);
+    void abortTrace(const std::string &reason);
+    void traceAborted(const DecodedMethod *version, int header,
+                      const std::string &reason);
+    void installTrace();
+    void dropTraces(const DecodedMethod *version, const std::string &reason);
+    void dropTrace(Trace &trace, const std::string &reason);
+    StackFrame *runTrace(StackFrame *frame, Slot *sp, int pc);
+    StackFrame *materialize(const Trace &trace, int index, StackFrame *root);
+    StackFrame *enter(StackFrame *caller, DecodedMethod *callee, Slot *args);
+    bool breaks(const RuntimeClass *runtime_class,
+                const Dependency &dependency) const;
+    void invalidate(DecodedMethod *method, const std::string &reason);
+    StackFrame *deoptimize(StackFrame *frame, Slot *sp, int pc);
+    Slot *staticField(const FieldRef &field);
+    ContextEntry *newObject(const std::string &class_name);
+    int linkField(const FieldRef &field);
+    bool isInstance(ContextEntry *object, const std::string &class_name);
+    template <bool Threaded> Slot run(MethodInfoCte &method, Slot *args);
+    DecodedMethod *findMethod(std::string class_name, const MethodRef &ref);
+    InlineCache newInlineCache(const MethodRef &ref, bool interface);
+    DecodedMethod *selectVirtual(ContextEntry *receiver,
+                                 const InlineCache &cache);
+    DecodedMethod *uniqueTarget(const RuntimeClass *runtime_class, int index);
+    DecodedMethod *devirtualize(Instruction &ins, const InlineCache &cache);
+    void invalidateDevirtualized();
+    StackFrame *invoke(const Instruction &ins, Slot *&sp, StackFrame *frame);
+    int findHandler(DecodedMethod *method, int index, ContextEntry *exception);
 
   public:
     MethodExecuter(std::map<std::string, ConstantPool *> cp,
                    std::map<std::string, ClassMethods> *cm,
                    std::map<std::string, ClassFields> *cf,
-                   std::function<int(std::string, std::string)> getArgsLen,
                    std::string class_name,
-                   std::map<std::string, std::string> super_class);
-    std::shared_ptr<ContextEntry>
-    Exec(std::vector<unsigned char> bytecode,
-         std::vector<std::shared_ptr<ContextEntry>> *ce);
+                   std::map<std::string, std::string> super_class,
+                   std::map<std::string, RuntimeClass> *classes,
+                   Heap *heap, VMOptions options);
+    Slot Exec(MethodInfoCte &method, Slot *args);
+    int inlinedCalls() const;
+    int methodsAtTier(int tier) const;
+    const CompileCounters &compileCounters() const;
+    unsigned deoptimizationCount() const;
+    unsigned deoptimizedFrames() const;
+    TraceCounters traceCounters() const;
+    void printMethodData(std::ostream &out) const;
+    void printTraces(std::ostream &out) const;
+    void printBytecodeNGrams(std::ostream &out) const;
 };
 
 #endif
\ No newline at end of file
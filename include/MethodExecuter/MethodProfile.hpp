@@ -0,0 +1,81 @@
+#ifndef _MethodProfile_H_
+#define _MethodProfile_H_
+
+#include <JVM/structures/ContextEntry.hpp>
+#include <JVM/structures/RuntimeClass.hpp>
+#include <MethodExecuter/Instruction.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+///
+/// Classes of the references one instruction saw: a row for each of the
+/// first Rows classes with the times it was seen, then the references of
+/// any other class (library classes and arrays, which have no RuntimeClass,
+/// included) and the null ones
+///
+struct TypeProfile {
+    enum { Rows = 2 };
+    const RuntimeClass *classes[Rows] = {nullptr, nullptr};
+    unsigned counts[Rows]             = {0, 0};
+    unsigned others                   = 0;
+    unsigned nulls                    = 0;
+
+    void record(const ContextEntry *object) {
+        if (object == nullptr) {
+            nulls++;
+            return;
+        }
+        auto runtime_class = object->runtime_class;
+        for (int row = 0; row < Rows && runtime_class != nullptr; row++) {
+            if (classes[row] == runtime_class || classes[row] == nullptr) {
+                classes[row] = runtime_class;
+                counts[row]++;
+                return;
+            }
+        }
+        others++;
+    }
+};
+
+///
+/// Profile of one instruction: the receivers of a virtual call, the
+/// objects a checkcast or an instanceof tests, the elements an aaload or
+/// an aastore moves, how often a conditional branch is taken or which
+/// targets a switch takes (by index in its SwitchTable, the default last)
+///
+struct ProfileData {
+    unsigned short opcode; // when the method was decoded
+    int bci;
+    TypeProfile types;
+    unsigned taken     = 0;
+    unsigned not_taken = 0;
+    std::vector<unsigned> cases;
+    const SwitchTable *table = nullptr; // keys of the cases
+
+    void branch(bool is_taken) {
+        if (is_taken) {
+            taken++;
+        } else {
+            not_taken++;
+        }
+    }
+};
+
+/**
+ * MethodProfile holds the type feedback the interpreter gathers while a
+ * method runs its baseline version, next to the MethodInfoCte of the
+ * method. Each profiled instruction of the baseline version keeps the
+ * index of its ProfileData, so recording is an index and an increment.
+ * Optimized versions are decoded again and record nothing, so the profile
+ * tells what the method did while it was warming up.
+ */
+struct MethodProfile {
+    std::vector<ProfileData> data;
+
+    explicit MethodProfile(DecodedMethod &method);
+    void print(std::ostream &out, const std::string &name) const;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _NativeMethods_H_
+#define _NativeMethods_H_
+
+#include <JVM/structures/Heap.hpp>
+#include <JVM/structures/Slot.hpp>
+#include <MethodExecuter/Instruction.hpp>
+
+#include <string>
+
+/**
+ * NativeMethods emulates the few library classes the interpreter supports
+ * without loading them: java/lang/Object, java/io/PrintStream (System.out)
+ * and java/lang/StringBuilder. Arguments arrive as the slots popped from the
+ * operand stack of the caller, the receiver first, and values are printed the
+ * way Java's String.valueOf formats them.
+ */
+class NativeMethods {
+  private:
+    Heap *heap;
+    std::string stringOf(const Slot *value, const std::string &type);
+
+  public:
+    NativeMethods(Heap *heap);
+    Slot invoke(const MethodRef &ref, Slot *args);
+    ContextEntry *getStatic(const FieldRef &field);
+    static std::string doubleToString(double value);
+    static std::string floatToString(float value);
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef _PassManager_H_
+#define _PassManager_H_
+
+#include <MethodExecuter/Ir.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * PassManager runs a pipeline of optimization passes over an IrFunction,
+ * over and over until none of them changes it or for Rounds rounds. The
+ * pipeline lists pass names separated by commas (-XX:IRPasses=):
+ *
+ * - constfold: evaluates the values whose arguments are constants, takes
+ *   the conditional branches whose outcome is known and simplifies the
+ *   integer operations a constant makes trivial (x + 0, x * 1, x * 0...);
+ * - copyprop: makes the uses of a copy, and of a phi that merges a single
+ *   value, use that value;
+ * - gvn: global value numbering, a value equal to one computed by a block
+ *   that dominates it (same operation on the same arguments) is dropped;
+ * - licm: moves the values a loop computes from values defined outside of
+ *   it to a preheader block, run once before the loop;
+ * - dse: drops the stores to a static field another store overwrites
+ *   before anything reads it, and the values nothing uses.
+ *
+ * Only values that neither throw nor read or write a field are moved or
+ * merged. Each pass counts the values it changed.
+ */
+class PassManager {
+  private:
+    enum { Rounds = 4 };
+    typedef int (*Pass)(IrFunction &function);
+    std::vector<std::string> names;
+    std::vector<Pass> passes;
+    std::vector<int> changes; // by each pass in the last run
+
+  public:
+    static const char *const default_pipeline;
+    PassManager(const std::string &pipeline);
+    void run(IrFunction &function);
+    std::string report() const;
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef _StackCache_H_
+#define _StackCache_H_
+
+#include <MethodExecuter/Instruction.hpp>
+
+///
+/// Values the threaded interpreter keeps out of the operand stack, in the
+/// tos (top of stack) and nos (next on stack) locals of its loop. A value
+/// of category 2 takes a single local but two slots once spilled
+///
+enum CacheState : unsigned char {
+    cache_none,    // every value is in the operand stack
+    cache_narrow,  // an int, float or reference in tos
+    cache_wide,    // a long or double in tos
+    cache_narrow2, // two category 1 values, the top one in tos
+    cache_wide2,   // two category 2 values, the top one in tos
+    CacheStates
+};
+
+///
+/// How an instruction runs: from its own handler once the cached values
+/// are spilled, from the handler of its opcode for the state it is entered
+/// in, or from the handler of the superinstruction starting there
+///
+enum CacheVariant : unsigned char {
+    variant_generic,
+    variant_cached,
+    variant_fused
+};
+
+///
+/// What the cached handlers of an opcode do to the operand stack, which
+/// decides the states they are entered in and leave (see StackCache.cpp)
+///
+enum CacheShape {
+    shape_push_narrow,   // pushes a category 1 value
+    shape_push_wide,     // pushes a category 2 value
+    shape_pop_narrow,    // pops a category 1 value
+    shape_pop_wide,      // pops a category 2 value
+    shape_unary_narrow,  // replaces a category 1 value
+    shape_unary_wide,    // replaces a category 2 value
+    shape_to_wide,       // turns a category 1 value into a category 2 one
+    shape_to_narrow,     // turns a category 2 value into a category 1 one
+    shape_binary_narrow, // two category 1 values into one
+    shape_binary_wide,   // two category 2 values into one
+    shape_compare_wide,  // two category 2 values into an int
+    shape_branch_narrow, // pops a category 1 value and may branch
+    shape_branch_binary, // pops two category 1 values and may branch
+    shape_array_store,   // pops an array, an index and a category 1 value
+    shape_return_narrow, // returns a category 1 value
+    shape_return_wide    // returns a category 2 value
+};
+
+///
+/// Opcodes of the threaded interpreter with handlers for cached values, as
+/// (name, shape, opcodes...). They are the loads, stores and arithmetic of
+/// the arithmetic heavy loops, with the comparisons and branches that end
+/// them. The rest, with whatever can call or throw on its own, runs from
+/// the handler of its opcode
+///
+#define JVM_CACHED_HANDLERS(X)                                                 \
+    X(load, shape_push_narrow, op_iload, op_fload, op_aload)                   \
+    X(iconst, shape_push_narrow, op_iconst_m1, op_iconst_0, op_iconst_1,       \
+      op_iconst_2, op_iconst_3, op_iconst_4, op_iconst_5, op_bipush,           \
+      op_sipush)                                                               \
+    X(fconst, shape_push_narrow, op_fconst_0, op_fconst_1, op_fconst_2)        \
+    X(aconst_null, shape_push_narrow, op_aconst_null)                          \
+    X(load2, shape_push_wide, op_lload, op_dload)                              \
+    X(lconst, shape_push_wide, op_lconst_0, op_lconst_1)                       \
+    X(dconst, shape_push_wide, op_dconst_0, op_dconst_1)                       \
+    X(store, shape_pop_narrow, op_istore, op_fstore, op_astore)                \
+    X(pop, shape_pop_narrow, op_pop)                                           \
+    X(store2, shape_pop_wide, op_lstore, op_dstore)                            \
+    X(iadd, shape_binary_narrow, op_iadd)                                      \
+    X(isub, shape_binary_narrow, op_isub)                                      \
+    X(imul, shape_binary_narrow, op_imul)                                      \
+    X(iand, shape_binary_narrow, op_iand)                                      \
+    X(ior, shape_binary_narrow, op_ior)                                        \
+    X(ixor, shape_binary_narrow, op_ixor)                                      \
+    X(ishl, shape_binary_narrow, op_ishl)                                      \
+    X(ishr, shape_binary_narrow, op_ishr)                                      \
+    X(iushr, shape_binary_narrow, op_iushr)                                    \
+    X(fadd, shape_binary_narrow, op_fadd)                                      \
+    X(fsub, shape_binary_narrow, op_fsub)                                      \
+    X(fmul, shape_binary_narrow, op_fmul)                                      \
+    X(fdiv, shape_binary_narrow, op_fdiv)                                      \
+    X(fcmp, shape_binary_narrow, op_fcmpl, op_fcmpg)                           \
+    X(iaload, shape_binary_narrow, op_iaload)                                  \
+    X(faload, shape_binary_narrow, op_faload)                                  \
+    X(ladd, shape_binary_wide, op_ladd)                                        \
+    X(lsub, shape_binary_wide, op_lsub)                                        \
+    X(lmul, shape_binary_wide, op_lmul)                                        \
+    X(land, shape_binary_wide, op_land)                                        \
+    X(lor, shape_binary_wide, op_lor)                                          \
+    X(lxor, shape_binary_wide, op_lxor)                                        \
+    X(dadd, shape_binary_wide, op_dadd)                                        \
+    X(dsub, shape_binary_wide, op_dsub)                                        \
+    X(dmul, shape_binary_wide, op_dmul)                                        \
+    X(ddiv, shape_binary_wide, op_ddiv)                                        \
+    X(drem, shape_binary_wide, op_drem)                                        \
+    X(lcmp, shape_compare_wide, op_lcmp)                                       \
+    X(dcmp, shape_compare_wide, op_dcmpl, op_dcmpg)                            \
+    X(ineg, shape_unary_narrow, op_ineg)                                       \
+    X(fneg, shape_unary_narrow, op_fneg)                                       \
+    X(i2f, shape_unary_narrow, op_i2f)                                         \
+    X(f2i, shape_unary_narrow, op_f2i)                                         \
+    X(i2b, shape_unary_narrow, op_i2b)                                         \
+    X(i2c, shape_unary_narrow, op_i2c)                                         \
+    X(i2s, shape_unary_narrow, op_i2s)                                         \
+    X(lneg, shape_unary_wide, op_lneg)                                         \
+    X(dneg, shape_unary_wide, op_dneg)                                         \
+    X(l2d, shape_unary_wide, op_l2d)                                           \
+    X(d2l, shape_unary_wide, op_d2l)                                           \
+    X(i2l, shape_to_wide, op_i2l)                                              \
+    X(i2d, shape_to_wide, op_i2d)                                              \
+    X(f2l, shape_to_wide, op_f2l)                                              \
+    X(f2d, shape_to_wide, op_f2d)                                              \
+    X(l2i, shape_to_narrow, op_l2i)                                            \
+    X(l2f, shape_to_narrow, op_l2f)                                            \
+    X(d2i, shape_to_narrow, op_d2i)                                            \
+    X(d2f, shape_to_narrow, op_d2f)                                            \
+    X(ifeq, shape_branch_narrow, op_ifeq)                                      \
+    X(ifne, shape_branch_narrow, op_ifne)                                      \
+    X(iflt, shape_branch_narrow, op_iflt)                                      \
+    X(ifge, shape_branch_narrow, op_ifge)                                      \
+    X(ifgt, shape_branch_narrow, op_ifgt)                                      \
+    X(ifle, shape_branch_narrow, op_ifle)                                      \
+    X(ifnull, shape_branch_narrow, op_ifnull)                                  \
+    X(ifnonnull, shape_branch_narrow, op_ifnonnull)                            \
+    X(if_icmpeq, shape_branch_binary, op_if_icmpeq)                            \
+    X(if_icmpne, shape_branch_binary, op_if_icmpne)                            \
+    X(if_icmplt, shape_branch_binary, op_if_icmplt)                            \
+    X(if_icmpge, shape_branch_binary, op_if_icmpge)                            \
+    X(if_icmpgt, shape_branch_binary, op_if_icmpgt)                            \
+    X(if_icmple, shape_branch_binary, op_if_icmple)                            \
+    X(if_acmpeq, shape_branch_binary, op_if_acmpeq)                            \
+    X(if_acmpne, shape_branch_binary, op_if_acmpne)                            \
+    X(iastore, shape_array_store, op_iastore)                                  \
+    X(fastore, shape_array_store, op_fastore)                                  \
+    X(ireturn, shape_return_narrow, op_ireturn, op_freturn, op_areturn)        \
+    X(lreturn, shape_return_wide, op_lreturn, op_dreturn)
+
+/**
+ * StackCache plans the top of stack caching of the threaded interpreter
+ * (-XX:+UseStackCaching). Each instruction of a method gets the CacheState
+ * its handler is entered in and the CacheVariant of that handler, so that
+ * the cached handlers of JVM_CACHED_HANDLERS pass the values they push
+ * from one to the next in locals instead of storing and loading them from
+ * the operand stack. The other instructions are entered through a spill
+ * of the cached values to the operand stack before their own handler.
+ *
+ * The plan is static: whatever dispatches an instruction arrives in the
+ * state it was planned for. The first instruction of a basic block, and
+ * the one after anything that can branch, call or return, is entered
+ * with every value in the operand stack, so the frames reaching an
+ * instruction any other way (a call returning, an exception handler, a
+ * branch) find the values where the generic handlers put them. What
+ * enters the interpreter in the middle of a block (the exit of compiled
+ * code or of a trace, a deoptimized frame) loads the values the
+ * instruction expects first.
+ */
+class StackCache {
+  private:
+    // costs of a dispatch and of a generic handler, in slots moved
+    enum { Dispatch = 2, Generic = 3 };
+    static int spillCost(int state);
+    static bool transition(CacheShape shape, int state, int &out, int &cost);
+    static bool cached(unsigned short opcode, int state, int &out,
+                       int &cost);
+
+  public:
+    static int handler(unsigned short opcode);
+    static void plan(DecodedMethod &method, bool fuse, bool cache);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef _Superinstructions_H_
+#define _Superinstructions_H_
+
+#include <MethodExecuter/Instruction.hpp>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+///
+/// Superinstructions of the threaded interpreter, as (name, opcodes...).
+/// They are the opcode sequences -XX:+PrintBytecodeNGrams found the most
+/// dispatches of in the sample programs: loading two locals, the loop
+/// conditions, the loop increments, adding into a local and reading an
+/// array element or a field. An opcode stands for every opcode sharing its
+/// handler (iload for fload and aload, istore for fstore and astore,
+/// iconst_0 for the other iconst, bipush and sipush). Only the last
+/// instruction of a sequence may branch and the first one is never
+/// rewritten into a _quick form. The superinstruction leaves the others to
+/// their own handler until they are
+///
+#define JVM_SUPERINSTRUCTIONS(X)                                               \
+    X(iload_iload, op_iload, op_iload)                                         \
+    X(iload_iload_iadd_istore, op_iload, op_iload, op_iadd, op_istore)         \
+    X(iload_iload_if_icmpge, op_iload, op_iload, op_if_icmpge)                 \
+    X(iload_iconst_if_icmpge, op_iload, op_iconst_0, op_if_icmpge)             \
+    X(iload_ldc_if_icmpge, op_iload, op_ldc, op_if_icmpge)                     \
+    X(iinc_goto, op_iinc, op_goto)                                             \
+    X(iadd_istore, op_iadd, op_istore)                                         \
+    X(aload_iload_iaload, op_aload, op_iload, op_iaload)                       \
+    X(aload_getfield, op_aload, op_getfield)
+
+enum Superinstruction : unsigned short {
+    super_none,
+#define SUPERINSTRUCTION_ENUM(name, ...) super_##name,
+    JVM_SUPERINSTRUCTIONS(SUPERINSTRUCTION_ENUM)
+#undef SUPERINSTRUCTION_ENUM
+    super_count // the superinstructions and super_none
+};
+
+/**
+ * Superinstructions fuses the instruction sequences of
+ * JVM_SUPERINSTRUCTIONS into one dispatch of the threaded interpreter. The
+ * first instruction of a sequence gets the handler of the superinstruction,
+ * which runs the whole sequence and dispatches the instruction after it.
+ * The other instructions stay where they are with their own handlers, so
+ * code that goes on in the middle of a sequence (a frame coming back from
+ * compiled code or from a trace, a deoptimized frame) just runs them one
+ * by one, and the JIT, the trace recorder and the IR never see anything
+ * but plain instructions. A sequence is only fused inside a basic block:
+ * none of its instructions but the first is a branch target or an
+ * exception handler.
+ *
+ * It also writes the n-gram report of -XX:+PrintBytecodeNGrams from the
+ * instructions the interpreter dispatched in each method.
+ */
+class Superinstructions {
+  private:
+    enum { Top = 10 }; // n-grams reported for each length
+    static bool matches(Superinstruction super, const DecodedMethod &method,
+                        const std::vector<bool> &starts, int index);
+
+  public:
+    static const char *name(Superinstruction super);
+    static int length(Superinstruction super);
+    static void fuse(DecodedMethod &method);
+    static void printNGrams(std::ostream &out,
+                            const std::vector<const DecodedMethod *> &methods,
+                            int max_length);
+};
+
+#endif
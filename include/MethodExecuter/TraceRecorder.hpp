@@ -0,0 +1,132 @@
+#ifndef _TraceRecorder_H_
+#define _TraceRecorder_H_
+
+#include <JVM/structures/RuntimeClass.hpp>
+#include <JVM/structures/StackFrame.hpp>
+#include <MethodExecuter/Instruction.hpp>
+#include <MethodExecuter/JitCompiler.hpp>
+
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+///
+/// Frame a trace runs code of: the root frame, running the loop, or the
+/// frame of a call made from one of them, inlined in the trace. lva is
+/// where its locals start, in slots from the ones of the root frame
+///
+struct TraceFrame {
+    DecodedMethod *method;
+    int parent;    // index of the calling frame, -1 for the root frame
+    int return_pc; // of the calling frame once the call returns
+    int lva;
+    const RuntimeClass *receiver; // class the call was recorded for
+};
+
+///
+/// Where the interpreter goes on when the compiled code of a trace stops at
+/// one of its instructions: the instruction pc of the method of frame. side
+/// is set when the trace leaves the recorded path there (a guard failed)
+///
+struct TraceExit {
+    int frame;
+    int pc;
+    bool side;
+};
+
+///
+/// Linear code of one iteration of a hot loop, with the code of the calls
+/// it made inlined, compiled by the JitCompiler. It starts at the loop
+/// header in version and goes back to it at its end. Each instruction has
+/// its exit, and the instructions of the root frame the trace can be
+/// entered at are listed in entry_points as (pc in version, index in code)
+///
+struct Trace {
+    DecodedMethod *version;
+    int header;
+    std::vector<Instruction> code;
+    std::vector<TraceExit> exits; // by index in code
+    std::vector<TraceFrame> frames;
+    std::vector<std::pair<int, int>> entry_points;
+    int extent; // slots of the VM stack it uses past the root locals
+    JitCode jit;
+    // handlers of the instructions of version entering the trace
+    std::vector<std::pair<Instruction *, const void *>> handlers;
+    bool dropped        = false;
+    unsigned entries    = 0;
+    unsigned side_exits = 0;
+    Slot iterations{}; // j counts the times it goes back to the header
+    bool uses(const DecodedMethod *method) const;
+    unsigned long runs() const;
+};
+
+///
+/// Traces recorded and given up, with what their compiled code did: the
+/// times it was entered, ran through the trace (from an entry or from the
+/// end of the trace back to its start) and left through a guard
+///
+struct TraceCounters {
+    unsigned recorded   = 0;
+    unsigned aborted    = 0;
+    unsigned dropped    = 0;
+    unsigned entries    = 0;
+    unsigned long runs  = 0;
+    unsigned side_exits = 0;
+};
+
+/**
+ * TraceRecorder records the instructions the interpreter runs through one
+ * iteration of a hot loop, following the calls it makes, and turns them
+ * into a Trace (-XX:+UseTraceJIT).
+ *
+ * The handler of every instruction of the methods involved is replaced by
+ * the recording one while it records, and given back when it stops, so
+ * the interpreter reports each instruction to record before running it.
+ * Recording completes when the root frame reaches the loop header again,
+ * and is aborted when the iteration runs an inner loop, returns from the
+ * root frame, throws, runs a subroutine, quickens an instruction or gets
+ * longer than the limit. Compiled methods are interpreted while recording.
+ *
+ * Conditional branches of the trace become guards on the recorded
+ * direction, which leave to an exit where the other direction goes on,
+ * and gotos disappear. The calls followed into a method of a loaded class
+ * are inlined: the receiver is guarded to be of the recorded class, its
+ * frame is laid out where the interpreter would push it (trace_enter), its
+ * locals are moved by the place of the frame and its returns copy the
+ * result to the calling frame (trace_return). Every other instruction is
+ * copied, the ones the JitCompiler leaves to the interpreter become exits.
+ * The trace counts its iterations before going back to its start.
+ */
+class TraceRecorder {
+  private:
+    StackFrame *root = nullptr;
+    int header;
+    const void *entry; // recording handler
+    int limit;
+    std::vector<TraceFrame> frames;
+    std::vector<std::pair<int, int>> steps; // frame index and pc
+    std::vector<StackFrame *> active;       // frames of the call chain
+    std::vector<int> active_index;          // their index in frames
+    std::set<std::pair<int, int>> seen;     // steps recorded
+    std::set<DecodedMethod *> watched;
+    std::vector<std::pair<Instruction *, const void *>> patched;
+    std::string failure;
+    bool fail(const std::string &reason);
+
+  public:
+    enum Result { Recording, Complete, Aborted };
+    bool recording() const { return root != nullptr; }
+    DecodedMethod *version() const { return frames[0].method; }
+    int loopHeader() const { return header; }
+    bool start(StackFrame *frame, int header, const void *entry, int limit);
+    bool watch(DecodedMethod *method);
+    bool watches(const DecodedMethod *method) const;
+    Result record(StackFrame *frame, int pc);
+    std::unique_ptr<Trace> build() const;
+    void stop();
+    const std::string &reason() const { return failure; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef _X86Assembler_H_
+#define _X86Assembler_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+///
+/// General purpose registers of x86-64 in encoding order, xmm registers use
+/// the same numbers
+///
+enum Reg { rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi, r8, r9, r10, r11, r12, r13 };
+
+///
+/// Condition codes of jcc, setcc and cmovcc
+///
+enum Cond { below = 0x2, above_equal, equal, not_equal, below_equal, above,
+            parity = 0xa, less = 0xc, greater_equal, less_equal, greater };
+
+/**
+ * X86Assembler encodes the few x86-64 instructions the JitCompiler needs
+ * into a byte buffer. Instructions are given by their opcode bytes and the
+ * ModRM operands (the reg field, which is the opcode extension for the /n
+ * forms, and a register or a [base + index * scale + disp] memory operand),
+ * the assembler adds the prefix, REX, ModRM, SIB and displacement bytes.
+ * Immediates are appended by the caller.
+ */
+class X86Assembler {
+  public:
+    std::vector<uint8_t> code;
+
+    int size() const;
+    void byte(int value);
+    void dword(int32_t value);
+    void qword(int64_t value);
+    ///
+    /// Instruction with a memory operand, wide sets REX.W and prefix (0x66,
+    /// 0xf2 or 0xf3) goes before REX
+    ///
+    void mem(std::initializer_list<int> opcode, int reg, Reg base, int disp,
+             bool wide, int prefix = 0, int index = -1, int scale = 1);
+    ///
+    /// Instruction with a register operand (ModRM mod 11)
+    ///
+    void regs(std::initializer_list<int> opcode, int reg, int rm, bool wide,
+              int prefix = 0);
+    void movImm(Reg reg, int64_t value);
+    void addImm(Reg reg, int32_t value, bool wide);
+    void push(Reg reg);
+    void pop(Reg reg);
+    void ret();
+    ///
+    /// lea reg, [rip + disp32], returns where disp32 is to patch it
+    ///
+    int leaRip(Reg reg);
+    ///
+    /// jcc rel32 (jmp when cond is -1), returns where rel32 is to bind it
+    ///
+    int jump(int cond);
+    ///
+    /// Makes the rel32 at fixup reach the code at offset target
+    ///
+    void bind(int fixup, int target);
+};
+
+#endif
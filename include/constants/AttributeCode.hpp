@@ -4,6 +4,7 @@
 #include <constants/AttributeInfo.hpp>
 #include <constants/LineTableNumber.hpp>
 #include <string>
+#include <vector>
 
 struct exception {
     unsigned short int start_pc;
@@ -2,7 +2,12 @@
 #define _MethodInfoCte_H_
 
 #include <constants/AttributeCode.hpp>
+#include <memory>
 #include <string>
+#include <vector>
+
+struct DecodedMethod;
+struct MethodProfile;
 
 struct MethodInfoCte {
     unsigned short int access_flags;
@@ -14,6 +19,11 @@ struct MethodInfoCte {
     unsigned short int attributes_count;
     std::vector<AttributeCode> attributes;
     std::vector<AttributeInfo> attributes_info;
+    /// Instruction stream built from attributes[0] on the first invocation,
+    /// its baseline version in the tiers of DecodedMethod
+    std::shared_ptr<DecodedMethod> decoded;
+    /// Type feedback recorded by the interpreter while decoded runs
+    std::shared_ptr<MethodProfile> profile;
     MethodInfoCte(int af, int ni, int di, int ac,
                   std::vector<AttributeCode> attrc,
                   std::vector<AttributeInfo> attri) {
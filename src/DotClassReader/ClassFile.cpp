@@ -324,4 +324,14 @@ void ClassFile::createCPMap(std::vector<std::string> external_classes) {
 
 std::map<std::string, std::string> ClassFile::getSuper(std::string class_name) {
     return super_map;
-}
\ No newline at end of file
+}
+
+///
+/// Returns the direct superinterfaces of every loaded class
+///
+std::map<std::string, std::vector<std::string>> ClassFile::getInterfaces() {
+    std::map<std::string, std::vector<std::string>> interfaces;
+    for (auto itf : itf_map)
+        interfaces.insert(std::make_pair(itf.first, itf.second->getITFNames()));
+    return interfaces;
+}
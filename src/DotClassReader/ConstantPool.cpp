@@ -601,6 +601,10 @@ std::string ConstantPool::getNameAndTypeByIndex(int index) {
         auto methref =
             std::static_pointer_cast<Methodref>(constant_pool[index].second);
         return methref->name_and_type;
+    } else if (constant_pool[index].first == 11) {
+        auto interface_ref = std::static_pointer_cast<InterfaceMethodref>(
+            constant_pool[index].second);
+        return interface_ref->name_and_type;
     } else {
         throw std::runtime_error(
             "Requested index is not a reference to a method");
@@ -670,6 +674,44 @@ std::string ConstantPool::getFieldByIndex(int index) {
     return name_and_type->name;
 }
 
+/// If the index points to a Fieldref entry on the ConstantPool,
+/// returns the name of the class that declares the field
+std::string ConstantPool::getFieldClassByIndex(int index) {
+    if (index > constant_pool.size() - 1 || index == 0) {
+        char error[80];
+        sprintf(error,
+                "Requested index %d is out of range, allowed range: 1-%ld",
+                index, constant_pool.size() - 1);
+        throw std::invalid_argument(error);
+    }
+    if (constant_pool[index].first != 9) {
+        throw std::runtime_error("index is not a FieldRef");
+    }
+    auto fieldRef =
+        std::static_pointer_cast<Fieldref>(constant_pool[index].second);
+    return fieldRef->class_name;
+}
+
+/// If the index points to a Fieldref entry on the ConstantPool,
+/// returns the field descriptor
+std::string ConstantPool::getFieldDescriptorByIndex(int index) {
+    if (index > constant_pool.size() - 1 || index == 0) {
+        char error[80];
+        sprintf(error,
+                "Requested index %d is out of range, allowed range: 1-%ld",
+                index, constant_pool.size() - 1);
+        throw std::invalid_argument(error);
+    }
+    if (constant_pool[index].first != 9) {
+        throw std::runtime_error("index is not a FieldRef");
+    }
+    auto fieldRef =
+        std::static_pointer_cast<Fieldref>(constant_pool[index].second);
+    auto name_and_type = std::static_pointer_cast<NameAndType>(
+        constant_pool[fieldRef->name_type_index].second);
+    return name_and_type->descriptor;
+}
+
 std::vector<std::string>
 ConstantPool::getExternalClasses(std::string this_class) {
     std::vector<std::string> external_classes;
@@ -702,6 +744,11 @@ std::string ConstantPool::getClassNameFromMethodByIndex(int index) {
                 index, constant_pool.size() - 1);
         throw std::invalid_argument(error);
     }
+    if (constant_pool[index].first == 11) {
+        auto interface_ref = std::static_pointer_cast<InterfaceMethodref>(
+            constant_pool[index].second);
+        return interface_ref->class_name;
+    }
     if (constant_pool[index].first != 10) {
         char error[150];
         sprintf(error,
@@ -16,6 +16,8 @@ void Interface::show() {
 
 std::vector<int> Interface::getITF() { return itf; }
 
+std::vector<std::string> Interface::getITFNames() { return itf_name; }
+
 int Interface::itfCount() { return interface_count; }
 
 void Interface::seek() {
@@ -1,11 +1,16 @@
 #include <JVM/JVM.hpp>
 #include <JVM/structures/ContextEntry.hpp>
+#include <MethodExecuter/AotCompiler.hpp>
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 
-JVM::JVM(ClassFile *cl) {
-    class_loader = cl;
+JVM::JVM(ClassFile *cl, VMOptions options) {
+    class_loader  = cl;
+    this->options = options;
     class_name   = class_loader->getClassName();
     super_class  = class_loader->getSuper(class_name);
+    interfaces   = class_loader->getInterfaces();
 }
 
 ClassMethods JVM::convertMethodIntoMap(std::vector<MethodInfoCte> mi) {
@@ -18,109 +23,243 @@ ClassMethods JVM::convertMethodIntoMap(std::vector<MethodInfoCte> mi) {
     return cm;
 }
 
+///
+/// Static fields of a class, they start as zero, false or null
+///
 ClassFields JVM::convertFieldIntoMap(std::vector<FieldInfoCte> fi) {
     ClassFields cf;
     for (auto f : fi) {
-        if (f.descriptor.length() == 1) {
-            int zero     = 0;
-            auto zeroref = reinterpret_cast<void *>(&zero);
-            cf[f.name]   = std::make_shared<ContextEntry>(
-                "", TypeMap.at(f.descriptor), zeroref);
+        if (f.access_flags & 0x0008) { // ACC_STATIC
+            cf[f.name] = Slot{};
+        }
+    }
+    return cf;
+}
+
+///
+/// Links class_name (and its super classes first): its instance fields get
+/// the slots after the ones of the super class, in declaration order, its
+/// virtual methods override or extend the vtable of the super class and
+/// the methods of the interfaces it implements are filled in its itable
+///
+RuntimeClass &
+JVM::linkClass(std::string class_name,
+               std::map<std::string, RuntimeClass> &classes,
+               std::map<std::string, std::vector<FieldInfoCte> *> &fields,
+               std::map<std::string, ClassMethods> &methods) {
+    auto linked = classes.find(class_name);
+    if (linked != classes.end()) {
+        return linked->second;
+    }
+    RuntimeClass runtime_class;
+    runtime_class.name           = class_name;
+    runtime_class.super          = nullptr;
+    runtime_class.instance_slots = 0;
+    RuntimeClass *super_runtime  = nullptr;
+    auto super                   = super_class.find(class_name);
+    if (super != super_class.end() && fields.count(super->second)) {
+        super_runtime = &linkClass(super->second, classes, fields, methods);
+        runtime_class.super          = super_runtime;
+        runtime_class.field_offsets  = super_runtime->field_offsets;
+        runtime_class.instance_slots = super_runtime->instance_slots;
+        runtime_class.vtable         = super_runtime->vtable;
+        runtime_class.vtable_index   = super_runtime->vtable_index;
+    }
+    for (auto &field : *fields.at(class_name)) {
+        if (!(field.access_flags & 0x0008)) {
+            // hides a field with the same name of a super class
+            runtime_class.field_offsets[field.name] =
+                runtime_class.instance_slots++;
+        }
+    }
+    for (auto &method : methods.at(class_name)) {
+        // static, private and initialization methods are never virtual
+        if ((method.second.access_flags & 0x000a) ||
+            method.second.name[0] == '<') {
+            continue;
+        }
+        VirtualMethod entry{&method.second, class_name};
+        auto index = runtime_class.vtable_index.find(method.first);
+        if (index != runtime_class.vtable_index.end()) {
+            runtime_class.vtable[index->second] = entry;
         } else {
-            int dimension = 0;
-            std::string type;
-            for (auto desc = f.descriptor.begin(); desc < f.descriptor.end();
-                 desc++) {
-                if (*desc == '[') {
-                    dimension++;
-                    continue;
-                }
-                type = std::string(desc, f.descriptor.end());
-                break;
-            }
-            std::shared_ptr<ContextEntry> array_operator = nullptr;
-            if (dimension >= 1) {
-                if (type[0] != 'L') {
-                    array_operator =
-                        std::make_shared<ContextEntry>("", TypeMap.at(type), 1);
-                    std::shared_ptr<ContextEntry> init = array_operator;
-                    for (auto i = 0; i < dimension - 1; i++) {
-                        auto newarray = std::make_shared<ContextEntry>(
-                            "", TypeMap.at(type), 1);
-                        array_operator->addToArray(0, newarray);
-                        array_operator = std::move(array_operator->arrayRef[0]);
-                    }
-                    cf[f.name] = init;
-                } else {
-                    array_operator = std::make_shared<ContextEntry>(type, L, 1);
-                    std::shared_ptr<ContextEntry> init = array_operator;
-                    for (auto i = 0; i < dimension - 1; i++) {
-                        auto newarray = std::make_shared<ContextEntry>(
-                            "", TypeMap.at(type), 1);
-                        array_operator->addToArray(0, newarray);
-                        array_operator = std::move(array_operator->arrayRef[0]);
-                    }
-                    cf[f.name] = init;
-                }
-                break;
-            } else {
-                cf[f.name] = std::make_shared<ContextEntry>(type, L, nullptr);
+            runtime_class.vtable_index[method.first] =
+                runtime_class.vtable.size();
+            runtime_class.vtable.push_back(entry);
+        }
+    }
+    // interfaces implemented by the super class, then the ones of this
+    // class along with their superinterfaces
+    std::vector<const RuntimeClass *> implemented;
+    if (runtime_class.super != nullptr) {
+        for (auto &table : runtime_class.super->itable) {
+            implemented.push_back(table.interface);
+        }
+    }
+    for (auto &name : interfaces[class_name]) {
+        if (!fields.count(name)) {
+            continue; // library interfaces are not loaded
+        }
+        auto &interface = linkClass(name, classes, fields, methods);
+        implemented.push_back(&interface);
+        for (auto &table : interface.itable) {
+            implemented.push_back(table.interface);
+        }
+    }
+    for (auto interface : implemented) {
+        auto &itable = runtime_class.itable;
+        if (std::any_of(itable.begin(), itable.end(), [&](InterfaceTable &t) {
+                return t.interface == interface;
+            })) {
+            continue;
+        }
+        // a method of the class (or of a super class) takes precedence over
+        // the default method, or the abstract one, of the interface
+        InterfaceTable table{interface, interface->vtable};
+        for (auto &index : interface->vtable_index) {
+            auto method = runtime_class.vtable_index.find(index.first);
+            if (method != runtime_class.vtable_index.end()) {
+                table.methods[index.second] =
+                    runtime_class.vtable[method->second];
             }
         }
+        itable.push_back(table);
     }
-    return cf;
+    auto &linked_class = classes[class_name] = runtime_class;
+    if (super_runtime != nullptr) {
+        super_runtime->subclasses.push_back(&linked_class);
+    }
+    return linked_class;
 }
 
-/**
- * Gets the information needed from the class_loader class variable, extracts
- * the bytecode and calls the executeByteCode method that will interpret the
- * code.
- */
-void JVM::Run() {
-    MethodInfoCte main = class_loader->getMainMethod();
-    auto all_fields    = class_loader->getFields();
-    std::map<std::string, ClassFields> field_map;
+///
+/// Builds the static fields, the methods and the linked classes of every
+/// class the class_loader loaded
+///
+void JVM::load(std::map<std::string, ClassFields> &field_map,
+               std::map<std::string, ClassMethods> &method_map,
+               std::map<std::string, RuntimeClass> &classes) {
+    auto all_fields = class_loader->getFields();
     for (auto field : all_fields) {
         field_map.insert(
             std::make_pair(field.first, convertFieldIntoMap(*field.second)));
     }
     auto all_methods = class_loader->getMethods();
-    std::map<std::string, ClassMethods> method_map;
     for (auto method : all_methods) {
         method_map.insert(
             std::make_pair(method.first, convertMethodIntoMap(*method.second)));
     }
+    // vtables point to the methods in method_map, which is not changed
+    // after this
+    for (auto field : all_fields) {
+        linkClass(field.first, classes, all_fields, method_map);
+    }
+}
+
+/**
+ * Gets the information needed from the class_loader class variable, extracts
+ * the bytecode and calls the executeByteCode method that will interpret the
+ * code.
+ */
+void JVM::Run() {
+    MethodInfoCte main = class_loader->getMainMethod();
+    std::map<std::string, ClassFields> field_map;
+    std::map<std::string, ClassMethods> method_map;
+    std::map<std::string, RuntimeClass> classes;
+    load(field_map, method_map, classes);
     if (main.attributes_count < 1) {
         throw std::out_of_range(
             "Method main must have only one code attribute, check .class file");
     }
-    auto method_attribute_code = main.attributes[0];
-    auto code_length           = method_attribute_code.code_length;
-    if (!code_length) {
+    // the entry from method_map is used so its decoded code stays cached
+    auto &main_method =
+        method_map.at(class_name).at(main.name + main.descriptor);
+    if (!main_method.attributes[0].code_length) {
         std::cout << "No code to be executed" << std::endl;
         return;
     }
-    std::shared_ptr<ContextEntry> main_context(
-        new ContextEntry(field_map.at(class_name), class_name));
-    std::vector<std::shared_ptr<ContextEntry>> context{main_context};
-    stack_per_thread.push(StackFrame(context));
+    executeByteCode(main_method, &field_map, &method_map, &classes);
+}
 
-    auto code = method_attribute_code.code;
-    executeByteCode(code, &field_map, &method_map);
+/**
+ * Compiles the methods of every loaded class to C++ ahead of time and builds
+ * them into the shared object output, which -XX:AOTLibrary= loads.
+ */
+void JVM::Compile(const std::string &output) {
+    std::map<std::string, ClassFields> field_map;
+    std::map<std::string, ClassMethods> method_map;
+    std::map<std::string, RuntimeClass> classes;
+    load(field_map, method_map, classes);
+    AotCompiler compiler(class_loader->getCP(), &field_map, &classes,
+                         super_class);
+    int methods = 0;
+    for (auto &loaded : method_map) {
+        for (auto &method : loaded.second) {
+            methods++;
+            compiler.add(method.second, loaded.first);
+        }
+    }
+    compiler.build(output);
+    std::cout << "Compiled " << compiler.methodCount() << " of " << methods
+              << " methods into " << output << std::endl;
 }
 
 /**
  * Sets up the context for bytecode execution and calls the method Exec from the
  * MethodExecuter class.
  */
-void JVM::executeByteCode(std::vector<unsigned char> code,
+void JVM::executeByteCode(MethodInfoCte &method,
                           std::map<std::string, ClassFields> *cf,
-                          std::map<std::string, ClassMethods> *cm) {
-    auto context = &stack_per_thread.top().lva;
-    std::function<int(std::string, std::string)> getArgsLength(
-        std::bind(&ClassFile::getMethodArgsLength, class_loader,
-                  std::placeholders::_1, std::placeholders::_2));
-    auto me = new MethodExecuter(class_loader->getCP(), cm, cf, getArgsLength,
-                                 class_name, super_class);
-    me->Exec(code, context);
+                          std::map<std::string, ClassMethods> *cm,
+                          std::map<std::string, RuntimeClass> *classes) {
+    Slot args[1];
+    args[0].ref = heap.allocateArray("java/lang/String", L, 0); // String[] args
+    MethodExecuter me(class_loader->getCP(), cm, cf, class_name, super_class,
+                      classes, &heap, options);
+    try {
+        me.Exec(method, args);
+    } catch (JavaException &exception) {
+        std::cerr << "Exception in thread \"main\" " << exception.what()
+                  << std::endl;
+    }
+    if (options.print_inlining) {
+        std::cerr << me.inlinedCalls() << " call sites inlined" << std::endl;
+    }
+    if (options.print_tiers) {
+        std::cerr << "Methods per tier: " << me.methodsAtTier(0) << " "
+                  << me.methodsAtTier(1) << " " << me.methodsAtTier(2)
+                  << std::endl;
+    }
+    if (options.print_compile_counters) {
+        auto &counters = me.compileCounters();
+        std::cerr << "Compile broker: " << counters.tasks << " tasks, "
+                  << "longest queue " << counters.longest_queue << ", "
+                  << counters.micros / 1000.0 << " ms compiling, "
+                  << counters.code_bytes << " bytes of code installed"
+                  << std::endl;
+    }
+    if (options.print_deoptimization) {
+        std::cerr << "Deoptimizations: " << me.deoptimizationCount() << ", "
+                  << me.deoptimizedFrames()
+                  << " frames sent back to the interpreter" << std::endl;
+    }
+    if (options.print_method_data) {
+        me.printMethodData(std::cerr);
+    }
+    if (options.print_traces) {
+        auto counters = me.traceCounters();
+        std::cerr << "Traces: " << counters.recorded << " recorded, "
+                  << counters.aborted << " aborted, " << counters.dropped
+                  << " dropped, " << counters.entries << " entries, "
+                  << counters.runs << " runs, " << counters.side_exits
+                  << " side exits (" << std::fixed << std::setprecision(2)
+                  << (counters.runs > 0
+                          ? 100.0 * counters.side_exits / counters.runs
+                          : 0.0)
+                  << "% of the runs)" << std::endl;
+        me.printTraces(std::cerr);
+    }
+    if (options.print_ngrams) {
+        me.printBytecodeNGrams(std::cerr);
+    }
 }
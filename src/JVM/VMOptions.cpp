@@ -0,0 +1,224 @@
+#include <JVM/VMOptions.hpp>
+#include <MethodExecuter/PassManager.hpp>
+#include <stdexcept>
+#include <thread>
+
+VMOptions::VMOptions() {
+#if defined(THREADED_DISPATCH) && defined(HAS_COMPUTED_GOTO)
+    dispatch = Threaded;
+#else
+    dispatch = Switch;
+#endif
+    stack_size      = 1024 * 1024;
+    inline_calls    = true;
+    max_inline_size = 35;
+    print_inlining  = false;
+#ifdef HAS_JIT
+    jit = true;
+#else
+    jit = false;
+#endif
+    tier1_threshold           = 100;
+    tier1_back_edge_threshold = 1000;
+    compile_threshold         = 1000;
+    back_edge_threshold       = 10000;
+    print_tiers               = false;
+    // a compile thread only takes time from the interpreter on one core
+    background_compilation    = std::thread::hardware_concurrency() > 1;
+    compiler_count            = 1;
+    print_compile_counters    = false;
+    per_method_trap_limit     = 4;
+    print_deoptimization      = false;
+    profile_interpreter       = true;
+    print_method_data         = false;
+    trace_jit                 = false;
+    max_trace_length          = 1000;
+    print_traces              = false;
+    use_ir                    = false;
+    interpret_ir              = false;
+    ir_passes                 = PassManager::default_pipeline;
+    print_ir                  = false;
+    use_superinstructions     = true;
+    print_ngrams              = false;
+    ngram_length              = 4;
+    use_stack_caching         = true;
+}
+
+///
+/// Reads sizes like 512k, 4m or 1g, plain numbers are in bytes
+///
+static unsigned long parseSize(std::string size) {
+    size_t end           = 0;
+    unsigned long number = std::stoul(size, &end);
+    std::string unit     = size.substr(end);
+    if (unit == "k" || unit == "K") {
+        number *= 1024;
+    } else if (unit == "m" || unit == "M") {
+        number *= 1024 * 1024;
+    } else if (unit == "g" || unit == "G") {
+        number *= 1024 * 1024 * 1024;
+    } else if (!unit.empty()) {
+        throw std::invalid_argument("Invalid size " + size);
+    }
+    return number;
+}
+
+///
+/// Applies one command line option, returns false if it is not a VM option
+///
+bool VMOptions::parse(std::string option) {
+    if (option == "-Xdispatch:switch") {
+        dispatch = Switch;
+    } else if (option == "-Xdispatch:threaded") {
+#ifdef HAS_COMPUTED_GOTO
+        dispatch = Threaded;
+#else
+        throw std::invalid_argument(
+            "-Xdispatch:threaded needs a compiler with computed goto support");
+#endif
+    } else if (option.compare(0, 4, "-Xss") == 0) {
+        stack_size = parseSize(option.substr(4));
+    } else if (option == "-XX:+Inline" || option == "-XX:-Inline") {
+        inline_calls = option[4] == '+';
+    } else if (option.compare(0, 18, "-XX:MaxInlineSize=") == 0) {
+        max_inline_size = std::stoi(option.substr(18));
+    } else if (option == "-XX:+PrintInlining") {
+        print_inlining = true;
+    } else if (option == "-Xint") {
+        jit = false;
+    } else if (option == "-Xjit") {
+#ifdef HAS_JIT
+        jit = true;
+#else
+        throw std::invalid_argument(
+            "-Xjit needs an x86-64 Unix build with computed goto support");
+#endif
+    } else if (option.compare(0, 19, "-XX:Tier1Threshold=") == 0) {
+        tier1_threshold = std::stoi(option.substr(19));
+    } else if (option.compare(0, 27, "-XX:Tier1BackEdgeThreshold=") == 0) {
+        tier1_back_edge_threshold = std::stoi(option.substr(27));
+    } else if (option.compare(0, 21, "-XX:CompileThreshold=") == 0) {
+        compile_threshold = std::stoi(option.substr(21));
+    } else if (option.compare(0, 22, "-XX:BackEdgeThreshold=") == 0) {
+        back_edge_threshold = std::stoi(option.substr(22));
+    } else if (option == "-XX:+PrintTiers") {
+        print_tiers = true;
+    } else if (option == "-Xbatch") {
+        background_compilation = false;
+    } else if (option == "-XX:+BackgroundCompilation" ||
+               option == "-XX:-BackgroundCompilation") {
+        background_compilation = option[4] == '+';
+    } else if (option.compare(0, 20, "-XX:CICompilerCount=") == 0) {
+        compiler_count = std::stoi(option.substr(20));
+        if (compiler_count < 1) {
+            throw std::invalid_argument("-XX:CICompilerCount must be >= 1");
+        }
+    } else if (option == "-XX:+CITime") {
+        print_compile_counters = true;
+    } else if (option.compare(0, 23, "-XX:PerMethodTrapLimit=") == 0) {
+        per_method_trap_limit = std::stoul(option.substr(23));
+    } else if (option == "-XX:+PrintDeoptimization") {
+        print_deoptimization = true;
+    } else if (option == "-XX:+ProfileInterpreter" ||
+               option == "-XX:-ProfileInterpreter") {
+        profile_interpreter = option[4] == '+';
+    } else if (option == "-XX:+PrintMethodData") {
+        print_method_data = true;
+    } else if (option.compare(0, 15, "-XX:AOTLibrary=") == 0) {
+#ifdef HAS_JIT
+        aot_library = option.substr(15);
+#else
+        throw std::invalid_argument(
+            "-XX:AOTLibrary needs an x86-64 Unix build with computed goto "
+            "support");
+#endif
+    } else if (option == "-XX:+UseTraceJIT" || option == "-XX:-UseTraceJIT") {
+#ifdef HAS_JIT
+        trace_jit = option[4] == '+';
+#else
+        throw std::invalid_argument(
+            "-XX:+UseTraceJIT needs an x86-64 Unix build with computed goto "
+            "support");
+#endif
+    } else if (option.compare(0, 19, "-XX:MaxTraceLength=") == 0) {
+        max_trace_length = std::stoi(option.substr(19));
+    } else if (option == "-XX:+PrintTraces") {
+        print_traces = true;
+    } else if (option == "-XX:+UseIR" || option == "-XX:-UseIR") {
+        use_ir = option[4] == '+';
+    } else if (option == "-XX:+InterpretIR") {
+        use_ir       = true;
+        interpret_ir = true;
+    } else if (option.compare(0, 13, "-XX:IRPasses=") == 0) {
+        ir_passes = option.substr(13);
+        PassManager pipeline(ir_passes); // throws for an unknown pass
+    } else if (option == "-XX:+PrintIR") {
+        print_ir = true;
+    } else if (option == "-XX:+UseSuperinstructions" ||
+               option == "-XX:-UseSuperinstructions") {
+        use_superinstructions = option[4] == '+';
+    } else if (option == "-XX:+PrintBytecodeNGrams") {
+        print_ngrams = true;
+    } else if (option.compare(0, 16, "-XX:NGramLength=") == 0) {
+        ngram_length = std::stoi(option.substr(16));
+        if (ngram_length < 2) {
+            throw std::invalid_argument("-XX:NGramLength must be >= 2");
+        }
+    } else if (option == "-XX:+UseStackCaching" ||
+               option == "-XX:-UseStackCaching") {
+        use_stack_caching = option[4] == '+';
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::string VMOptions::usage() {
+    return "  -Xdispatch:switch|threaded  interpreter dispatch engine\n"
+           "  -Xss<size>                  VM stack size, like 512k or 4m\n"
+           "  -XX:+Inline|-XX:-Inline     inlining of trivial calls\n"
+           "  -XX:MaxInlineSize=<bytes>   largest inlined method (35)\n"
+           "  -XX:+PrintInlining          reports the inlined call sites\n"
+           "  -Xjit|-Xint                 compiles hot methods or not\n"
+           "  -XX:Tier1Threshold=<n>      calls before inlining (100)\n"
+           "  -XX:Tier1BackEdgeThreshold=<n>\n"
+           "                              loop iterations before inlining "
+           "(1000)\n"
+           "  -XX:CompileThreshold=<n>    calls before compiling (1000)\n"
+           "  -XX:BackEdgeThreshold=<n>   loop iterations before compiling "
+           "(10000)\n"
+           "  -XX:+PrintTiers             reports the tier of methods\n"
+           "  -XX:+BackgroundCompilation|-XX:-BackgroundCompilation\n"
+           "                              compiles on other threads or not\n"
+           "  -Xbatch                     same as -XX:-BackgroundCompilation\n"
+           "  -XX:CICompilerCount=<n>     background compiler threads (1)\n"
+           "  -XX:+CITime                 reports the compiler counters\n"
+           "  -XX:PerMethodTrapLimit=<n>  invalidations before a method "
+           "stops\n"
+           "                              speculating (4)\n"
+           "  -XX:+PrintDeoptimization    reports the invalidated methods\n"
+           "  -XX:+ProfileInterpreter|-XX:-ProfileInterpreter\n"
+           "                              type feedback in tier 0 or not\n"
+           "  -XX:+PrintMethodData        prints the type feedback at exit\n"
+           "  -XX:AOTLibrary=<file>       runs the methods compiled by --aot\n"
+           "  -XX:+UseTraceJIT|-XX:-UseTraceJIT\n"
+           "                              compiles traces of hot loops or "
+           "not\n"
+           "  -XX:MaxTraceLength=<n>      longest trace recorded (1000)\n"
+           "  -XX:+PrintTraces            reports the traces of hot loops\n"
+           "  -XX:+UseIR|-XX:-UseIR       optimizes through the SSA IR or not\n"
+           "  -XX:+InterpretIR            runs the IR instead of its lowering\n"
+           "  -XX:IRPasses=<names>        passes run over the IR, out of\n"
+           "                              constfold,copyprop,gvn,licm,dse\n"
+           "  -XX:+PrintIR                prints the IR of optimized methods\n"
+           "  -XX:+UseSuperinstructions|-XX:-UseSuperinstructions\n"
+           "                              fuses frequent instruction "
+           "sequences or not\n"
+           "  -XX:+PrintBytecodeNGrams    reports the instruction sequences "
+           "run\n"
+           "                              the most\n"
+           "  -XX:NGramLength=<n>         longest sequence reported (4)\n"
+           "  -XX:+UseStackCaching|-XX:-UseStackCaching\n"
+           "                              caches the top of the operand stack "
+           "or not\n";
+}
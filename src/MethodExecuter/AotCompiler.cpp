@@ -0,0 +1,842 @@
+#include <JVM/structures/ContextEntry.hpp>
+#include <MethodExecuter/AotCompiler.hpp>
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+/// Host compiler that builds the libraries, the CXX environment variable
+/// overrides it
+#ifndef AOT_CXX
+#define AOT_CXX "c++"
+#endif
+
+///
+/// Start of every generated source: the value and frame model of the VM,
+/// the tables of AotLibrary.hpp and the helpers shared with the
+/// interpreter, which wrap int and long arithmetic around as Java does
+///
+static const char *const prelude = R"aot(// Generated by sb-2019 --aot
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+union Slot {
+    int64_t j;
+    int32_t i;
+    float f;
+    double d;
+    void *ref;
+};
+
+struct CompiledExit {
+    Slot *sp;
+    int pc;
+};
+
+struct AotLink {
+    int kind;
+    const char *class_name;
+    const char *name;
+};
+
+struct AotMethod {
+    const char *class_name;
+    const char *name;
+    const char *descriptor;
+    unsigned code_hash;
+    CompiledExit (*entry)(Slot *lva, Slot *sp, int pc);
+    const char *compiled;
+};
+
+struct AotImage {
+    int format;
+    int slot_size;
+    int entry_size;
+    int length_offset;
+    int links_count;
+    const AotLink *links;
+    void **resolved;
+    int methods_count;
+    const AotMethod *methods;
+};
+
+// named after the instructions, some clash with the C library otherwise
+namespace java {
+
+static inline int32_t iadd(int32_t a, int32_t b) {
+    return static_cast<uint32_t>(a) + static_cast<uint32_t>(b);
+}
+static inline int32_t isub(int32_t a, int32_t b) {
+    return static_cast<uint32_t>(a) - static_cast<uint32_t>(b);
+}
+static inline int32_t imul(int32_t a, int32_t b) {
+    return static_cast<uint32_t>(a) * static_cast<uint32_t>(b);
+}
+static inline int32_t ineg(int32_t a) { return 0u - static_cast<uint32_t>(a); }
+static inline int32_t idiv(int32_t a, int32_t b) {
+    return b == -1 ? ineg(a) : a / b;
+}
+static inline int32_t irem(int32_t a, int32_t b) { return b == -1 ? 0 : a % b; }
+static inline int32_t ishl(int32_t a, int32_t b) {
+    return static_cast<uint32_t>(a) << (b & 31);
+}
+static inline int32_t ishr(int32_t a, int32_t b) { return a >> (b & 31); }
+static inline int32_t iushr(int32_t a, int32_t b) {
+    return static_cast<uint32_t>(a) >> (b & 31);
+}
+static inline int64_t ladd(int64_t a, int64_t b) {
+    return static_cast<uint64_t>(a) + static_cast<uint64_t>(b);
+}
+static inline int64_t lsub(int64_t a, int64_t b) {
+    return static_cast<uint64_t>(a) - static_cast<uint64_t>(b);
+}
+static inline int64_t lmul(int64_t a, int64_t b) {
+    return static_cast<uint64_t>(a) * static_cast<uint64_t>(b);
+}
+static inline int64_t lneg(int64_t a) { return 0u - static_cast<uint64_t>(a); }
+static inline int64_t ldiv(int64_t a, int64_t b) {
+    return b == -1 ? lneg(a) : a / b;
+}
+static inline int64_t lrem(int64_t a, int64_t b) { return b == -1 ? 0 : a % b; }
+static inline int64_t lshl(int64_t a, int32_t b) {
+    return static_cast<uint64_t>(a) << (b & 63);
+}
+static inline int64_t lshr(int64_t a, int32_t b) { return a >> (b & 63); }
+static inline int64_t lushr(int64_t a, int32_t b) {
+    return static_cast<uint64_t>(a) >> (b & 63);
+}
+
+} // namespace java
+
+template <typename To, typename From> static inline To saturate(From value) {
+    if (std::isnan(value)) {
+        return 0;
+    }
+    if (value >= static_cast<From>(std::numeric_limits<To>::max())) {
+        return std::numeric_limits<To>::max();
+    }
+    if (value <= static_cast<From>(std::numeric_limits<To>::min())) {
+        return std::numeric_limits<To>::min();
+    }
+    return static_cast<To>(value);
+}
+
+template <typename T> static inline int compare(T value1, T value2, int nan) {
+    if (value1 > value2) {
+        return 1;
+    }
+    if (value1 < value2) {
+        return -1;
+    }
+    if (value1 == value2) {
+        return 0;
+    }
+    return nan;
+}
+)aot";
+
+///
+/// Helpers reaching into the heap, after the layout constants and the
+/// resolved links
+///
+static const char *const heap_access = R"aot(
+static inline Slot &field(void *object, int link) {
+    auto fields = reinterpret_cast<Slot *>(static_cast<char *>(object) +
+                                           entry_size);
+    return fields[reinterpret_cast<intptr_t>(resolved[link])];
+}
+
+static inline Slot &staticField(int link) {
+    return *static_cast<Slot *>(resolved[link]);
+}
+
+static inline int32_t length(void *array) {
+    return *reinterpret_cast<int *>(static_cast<char *>(array) +
+                                    length_offset);
+}
+
+static inline bool inBounds(void *array, int32_t index) {
+    return array != nullptr &&
+           static_cast<uint32_t>(index) < static_cast<uint32_t>(length(array));
+}
+
+template <typename T> static inline T &element(void *array, int32_t index) {
+    return reinterpret_cast<T *>(static_cast<char *>(array) +
+                                 entry_size)[index];
+}
+)aot";
+
+///
+/// C++ string literal of text
+///
+static std::string literal(const std::string &text) {
+    std::string quoted = "\"";
+    for (auto c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+        }
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+///
+/// text quoted for the shell
+///
+static std::string shellQuote(const std::string &text) {
+    std::string quoted = "'";
+    for (auto c : text) {
+        quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    }
+    return quoted + "'";
+}
+
+///
+/// Expression of the 64 bits of value
+///
+static std::string bits(Slot value) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "static_cast<int64_t>(0x%" PRIx64 "u)",
+                  static_cast<uint64_t>(value.j));
+    return text;
+}
+
+static std::string label(int index) { return "L" + std::to_string(index); }
+
+AotCompiler::AotCompiler(std::map<std::string, ConstantPool *> cp,
+                         std::map<std::string, ClassFields> *cf,
+                         std::map<std::string, RuntimeClass> *classes,
+                         std::map<std::string, std::string> super_class) {
+    this->cp          = cp;
+    this->cf          = cf;
+    this->classes     = classes;
+    this->super_class = super_class;
+}
+
+///
+/// Index of the link to the field name of class_name, added the first time
+///
+int AotCompiler::link(int kind, const std::string &class_name,
+                      const std::string &name) {
+    auto key   = std::to_string(kind) + " " + class_name + "." + name;
+    auto found = link_index.find(key);
+    if (found != link_index.end()) {
+        return found->second;
+    }
+    links.push_back(Link{kind, class_name, name});
+    return link_index[key] = links.size() - 1;
+}
+
+///
+/// Link to an instance field, -1 when it is not one of a loaded class
+///
+int AotCompiler::fieldLink(const FieldRef &field) {
+    auto runtime_class = classes->find(field.class_name);
+    if (runtime_class == classes->end() ||
+        !runtime_class->second.field_offsets.count(field.name)) {
+        return -1;
+    }
+    return link(AotLink::Field, field.class_name, field.name);
+}
+
+///
+/// Link to a static field, declared by the class of the Fieldref or by one
+/// of its super classes, -1 for the fields of library classes
+///
+int AotCompiler::staticLink(const FieldRef &field) {
+    for (auto name = field.class_name; cf->count(name);) {
+        if (cf->at(name).count(field.name)) {
+            return link(AotLink::Static, name, field.name);
+        }
+        auto super = super_class.find(name);
+        if (super == super_class.end()) {
+            break;
+        }
+        name = super->second;
+    }
+    return -1;
+}
+
+///
+/// Writes the C++ of ins, the instruction at pc. Returns false, having
+/// written nothing, when ins is left to the interpreter
+///
+bool AotCompiler::emit(std::ostream &out, const Instruction &ins, int pc) {
+    auto line = [&](const std::string &text) {
+        out << "    " << text << "\n";
+    };
+    auto moveSp = [&](int slots) {
+        if (slots > 0) {
+            line("sp += " + std::to_string(slots) + ";");
+        } else if (slots < 0) {
+            line("sp -= " + std::to_string(-slots) + ";");
+        }
+    };
+    auto exitIf = [&](const std::string &condition) {
+        line("if (" + condition + ") {");
+        line("    return {sp, " + std::to_string(pc) + "};");
+        line("}");
+    };
+    auto branchIf = [&](const std::string &condition, int target) {
+        line("if (" + condition + ") {");
+        line("    goto " + label(target) + ";");
+        line("}");
+    };
+    // the dup and swap instructions, as in JitCompiler
+    auto shuffle = [&](int pops, std::vector<int> order) {
+        std::string text = "{";
+        for (int k = 0; k < pops; k++) {
+            text += " Slot t" + std::to_string(k) + " = sp[" +
+                    std::to_string(k - pops) + "];";
+        }
+        for (int k = 0; k < order.size(); k++) {
+            if (k >= pops || order[k] != k) {
+                text += " sp[" + std::to_string(k - pops) + "] = t" +
+                        std::to_string(order[k]) + ";";
+            }
+        }
+        line(text + " }");
+        moveSp(order.size() - pops);
+    };
+    static const char *const conditions[] = {"==", "!=", "<", ">=", ">", "<="};
+    switch (ins.opcode) {
+    case op_nop:
+        break;
+    case op_aconst_null:
+        line("sp[0].ref = nullptr;");
+        moveSp(1);
+        break;
+    case op_iconst_m1:
+    case op_iconst_0:
+    case op_iconst_1:
+    case op_iconst_2:
+    case op_iconst_3:
+    case op_iconst_4:
+    case op_iconst_5:
+    case op_bipush:
+    case op_sipush:
+        line("sp[0].i = " + std::to_string(ins.a) + ";");
+        moveSp(1);
+        break;
+    case op_fconst_0:
+    case op_fconst_1:
+    case op_fconst_2: {
+        Slot value{};
+        value.f = ins.a;
+        line("sp[0].j = " + bits(value) + ";");
+        moveSp(1);
+    } break;
+    case op_lconst_0:
+    case op_lconst_1:
+    case op_dconst_0:
+    case op_dconst_1: {
+        Slot value;
+        if (ins.opcode <= op_lconst_1) {
+            value.j = ins.a;
+        } else {
+            value.d = ins.a;
+        }
+        line("sp[0].j = " + bits(value) + ";");
+        moveSp(2);
+    } break;
+    // strings are allocated by the interpreter
+    case op_ldc: {
+        auto &constant = ins.ref.constant->value;
+        if (constant.t == R) {
+            return false;
+        }
+        Slot value{};
+        if (constant.t == F) {
+            value.f = constant.val.f;
+        } else {
+            value.i = constant.val.i;
+        }
+        line("sp[0].j = " + bits(value) + ";");
+        moveSp(1);
+    } break;
+    case op_ldc2_w: {
+        auto &constant = ins.ref.constant->wide_value;
+        Slot value;
+        if (constant.t == D) {
+            value.d = constant.val.d;
+        } else {
+            value.j = constant.val.l;
+        }
+        line("sp[0].j = " + bits(value) + ";");
+        moveSp(2);
+    } break;
+    case op_iload:
+    case op_fload:
+    case op_aload:
+    case op_lload:
+    case op_dload:
+        line("sp[0] = lva[" + std::to_string(ins.a) + "];");
+        moveSp(ins.opcode == op_lload || ins.opcode == op_dload ? 2 : 1);
+        break;
+    case op_istore:
+    case op_fstore:
+    case op_astore:
+    case op_lstore:
+    case op_dstore: {
+        int slots = ins.opcode == op_lstore || ins.opcode == op_dstore ? 2 : 1;
+        line("lva[" + std::to_string(ins.a) + "] = sp[-" +
+             std::to_string(slots) + "];");
+        moveSp(-slots);
+    } break;
+    case op_iinc: {
+        auto local = "lva[" + std::to_string(ins.a) + "].i";
+        line(local + " = java::iadd(" + local + ", " +
+             std::to_string(ins.b) + ");");
+    } break;
+    case op_iadd:
+    case op_isub:
+    case op_imul:
+    case op_iand:
+    case op_ior:
+    case op_ixor:
+    case op_ishl:
+    case op_ishr:
+    case op_iushr: {
+        std::string operation;
+        if (ins.opcode == op_iand || ins.opcode == op_ior ||
+            ins.opcode == op_ixor) {
+            operation = std::string("sp[-2].i ") +
+                        (ins.opcode == op_iand  ? "&"
+                         : ins.opcode == op_ior ? "|"
+                                                : "^") +
+                        " sp[-1].i";
+        } else {
+            operation = "java::" + std::string(opcodeName(ins.opcode)) +
+                        "(sp[-2].i, sp[-1].i)";
+        }
+        line("sp[-2].i = " + operation + ";");
+        moveSp(-1);
+    } break;
+    case op_ladd:
+    case op_lsub:
+    case op_lmul:
+    case op_land:
+    case op_lor:
+    case op_lxor: {
+        std::string operation;
+        if (ins.opcode == op_land || ins.opcode == op_lor ||
+            ins.opcode == op_lxor) {
+            operation = std::string("sp[-4].j ") +
+                        (ins.opcode == op_land  ? "&"
+                         : ins.opcode == op_lor ? "|"
+                                                : "^") +
+                        " sp[-2].j";
+        } else {
+            operation = "java::" + std::string(opcodeName(ins.opcode)) +
+                        "(sp[-4].j, sp[-2].j)";
+        }
+        line("sp[-4].j = " + operation + ";");
+        moveSp(-2);
+    } break;
+    // a division by zero throws in the interpreter
+    case op_idiv:
+    case op_irem:
+        exitIf("sp[-1].i == 0");
+        line("sp[-2].i = java::" + std::string(opcodeName(ins.opcode)) +
+             "(sp[-2].i, sp[-1].i);");
+        moveSp(-1);
+        break;
+    case op_ldiv:
+    case op_lrem:
+        exitIf("sp[-2].j == 0");
+        line("sp[-4].j = java::" + std::string(opcodeName(ins.opcode)) +
+             "(sp[-4].j, sp[-2].j);");
+        moveSp(-2);
+        break;
+    case op_lshl:
+    case op_lshr:
+    case op_lushr:
+        line("sp[-3].j = java::" + std::string(opcodeName(ins.opcode)) +
+             "(sp[-3].j, sp[-1].i);");
+        moveSp(-1);
+        break;
+    case op_ineg:
+        line("sp[-1].i = java::ineg(sp[-1].i);");
+        break;
+    case op_lneg:
+        line("sp[-2].j = java::lneg(sp[-2].j);");
+        break;
+    case op_fneg:
+        line("sp[-1].f = -sp[-1].f;");
+        break;
+    case op_dneg:
+        line("sp[-2].d = -sp[-2].d;");
+        break;
+    case op_fadd:
+    case op_fsub:
+    case op_fmul:
+    case op_fdiv:
+    case op_frem:
+    case op_dadd:
+    case op_dsub:
+    case op_dmul:
+    case op_ddiv:
+    case op_drem: {
+        static const char *const operators[] = {"+", "-", "*", "/"};
+        bool wide  = (ins.opcode - op_iadd) % 4 == 3;
+        auto kind  = (ins.opcode - op_iadd) / 4; // add, sub, mul, div, rem
+        auto left  = wide ? std::string("sp[-4].d") : std::string("sp[-2].f");
+        auto right = wide ? std::string("sp[-2].d") : std::string("sp[-1].f");
+        if (kind == 4) {
+            line(left + " = std::fmod(" + left + ", " + right + ");");
+        } else {
+            line(left + " = " + left + " " + operators[kind] + " " + right +
+                 ";");
+        }
+        moveSp(wide ? -2 : -1);
+    } break;
+    case op_i2l:
+        line("sp[-1].j = sp[-1].i;");
+        moveSp(1);
+        break;
+    case op_i2f:
+        line("sp[-1].f = sp[-1].i;");
+        break;
+    case op_i2d:
+        line("sp[-1].d = sp[-1].i;");
+        moveSp(1);
+        break;
+    case op_l2i:
+        line("sp[-2].i = static_cast<int32_t>(sp[-2].j);");
+        moveSp(-1);
+        break;
+    case op_l2f:
+        line("sp[-2].f = sp[-2].j;");
+        moveSp(-1);
+        break;
+    case op_l2d:
+        line("sp[-2].d = sp[-2].j;");
+        break;
+    case op_f2i:
+        line("sp[-1].i = saturate<int32_t>(sp[-1].f);");
+        break;
+    case op_f2l:
+        line("sp[-1].j = saturate<int64_t>(sp[-1].f);");
+        moveSp(1);
+        break;
+    case op_f2d:
+        line("sp[-1].d = sp[-1].f;");
+        moveSp(1);
+        break;
+    case op_d2i:
+        line("sp[-2].i = saturate<int32_t>(sp[-2].d);");
+        moveSp(-1);
+        break;
+    case op_d2l:
+        line("sp[-2].j = saturate<int64_t>(sp[-2].d);");
+        break;
+    case op_d2f:
+        line("sp[-2].f = sp[-2].d;");
+        moveSp(-1);
+        break;
+    case op_i2b:
+        line("sp[-1].i = static_cast<int8_t>(sp[-1].i);");
+        break;
+    case op_i2c:
+        line("sp[-1].i = static_cast<uint16_t>(sp[-1].i);");
+        break;
+    case op_i2s:
+        line("sp[-1].i = static_cast<int16_t>(sp[-1].i);");
+        break;
+    case op_lcmp:
+        line("sp[-4].i = (sp[-4].j > sp[-2].j) - (sp[-4].j < sp[-2].j);");
+        moveSp(-3);
+        break;
+    case op_fcmpl:
+    case op_fcmpg:
+        line("sp[-2].i = compare(sp[-2].f, sp[-1].f, " +
+             std::string(ins.opcode == op_fcmpg ? "1" : "-1") + ");");
+        moveSp(-1);
+        break;
+    case op_dcmpl:
+    case op_dcmpg:
+        line("sp[-4].i = compare(sp[-4].d, sp[-2].d, " +
+             std::string(ins.opcode == op_dcmpg ? "1" : "-1") + ");");
+        moveSp(-3);
+        break;
+    case op_ifeq:
+    case op_ifne:
+    case op_iflt:
+    case op_ifge:
+    case op_ifgt:
+    case op_ifle:
+        moveSp(-1);
+        branchIf(std::string("sp[0].i ") + conditions[ins.opcode - op_ifeq] +
+                     " 0",
+                 ins.target);
+        break;
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmpge:
+    case op_if_icmpgt:
+    case op_if_icmple:
+        moveSp(-2);
+        branchIf(std::string("sp[0].i ") +
+                     conditions[ins.opcode - op_if_icmpeq] + " sp[1].i",
+                 ins.target);
+        break;
+    case op_if_acmpeq:
+    case op_if_acmpne:
+        moveSp(-2);
+        branchIf(std::string("sp[0].ref ") +
+                     conditions[ins.opcode - op_if_acmpeq] + " sp[1].ref",
+                 ins.target);
+        break;
+    case op_ifnull:
+    case op_ifnonnull:
+        moveSp(-1);
+        branchIf(std::string("sp[0].ref ") +
+                     (ins.opcode == op_ifnull ? "==" : "!=") + " nullptr",
+                 ins.target);
+        break;
+    case op_goto:
+        line("goto " + label(ins.target) + ";");
+        break;
+    case op_tableswitch:
+    case op_lookupswitch: {
+        auto table = ins.ref.table;
+        moveSp(-1);
+        line("switch (sp[0].i) {");
+        for (int k = 0; k < table->targets.size(); k++) {
+            int key = table->keys.empty() ? table->low + k : table->keys[k];
+            line("case " + std::to_string(key) + ":");
+            line("    goto " + label(table->targets[k]) + ";");
+        }
+        line("default:");
+        line("    goto " + label(table->default_target) + ";");
+        line("}");
+    } break;
+    case op_pop:
+        moveSp(-1);
+        break;
+    case op_pop2:
+        moveSp(-2);
+        break;
+    case op_dup:
+        shuffle(1, {0, 0});
+        break;
+    case op_dup_x1:
+        shuffle(2, {1, 0, 1});
+        break;
+    case op_dup_x2:
+        shuffle(3, {2, 0, 1, 2});
+        break;
+    case op_dup2:
+        shuffle(2, {0, 1, 0, 1});
+        break;
+    case op_dup2_x1:
+        shuffle(3, {1, 2, 0, 1, 2});
+        break;
+    case op_dup2_x2:
+        shuffle(4, {2, 3, 0, 1, 2, 3});
+        break;
+    case op_swap:
+        shuffle(2, {1, 0});
+        break;
+    // a field takes one slot even when its value takes two on the operand
+    // stack
+    case op_getstatic:
+    case op_putstatic: {
+        int index = staticLink(*ins.ref.field);
+        if (index < 0) {
+            return false;
+        }
+        int slots = ins.ref.field->slots;
+        if (ins.opcode == op_getstatic) {
+            line("sp[0] = staticField(" + std::to_string(index) + ");");
+            moveSp(slots);
+        } else {
+            moveSp(-slots);
+            line("staticField(" + std::to_string(index) + ") = sp[0];");
+        }
+    } break;
+    case op_getfield: {
+        int index = fieldLink(*ins.ref.field);
+        if (index < 0) {
+            return false;
+        }
+        exitIf("sp[-1].ref == nullptr");
+        line("sp[-1] = field(sp[-1].ref, " + std::to_string(index) + ");");
+        moveSp(ins.ref.field->slots - 1);
+    } break;
+    case op_putfield: {
+        int index = fieldLink(*ins.ref.field);
+        if (index < 0) {
+            return false;
+        }
+        int slots = ins.ref.field->slots;
+        exitIf("sp[-" + std::to_string(slots + 1) + "].ref == nullptr");
+        moveSp(-slots - 1);
+        line("field(sp[0].ref, " + std::to_string(index) + ") = sp[1];");
+    } break;
+    case op_arraylength:
+        exitIf("sp[-1].ref == nullptr");
+        line("sp[-1].i = length(sp[-1].ref);");
+        break;
+    case op_iaload:
+    case op_laload:
+    case op_faload:
+    case op_daload:
+    case op_aaload:
+    case op_baload:
+    case op_caload:
+    case op_saload: {
+        static const char *const members[] = {"i", "j", "f", "d",
+                                              "ref", "i", "i", "i"};
+        static const char *const types[] = {
+            "int32_t", "int64_t", "float",   "double",
+            "void *",  "int8_t",  "uint16_t", "int16_t"};
+        int kind = ins.opcode - op_iaload;
+        exitIf("!inBounds(sp[-2].ref, sp[-1].i)");
+        line(std::string("sp[-2].") + members[kind] + " = element<" +
+             types[kind] + ">(sp[-2].ref, sp[-1].i);");
+        moveSp(ins.opcode == op_laload || ins.opcode == op_daload ? 0 : -1);
+    } break;
+    // bastore masks booleans, which needs the type of the array
+    case op_iastore:
+    case op_lastore:
+    case op_fastore:
+    case op_dastore:
+    case op_aastore:
+    case op_castore:
+    case op_sastore: {
+        static const char *const members[] = {"i",   "j", "f", "d",
+                                              "ref", "",  "i", "i"};
+        static const char *const types[] = {
+            "int32_t", "int64_t", "float",   "double",
+            "void *",  "",        "uint16_t", "int16_t"};
+        int kind = ins.opcode - op_iastore;
+        int n    = ins.opcode == op_lastore || ins.opcode == op_dastore ? 2 : 1;
+        auto array = "sp[-" + std::to_string(n + 2) + "].ref";
+        auto index = "sp[-" + std::to_string(n + 1) + "].i";
+        exitIf("!inBounds(" + array + ", " + index + ")");
+        line(std::string("element<") + types[kind] + ">(" + array + ", " +
+             index + ") = sp[-" + std::to_string(n) + "]." + members[kind] +
+             ";");
+        moveSp(-n - 2);
+    } break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+///
+/// Translates method, declared by class_name. Returns false when it has no
+/// instruction to compile
+///
+bool AotCompiler::add(const MethodInfoCte &method,
+                      const std::string &class_name) {
+    if (method.attributes.empty() || method.attributes[0].code_length == 0) {
+        return false; // abstract or native
+    }
+    BytecodeDecoder decoder(cp.at(class_name), class_name);
+    auto decoded = decoder.decode(method.attributes[0]);
+    auto &code   = decoded->code;
+    std::string compiled(code.size(), '0');
+    std::ostringstream body;
+    for (int pc = 0; pc < code.size(); pc++) {
+        body << label(pc) << ": // bci " << code[pc].bci << " "
+             << opcodeName(code[pc].opcode) << "\n";
+        if (emit(body, code[pc], pc)) {
+            compiled[pc] = '1';
+        } else {
+            body << "    return {sp, " << pc << "};\n";
+        }
+    }
+    if (compiled.find('1') == std::string::npos) {
+        return false;
+    }
+    body << label(code.size()) << ":\n"
+         << "    return {sp, " << code.size() << "};\n";
+    auto name = "aot_" + std::to_string(method_count++);
+    functions << "\n// " << class_name << "." << method.name
+              << method.descriptor << "\n"
+              << "static CompiledExit " << name
+              << "(Slot *lva, Slot *sp, int pc) {\n"
+              << "    switch (pc) {\n";
+    for (int pc = 0; pc < code.size(); pc++) {
+        if (compiled[pc] == '1') {
+            functions << "    case " << pc << ":\n"
+                      << "        goto " << label(pc) << ";\n";
+        }
+    }
+    functions << "    default:\n"
+              << "        return {sp, pc};\n"
+              << "    }\n"
+              << body.str() << "}\n";
+    methods << "    {" << literal(class_name) << ", " << literal(method.name)
+            << ", " << literal(method.descriptor) << ", "
+            << AotLibrary::codeHash(method.attributes[0]) << "u, " << name
+            << ", " << literal(compiled) << "},\n";
+    return true;
+}
+
+int AotCompiler::methodCount() const { return method_count; }
+
+///
+/// Source of the library with the methods added so far
+///
+std::string AotCompiler::source() const {
+    std::ostringstream out;
+    out << prelude << "\n"
+        << "static const int entry_size = " << sizeof(ContextEntry) << ";\n"
+        << "static const int length_offset = " << AotLibrary::lengthOffset()
+        << ";\n"
+        << "static void *resolved[" << std::max<size_t>(links.size(), 1)
+        << "];\n"
+        << heap_access << functions.str() << "\n"
+        << "static const AotLink links[] = {\n";
+    for (auto &link : links) {
+        out << "    {" << link.kind << ", " << literal(link.class_name) << ", "
+            << literal(link.name) << "},\n";
+    }
+    // arrays cannot be empty, the counts tell the entries
+    out << "    {0, \"\", \"\"}};\n\n"
+        << "static const AotMethod methods[] = {\n"
+        << this->methods.str()
+        << "    {\"\", \"\", \"\", 0u, nullptr, \"\"}};\n\n"
+        << "extern \"C\" {\n"
+        << "extern const AotImage aot_image;\n"
+        << "const AotImage aot_image = {" << AotImage::Format << ", "
+        << sizeof(Slot) << ", entry_size, length_offset, " << links.size()
+        << ", links, resolved, " << method_count << ", methods};\n"
+        << "}\n";
+    return out.str();
+}
+
+///
+/// Writes the source of the library next to output and builds it into
+/// output with the host compiler. Throws a std::runtime_error when it fails,
+/// the source is kept then
+///
+void AotCompiler::build(const std::string &output) const {
+    auto source_path = output + ".cpp";
+    {
+        std::ofstream file(source_path);
+        file << source();
+        if (!file) {
+            throw std::runtime_error("Cannot write " + source_path);
+        }
+    }
+    auto cxx = std::getenv("CXX");
+    auto command = std::string(cxx != nullptr && *cxx ? cxx : AOT_CXX) +
+                   " -std=c++11 -O2 -fPIC -shared -w -o " + shellQuote(output) +
+                   " " + shellQuote(source_path);
+    if (std::system(command.c_str()) != 0) {
+        throw std::runtime_error("The host compiler could not build " +
+                                 output + ", its source is in " +
+                                 source_path);
+    }
+    std::remove(source_path.c_str());
+}
@@ -0,0 +1,78 @@
+#include <JVM/structures/ContextEntry.hpp>
+#include <MethodExecuter/AotLibrary.hpp>
+#include <dlfcn.h>
+#include <stdexcept>
+
+AotLibrary::~AotLibrary() {
+    if (handle != nullptr) {
+        dlclose(handle);
+    }
+}
+
+///
+/// Loads the library at path and resolves its links with resolve. Throws a
+/// std::runtime_error when it cannot be loaded, was built for a different
+/// VM or uses a field the loaded classes do not have
+///
+void AotLibrary::open(const std::string &path, Resolver resolve) {
+    // without a slash dlopen searches the library path, not the current
+    // directory
+    auto file = path.find('/') == std::string::npos ? "./" + path : path;
+    handle    = dlopen(file.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr) {
+        throw std::runtime_error(dlerror());
+    }
+    image = static_cast<const AotImage *>(dlsym(handle, "aot_image"));
+    if (image == nullptr) {
+        throw std::runtime_error(path + " was not built by --aot");
+    }
+    if (image->format != AotImage::Format ||
+        image->slot_size != sizeof(Slot) ||
+        image->entry_size != sizeof(ContextEntry) ||
+        image->length_offset != lengthOffset()) {
+        throw std::runtime_error(path + " was built for another VM");
+    }
+    for (int k = 0; k < image->links_count; k++) {
+        image->resolved[k] = resolve(image->links[k]);
+    }
+    for (int k = 0; k < image->methods_count; k++) {
+        auto &method = image->methods[k];
+        methods[std::string(method.class_name) + "." + method.name +
+                method.descriptor] = &method;
+    }
+}
+
+///
+/// Compiled code of method, declared by class_name, nullptr when the
+/// library has none or its bytecode changed since it was compiled
+///
+const AotMethod *AotLibrary::find(const std::string &class_name,
+                                  const MethodInfoCte &method) const {
+    auto found = methods.find(class_name + "." + method.name +
+                              method.descriptor);
+    if (found == methods.end() || method.attributes.empty() ||
+        found->second->code_hash != codeHash(method.attributes[0])) {
+        return nullptr;
+    }
+    return found->second;
+}
+
+///
+/// FNV-1a hash of the bytecode of a Code attribute
+///
+unsigned AotLibrary::codeHash(const AttributeCode &code) {
+    unsigned hash = 2166136261u;
+    for (auto byte : code.code) {
+        hash = (hash ^ byte) * 16777619u;
+    }
+    return hash;
+}
+
+///
+/// Offset of the length of arrays in their ContextEntry
+///
+int AotLibrary::lengthOffset() {
+    static ContextEntry probe(std::string(), I, 0);
+    return reinterpret_cast<char *>(&probe.length) -
+           reinterpret_cast<char *>(&probe);
+}
@@ -0,0 +1,481 @@
+#include <JVM/structures/JavaException.hpp>
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <map>
+
+BytecodeDecoder::BytecodeDecoder(ConstantPool *cp, std::string class_name) {
+    this->cp         = cp;
+    this->class_name = class_name;
+    this->pos        = 0;
+}
+
+unsigned char BytecodeDecoder::u1() {
+    if (pos >= code.size()) {
+        throw std::runtime_error("Truncated bytecode, instruction operands "
+                                 "go past the end of the Code attribute");
+    }
+    return code[pos++];
+}
+
+unsigned short BytecodeDecoder::u2() {
+    unsigned short high = u1();
+    return (high << 8) | u1();
+}
+
+int BytecodeDecoder::s1() { return static_cast<signed char>(u1()); }
+
+int BytecodeDecoder::s2() { return static_cast<short>(u2()); }
+
+int BytecodeDecoder::s4() {
+    unsigned int high = u2();
+    return static_cast<int>((high << 16) | u2());
+}
+
+const FieldRef *BytecodeDecoder::fieldRef(DecodedMethod *dm, int index) {
+    FieldRef ref;
+    ref.class_name = cp->getFieldClassByIndex(index);
+    ref.name       = cp->getFieldByIndex(index);
+    ref.descriptor = cp->getFieldDescriptorByIndex(index);
+    ref.slots = ref.descriptor == "J" || ref.descriptor == "D" ? 2 : 1;
+    dm->fields.push_back(ref);
+    return &dm->fields.back();
+}
+
+const MethodRef *BytecodeDecoder::methodRef(DecodedMethod *dm, int index) {
+    MethodRef ref;
+    ref.class_name    = cp->getClassNameFromMethodByIndex(index);
+    ref.name_and_type = cp->getNameAndTypeByIndex(index);
+    auto paren        = ref.name_and_type.find_first_of('(');
+    ref.name          = ref.name_and_type.substr(0, paren);
+    ref.descriptor    = ref.name_and_type.substr(paren);
+    ref.args          = std::string(
+        ref.name_and_type.begin() + paren + 1,
+        ref.name_and_type.begin() + ref.name_and_type.find_first_of(')'));
+    ref.args_count = countArgs(ref.args);
+    ref.arg_slots  = countArgSlots(ref.args);
+    auto ret = ref.descriptor.substr(ref.descriptor.find_first_of(')') + 1);
+    ref.return_slots = ret == "V" ? 0 : (ret == "J" || ret == "D") ? 2 : 1;
+    if (ref.class_name == "java/lang/Object") {
+        ref.kind = MethodRef::JavaObject;
+    } else if (ref.class_name == "java/io/PrintStream") {
+        ref.kind = MethodRef::PrintStream;
+    } else if (ref.class_name.find("java/lang/StringBuilder", 0) !=
+               std::string::npos) {
+        ref.kind = MethodRef::StringBuilder;
+    } else if (ThrowableHierarchy.count(ref.class_name)) {
+        ref.kind = MethodRef::Throwable;
+    } else {
+        ref.kind = MethodRef::User;
+    }
+    dm->methods.push_back(ref);
+    return &dm->methods.back();
+}
+
+const std::string *BytecodeDecoder::classRef(DecodedMethod *dm, int index) {
+    dm->classes.push_back(cp->getNameByIndex(index));
+    return &dm->classes.back();
+}
+
+///
+/// Reads tableswitch/lookupswitch operands. Targets are kept as bytecode
+/// offsets here and translated later by resolveTargets
+///
+void BytecodeDecoder::decodeSwitch(DecodedMethod *dm, Instruction &ins) {
+    while (pos % 4 != 0) {
+        u1(); // up to 3 padding bytes
+    }
+    SwitchTable table;
+    table.default_target = ins.bci + s4();
+    if (ins.opcode == op_tableswitch) {
+        table.low = s4();
+        int high  = s4();
+        if (high < table.low) {
+            throw std::runtime_error("tableswitch with high lower than low");
+        }
+        for (long k = table.low; k <= high; k++) {
+            table.targets.push_back(ins.bci + s4());
+        }
+    } else {
+        table.low  = 0;
+        int npairs = s4();
+        for (int k = 0; k < npairs; k++) {
+            table.keys.push_back(s4());
+            table.targets.push_back(ins.bci + s4());
+        }
+    }
+    dm->switches.push_back(table);
+    ins.ref.table = &dm->switches.back();
+}
+
+///
+/// Converts every branch target from bytecode offset to instruction index
+///
+void BytecodeDecoder::resolveTargets(DecodedMethod *dm) {
+    std::vector<int> index_of(code.size() + 1, -1);
+    for (int k = 0; k < dm->code.size(); k++) {
+        index_of[dm->code[k].bci] = k;
+    }
+    auto resolve = [&](int bci) {
+        if (bci < 0 || bci >= code.size() || index_of[bci] == -1) {
+            throw std::runtime_error("Branch target " + std::to_string(bci) +
+                                     " is not an instruction boundary");
+        }
+        return index_of[bci];
+    };
+    for (auto &ins : dm->code) {
+        if (ins.target != -1) {
+            ins.target = resolve(ins.target);
+        }
+    }
+    for (auto &table : dm->switches) {
+        table.default_target = resolve(table.default_target);
+        for (auto &target : table.targets) {
+            target = resolve(target);
+        }
+    }
+    for (auto &handler : dm->handlers) {
+        handler.start   = resolve(handler.start);
+        handler.handler = resolve(handler.handler);
+        // end is exclusive and may be the length of the code
+        handler.end = handler.end == code.size() ? dm->code.size()
+                                                 : resolve(handler.end);
+    }
+}
+
+///
+/// Decodes the whole Code attribute. Opcodes the interpreter does not know
+/// are kept as they are, so the error only happens if they are executed
+///
+std::shared_ptr<DecodedMethod>
+BytecodeDecoder::decode(const AttributeCode &attribute) {
+    auto dm        = std::make_shared<DecodedMethod>();
+    dm->class_name = class_name;
+    dm->max_stack  = attribute.max_stack;
+    dm->max_locals = attribute.max_locals;
+    code           = attribute.code;
+    pos            = 0;
+    while (pos < code.size()) {
+        Instruction ins;
+        ins.bci     = pos;
+        ins.opcode  = u1();
+        ins.a       = 0;
+        ins.b       = 0;
+        ins.target  = -1;
+        ins.ref.ptr = nullptr;
+        ins.handler = nullptr;
+        ins.profile = -1;
+        ins.fused   = 0;
+        ins.cache   = 0;
+        ins.variant = 0;
+        switch (ins.opcode) {
+        case op_iconst_m1:
+        case op_iconst_0:
+        case op_iconst_1:
+        case op_iconst_2:
+        case op_iconst_3:
+        case op_iconst_4:
+        case op_iconst_5:
+            ins.a = ins.opcode - op_iconst_0;
+            break;
+        case op_lconst_0:
+        case op_lconst_1:
+            ins.a = ins.opcode - op_lconst_0;
+            break;
+        case op_fconst_0:
+        case op_fconst_1:
+        case op_fconst_2:
+            ins.a = ins.opcode - op_fconst_0;
+            break;
+        case op_dconst_0:
+        case op_dconst_1:
+            ins.a = ins.opcode - op_dconst_0;
+            break;
+        case op_bipush:
+            ins.a = s1();
+            break;
+        case op_sipush:
+            ins.a = s2();
+            break;
+        case op_ldc:
+        case op_ldc_w: {
+            int index = ins.opcode == op_ldc ? u1() : u2();
+            ins.opcode = op_ldc;
+            ConstantRef constant;
+            constant.value = cp->getValueByIndex(index);
+            dm->constants.push_back(constant);
+            ins.ref.constant = &dm->constants.back();
+        } break;
+        case op_ldc2_w: {
+            ConstantRef constant;
+            constant.wide_value = cp->getNumberByIndex(u2());
+            dm->constants.push_back(constant);
+            ins.ref.constant = &dm->constants.back();
+        } break;
+        case op_iload:
+        case op_lload:
+        case op_fload:
+        case op_dload:
+        case op_aload:
+        case op_istore:
+        case op_lstore:
+        case op_fstore:
+        case op_dstore:
+        case op_astore:
+        case op_ret:
+            ins.a = u1();
+            break;
+        case op_iload_0:
+        case op_iload_1:
+        case op_iload_2:
+        case op_iload_3:
+        case op_lload_0:
+        case op_lload_1:
+        case op_lload_2:
+        case op_lload_3:
+        case op_fload_0:
+        case op_fload_1:
+        case op_fload_2:
+        case op_fload_3:
+        case op_dload_0:
+        case op_dload_1:
+        case op_dload_2:
+        case op_dload_3:
+        case op_aload_0:
+        case op_aload_1:
+        case op_aload_2:
+        case op_aload_3: {
+            int n      = ins.opcode - op_iload_0;
+            ins.opcode = op_iload + n / 4;
+            ins.a      = n % 4;
+        } break;
+        case op_istore_0:
+        case op_istore_1:
+        case op_istore_2:
+        case op_istore_3:
+        case op_lstore_0:
+        case op_lstore_1:
+        case op_lstore_2:
+        case op_lstore_3:
+        case op_fstore_0:
+        case op_fstore_1:
+        case op_fstore_2:
+        case op_fstore_3:
+        case op_dstore_0:
+        case op_dstore_1:
+        case op_dstore_2:
+        case op_dstore_3:
+        case op_astore_0:
+        case op_astore_1:
+        case op_astore_2:
+        case op_astore_3: {
+            int n      = ins.opcode - op_istore_0;
+            ins.opcode = op_istore + n / 4;
+            ins.a      = n % 4;
+        } break;
+        case op_iinc:
+            ins.a = u1();
+            ins.b = s1();
+            break;
+        case op_ifeq:
+        case op_ifne:
+        case op_iflt:
+        case op_ifge:
+        case op_ifgt:
+        case op_ifle:
+        case op_if_icmpeq:
+        case op_if_icmpne:
+        case op_if_icmplt:
+        case op_if_icmpge:
+        case op_if_icmpgt:
+        case op_if_icmple:
+        case op_if_acmpeq:
+        case op_if_acmpne:
+        case op_goto:
+        case op_jsr:
+        case op_ifnull:
+        case op_ifnonnull:
+            ins.target = ins.bci + s2();
+            break;
+        case op_goto_w:
+        case op_jsr_w:
+            ins.opcode = ins.opcode == op_goto_w ? op_goto : op_jsr;
+            ins.target = ins.bci + s4();
+            break;
+        case op_tableswitch:
+        case op_lookupswitch:
+            decodeSwitch(dm.get(), ins);
+            break;
+        case op_getstatic:
+        case op_putstatic:
+        case op_getfield:
+        case op_putfield:
+            ins.ref.field = fieldRef(dm.get(), u2());
+            break;
+        case op_invokevirtual:
+        case op_invokespecial:
+        case op_invokestatic:
+            ins.ref.method = methodRef(dm.get(), u2());
+            break;
+        case op_invokeinterface:
+            ins.ref.method = methodRef(dm.get(), u2());
+            ins.b          = u1();
+            u1();
+            break;
+        case op_invokedynamic:
+            ins.a = u2();
+            u2();
+            break;
+        case op_new:
+        case op_anewarray:
+        case op_checkcast:
+        case op_instanceof:
+            ins.ref.class_name = classRef(dm.get(), u2());
+            break;
+        case op_multianewarray:
+            ins.ref.class_name = classRef(dm.get(), u2());
+            ins.a              = u1();
+            break;
+        case op_newarray:
+            ins.a = u1();
+            break;
+        case op_wide: {
+            ins.opcode = u1();
+            switch (ins.opcode) {
+            case op_iload:
+            case op_lload:
+            case op_fload:
+            case op_dload:
+            case op_aload:
+            case op_istore:
+            case op_lstore:
+            case op_fstore:
+            case op_dstore:
+            case op_astore:
+            case op_ret:
+                ins.a = u2();
+                break;
+            case op_iinc:
+                ins.a = u2();
+                ins.b = s2();
+                break;
+            default:
+                throw std::runtime_error("wide used over an invalid opcode " +
+                                         std::string(opcodeName(ins.opcode)));
+            }
+        } break;
+        default:
+            break;
+        }
+        dm->code.push_back(ins);
+    }
+    for (int k = 0; k < attribute.exception_table_length; k++) {
+        auto &entry = attribute.exception_table[k];
+        ExceptionHandler handler;
+        handler.start   = entry.start_pc;
+        handler.end     = entry.end_pc;
+        handler.handler = entry.handler_pc;
+        if (entry.catch_type != 0) {
+            handler.catch_type = cp->getNameByIndex(entry.catch_type);
+        }
+        dm->handlers.push_back(handler);
+    }
+    resolveTargets(dm.get());
+    return dm;
+}
+
+///
+/// Counts parameters of a descriptor argument list, arrays and objects
+/// count as one parameter each
+///
+int BytecodeDecoder::countArgs(std::string args) {
+    int args_number = 0;
+    for (auto arg = args.begin(); arg < args.end(); arg++) {
+        switch (*arg) {
+        case 'B':
+        case 'C':
+        case 'D':
+        case 'F':
+        case 'I':
+        case 'J':
+        case 'S':
+        case 'Z':
+            args_number++;
+            break;
+        case 'L':
+            args_number++;
+            while (arg < args.end() && *arg != ';') {
+                arg++;
+            }
+            break;
+        default: // '[' only prefixes the element type
+            break;
+        }
+    }
+    return args_number;
+}
+
+///
+/// Counts the local variable slots taken by a descriptor argument list, long
+/// and double take two slots while arrays of them are single references
+///
+int BytecodeDecoder::countArgSlots(std::string args) {
+    int slots = 0;
+    for (auto arg = args.begin(); arg < args.end(); arg++) {
+        bool array = false;
+        while (*arg == '[') {
+            array = true;
+            arg++;
+        }
+        if (*arg == 'L') {
+            while (arg < args.end() && *arg != ';') {
+                arg++;
+            }
+        }
+        slots += (!array && (*arg == 'J' || *arg == 'D')) ? 2 : 1;
+    }
+    return slots;
+}
+
+///
+/// Marks the instructions of method control can reach other than from the
+/// instruction before them: branch and switch targets, exception handlers
+/// and the instructions a ret goes back to
+///
+std::vector<bool>
+BytecodeDecoder::blockStarts(const DecodedMethod &method) {
+    auto &code = method.code;
+    std::vector<bool> starts(code.size() + 1, false);
+    starts[0] = true;
+    for (int index = 0; index < code.size(); index++) {
+        auto &ins = code[index];
+        if (ins.opcode == op_tableswitch || ins.opcode == op_lookupswitch) {
+            for (auto target : ins.ref.table->targets) {
+                starts[target] = true;
+            }
+            starts[ins.ref.table->default_target] = true;
+        } else if (ins.target >= 0) {
+            starts[ins.target] = true;
+        }
+        if (ins.opcode == op_jsr) {
+            starts[index + 1] = true;
+        }
+    }
+    for (auto &handler : method.handlers) {
+        starts[handler.handler] = true;
+    }
+    return starts;
+}
+
+///
+/// Gives each loop of dm a back-edge counter: the branches going back to the
+/// same instruction, the loop header, share the counter in their b operand
+///
+void BytecodeDecoder::numberLoops(DecodedMethod *dm) {
+    std::map<int, int> loops; // header and counter
+    for (int k = 0; k < dm->code.size(); k++) {
+        auto &ins = dm->code[k];
+        if (ins.target != -1 && ins.target <= k && ins.opcode != op_jsr) {
+            ins.b = loops.emplace(ins.target, loops.size()).first->second;
+        }
+    }
+    dm->back_edges.assign(loops.size(), 0);
+}
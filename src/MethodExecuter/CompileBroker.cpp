@@ -0,0 +1,129 @@
+#include <MethodExecuter/CompileBroker.hpp>
+#include <chrono>
+#include <stdexcept>
+
+///
+/// Room for the tasks waiting in each queue, more are submitted again later
+///
+static const size_t queue_capacity = 256;
+
+CompileBroker::CompileBroker(const VMOptions &options, Optimizer optimize)
+    : optimize(optimize), submitted(queue_capacity), built(queue_capacity),
+      stopping(false) {
+    worker_count = options.background_compilation ? options.compiler_count : 0;
+}
+
+CompileBroker::~CompileBroker() {
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    // tasks left behind were never installed
+    CompileTask *task;
+    while (submitted.pop(task) || built.pop(task)) {
+        delete task;
+    }
+}
+
+///
+/// Builds task, recording the time it took and why it failed, if it did
+///
+void CompileBroker::build(CompileTask *task, JitCompiler *jit) {
+    auto start = std::chrono::steady_clock::now();
+    try {
+        if (task->tier == 1) {
+            task->optimized = optimize(*task);
+        } else {
+#ifdef HAS_JIT
+            if (!jit->compile(task->code, task->jit)) {
+                task->failed = true;
+                task->error  = "no memory for the machine code";
+            }
+#endif
+        }
+    } catch (std::exception &exception) {
+        task->failed = true;
+        task->error  = exception.what();
+    }
+    auto spent = std::chrono::steady_clock::now() - start;
+    counters.micros +=
+        std::chrono::duration_cast<std::chrono::microseconds>(spent).count();
+    counters.tasks++;
+}
+
+///
+/// Loop of a worker thread: builds the submitted tasks and sleeps while
+/// there is none
+///
+void CompileBroker::work() {
+#ifdef HAS_JIT
+    JitCompiler jit;
+    JitCompiler *compiler = &jit;
+#else
+    JitCompiler *compiler = nullptr;
+#endif
+    while (!stopping) {
+        CompileTask *task;
+        if (submitted.pop(task)) {
+            counters.queued--;
+            build(task, compiler);
+            while (!built.push(task)) {
+                std::this_thread::yield();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(idle_mutex);
+        idle.wait(lock, [&]() { return stopping || submitted.size() > 0; });
+    }
+}
+
+///
+/// Hands task over to the workers, which start with the first task. false
+/// when the queue is full and task stays with the caller
+///
+bool CompileBroker::submit(CompileTask *task) {
+    if (worker_count == 0) {
+#ifdef HAS_JIT
+        build(task, &batch_jit);
+#else
+        build(task, nullptr);
+#endif
+        return built.push(task);
+    }
+    if (workers.empty()) {
+        for (int k = 0; k < worker_count; k++) {
+            workers.emplace_back(&CompileBroker::work, this);
+        }
+    }
+    int queued = ++counters.queued;
+    if (!submitted.push(task)) {
+        counters.queued--;
+        return false;
+    }
+    int longest = counters.longest_queue;
+    while (queued > longest &&
+           !counters.longest_queue.compare_exchange_weak(longest, queued)) {
+    }
+    // taking the lock orders the push before the check of a worker about
+    // to sleep, so it cannot miss the task
+    { std::lock_guard<std::mutex> lock(idle_mutex); }
+    idle.notify_one();
+    return true;
+}
+
+///
+/// Whether a task is ready to be installed, cheap enough for every call
+///
+bool CompileBroker::hasBuilt() const { return built.size() > 0; }
+
+///
+/// Next built task to install, nullptr if there is none. The caller owns it
+///
+CompileTask *CompileBroker::nextBuilt() {
+    CompileTask *task;
+    return built.pop(task) ? task : nullptr;
+}
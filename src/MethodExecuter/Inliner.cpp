@@ -0,0 +1,620 @@
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <MethodExecuter/Inliner.hpp>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+Inliner::Inliner(std::map<std::string, ConstantPool *> cp,
+                 std::map<std::string, ClassMethods> *cm,
+                 const std::map<std::string, std::string> *super_class,
+                 std::map<std::string, RuntimeClass> *classes,
+                 VMOptions options) {
+    this->cp            = cp;
+    this->cm            = cm;
+    this->super_class   = super_class;
+    this->classes       = classes;
+    this->options       = options;
+    this->inlined_calls = 0;
+}
+
+int Inliner::inlinedCalls() const { return inlined_calls; }
+
+///
+/// Slots popped and pushed by the instructions an inlined method may have,
+/// false for the other ones. Returns are left to the caller
+///
+static bool stackEffect(const Instruction &ins, int &pops, int &pushes) {
+    pops   = 0;
+    pushes = 0;
+    switch (ins.opcode) {
+    case op_nop:
+    case op_iinc:
+    case op_goto:
+        break;
+    case op_aconst_null:
+    case op_iconst_m1:
+    case op_iconst_0:
+    case op_iconst_1:
+    case op_iconst_2:
+    case op_iconst_3:
+    case op_iconst_4:
+    case op_iconst_5:
+    case op_fconst_0:
+    case op_fconst_1:
+    case op_fconst_2:
+    case op_bipush:
+    case op_sipush:
+    case op_ldc:
+    case op_iload:
+    case op_fload:
+    case op_aload:
+    case op_new:
+        pushes = 1;
+        break;
+    case op_lconst_0:
+    case op_lconst_1:
+    case op_dconst_0:
+    case op_dconst_1:
+    case op_ldc2_w:
+    case op_lload:
+    case op_dload:
+        pushes = 2;
+        break;
+    case op_istore:
+    case op_fstore:
+    case op_astore:
+    case op_pop:
+    case op_ifeq:
+    case op_ifne:
+    case op_iflt:
+    case op_ifge:
+    case op_ifgt:
+    case op_ifle:
+    case op_ifnull:
+    case op_ifnonnull:
+    case op_athrow:
+        pops = 1;
+        break;
+    case op_lstore:
+    case op_dstore:
+    case op_pop2:
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmpge:
+    case op_if_icmpgt:
+    case op_if_icmple:
+    case op_if_acmpeq:
+    case op_if_acmpne:
+        pops = 2;
+        break;
+    case op_iaload:
+    case op_faload:
+    case op_aaload:
+    case op_baload:
+    case op_caload:
+    case op_saload:
+    case op_iadd:
+    case op_fadd:
+    case op_isub:
+    case op_fsub:
+    case op_imul:
+    case op_fmul:
+    case op_idiv:
+    case op_fdiv:
+    case op_irem:
+    case op_frem:
+    case op_ishl:
+    case op_ishr:
+    case op_iushr:
+    case op_iand:
+    case op_ior:
+    case op_ixor:
+    case op_fcmpl:
+    case op_fcmpg:
+    case op_l2i:
+    case op_l2f:
+    case op_d2i:
+    case op_d2f:
+        pops   = 2;
+        pushes = 1;
+        break;
+    case op_laload:
+    case op_daload:
+    case op_swap:
+    case op_lneg:
+    case op_dneg:
+    case op_l2d:
+    case op_d2l:
+        pops   = 2;
+        pushes = 2;
+        break;
+    case op_ineg:
+    case op_fneg:
+    case op_i2f:
+    case op_f2i:
+    case op_i2b:
+    case op_i2c:
+    case op_i2s:
+    case op_newarray:
+    case op_anewarray:
+    case op_arraylength:
+    case op_checkcast:
+    case op_instanceof:
+        pops   = 1;
+        pushes = 1;
+        break;
+    case op_i2l:
+    case op_i2d:
+    case op_f2l:
+    case op_f2d:
+        pops   = 1;
+        pushes = 2;
+        break;
+    case op_iastore:
+    case op_fastore:
+    case op_aastore:
+    case op_bastore:
+    case op_castore:
+    case op_sastore:
+        pops = 3;
+        break;
+    case op_lastore:
+    case op_dastore:
+        pops = 4;
+        break;
+    case op_ladd:
+    case op_dadd:
+    case op_lsub:
+    case op_dsub:
+    case op_lmul:
+    case op_dmul:
+    case op_ldiv:
+    case op_ddiv:
+    case op_lrem:
+    case op_drem:
+    case op_land:
+    case op_lor:
+    case op_lxor:
+        pops   = 4;
+        pushes = 2;
+        break;
+    case op_lshl:
+    case op_lshr:
+    case op_lushr:
+        pops   = 3;
+        pushes = 2;
+        break;
+    case op_lcmp:
+    case op_dcmpl:
+    case op_dcmpg:
+        pops   = 4;
+        pushes = 1;
+        break;
+    case op_dup:
+        pops   = 1;
+        pushes = 2;
+        break;
+    case op_dup_x1:
+        pops   = 2;
+        pushes = 3;
+        break;
+    case op_dup_x2:
+        pops   = 3;
+        pushes = 4;
+        break;
+    case op_dup2:
+        pops   = 2;
+        pushes = 4;
+        break;
+    case op_dup2_x1:
+        pops   = 3;
+        pushes = 5;
+        break;
+    case op_dup2_x2:
+        pops   = 4;
+        pushes = 6;
+        break;
+    case op_getstatic:
+        pushes = ins.ref.field->slots;
+        break;
+    case op_putstatic:
+        pops = ins.ref.field->slots;
+        break;
+    case op_getfield:
+        pops   = 1;
+        pushes = ins.ref.field->slots;
+        break;
+    case op_putfield:
+        pops = 1 + ins.ref.field->slots;
+        break;
+    case op_multianewarray:
+        pops   = ins.a;
+        pushes = 1;
+        break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+///
+/// Slots a return instruction returns, -1 if opcode is not a return
+///
+static int returnSlots(unsigned short opcode) {
+    switch (opcode) {
+    case op_ireturn:
+    case op_freturn:
+    case op_areturn:
+        return 1;
+    case op_lreturn:
+    case op_dreturn:
+        return 2;
+    case op_return:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+///
+/// Finds the method of ref in class_name or in the nearest super class that
+/// declares it, and sets class_name to that class. nullptr if not found
+///
+MethodInfoCte *Inliner::lookup(std::string &class_name, const MethodRef &ref) {
+    while (cm->count(class_name)) {
+        auto &methods = cm->at(class_name);
+        auto method   = methods.find(ref.name_and_type);
+        if (method != methods.end()) {
+            return &method->second;
+        }
+        auto super = super_class->find(class_name);
+        if (super == super_class->end()) {
+            break;
+        }
+        class_name = super->second;
+    }
+    return nullptr;
+}
+
+///
+/// The method the call ins, at index in the decoded method, runs. Its
+/// method is nullptr when it depends on the receiver beyond what
+/// speculation tells or is not known
+///
+Inliner::Binding Inliner::bind(const Instruction &ins, int index,
+                               const Speculation &speculation) {
+    Binding binding;
+    auto ref           = ins.ref.method;
+    binding.class_name = ref->class_name;
+    if (ref->kind != MethodRef::User) {
+        return binding;
+    }
+    if (ins.opcode == op_invokestatic || ins.opcode == op_invokespecial) {
+        auto method = lookup(binding.class_name, *ref);
+        bool is_static = method != nullptr &&
+                         (method->access_flags & 0x0008); // ACC_STATIC
+        if (is_static == (ins.opcode == op_invokestatic)) {
+            binding.method = method;
+        }
+        return binding;
+    }
+    auto runtime_class = classes->find(binding.class_name);
+    if (ins.opcode != op_invokevirtual || runtime_class == classes->end()) {
+        return binding;
+    }
+    auto entry = runtime_class->second.vtable_index.find(ref->name_and_type);
+    if (entry == runtime_class->second.vtable_index.end()) {
+        return binding;
+    }
+    // the entry of the loaded classes and of the instantiated ones
+    const VirtualMethod *loaded       = nullptr;
+    const VirtualMethod *instantiated = nullptr;
+    bool unique                       = true;
+    bool unique_instantiated          = true;
+    std::vector<const RuntimeClass *> pending{&runtime_class->second};
+    while (!pending.empty()) {
+        auto current = pending.back();
+        pending.pop_back();
+        auto &method = current->vtable[entry->second];
+        unique =
+            unique && (loaded == nullptr || loaded->method == method.method);
+        loaded = &method;
+        if (speculation.instantiated.count(current)) {
+            unique_instantiated =
+                unique_instantiated && (instantiated == nullptr ||
+                                        instantiated->method == method.method);
+            instantiated = &method;
+        }
+        pending.insert(pending.end(), current->subclasses.begin(),
+                       current->subclasses.end());
+    }
+    auto receiver = speculation.receivers.find(index);
+    if (!unique && unique_instantiated && instantiated != nullptr) {
+        loaded            = instantiated;
+        binding.dependent = true;
+        binding.dependency =
+            Dependency{&runtime_class->second, entry->second,
+                       instantiated->method, ins.bci};
+    } else if (!unique && receiver != speculation.receivers.end()) {
+        loaded        = &receiver->second->vtable[entry->second];
+        binding.guard = receiver->second;
+    } else if (!unique) {
+        return binding;
+    }
+    binding.class_name = loaded->declaring_class;
+    binding.method     = loaded->method;
+    return binding;
+}
+
+///
+/// Decodes a copy of the code of method that is only used inlined, nullptr
+/// if method cannot be inlined. Besides the rules on the instructions, the
+/// operand stack depth of each instruction is computed over every path to
+/// check what returns leave on it
+///
+std::shared_ptr<DecodedMethod> Inliner::body(MethodInfoCte &method,
+                                             const std::string &class_name) {
+    // ACC_SYNCHRONIZED, ACC_NATIVE and ACC_ABSTRACT
+    if ((method.access_flags & 0x0520) || method.attributes.empty()) {
+        return nullptr;
+    }
+    auto &attribute = method.attributes[0];
+    if (attribute.code_length == 0 ||
+        attribute.code_length > options.max_inline_size ||
+        attribute.exception_table_length > 0) {
+        return nullptr;
+    }
+    BytecodeDecoder decoder(cp.at(class_name), class_name);
+    auto body  = decoder.decode(attribute);
+    auto &code = body->code;
+    std::vector<int> depth(code.size(), -1);
+    std::vector<int> pending{0};
+    depth[0] = 0;
+    while (!pending.empty()) {
+        int index = pending.back();
+        auto &ins = code[index];
+        pending.pop_back();
+        if (ins.opcode == op_invokespecial &&
+            ins.ref.method->kind == MethodRef::JavaObject &&
+            ins.ref.method->name == "<init>") {
+            ins.opcode = op_pop;
+        }
+        int slots = returnSlots(ins.opcode);
+        if (slots >= 0) {
+            if (depth[index] != slots) {
+                return nullptr;
+            }
+            continue;
+        }
+        int pops, pushes;
+        if (!stackEffect(ins, pops, pushes) || depth[index] < pops) {
+            return nullptr;
+        }
+        int after = depth[index] - pops + pushes;
+        std::vector<int> next;
+        if (ins.opcode != op_goto && ins.opcode != op_athrow) {
+            next.push_back(index + 1);
+        }
+        if (ins.target != -1) {
+            next.push_back(ins.target);
+        }
+        for (auto successor : next) {
+            if (successor >= code.size()) {
+                return nullptr;
+            }
+            if (depth[successor] == -1) {
+                depth[successor] = after;
+                pending.push_back(successor);
+            } else if (depth[successor] != after) {
+                return nullptr;
+            }
+        }
+    }
+    return body;
+}
+
+///
+/// Store instruction of the local variable of the parameter at arg of a
+/// descriptor argument list, arg is moved past the parameter
+///
+static unsigned short storeOf(std::string::const_iterator &arg) {
+    switch (*arg++) {
+    case 'J':
+        return op_lstore;
+    case 'D':
+        return op_dstore;
+    case 'F':
+        return op_fstore;
+    case 'L':
+        while (*arg++ != ';') {
+        }
+        return op_astore;
+    case '[':
+        while (*arg == '[') {
+            arg++;
+        }
+        storeOf(arg);
+        return op_astore;
+    default:
+        return op_istore;
+    }
+}
+
+///
+/// Inlines the eligible calls of method, name is only used to report them.
+/// The inlined code uses the locals after max_locals of method: as inlined
+/// methods make no calls, they never run at the same time and all of them
+/// share these locals
+///
+void Inliner::inlineCalls(DecodedMethod *method, const std::string &name,
+                          const Speculation &speculation) {
+    struct Site {
+        std::shared_ptr<DecodedMethod> body;
+        std::string callee;
+        int bytes;
+        Binding binding;
+    };
+    std::map<int, Site> sites; // by index of the call
+    int extra_locals = 0;
+    int extra_stack  = 0;
+    for (int index = 0; index < method->code.size(); index++) {
+        auto &ins = method->code[index];
+        if (ins.opcode != op_invokestatic && ins.opcode != op_invokespecial &&
+            ins.opcode != op_invokevirtual) {
+            continue;
+        }
+        auto binding = bind(ins, index, speculation);
+        auto callee  = binding.method;
+        auto copy    = callee == nullptr ? nullptr
+                                         : body(*callee, binding.class_name);
+        if (copy == nullptr || method->max_locals + copy->max_locals > 0xffff ||
+            method->max_stack + copy->max_stack > 0xffff) {
+            continue;
+        }
+        extra_locals = std::max<int>(extra_locals, copy->max_locals);
+        extra_stack  = std::max<int>(extra_stack, copy->max_stack);
+        sites[index] = Site{copy,
+                            binding.class_name + "." + callee->name +
+                                callee->descriptor,
+                            static_cast<int>(
+                                callee->attributes[0].code_length),
+                            binding};
+    }
+    if (sites.empty()) {
+        return;
+    }
+    int base = method->max_locals;
+    std::vector<Instruction> code;
+    std::vector<int> index_of(method->code.size() + 1);
+    std::vector<int> branches; // instructions of method with a target
+    for (int index = 0; index < method->code.size(); index++) {
+        auto &ins       = method->code[index];
+        index_of[index] = code.size();
+        auto site       = sites.find(index);
+        if (site == sites.end()) {
+            if (ins.target != -1) {
+                branches.push_back(code.size());
+            }
+            code.push_back(ins);
+            continue;
+        }
+        auto ref = ins.ref.method;
+        Instruction emitted = ins;
+        emitted.target      = -1;
+        emitted.ref.ptr     = nullptr;
+        // arguments leave the operand stack for the locals of the callee
+        std::vector<Instruction> stores;
+        int local = base;
+        auto &binding = site->second.binding;
+        if (binding.dependent) {
+            method->dependencies.push_back(binding.dependency);
+        }
+        if (ins.opcode != op_invokestatic) {
+            emitted.opcode = op_nullcheck;
+            emitted.a      = ref->arg_slots + 1;
+            if (binding.guard != nullptr) {
+                emitted.opcode            = op_guard_class;
+                emitted.ref.runtime_class = binding.guard;
+            }
+            code.push_back(emitted);
+            emitted.ref.ptr = nullptr;
+            emitted.opcode  = op_astore;
+            emitted.a      = local++;
+            stores.push_back(emitted);
+        }
+        for (auto arg = ref->args.cbegin(); arg != ref->args.cend();) {
+            emitted.opcode = storeOf(arg);
+            emitted.a      = local;
+            local += emitted.opcode == op_lstore ||
+                             emitted.opcode == op_dstore
+                         ? 2
+                         : 1;
+            stores.push_back(emitted);
+        }
+        code.insert(code.end(), stores.rbegin(), stores.rend());
+        // the code of the callee, returns jump to the end of it but the
+        // last one, which is dropped
+        auto &body = site->second.body->code;
+        int end    = code.size();
+        std::vector<int> body_index(body.size());
+        for (int k = 0; k < body.size(); k++) {
+            body_index[k] = end;
+            end += returnSlots(body[k].opcode) < 0 || k + 1 < body.size();
+        }
+        for (int k = 0; k < body.size(); k++) {
+            auto copied = body[k];
+            copied.bci  = ins.bci;
+            switch (copied.opcode) {
+            case op_iload:
+            case op_lload:
+            case op_fload:
+            case op_dload:
+            case op_aload:
+            case op_istore:
+            case op_lstore:
+            case op_fstore:
+            case op_dstore:
+            case op_astore:
+            case op_iinc:
+                copied.a += base;
+                break;
+            default:
+                break;
+            }
+            if (returnSlots(copied.opcode) >= 0) {
+                if (k + 1 == body.size()) {
+                    continue;
+                }
+                copied.opcode = op_goto;
+                copied.target = end;
+            } else if (copied.target != -1) {
+                copied.target = body_index[copied.target];
+            }
+            code.push_back(copied);
+        }
+        method->inlined.push_back(site->second.body);
+        inlined_calls++;
+        if (options.print_inlining) {
+            // one write per line, as compile threads report at once
+            std::ostringstream line;
+            line << name << " @ " << ins.bci << " inlines "
+                 << site->second.callee << " (" << site->second.bytes
+                 << " bytes";
+            if (binding.dependent) {
+                line << ", while no subclass instance overrides it";
+            } else if (binding.guard != nullptr) {
+                line << ", guarded by class " << binding.guard->name;
+            }
+            line << ")\n";
+            std::cerr << line.str() << std::flush;
+        }
+    }
+    index_of[method->code.size()] = code.size();
+    for (auto branch : branches) {
+        code[branch].target = index_of[code[branch].target];
+    }
+    for (auto &table : method->switches) {
+        table.default_target = index_of[table.default_target];
+        for (auto &target : table.targets) {
+            target = index_of[target];
+        }
+    }
+    for (auto &handler : method->handlers) {
+        handler.start   = index_of[handler.start];
+        handler.end     = index_of[handler.end];
+        handler.handler = index_of[handler.handler];
+    }
+    // the interpreter index of an empty inlined call is the one of the
+    // instruction after it, where its index_of points too
+    method->interpreter_index.assign(code.size(), -1);
+    for (int index = 0; index < method->code.size(); index++) {
+        if (index_of[index] < code.size()) {
+            method->interpreter_index[index_of[index]] = index;
+        }
+    }
+    method->code = code;
+    method->max_locals += extra_locals;
+    method->max_stack += extra_stack;
+}
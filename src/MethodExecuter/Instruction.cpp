@@ -0,0 +1,14 @@
+#include <MethodExecuter/Instruction.hpp>
+
+const char *opcodeName(unsigned short opcode) {
+    switch (opcode) {
+#define OPCODE_NAME(name, code)                                                \
+    case code:                                                                 \
+        return #name;
+        JVM_OPCODES(OPCODE_NAME)
+        JVM_QUICK_OPCODES(OPCODE_NAME)
+#undef OPCODE_NAME
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,598 @@
+#include <JVM/structures/JavaException.hpp>
+#include <MethodExecuter/Ir.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <math.h>
+
+///
+/// Appends an empty block whose first instruction in the decoded code is
+/// start
+///
+int IrFunction::newBlock(int start) {
+    blocks.push_back(IrBlock{start, {}, {}, {}});
+    return blocks.size() - 1;
+}
+
+///
+/// Appends a value to the code of block and returns its index
+///
+int IrFunction::add(int block, unsigned short opcode, IrType type,
+                    std::vector<int> args, int bci) {
+    IrValue value{};
+    value.opcode = opcode;
+    value.type   = type;
+    value.block  = block;
+    value.bci    = bci;
+    value.args   = std::move(args);
+    values.push_back(value);
+    blocks[block].code.push_back(values.size() - 1);
+    return values.size() - 1;
+}
+
+int IrFunction::constant(int block, IrType type, Slot value, int bci) {
+    int index              = add(block, ir_const, type, {}, bci);
+    values[index].constant = value;
+    return index;
+}
+
+///
+/// Takes value out of its block, whatever still uses it
+///
+void IrFunction::remove(int value) {
+    auto &code = blocks[values[value].block].code;
+    code.erase(std::find(code.begin(), code.end(), value));
+    values[value].block = -1;
+}
+
+///
+/// Makes every value use replacement[v] instead of v, when it is not -1,
+/// following the replacements of the replacements
+///
+void IrFunction::replaceUses(const std::vector<int> &replacement) {
+    auto find = [&replacement](int value) {
+        while (value >= 0 && replacement[value] >= 0) {
+            value = replacement[value];
+        }
+        return value;
+    };
+    for (auto &value : values) {
+        if (value.block >= 0) {
+            for (auto &arg : value.args) {
+                arg = find(arg);
+            }
+        }
+    }
+}
+
+///
+/// Removes one edge from block from to block to, with the arguments the
+/// phis of to take from it
+///
+void IrFunction::removeEdge(int from, int to) {
+    auto &succs = blocks[from].succs;
+    succs.erase(std::find(succs.begin(), succs.end(), to));
+    auto &preds = blocks[to].preds;
+    auto pred   = std::find(preds.begin(), preds.end(), from);
+    int index   = pred - preds.begin();
+    preds.erase(pred);
+    for (int value : blocks[to].code) {
+        if (values[value].opcode == ir_phi) {
+            auto &args = values[value].args;
+            args.erase(args.begin() + index);
+        }
+    }
+}
+
+///
+/// Empties the blocks the entry no longer reaches, as their branch was
+/// folded, and removes their edges to the blocks it reaches
+///
+void IrFunction::removeUnreachable() {
+    std::vector<bool> reached(blocks.size(), false);
+    for (int block : order()) {
+        reached[block] = true;
+    }
+    for (int block = 0; block < blocks.size(); block++) {
+        if (reached[block]) {
+            continue;
+        }
+        while (!blocks[block].succs.empty()) {
+            removeEdge(block, blocks[block].succs.back());
+        }
+        for (int value : blocks[block].code) {
+            values[value].block = -1;
+        }
+        blocks[block].code.clear();
+        blocks[block].preds.clear();
+    }
+}
+
+///
+/// Blocks the entry reaches, in reverse postorder: a block comes before its
+/// successors, except along the edges going back to a loop header
+///
+std::vector<int> IrFunction::order() const {
+    std::vector<int> postorder;
+    std::vector<bool> visited(blocks.size(), false);
+    std::vector<std::pair<int, int>> path{{0, 0}}; // block and next succ
+    visited[0] = true;
+    while (!path.empty()) {
+        auto &top = path.back();
+        auto &succs = blocks[top.first].succs;
+        if (top.second < succs.size()) {
+            int succ = succs[top.second++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                path.push_back(std::make_pair(succ, 0));
+            }
+        } else {
+            postorder.push_back(top.first);
+            path.pop_back();
+        }
+    }
+    return std::vector<int>(postorder.rbegin(), postorder.rend());
+}
+
+///
+/// Immediate dominator of each block in order (the entry dominates itself),
+/// -1 for the blocks the entry does not reach. From Cooper, Harvey and
+/// Kennedy, "A Simple, Fast Dominance Algorithm"
+///
+std::vector<int>
+IrFunction::dominators(const std::vector<int> &order) const {
+    std::vector<int> idom(blocks.size(), -1);
+    std::vector<int> rank(blocks.size(), -1);
+    for (int k = 0; k < order.size(); k++) {
+        rank[order[k]] = k;
+    }
+    idom[0]      = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int k = 1; k < order.size(); k++) {
+            int block = order[k];
+            int dom   = -1;
+            for (int pred : blocks[block].preds) {
+                if (idom[pred] < 0) {
+                    continue;
+                }
+                int other = pred;
+                while (dom >= 0 && dom != other) {
+                    while (rank[other] > rank[dom]) {
+                        other = idom[other];
+                    }
+                    while (rank[dom] > rank[other]) {
+                        dom = idom[dom];
+                    }
+                }
+                dom = other;
+            }
+            if (idom[block] != dom) {
+                idom[block] = dom;
+                changed     = true;
+            }
+        }
+    }
+    return idom;
+}
+
+///
+/// Whether block a dominates block b, with idom from dominators
+///
+bool IrFunction::dominates(const std::vector<int> &idom, int a,
+                           int b) const {
+    while (b != a && b > 0) {
+        b = idom[b];
+    }
+    return b == a;
+}
+
+///
+/// Times each value is used by the values still in a block
+///
+std::vector<int> IrFunction::useCounts() const {
+    std::vector<int> uses(values.size(), 0);
+    for (auto &value : values) {
+        if (value.block >= 0) {
+            for (int arg : value.args) {
+                uses[arg]++;
+            }
+        }
+    }
+    return uses;
+}
+
+///
+/// Number of values still in a block
+///
+int IrFunction::size() const {
+    int size = 0;
+    for (auto &block : blocks) {
+        size += block.code.size();
+    }
+    return size;
+}
+
+static const char *typeName(IrType type) {
+    static const char *const names[] = {"void", "int", "long", "float",
+                                        "double"};
+    return names[static_cast<int>(type)];
+}
+
+///
+/// Writes the blocks the entry reaches, one value per line
+///
+void IrFunction::print(std::ostream &out) const {
+    static const char *const ir_names[] = {"const", "param", "phi", "copy"};
+    for (int block : order()) {
+        out << "  B" << block << ":";
+        if (!blocks[block].preds.empty()) {
+            out << " <-";
+            for (int pred : blocks[block].preds) {
+                out << " B" << pred;
+            }
+        }
+        out << std::endl;
+        for (int index : blocks[block].code) {
+            auto &value = values[index];
+            out << "    ";
+            if (value.type != IrType::Void) {
+                out << "v" << index << " = ";
+            }
+            if (value.opcode >= ir_const) {
+                out << ir_names[value.opcode - ir_const];
+            } else {
+                out << opcodeName(value.opcode);
+            }
+            if (value.type != IrType::Void) {
+                out << " " << typeName(value.type);
+            }
+            if (value.opcode == ir_const) {
+                switch (value.type) {
+                case IrType::Int:
+                    out << " " << value.constant.i;
+                    break;
+                case IrType::Long:
+                    out << " " << value.constant.j;
+                    break;
+                case IrType::Float:
+                    out << " " << value.constant.f;
+                    break;
+                default:
+                    out << " " << value.constant.d;
+                }
+            } else if (value.opcode == ir_param) {
+                out << " local " << value.local;
+            } else if (value.field != nullptr) {
+                out << " " << value.field->class_name << "."
+                    << value.field->name;
+            }
+            for (int arg : value.args) {
+                out << " v" << arg;
+            }
+            if (irIsBranch(value.opcode)) {
+                out << " ->";
+                for (int succ : blocks[block].succs) {
+                    out << " B" << succ;
+                }
+            }
+            out << std::endl;
+        }
+    }
+}
+
+///
+/// Slots a value of type takes in the locals or on the operand stack
+///
+int irSlots(IrType type) {
+    switch (type) {
+    case IrType::Void:
+        return 0;
+    case IrType::Long:
+    case IrType::Double:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+///
+/// Whether opcode ends a block with a jump: goto or a conditional branch
+///
+bool irIsBranch(unsigned short opcode) {
+    return (opcode >= op_ifeq && opcode <= op_if_icmple) || opcode == op_goto;
+}
+
+bool irIsReturn(unsigned short opcode) {
+    return opcode >= op_ireturn && opcode <= op_return;
+}
+
+///
+/// Whether value may throw: an integer division or remainder whose divisor
+/// is not a constant other than zero
+///
+bool irCanThrow(const IrFunction &function, const IrValue &value) {
+    switch (value.opcode) {
+    case op_idiv:
+    case op_irem:
+    case op_ldiv:
+    case op_lrem: {
+        auto &divisor = function.values[value.args[1]];
+        return divisor.opcode != ir_const || divisor.constant.j == 0;
+    }
+    default:
+        return false;
+    }
+}
+
+///
+/// Whether value only computes a result from its arguments: it neither
+/// throws, reads or writes a field nor changes the control flow, so it may
+/// be moved, merged with an equal one or dropped when unused
+///
+bool irIsPure(const IrFunction &function, const IrValue &value) {
+    if (value.opcode == ir_const || value.opcode == ir_copy) {
+        return true;
+    }
+    return value.opcode >= op_iadd && value.opcode <= op_dcmpg &&
+           value.opcode != op_iinc && !irCanThrow(function, value);
+}
+
+///
+/// Floating point to integer conversion: NaN gives zero and values out of
+/// range saturate at the limits of the integer type
+///
+template <typename To, typename From> static To saturate(From value) {
+    if (isnan(value)) {
+        return 0;
+    }
+    if (value >= static_cast<From>(std::numeric_limits<To>::max())) {
+        return std::numeric_limits<To>::max();
+    }
+    if (value <= static_cast<From>(std::numeric_limits<To>::min())) {
+        return std::numeric_limits<To>::min();
+    }
+    return static_cast<To>(value);
+}
+
+///
+/// fcmpl, fcmpg, dcmpl and dcmpg, nan is the result when any value is NaN
+///
+template <typename T> static int compare(T value1, T value2, int nan) {
+    if (value1 > value2) {
+        return 1;
+    }
+    if (value1 < value2) {
+        return -1;
+    }
+    if (value1 == value2) {
+        return 0;
+    }
+    return nan;
+}
+
+static void divisionByZero() {
+    throw JavaException("java/lang/ArithmeticException", "/ by zero");
+}
+
+///
+/// Result of the arithmetic, conversion or comparison opcode on args, as
+/// the interpreter computes it. Throws the ArithmeticException of an
+/// integer division by zero
+///
+Slot irEvaluate(unsigned short opcode, const Slot *args) {
+    Slot result{};
+    auto &x = args[0];
+    auto &y = args[1];
+    switch (opcode) {
+    case op_iadd:
+        result.i = static_cast<uint32_t>(x.i) + y.i;
+        break;
+    case op_ladd:
+        result.j = static_cast<uint64_t>(x.j) + y.j;
+        break;
+    case op_fadd:
+        result.f = x.f + y.f;
+        break;
+    case op_dadd:
+        result.d = x.d + y.d;
+        break;
+    case op_isub:
+        result.i = static_cast<uint32_t>(x.i) - y.i;
+        break;
+    case op_lsub:
+        result.j = static_cast<uint64_t>(x.j) - y.j;
+        break;
+    case op_fsub:
+        result.f = x.f - y.f;
+        break;
+    case op_dsub:
+        result.d = x.d - y.d;
+        break;
+    case op_imul:
+        result.i = static_cast<uint32_t>(x.i) * y.i;
+        break;
+    case op_lmul:
+        result.j = static_cast<uint64_t>(x.j) * y.j;
+        break;
+    case op_fmul:
+        result.f = x.f * y.f;
+        break;
+    case op_dmul:
+        result.d = x.d * y.d;
+        break;
+    case op_idiv:
+        if (y.i == 0) {
+            divisionByZero();
+        }
+        // MIN_VALUE / -1 overflows back to MIN_VALUE
+        result.i = y.i == -1 ? 0u - static_cast<uint32_t>(x.i) : x.i / y.i;
+        break;
+    case op_ldiv:
+        if (y.j == 0) {
+            divisionByZero();
+        }
+        result.j = y.j == -1 ? 0u - static_cast<uint64_t>(x.j) : x.j / y.j;
+        break;
+    case op_fdiv:
+        result.f = x.f / y.f;
+        break;
+    case op_ddiv:
+        result.d = x.d / y.d;
+        break;
+    case op_irem:
+        if (y.i == 0) {
+            divisionByZero();
+        }
+        result.i = y.i == -1 ? 0 : x.i % y.i;
+        break;
+    case op_lrem:
+        if (y.j == 0) {
+            divisionByZero();
+        }
+        result.j = y.j == -1 ? 0 : x.j % y.j;
+        break;
+    case op_frem:
+        result.f = fmodf(x.f, y.f);
+        break;
+    case op_drem:
+        result.d = fmod(x.d, y.d);
+        break;
+    case op_ineg:
+        result.i = 0u - static_cast<uint32_t>(x.i);
+        break;
+    case op_lneg:
+        result.j = 0u - static_cast<uint64_t>(x.j);
+        break;
+    case op_fneg:
+        result.f = -x.f;
+        break;
+    case op_dneg:
+        result.d = -x.d;
+        break;
+    case op_ishl:
+        result.i = static_cast<uint32_t>(x.i) << (y.i & 31);
+        break;
+    case op_lshl:
+        result.j = static_cast<uint64_t>(x.j) << (y.i & 63);
+        break;
+    case op_ishr:
+        result.i = x.i >> (y.i & 31);
+        break;
+    case op_lshr:
+        result.j = x.j >> (y.i & 63);
+        break;
+    case op_iushr:
+        result.i = static_cast<uint32_t>(x.i) >> (y.i & 31);
+        break;
+    case op_lushr:
+        result.j = static_cast<uint64_t>(x.j) >> (y.i & 63);
+        break;
+    case op_iand:
+        result.i = x.i & y.i;
+        break;
+    case op_land:
+        result.j = x.j & y.j;
+        break;
+    case op_ior:
+        result.i = x.i | y.i;
+        break;
+    case op_lor:
+        result.j = x.j | y.j;
+        break;
+    case op_ixor:
+        result.i = x.i ^ y.i;
+        break;
+    case op_lxor:
+        result.j = x.j ^ y.j;
+        break;
+    case op_i2l:
+        result.j = x.i;
+        break;
+    case op_i2f:
+        result.f = x.i;
+        break;
+    case op_i2d:
+        result.d = x.i;
+        break;
+    case op_l2i:
+        result.i = static_cast<int32_t>(x.j);
+        break;
+    case op_l2f:
+        result.f = x.j;
+        break;
+    case op_l2d:
+        result.d = x.j;
+        break;
+    case op_f2i:
+        result.i = saturate<int32_t>(x.f);
+        break;
+    case op_f2l:
+        result.j = saturate<int64_t>(x.f);
+        break;
+    case op_f2d:
+        result.d = x.f;
+        break;
+    case op_d2i:
+        result.i = saturate<int32_t>(x.d);
+        break;
+    case op_d2l:
+        result.j = saturate<int64_t>(x.d);
+        break;
+    case op_d2f:
+        result.f = x.d;
+        break;
+    case op_i2b:
+        result.i = static_cast<int8_t>(x.i);
+        break;
+    case op_i2c:
+        result.i = static_cast<uint16_t>(x.i);
+        break;
+    case op_i2s:
+        result.i = static_cast<int16_t>(x.i);
+        break;
+    case op_lcmp:
+        result.i = (x.j > y.j) - (x.j < y.j);
+        break;
+    case op_fcmpl:
+    case op_fcmpg:
+        result.i = compare(x.f, y.f, opcode == op_fcmpg ? 1 : -1);
+        break;
+    case op_dcmpl:
+    case op_dcmpg:
+        result.i = compare(x.d, y.d, opcode == op_dcmpg ? 1 : -1);
+        break;
+    default:
+        throw std::runtime_error(std::string("Cannot evaluate ") +
+                                 opcodeName(opcode));
+    }
+    return result;
+}
+
+///
+/// Whether the conditional branch opcode is taken for args
+///
+bool irTaken(unsigned short opcode, const Slot *args) {
+    int x = args[0].i;
+    int y = opcode >= op_if_icmpeq ? args[1].i : 0;
+    switch (opcode) {
+    case op_ifeq:
+    case op_if_icmpeq:
+        return x == y;
+    case op_ifne:
+    case op_if_icmpne:
+        return x != y;
+    case op_iflt:
+    case op_if_icmplt:
+        return x < y;
+    case op_ifge:
+    case op_if_icmpge:
+        return x >= y;
+    case op_ifgt:
+    case op_if_icmpgt:
+        return x > y;
+    default:
+        return x <= y;
+    }
+}
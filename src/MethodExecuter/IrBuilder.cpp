@@ -0,0 +1,580 @@
+#include <MethodExecuter/IrBuilder.hpp>
+#include <constants/MethodInfoCte.hpp>
+#include <algorithm>
+
+IrBuilder::IrBuilder(const DecodedMethod &method) : method(method) {
+    function = nullptr;
+}
+
+bool IrBuilder::fail(const std::string &reason) {
+    failure = reason;
+    return false;
+}
+
+///
+/// Type of a field or parameter descriptor starting at c, false for a
+/// reference
+///
+static bool descriptorType(char c, IrType &type) {
+    switch (c) {
+    case 'B':
+    case 'C':
+    case 'I':
+    case 'S':
+    case 'Z':
+        type = IrType::Int;
+        return true;
+    case 'J':
+        type = IrType::Long;
+        return true;
+    case 'F':
+        type = IrType::Float;
+        return true;
+    case 'D':
+        type = IrType::Double;
+        return true;
+    case 'V':
+        type = IrType::Void;
+        return true;
+    default:
+        return false;
+    }
+}
+
+///
+/// Type of the value an arithmetic, conversion or comparison opcode pushes
+///
+static IrType resultType(unsigned short opcode) {
+    static const IrType types[] = {IrType::Int, IrType::Long, IrType::Float,
+                                   IrType::Double};
+    if (opcode >= op_iadd && opcode <= op_dneg) {
+        return types[(opcode - op_iadd) % 4];
+    }
+    if (opcode >= op_ishl && opcode <= op_lxor) {
+        return types[(opcode - op_ishl) % 2];
+    }
+    switch (opcode) {
+    case op_i2l:
+    case op_f2l:
+    case op_d2l:
+        return IrType::Long;
+    case op_i2f:
+    case op_l2f:
+    case op_d2f:
+        return IrType::Float;
+    case op_i2d:
+    case op_l2d:
+    case op_f2d:
+        return IrType::Double;
+    default:
+        return IrType::Int;
+    }
+}
+
+static bool isUnary(unsigned short opcode) {
+    return (opcode >= op_ineg && opcode <= op_dneg) ||
+           (opcode >= op_i2l && opcode <= op_i2s);
+}
+
+///
+/// Whether the IR has a translation for ins
+///
+bool IrBuilder::supported(const Instruction &ins) const {
+    IrType type;
+    switch (ins.opcode) {
+    case op_ldc:
+        return ins.ref.constant->value.t != R;
+    case op_getstatic:
+    case op_putstatic:
+        return ins.ref.field->descriptor.size() == 1 &&
+               descriptorType(ins.ref.field->descriptor[0], type);
+    case op_aload:
+    case op_astore:
+    case op_if_acmpeq:
+    case op_if_acmpne:
+    case op_areturn:
+        return false;
+    default:
+        return (ins.opcode >= op_nop && ins.opcode <= op_dconst_1 &&
+                ins.opcode != op_aconst_null) ||
+               ins.opcode == op_bipush || ins.opcode == op_sipush ||
+               ins.opcode == op_ldc2_w ||
+               (ins.opcode >= op_iload && ins.opcode <= op_dload) ||
+               (ins.opcode >= op_istore && ins.opcode <= op_dstore) ||
+               (ins.opcode >= op_pop && ins.opcode <= op_dcmpg) ||
+               (ins.opcode >= op_ifeq && ins.opcode <= op_goto) ||
+               (ins.opcode >= op_ireturn && ins.opcode <= op_return);
+    }
+}
+
+///
+/// Reads the parameters of primitive type into the locals of the entry
+/// block and checks the method does not return a reference
+///
+bool IrBuilder::addParameters(State &state) {
+    auto &descriptor = method.info->descriptor;
+    int local        = (method.info->access_flags & 0x0008) ? 0 : 1;
+    int k            = 1; // past '('
+    while (descriptor[k] != ')') {
+        IrType type;
+        if (descriptorType(descriptor[k], type)) {
+            int param = function->add(0, ir_param, type, {}, 0);
+            function->values[param].local = local;
+            store(state.locals, local, param);
+            local += irSlots(type);
+            k++;
+            continue;
+        }
+        while (descriptor[k] == '[') {
+            k++;
+        }
+        k = descriptor[k] == 'L' ? descriptor.find(';', k) + 1 : k + 1;
+        local++;
+    }
+    IrType type;
+    if (!descriptorType(descriptor[k + 1], type)) {
+        return fail("returns a reference");
+    }
+    function->return_slots = irSlots(type);
+    return true;
+}
+
+///
+/// Splits the code into blocks after the entry block, blocks[0], and links
+/// them. The blocks no path reaches are dropped
+///
+void IrBuilder::findBlocks() {
+    auto &code = method.code;
+    std::vector<bool> leader(code.size(), false);
+    leader[0] = true;
+    for (int k = 0; k < code.size(); k++) {
+        auto &ins = code[k];
+        if (irIsBranch(ins.opcode)) {
+            leader[ins.target] = true;
+        }
+        if ((irIsBranch(ins.opcode) || irIsReturn(ins.opcode)) &&
+            k + 1 < code.size()) {
+            leader[k + 1] = true;
+        }
+    }
+    auto &blocks = function->blocks;
+    function->newBlock(-1);
+    block_at.assign(code.size(), -1);
+    for (int k = 0; k < code.size(); k++) {
+        if (leader[k]) {
+            block_at[k] = function->newBlock(k);
+        }
+    }
+    auto link = [&blocks](int from, int to) {
+        blocks[from].succs.push_back(to);
+        blocks[to].preds.push_back(from);
+    };
+    link(0, 1);
+    for (int block = 1; block < blocks.size(); block++) {
+        int last = block + 1 < blocks.size() ? blocks[block + 1].start - 1
+                                             : code.size() - 1;
+        auto &ins = code[last];
+        if (irIsBranch(ins.opcode)) {
+            link(block, block_at[ins.target]);
+        }
+        if (ins.opcode != op_goto && !irIsReturn(ins.opcode) &&
+            last + 1 < code.size()) {
+            link(block, block_at[last + 1]);
+        }
+    }
+    function->removeUnreachable();
+}
+
+int IrBuilder::pop(std::vector<int> &stack) {
+    if (!stack.empty() && stack.back() == Upper) {
+        stack.pop_back();
+    }
+    if (stack.empty()) {
+        return Undefined;
+    }
+    int value = stack.back();
+    stack.pop_back();
+    return value;
+}
+
+void IrBuilder::push(std::vector<int> &stack, int value) {
+    stack.push_back(value);
+    if (irSlots(function->values[value].type) == 2) {
+        stack.push_back(Upper);
+    }
+}
+
+///
+/// Sets the locals from local to value, and drops the long or double it
+/// overwrites half of
+///
+void IrBuilder::store(std::vector<int> &locals, int local, int value) {
+    int slots = irSlots(function->values[value].type);
+    if (locals[local] == Upper) {
+        locals[local - 1] = Undefined;
+    }
+    if (local + slots < locals.size() && locals[local + slots] == Upper) {
+        locals[local + slots] = Undefined;
+    }
+    locals[local] = value;
+    if (slots == 2) {
+        locals[local + 1] = Upper;
+    }
+}
+
+///
+/// Locals and operand stack block starts with: the ones its predecessor
+/// ends with, or a phi for each one its predecessors translated so far
+/// define. The arguments of the phis are set once every block is
+/// translated
+///
+bool IrBuilder::entryState(int block, State &state) {
+    auto &preds = function->blocks[block].preds;
+    if (preds.size() == 1) {
+        state = exits[preds[0]];
+        return true;
+    }
+    std::vector<const State *> known; // of the predecessors translated
+    for (int pred : preds) {
+        if (translated[pred]) {
+            known.push_back(&exits[pred]);
+        }
+    }
+    int bci  = method.code[function->blocks[block].start].bci;
+    auto phi = [&](const std::vector<int> &slots, bool stack, int index) {
+        int value = function->add(block, ir_phi,
+                                  function->values[slots[index]].type,
+                                  std::vector<int>(preds.size(), Undefined),
+                                  bci);
+        phis.push_back(PhiSource{value, block, stack, index});
+        return value;
+    };
+    auto &first = *known[0];
+    for (auto other : known) {
+        if (other->stack.size() != first.stack.size()) {
+            return fail("reaches bci " + std::to_string(bci) +
+                        " with operand stacks of different depths");
+        }
+    }
+    state.stack = first.stack;
+    for (int k = 0; k < first.stack.size(); k++) {
+        if (first.stack[k] >= 0) {
+            state.stack[k] = phi(first.stack, true, k);
+        }
+    }
+    state.locals.assign(first.locals.size(), Undefined);
+    for (int k = 0; k < first.locals.size(); k++) {
+        for (auto other : known) {
+            if (other->locals[k] >= 0) {
+                store(state.locals, k, phi(other->locals, false, k));
+                break;
+            }
+        }
+        if (state.locals[k] >= 0 &&
+            irSlots(function->values[state.locals[k]].type) == 2) {
+            k++;
+        }
+    }
+    return true;
+}
+
+///
+/// Translates the instructions of block, from the locals and operand stack
+/// of state, and keeps the state it ends with
+///
+bool IrBuilder::translate(int block, State &state) {
+    auto &code   = method.code;
+    auto &locals = state.locals;
+    auto &stack  = state.stack;
+    int pc       = function->blocks[block].start;
+    for (;;) {
+        auto &ins  = code[pc];
+        auto value = [&](unsigned short opcode, IrType type,
+                         std::vector<int> args) {
+            return function->add(block, opcode, type, std::move(args),
+                                 ins.bci);
+        };
+        auto constant = [&](IrType type, Slot slot) {
+            push(stack, function->constant(block, type, slot, ins.bci));
+        };
+        auto underflow = [&]() {
+            return fail("underflows its operand stack at bci " +
+                        std::to_string(ins.bci));
+        };
+        Slot slot{};
+        switch (ins.opcode) {
+        case op_nop:
+            break;
+        case op_iconst_m1:
+        case op_iconst_0:
+        case op_iconst_1:
+        case op_iconst_2:
+        case op_iconst_3:
+        case op_iconst_4:
+        case op_iconst_5:
+        case op_bipush:
+        case op_sipush:
+            slot.i = ins.a;
+            constant(IrType::Int, slot);
+            break;
+        case op_lconst_0:
+        case op_lconst_1:
+            slot.j = ins.a;
+            constant(IrType::Long, slot);
+            break;
+        case op_fconst_0:
+        case op_fconst_1:
+        case op_fconst_2:
+            slot.f = ins.a;
+            constant(IrType::Float, slot);
+            break;
+        case op_dconst_0:
+        case op_dconst_1:
+            slot.d = ins.a;
+            constant(IrType::Double, slot);
+            break;
+        case op_ldc:
+            if (ins.ref.constant->value.t == F) {
+                slot.f = ins.ref.constant->value.val.f;
+                constant(IrType::Float, slot);
+            } else {
+                slot.i = ins.ref.constant->value.val.i;
+                constant(IrType::Int, slot);
+            }
+            break;
+        case op_ldc2_w:
+            if (ins.ref.constant->wide_value.t == D) {
+                slot.d = ins.ref.constant->wide_value.val.d;
+                constant(IrType::Double, slot);
+            } else {
+                slot.j = ins.ref.constant->wide_value.val.l;
+                constant(IrType::Long, slot);
+            }
+            break;
+        case op_iload:
+        case op_lload:
+        case op_fload:
+        case op_dload: {
+            static const IrType types[] = {IrType::Int, IrType::Long,
+                                           IrType::Float, IrType::Double};
+            int local = locals[ins.a];
+            if (local < 0 ||
+                function->values[local].type != types[ins.opcode - op_iload]) {
+                return fail("reads local " + std::to_string(ins.a) +
+                            " of an unknown type at bci " +
+                            std::to_string(ins.bci));
+            }
+            push(stack, local);
+        } break;
+        case op_istore:
+        case op_lstore:
+        case op_fstore:
+        case op_dstore: {
+            int stored = pop(stack);
+            if (stored < 0) {
+                return underflow();
+            }
+            store(locals, ins.a,
+                  value(ir_copy, function->values[stored].type, {stored}));
+        } break;
+        case op_iinc: {
+            int local = locals[ins.a];
+            if (local < 0 || function->values[local].type != IrType::Int) {
+                return fail("increments local " + std::to_string(ins.a) +
+                            " of an unknown type at bci " +
+                            std::to_string(ins.bci));
+            }
+            slot.i = ins.b;
+            int increment =
+                function->constant(block, IrType::Int, slot, ins.bci);
+            store(locals, ins.a,
+                  value(op_iadd, IrType::Int, {local, increment}));
+        } break;
+        case op_pop:
+        case op_pop2: {
+            int depth = ins.opcode - op_pop + 1;
+            if (stack.size() < depth) {
+                return underflow();
+            }
+            stack.resize(stack.size() - depth);
+        } break;
+        case op_dup:
+        case op_dup_x1:
+        case op_dup_x2: {
+            int depth = ins.opcode - op_dup + 1;
+            if (stack.size() < depth) {
+                return underflow();
+            }
+            stack.insert(stack.end() - depth, stack.back());
+        } break;
+        case op_dup2:
+        case op_dup2_x1:
+        case op_dup2_x2: {
+            int depth = ins.opcode - op_dup2 + 2;
+            if (stack.size() < depth) {
+                return underflow();
+            }
+            std::vector<int> top(stack.end() - 2, stack.end());
+            stack.insert(stack.end() - depth, top.begin(), top.end());
+        } break;
+        case op_swap:
+            if (stack.size() < 2) {
+                return underflow();
+            }
+            std::swap(stack[stack.size() - 1], stack[stack.size() - 2]);
+            break;
+        case op_getstatic: {
+            IrType type;
+            descriptorType(ins.ref.field->descriptor[0], type);
+            int read = value(op_getstatic, type, {});
+            function->values[read].field = ins.ref.field;
+            push(stack, read);
+        } break;
+        case op_putstatic: {
+            int stored = pop(stack);
+            if (stored < 0) {
+                return underflow();
+            }
+            int write = value(op_putstatic, IrType::Void, {stored});
+            function->values[write].field = ins.ref.field;
+        } break;
+        case op_goto:
+        case op_return:
+            value(ins.opcode, IrType::Void, {});
+            break;
+        default: {
+            // arithmetic, conversions, comparisons, conditional branches
+            // and returns of a value pop all of their operands
+            bool unary = isUnary(ins.opcode) ||
+                         (ins.opcode >= op_ifeq && ins.opcode <= op_ifle) ||
+                         irIsReturn(ins.opcode);
+            std::vector<int> args(unary ? 1 : 2);
+            for (int k = args.size() - 1; k >= 0; k--) {
+                args[k] = pop(stack);
+                if (args[k] < 0) {
+                    return underflow();
+                }
+            }
+            if (irIsBranch(ins.opcode) || irIsReturn(ins.opcode)) {
+                value(ins.opcode, IrType::Void, args);
+            } else {
+                push(stack,
+                     value(ins.opcode, resultType(ins.opcode), args));
+            }
+        }
+        }
+        pc++;
+        if (irIsBranch(ins.opcode) || irIsReturn(ins.opcode)) {
+            break;
+        }
+        if (pc == code.size()) {
+            return fail("runs past the end of its code");
+        }
+        if (block_at[pc] >= 0) {
+            // falls through into the next block
+            value(op_goto, IrType::Void, {});
+            break;
+        }
+    }
+    exits[block] = state;
+    return true;
+}
+
+///
+/// Sets the arguments of the phis from the state each predecessor ends
+/// with. A phi merging a local of different types or not set on every path
+/// is dropped, the method is not translated when something reads it
+///
+bool IrBuilder::resolvePhis() {
+    auto &values = function->values;
+    std::vector<bool> invalid(values.size(), false);
+    for (auto &source : phis) {
+        auto &phi   = values[source.phi];
+        auto &preds = function->blocks[source.block].preds;
+        for (int k = 0; k < preds.size(); k++) {
+            auto &exit  = exits[preds[k]];
+            auto &slots = source.stack ? exit.stack : exit.locals;
+            int arg     = source.index < slots.size() ? slots[source.index]
+                                                      : Undefined;
+            phi.args[k] = arg;
+            if (arg < 0 || values[arg].type != phi.type) {
+                invalid[source.phi] = true;
+            }
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto &source : phis) {
+            for (int arg : values[source.phi].args) {
+                if (!invalid[source.phi] && arg >= 0 && invalid[arg]) {
+                    invalid[source.phi] = true;
+                    changed             = true;
+                }
+            }
+        }
+    }
+    for (auto &value : values) {
+        if (value.opcode == ir_phi) {
+            continue;
+        }
+        for (int arg : value.args) {
+            if (invalid[arg]) {
+                return fail("reads a local or operand of different types "
+                            "at bci " +
+                            std::to_string(value.bci));
+            }
+        }
+    }
+    for (auto &source : phis) {
+        if (invalid[source.phi]) {
+            function->remove(source.phi);
+        }
+    }
+    return true;
+}
+
+///
+/// IrFunction of the method, named name, or nullptr with the reason when
+/// the IR cannot translate it
+///
+std::unique_ptr<IrFunction> IrBuilder::build(const std::string &name) {
+    std::unique_ptr<IrFunction> result(new IrFunction());
+    function               = result.get();
+    function->name         = name;
+    function->arg_slots    = method.arg_slots;
+    function->return_slots = 0;
+    if (!method.handlers.empty()) {
+        fail("has an exception table");
+        return nullptr;
+    }
+    for (auto &ins : method.code) {
+        if (!supported(ins)) {
+            fail(std::string("runs ") + opcodeName(ins.opcode));
+            return nullptr;
+        }
+    }
+    findBlocks();
+    State entry;
+    entry.locals.assign(std::max<int>(method.max_locals, method.arg_slots),
+                        Undefined);
+    if (!addParameters(entry)) {
+        return nullptr;
+    }
+    function->add(0, op_goto, IrType::Void, {}, 0);
+    exits.assign(function->blocks.size(), State());
+    translated.assign(function->blocks.size(), false);
+    exits[0]      = entry;
+    translated[0] = true;
+    for (int block : function->order()) {
+        State state;
+        if (block != 0 &&
+            (!entryState(block, state) || !translate(block, state))) {
+            return nullptr;
+        }
+        translated[block] = true;
+    }
+    if (!resolvePhis()) {
+        return nullptr;
+    }
+    return result;
+}
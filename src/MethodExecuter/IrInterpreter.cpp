@@ -0,0 +1,84 @@
+#include <MethodExecuter/IrInterpreter.hpp>
+#include <algorithm>
+
+IrInterpreter::IrInterpreter(
+    std::function<Slot *(const FieldRef &)> static_field)
+    : static_field(static_field) {}
+
+Slot *IrInterpreter::field(IrValue &value) {
+    if (value.static_slot == nullptr) {
+        value.static_slot = static_field(*value.field);
+    }
+    return value.static_slot;
+}
+
+///
+/// Runs function with its parameters in the locals at lva and returns the
+/// value it returns. Throws the JavaException of an integer division by
+/// zero
+///
+Slot IrInterpreter::run(IrFunction &function, const Slot *lva) {
+    auto &values = function.values;
+    std::vector<Slot> registers(values.size());
+    std::vector<Slot> incoming;
+    int block = 0;
+    int pred  = -1;
+    for (;;) {
+        auto &current = function.blocks[block];
+        auto &code    = current.code;
+        int index     = 0;
+        if (pred >= 0) {
+            auto &preds = current.preds;
+            int k = std::find(preds.begin(), preds.end(), pred) - preds.begin();
+            incoming.clear();
+            for (; values[code[index]].opcode == ir_phi; index++) {
+                incoming.push_back(registers[values[code[index]].args[k]]);
+            }
+            for (int phi = 0; phi < index; phi++) {
+                registers[code[phi]] = incoming[phi];
+            }
+        }
+        for (; index + 1 < code.size(); index++) {
+            auto &value = values[code[index]];
+            auto &result = registers[code[index]];
+            switch (value.opcode) {
+            case ir_const:
+                result = value.constant;
+                break;
+            case ir_param:
+                result = lva[value.local];
+                break;
+            case ir_copy:
+                result = registers[value.args[0]];
+                break;
+            case op_getstatic:
+                result = *field(value);
+                break;
+            case op_putstatic:
+                *field(value) = registers[value.args[0]];
+                break;
+            default: {
+                Slot args[2];
+                for (int k = 0; k < value.args.size(); k++) {
+                    args[k] = registers[value.args[k]];
+                }
+                result = irEvaluate(value.opcode, args);
+            }
+            }
+        }
+        auto &last = values[code[index]];
+        if (irIsReturn(last.opcode)) {
+            return last.args.empty() ? Slot{} : registers[last.args[0]];
+        }
+        pred = block;
+        if (last.opcode == op_goto) {
+            block = current.succs[0];
+        } else {
+            Slot args[2];
+            for (int k = 0; k < last.args.size(); k++) {
+                args[k] = registers[last.args[k]];
+            }
+            block = current.succs[irTaken(last.opcode, args) ? 0 : 1];
+        }
+    }
+}
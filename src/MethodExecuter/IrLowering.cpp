@@ -0,0 +1,567 @@
+#include <MethodExecuter/IrLowering.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <math.h>
+#include <numeric>
+
+///
+/// Whether increment fits the constant of an iinc
+///
+static bool fitsIinc(int64_t increment) {
+    return increment >= -32768 && increment <= 32767;
+}
+
+IrLowering::IrLowering(IrFunction &function, DecodedMethod &method)
+    : function(function), method(method) {
+    depth     = 0;
+    max_depth = 0;
+}
+
+///
+/// Puts a block that only has a goto on each edge from a block with
+/// several successors to a block with phis, so the copies setting the phis
+/// have a block of their own
+///
+void IrLowering::splitCriticalEdges() {
+    auto &blocks = function.blocks;
+    int count    = blocks.size();
+    for (int from = 0; from < count; from++) {
+        if (blocks[from].succs.size() < 2) {
+            continue;
+        }
+        for (int k = 0; k < blocks[from].succs.size(); k++) {
+            int to = blocks[from].succs[k];
+            if (blocks[to].code.empty() ||
+                function.values[blocks[to].code[0]].opcode != ir_phi) {
+                continue;
+            }
+            int bci  = function.values[blocks[from].code.back()].bci;
+            int edge = function.newBlock(blocks[to].start);
+            function.add(edge, op_goto, IrType::Void, {}, bci);
+            blocks[edge].preds    = {from};
+            blocks[edge].succs    = {to};
+            blocks[from].succs[k] = edge;
+            auto &preds = blocks[to].preds;
+            *std::find(preds.begin(), preds.end(), from) = edge;
+        }
+    }
+}
+
+///
+/// Picks the values computed where they are used: the constants, and the
+/// values used once by a value of their own block that can be moved there
+///
+void IrLowering::selectInlined() {
+    auto &values = function.values;
+    uses         = function.useCounts();
+    inlined.assign(values.size(), false);
+    std::vector<int> user(values.size(), -1);
+    for (int index = 0; index < values.size(); index++) {
+        if (values[index].block >= 0) {
+            for (int arg : values[index].args) {
+                user[arg] = index;
+            }
+        }
+    }
+    for (int index = 0; index < values.size(); index++) {
+        auto &value = values[index];
+        if (value.block < 0) {
+            continue;
+        }
+        if (value.opcode == ir_const) {
+            inlined[index] = true;
+        } else if (uses[index] == 1 && irIsPure(function, value)) {
+            auto &use      = values[user[index]];
+            inlined[index] = use.block == value.block && use.opcode != ir_phi;
+        }
+    }
+}
+
+///
+/// Whether value is kept in a local
+///
+bool IrLowering::stored(int value) const {
+    return function.values[value].type != IrType::Void && !inlined[value] &&
+           uses[value] > 0;
+}
+
+///
+/// Adds to leaves the values kept in locals value reads, through the
+/// values computed where value is
+///
+void IrLowering::operands(int value, std::vector<int> &leaves) const {
+    for (int arg : function.values[value].args) {
+        if (inlined[arg]) {
+            operands(arg, leaves);
+        } else {
+            leaves.push_back(arg);
+        }
+    }
+}
+
+///
+/// Values kept in locals that are live at the end of each block, the
+/// arguments of the phis of its successors included
+///
+std::vector<std::set<int>>
+IrLowering::liveOut(const std::vector<int> &order) const {
+    auto &blocks = function.blocks;
+    auto &values = function.values;
+    std::vector<std::set<int>> in(blocks.size()), out(blocks.size());
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto block = order.rbegin(); block != order.rend(); ++block) {
+            std::set<int> live;
+            for (int succ : blocks[*block].succs) {
+                auto &preds = blocks[succ].preds;
+                int k = std::find(preds.begin(), preds.end(), *block) -
+                        preds.begin();
+                live.insert(in[succ].begin(), in[succ].end());
+                for (int phi : blocks[succ].code) {
+                    if (values[phi].opcode != ir_phi) {
+                        break;
+                    }
+                    int arg = values[phi].args[k];
+                    if (stored(phi) && !inlined[arg]) {
+                        live.insert(arg);
+                    }
+                }
+            }
+            out[*block] = live;
+            auto &code  = blocks[*block].code;
+            for (auto index = code.rbegin(); index != code.rend(); ++index) {
+                if (inlined[*index]) {
+                    continue;
+                }
+                live.erase(*index);
+                if (values[*index].opcode != ir_phi) {
+                    std::vector<int> leaves;
+                    operands(*index, leaves);
+                    live.insert(leaves.begin(), leaves.end());
+                }
+            }
+            if (live != in[*block]) {
+                in[*block] = live;
+                changed    = true;
+            }
+        }
+    }
+    return out;
+}
+
+void IrLowering::interfere(int value, const std::set<int> &live) {
+    for (int other : live) {
+        if (other != value) {
+            interference[value].insert(other);
+            interference[other].insert(value);
+        }
+    }
+}
+
+///
+/// Links each value kept in a local to the ones live where it is set: the
+/// values live after the instruction setting it, and for a phi the values
+/// live when its block starts, the other phis of the block included
+///
+void IrLowering::buildInterference(const std::vector<int> &order) {
+    auto out = liveOut(order);
+    interference.assign(function.values.size(), std::set<int>());
+    for (int block : order) {
+        auto &live = out[block];
+        auto &code = function.blocks[block].code;
+        std::vector<int> phis;
+        for (auto index = code.rbegin(); index != code.rend(); ++index) {
+            if (inlined[*index]) {
+                continue;
+            }
+            if (function.values[*index].opcode == ir_phi) {
+                if (stored(*index)) {
+                    phis.push_back(*index);
+                }
+                continue;
+            }
+            // a value set but never used is popped, it has no local
+            if (stored(*index)) {
+                interfere(*index, live);
+                live.erase(*index);
+            }
+            std::vector<int> leaves;
+            operands(*index, leaves);
+            live.insert(leaves.begin(), leaves.end());
+        }
+        live.insert(phis.begin(), phis.end());
+        for (int phi : phis) {
+            interfere(phi, live);
+        }
+    }
+}
+
+///
+/// Assigns a local to each value kept in one: the parameters keep theirs,
+/// values that a phi, or an iinc, would copy into another share its local
+/// when they do not interfere, and the others take the lowest locals no
+/// value they interfere with has
+///
+void IrLowering::assignLocals() {
+    auto &values = function.values;
+    std::vector<int> group(values.size());
+    std::iota(group.begin(), group.end(), 0);
+    std::vector<std::vector<int>> members(values.size());
+    std::vector<int> fixed(values.size(), -1);
+    auto find = [&group](int value) {
+        while (group[value] != value) {
+            value = group[value] = group[group[value]];
+        }
+        return value;
+    };
+    for (int index = 0; index < values.size(); index++) {
+        members[index] = {index};
+        if (values[index].opcode == ir_param) {
+            fixed[index] = values[index].local;
+        }
+    }
+    auto merge = [&](int a, int b) {
+        a = find(a);
+        b = find(b);
+        if (a == b || (fixed[a] >= 0 && fixed[b] >= 0)) {
+            return;
+        }
+        for (int member : members[a]) {
+            for (int other : members[b]) {
+                if (interference[member].count(other)) {
+                    return;
+                }
+            }
+        }
+        members[a].insert(members[a].end(), members[b].begin(),
+                          members[b].end());
+        group[b] = a;
+        fixed[a] = std::max(fixed[a], fixed[b]);
+    };
+    auto constant = [&](int value, int sign) {
+        auto &c = values[value];
+        return c.opcode == ir_const &&
+               fitsIinc(sign * static_cast<int64_t>(c.constant.i));
+    };
+    for (int index = 0; index < values.size(); index++) {
+        auto &value = values[index];
+        if (value.block < 0 || !stored(index)) {
+            continue;
+        }
+        if (value.opcode == ir_phi) {
+            for (int arg : value.args) {
+                if (stored(arg)) {
+                    merge(index, arg);
+                }
+            }
+        } else if ((value.opcode == op_iadd || value.opcode == op_isub) &&
+                   value.type == IrType::Int) {
+            int sign = value.opcode == op_iadd ? 1 : -1;
+            if (constant(value.args[1], sign) && stored(value.args[0])) {
+                merge(value.args[0], index);
+            } else if (sign > 0 && constant(value.args[0], 1) &&
+                       stored(value.args[1])) {
+                merge(value.args[1], index);
+            }
+        }
+    }
+    local.assign(values.size(), -1);
+    std::vector<int> roots;
+    for (int index = 0; index < values.size(); index++) {
+        if (values[index].block >= 0 && stored(index) &&
+            find(index) == index) {
+            roots.push_back(index);
+        }
+    }
+    std::stable_partition(roots.begin(), roots.end(),
+                          [&fixed](int root) { return fixed[root] >= 0; });
+    for (int root : roots) {
+        int slots = irSlots(values[root].type);
+        int first = fixed[root];
+        for (bool free = first >= 0; !free;) {
+            first++;
+            free = true;
+            for (int member : members[root]) {
+                for (int other : interference[member]) {
+                    int end = local[other] + irSlots(values[other].type);
+                    if (local[other] >= 0 && local[other] < first + slots &&
+                        end > first) {
+                        free = false;
+                    }
+                }
+            }
+        }
+        for (int member : members[root]) {
+            local[member] = first;
+        }
+    }
+}
+
+///
+/// Appends an instruction that pops popped slots and pushes pushed ones
+///
+Instruction &IrLowering::emit(unsigned short opcode, int bci, int pushed,
+                              int popped) {
+    Instruction ins;
+    ins.opcode  = opcode;
+    ins.bci     = bci;
+    ins.a       = 0;
+    ins.b       = 0;
+    ins.target  = -1;
+    ins.ref.ptr = nullptr;
+    ins.handler = nullptr;
+    ins.profile = -1;
+    ins.fused   = 0;
+    ins.cache   = 0;
+    ins.variant = 0;
+    code.push_back(ins);
+    depth += pushed - popped;
+    max_depth = std::max(max_depth, depth);
+    return code.back();
+}
+
+///
+/// Pushes the constant value with the shortest instruction that has it
+///
+void IrLowering::emitConstant(const IrValue &value) {
+    auto &c = value.constant;
+    int bci = value.bci;
+    switch (value.type) {
+    case IrType::Int:
+        if (c.i >= -1 && c.i <= 5) {
+            emit(op_iconst_0 + c.i, bci, 1, 0).a = c.i;
+        } else if (c.i >= -128 && c.i <= 127) {
+            emit(op_bipush, bci, 1, 0).a = c.i;
+        } else if (c.i >= -32768 && c.i <= 32767) {
+            emit(op_sipush, bci, 1, 0).a = c.i;
+        } else {
+            emit(op_ldc_quick, bci, 1, 0).ref.value = c;
+        }
+        break;
+    case IrType::Float:
+        if ((c.f == 0 && !signbit(c.f)) || c.f == 1 || c.f == 2) {
+            int k = static_cast<int>(c.f);
+            emit(op_fconst_0 + k, bci, 1, 0).a = k;
+        } else {
+            emit(op_ldc_quick, bci, 1, 0).ref.value = c;
+        }
+        break;
+    case IrType::Long:
+        if (c.j == 0 || c.j == 1) {
+            emit(op_lconst_0 + c.j, bci, 2, 0).a = c.j;
+        } else {
+            emit(op_ldc2_w_quick, bci, 2, 0).ref.value = c;
+        }
+        break;
+    default:
+        if ((c.d == 0 && !signbit(c.d)) || c.d == 1) {
+            int k = static_cast<int>(c.d);
+            emit(op_dconst_0 + k, bci, 2, 0).a = k;
+        } else {
+            emit(op_ldc2_w_quick, bci, 2, 0).ref.value = c;
+        }
+    }
+}
+
+void IrLowering::emitLoad(int value) {
+    static const unsigned short loads[] = {op_nop, op_iload, op_lload,
+                                           op_fload, op_dload};
+    auto type = function.values[value].type;
+    emit(loads[static_cast<int>(type)], function.values[value].bci,
+         irSlots(type), 0)
+        .a = local[value];
+}
+
+///
+/// Pushes the value computed by value: its operands, each one loaded from
+/// its local or computed there, then its own instruction
+///
+void IrLowering::emitValue(int value) {
+    auto &ir = function.values[value];
+    if (ir.opcode == ir_const) {
+        emitConstant(ir);
+        return;
+    }
+    int popped = 0;
+    for (int arg : ir.args) {
+        if (inlined[arg]) {
+            emitValue(arg);
+        } else {
+            emitLoad(arg);
+        }
+        popped += irSlots(function.values[arg].type);
+    }
+    if (ir.opcode == ir_copy) {
+        return;
+    }
+    auto &ins = emit(ir.opcode, ir.bci, irSlots(ir.type), popped);
+    if (ir.opcode == op_getstatic || ir.opcode == op_putstatic) {
+        ins.ref.field = ir.field;
+    }
+}
+
+///
+/// Emits value, which is neither a phi nor a terminator nor computed where
+/// it is used, and stores it in its local
+///
+void IrLowering::emitStatement(int value) {
+    static const unsigned short stores[] = {op_nop, op_istore, op_lstore,
+                                            op_fstore, op_dstore};
+    auto &ir = function.values[value];
+    if (ir.opcode == ir_param) {
+        return;
+    }
+    if ((ir.opcode == op_iadd || ir.opcode == op_isub) && stored(value)) {
+        // an iadd of a constant to a value with the same local
+        int sign = ir.opcode == op_iadd ? 1 : -1;
+        for (int k = 0; k < (sign > 0 ? 2 : 1); k++) {
+            auto &c   = function.values[ir.args[1 - k]];
+            int arg   = ir.args[k];
+            int64_t increment = sign * static_cast<int64_t>(c.constant.i);
+            if (c.opcode == ir_const && !inlined[arg] &&
+                local[arg] == local[value] && fitsIinc(increment)) {
+                auto &ins = emit(op_iinc, ir.bci, 0, 0);
+                ins.a     = local[value];
+                ins.b     = increment;
+                return;
+            }
+        }
+    }
+    emitValue(value);
+    int slots = irSlots(ir.type);
+    if (stored(value)) {
+        emit(stores[static_cast<int>(ir.type)], ir.bci, 0, slots).a =
+            local[value];
+    } else if (slots > 0) {
+        emit(slots == 2 ? op_pop2 : op_pop, ir.bci, 0, slots);
+    }
+}
+
+///
+/// Sets the phis of block to from the arguments of the edge from block
+/// from: every argument is pushed, then the phis are stored in reverse, as
+/// a phi may be an argument of another one
+///
+void IrLowering::emitCopies(int from, int to) {
+    static const unsigned short stores[] = {op_nop, op_istore, op_lstore,
+                                            op_fstore, op_dstore};
+    auto &preds = function.blocks[to].preds;
+    int k       = std::find(preds.begin(), preds.end(), from) - preds.begin();
+    std::vector<int> copied;
+    for (int phi : function.blocks[to].code) {
+        auto &ir = function.values[phi];
+        if (ir.opcode != ir_phi) {
+            break;
+        }
+        int arg = ir.args[k];
+        if (!stored(phi) || (!inlined[arg] && local[arg] == local[phi])) {
+            continue;
+        }
+        if (inlined[arg]) {
+            emitValue(arg);
+        } else {
+            emitLoad(arg);
+        }
+        copied.push_back(phi);
+    }
+    for (auto phi = copied.rbegin(); phi != copied.rend(); ++phi) {
+        auto &ir = function.values[*phi];
+        emit(stores[static_cast<int>(ir.type)], ir.bci, 0, irSlots(ir.type))
+            .a = local[*phi];
+    }
+}
+
+///
+/// Emits the branch or return block ends with, next being the block laid
+/// out after it. A conditional branch to next is inverted so it falls
+/// through there
+///
+void IrLowering::emitTerminator(int block, int next) {
+    auto &blocks = function.blocks;
+    int last     = blocks[block].code.back();
+    auto &ir     = function.values[last];
+    auto jump    = [&](unsigned short opcode, int target, int popped) {
+        emit(opcode, ir.bci, 0, popped);
+        jumps.push_back(std::make_pair(code.size() - 1, target));
+    };
+    if (ir.opcode == op_goto) {
+        if (blocks[block].succs[0] != next) {
+            jump(op_goto, blocks[block].succs[0], 0);
+        }
+        return;
+    }
+    int popped = 0;
+    for (int arg : ir.args) {
+        if (inlined[arg]) {
+            emitValue(arg);
+        } else {
+            emitLoad(arg);
+        }
+        popped += irSlots(function.values[arg].type);
+    }
+    if (irIsReturn(ir.opcode)) {
+        emit(ir.opcode, ir.bci, 0, popped);
+        return;
+    }
+    unsigned short opcode = ir.opcode;
+    int taken             = blocks[block].succs[0];
+    int other             = blocks[block].succs[1];
+    if (taken == next && other != next) {
+        // ifeq and ifne, iflt and ifge... are pairs in this order
+        int first = opcode >= op_if_icmpeq ? op_if_icmpeq : op_ifeq;
+        opcode    = first + ((opcode - first) ^ 1);
+        std::swap(taken, other);
+    }
+    jump(opcode, taken, popped);
+    if (other != next) {
+        jump(op_goto, other, 0);
+    }
+}
+
+///
+/// Replaces the code of the method with the lowered function. Returns false
+/// with the reason when its frame would be too large
+///
+bool IrLowering::lower() {
+    splitCriticalEdges();
+    auto order = function.order();
+    selectInlined();
+    buildInterference(order);
+    assignLocals();
+    block_start.assign(function.blocks.size(), -1);
+    for (int k = 0; k < order.size(); k++) {
+        int block  = order[k];
+        auto &body = function.blocks[block].code;
+        block_start[block] = code.size();
+        for (int index = 0; index + 1 < body.size(); index++) {
+            int value = body[index];
+            if (function.values[value].opcode != ir_phi && !inlined[value]) {
+                emitStatement(value);
+            }
+        }
+        if (function.blocks[block].succs.size() == 1) {
+            emitCopies(block, function.blocks[block].succs[0]);
+        }
+        emitTerminator(block, k + 1 < order.size() ? order[k + 1] : -1);
+    }
+    for (auto &jump : jumps) {
+        code[jump.first].target = block_start[jump.second];
+    }
+    int locals = method.arg_slots;
+    for (int index = 0; index < local.size(); index++) {
+        if (local[index] >= 0) {
+            locals = std::max(locals, local[index] +
+                                          irSlots(function.values[index].type));
+        }
+    }
+    if (locals > 0xffff || max_depth > 0xffff) {
+        failure = "needs a frame too large";
+        return false;
+    }
+    method.code       = std::move(code);
+    method.max_locals = locals;
+    method.max_stack  = max_depth;
+    method.threaded   = false;
+    method.interpreter_index.assign(method.code.size(), -1);
+    return true;
+}
@@ -0,0 +1,691 @@
+#include <JVM/VMOptions.hpp>
+
+#ifdef HAS_JIT
+
+#include <JVM/structures/ContextEntry.hpp>
+#include <MethodExecuter/JitCompiler.hpp>
+#include <MethodExecuter/X86Assembler.hpp>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <sys/mman.h>
+
+// registers holding the frame in compiled code
+static const Reg lva_reg = rbx;
+static const Reg sp_reg  = r12;
+
+///
+/// Fields of objects and elements of arrays start right after their
+/// ContextEntry
+///
+static const int entry_size = sizeof(ContextEntry);
+
+static int lengthOffset() {
+    static ContextEntry probe(std::string(), I, 0);
+    return reinterpret_cast<char *>(&probe.length) -
+           reinterpret_cast<char *>(&probe);
+}
+
+static int runtimeClassOffset() {
+    static ContextEntry probe(std::string(), I, 0);
+    return reinterpret_cast<char *>(&probe.runtime_class) -
+           reinterpret_cast<char *>(&probe);
+}
+
+///
+/// Displacement of the slot k of the operand stack, relative to sp
+///
+static int slot(int k) { return 8 * k; }
+
+static void load(X86Assembler &as, Reg reg, Reg base, int disp,
+                 bool wide = true) {
+    as.mem({0x8b}, reg, base, disp, wide);
+}
+
+static void store(X86Assembler &as, Reg base, int disp, Reg reg,
+                  bool wide = true) {
+    as.mem({0x89}, reg, base, disp, wide);
+}
+
+static void moveSp(X86Assembler &as, int slots) {
+    if (slots != 0) {
+        as.addImm(sp_reg, 8 * slots, true);
+    }
+}
+
+static void test(X86Assembler &as, Reg reg, bool wide = true) {
+    as.regs({0x85}, reg, reg, wide);
+}
+
+///
+/// eax = 1, 0 or -1 from the flags of ucomiss/ucomisd, nan when unordered
+///
+static void compareResult(X86Assembler &as, int nan) {
+    as.regs({0x0f, 0x90 | above}, 0, rax, false);
+    as.regs({0x0f, 0x90 | below}, 0, rcx, false);
+    as.regs({0x0f, 0x90 | parity}, 0, rdx, false);
+    as.regs({0x0f, 0xb6}, rax, rax, false);
+    as.regs({0x0f, 0xb6}, rcx, rcx, false);
+    as.regs({0x2b}, rax, rcx, false);
+    as.regs({0x84}, rdx, rdx, false);
+    as.movImm(rcx, static_cast<uint32_t>(nan));
+    as.regs({0x0f, 0x40 | not_equal}, rax, rcx, false);
+}
+
+///
+/// Moves the top pops slots of the operand stack to the slots listed in
+/// order, by their depth among the popped ones (0 is the deepest), for the
+/// dup and swap instructions
+///
+static void shuffle(X86Assembler &as, int pops, std::vector<int> order) {
+    static const Reg temps[] = {rax, rcx, rdx, rsi};
+    for (int k = 0; k < pops; k++) {
+        load(as, temps[k], sp_reg, slot(k - pops));
+    }
+    for (int k = 0; k < order.size(); k++) {
+        if (k >= pops || order[k] != k) {
+            store(as, sp_reg, slot(k - pops), temps[order[k]]);
+        }
+    }
+    moveSp(as, order.size() - pops);
+}
+
+JitCompiler::~JitCompiler() {
+    for (auto &region : regions) {
+        munmap(region.first, region.second);
+    }
+}
+
+void JitCompiler::branch(X86Assembler &as, int cond, int target) {
+    branches.push_back(std::make_pair(as.jump(cond), target));
+}
+
+void JitCompiler::exitIf(X86Assembler &as, int cond, int pc) {
+    exits.push_back(std::make_pair(as.jump(cond), pc));
+}
+
+///
+/// Returns to the interpreter, which runs the instruction at pc next
+///
+void JitCompiler::leave(X86Assembler &as, int pc, int epilogue) {
+    as.movImm(rdx, pc);
+    as.bind(as.jump(-1), epilogue);
+}
+
+///
+/// Emits the template of ins, the instruction at pc. Returns false, having
+/// emitted nothing, when ins is left to the interpreter
+///
+bool JitCompiler::emit(X86Assembler &as, const Instruction &ins, int pc) {
+    int elements = entry_size;
+    int length   = lengthOffset();
+    switch (ins.opcode) {
+    case op_nop:
+        break;
+    case op_aconst_null:
+        as.movImm(rax, 0);
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, 1);
+        break;
+    case op_iconst_m1:
+    case op_iconst_0:
+    case op_iconst_1:
+    case op_iconst_2:
+    case op_iconst_3:
+    case op_iconst_4:
+    case op_iconst_5:
+    case op_bipush:
+    case op_sipush:
+        as.movImm(rax, static_cast<uint32_t>(ins.a));
+        store(as, sp_reg, slot(0), rax, false);
+        moveSp(as, 1);
+        break;
+    case op_fconst_0:
+    case op_fconst_1:
+    case op_fconst_2: {
+        Slot value{};
+        value.f = ins.a;
+        as.movImm(rax, value.j);
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, 1);
+    } break;
+    case op_lconst_0:
+    case op_lconst_1:
+    case op_dconst_0:
+    case op_dconst_1: {
+        Slot value;
+        if (ins.opcode <= op_lconst_1) {
+            value.j = ins.a;
+        } else {
+            value.d = ins.a;
+        }
+        as.movImm(rax, value.j);
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, 2);
+    } break;
+    case op_ldc_quick:
+    case op_ldc2_w_quick:
+        as.movImm(rax, ins.ref.value.j);
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, ins.opcode == op_ldc_quick ? 1 : 2);
+        break;
+    // a value of category 2 is read from its lower slot, only that one is
+    // copied
+    case op_iload:
+    case op_fload:
+    case op_aload:
+    case op_lload:
+    case op_dload:
+        load(as, rax, lva_reg, slot(ins.a));
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, ins.opcode == op_lload || ins.opcode == op_dload ? 2 : 1);
+        break;
+    case op_istore:
+    case op_fstore:
+    case op_astore:
+    case op_lstore:
+    case op_dstore: {
+        int slots = ins.opcode == op_lstore || ins.opcode == op_dstore ? 2 : 1;
+        load(as, rax, sp_reg, slot(-slots));
+        store(as, lva_reg, slot(ins.a), rax);
+        moveSp(as, -slots);
+    } break;
+    case op_iinc:
+        as.mem({0x81}, 0, lva_reg, slot(ins.a), false);
+        as.dword(ins.b);
+        break;
+    case op_iadd:
+    case op_isub:
+    case op_iand:
+    case op_ior:
+    case op_ixor:
+    case op_imul:
+    case op_ladd:
+    case op_lsub:
+    case op_land:
+    case op_lor:
+    case op_lxor:
+    case op_lmul: {
+        bool wide = ins.opcode == op_ladd || ins.opcode == op_lsub ||
+                    ins.opcode == op_land || ins.opcode == op_lor ||
+                    ins.opcode == op_lxor || ins.opcode == op_lmul;
+        int n = wide ? 2 : 1;
+        load(as, rax, sp_reg, slot(-2 * n), wide);
+        switch (ins.opcode) {
+        case op_iadd:
+        case op_ladd:
+            as.mem({0x03}, rax, sp_reg, slot(-n), wide);
+            break;
+        case op_isub:
+        case op_lsub:
+            as.mem({0x2b}, rax, sp_reg, slot(-n), wide);
+            break;
+        case op_iand:
+        case op_land:
+            as.mem({0x23}, rax, sp_reg, slot(-n), wide);
+            break;
+        case op_ior:
+        case op_lor:
+            as.mem({0x0b}, rax, sp_reg, slot(-n), wide);
+            break;
+        case op_ixor:
+        case op_lxor:
+            as.mem({0x33}, rax, sp_reg, slot(-n), wide);
+            break;
+        default:
+            as.mem({0x0f, 0xaf}, rax, sp_reg, slot(-n), wide);
+            break;
+        }
+        store(as, sp_reg, slot(-2 * n), rax, wide);
+        moveSp(as, -n);
+    } break;
+    // the divisor 0 throws and -1 overflows idiv for the smallest value,
+    // both are left to the interpreter
+    case op_idiv:
+    case op_irem:
+    case op_ldiv:
+    case op_lrem: {
+        bool wide = ins.opcode == op_ldiv || ins.opcode == op_lrem;
+        int n     = wide ? 2 : 1;
+        load(as, rcx, sp_reg, slot(-n), wide);
+        as.regs({0x8b}, rax, rcx, wide);
+        as.addImm(rax, 1, wide);
+        as.regs({0x83}, 7, rax, wide);
+        as.byte(1);
+        exitIf(as, below_equal, pc);
+        load(as, rax, sp_reg, slot(-2 * n), wide);
+        if (wide) {
+            as.byte(0x48);
+        }
+        as.byte(0x99); // cdq or cqo
+        as.regs({0xf7}, 7, rcx, wide);
+        bool div = ins.opcode == op_idiv || ins.opcode == op_ldiv;
+        store(as, sp_reg, slot(-2 * n), div ? rax : rdx, wide);
+        moveSp(as, -n);
+    } break;
+    // x86 masks the shift count like Java does
+    case op_ishl:
+    case op_ishr:
+    case op_iushr:
+    case op_lshl:
+    case op_lshr:
+    case op_lushr: {
+        bool wide = ins.opcode >= op_lshl && ins.opcode <= op_lushr &&
+                    (ins.opcode - op_ishl) % 2 == 1;
+        int kind = (ins.opcode - op_ishl) / 2; // shl, sar, shr
+        load(as, rcx, sp_reg, slot(-1), false);
+        as.mem({0xd3}, kind == 0 ? 4 : kind == 1 ? 7 : 5, sp_reg,
+               slot(wide ? -3 : -2), wide);
+        moveSp(as, -1);
+    } break;
+    case op_ineg:
+        as.mem({0xf7}, 3, sp_reg, slot(-1), false);
+        break;
+    case op_lneg:
+        as.mem({0xf7}, 3, sp_reg, slot(-2), true);
+        break;
+    case op_fneg:
+        as.mem({0x81}, 6, sp_reg, slot(-1), false);
+        as.dword(std::numeric_limits<int32_t>::min());
+        break;
+    case op_dneg:
+        as.movImm(rax, std::numeric_limits<int64_t>::min());
+        as.mem({0x31}, rax, sp_reg, slot(-2), true);
+        break;
+    case op_fadd:
+    case op_fsub:
+    case op_fmul:
+    case op_fdiv:
+    case op_dadd:
+    case op_dsub:
+    case op_dmul:
+    case op_ddiv: {
+        bool wide  = ins.opcode >= op_dadd && (ins.opcode - op_iadd) % 4 == 3;
+        int n      = wide ? 2 : 1;
+        int prefix = wide ? 0xf2 : 0xf3;
+        int kind   = (ins.opcode - op_iadd) / 4; // add, sub, mul, div
+        static const int operations[] = {0x58, 0x5c, 0x59, 0x5e};
+        as.mem({0x0f, 0x10}, 0, sp_reg, slot(-2 * n), false, prefix);
+        as.mem({0x0f, operations[kind]}, 0, sp_reg, slot(-n), false, prefix);
+        as.mem({0x0f, 0x11}, 0, sp_reg, slot(-2 * n), false, prefix);
+        moveSp(as, -n);
+    } break;
+    case op_i2l:
+        as.mem({0x63}, rax, sp_reg, slot(-1), true);
+        store(as, sp_reg, slot(-1), rax);
+        moveSp(as, 1);
+        break;
+    case op_l2i:
+        moveSp(as, -1);
+        break;
+    case op_i2f:
+    case op_i2d:
+    case op_l2f:
+    case op_l2d:
+    case op_f2d:
+    case op_d2f: {
+        bool from_wide = ins.opcode == op_l2f || ins.opcode == op_l2d ||
+                         ins.opcode == op_d2f;
+        bool to_wide = ins.opcode == op_i2d || ins.opcode == op_l2d ||
+                       ins.opcode == op_f2d;
+        int from   = from_wide ? 2 : 1;
+        int prefix = to_wide ? 0xf2 : 0xf3;
+        if (ins.opcode == op_f2d || ins.opcode == op_d2f) {
+            as.mem({0x0f, 0x5a}, 0, sp_reg, slot(-from), false,
+                   to_wide ? 0xf3 : 0xf2);
+        } else {
+            as.mem({0x0f, 0x2a}, 0, sp_reg, slot(-from), from_wide, prefix);
+        }
+        as.mem({0x0f, 0x11}, 0, sp_reg, slot(-from), false, prefix);
+        moveSp(as, (to_wide ? 2 : 1) - from);
+    } break;
+    // cvttss2si and cvttsd2si give the smallest integer for NaN and values
+    // out of range, which Java saturates, so the interpreter takes those
+    case op_f2i:
+    case op_f2l:
+    case op_d2i:
+    case op_d2l: {
+        bool from_wide = ins.opcode == op_d2i || ins.opcode == op_d2l;
+        bool to_wide   = ins.opcode == op_f2l || ins.opcode == op_d2l;
+        int from       = from_wide ? 2 : 1;
+        as.mem({0x0f, 0x2c}, rax, sp_reg, slot(-from), to_wide,
+               from_wide ? 0xf2 : 0xf3);
+        if (to_wide) {
+            as.movImm(rcx, std::numeric_limits<int64_t>::min());
+        } else {
+            as.movImm(rcx, static_cast<uint32_t>(
+                               std::numeric_limits<int32_t>::min()));
+        }
+        as.regs({0x3b}, rax, rcx, to_wide);
+        exitIf(as, equal, pc);
+        store(as, sp_reg, slot(-from), rax, to_wide);
+        moveSp(as, (to_wide ? 2 : 1) - from);
+    } break;
+    case op_i2b:
+    case op_i2c:
+    case op_i2s:
+        as.mem({0x0f, ins.opcode == op_i2b   ? 0xbe
+                      : ins.opcode == op_i2c ? 0xb7
+                                             : 0xbf},
+               rax, sp_reg, slot(-1), false);
+        store(as, sp_reg, slot(-1), rax, false);
+        break;
+    case op_lcmp:
+        load(as, rax, sp_reg, slot(-4));
+        as.mem({0x3b}, rax, sp_reg, slot(-2), true);
+        as.regs({0x0f, 0x90 | greater}, 0, rax, false);
+        as.regs({0x0f, 0x90 | less}, 0, rcx, false);
+        as.regs({0x0f, 0xb6}, rax, rax, false);
+        as.regs({0x0f, 0xb6}, rcx, rcx, false);
+        as.regs({0x2b}, rax, rcx, false);
+        store(as, sp_reg, slot(-4), rax, false);
+        moveSp(as, -3);
+        break;
+    case op_fcmpl:
+    case op_fcmpg:
+        as.mem({0x0f, 0x10}, 0, sp_reg, slot(-2), false, 0xf3);
+        as.mem({0x0f, 0x2e}, 0, sp_reg, slot(-1), false);
+        compareResult(as, ins.opcode == op_fcmpl ? -1 : 1);
+        store(as, sp_reg, slot(-2), rax, false);
+        moveSp(as, -1);
+        break;
+    case op_dcmpl:
+    case op_dcmpg:
+        as.mem({0x0f, 0x10}, 0, sp_reg, slot(-4), false, 0xf2);
+        as.mem({0x0f, 0x2e}, 0, sp_reg, slot(-2), false, 0x66);
+        compareResult(as, ins.opcode == op_dcmpl ? -1 : 1);
+        store(as, sp_reg, slot(-4), rax, false);
+        moveSp(as, -3);
+        break;
+    case op_ifeq:
+    case op_ifne:
+    case op_iflt:
+    case op_ifge:
+    case op_ifgt:
+    case op_ifle: {
+        static const int conditions[] = {equal,         not_equal, less,
+                                         greater_equal, greater,   less_equal};
+        load(as, rax, sp_reg, slot(-1), false);
+        moveSp(as, -1);
+        test(as, rax, false);
+        branch(as, conditions[ins.opcode - op_ifeq], ins.target);
+    } break;
+    case op_if_icmpeq:
+    case op_if_icmpne:
+    case op_if_icmplt:
+    case op_if_icmpge:
+    case op_if_icmpgt:
+    case op_if_icmple:
+    case op_if_acmpeq:
+    case op_if_acmpne: {
+        static const int conditions[] = {equal,         not_equal, less,
+                                         greater_equal, greater,   less_equal,
+                                         equal,         not_equal};
+        bool wide = ins.opcode >= op_if_acmpeq;
+        load(as, rax, sp_reg, slot(-2), wide);
+        moveSp(as, -2);
+        as.mem({0x3b}, rax, sp_reg, slot(1), wide);
+        branch(as, conditions[ins.opcode - op_if_icmpeq], ins.target);
+    } break;
+    case op_ifnull:
+    case op_ifnonnull:
+        load(as, rax, sp_reg, slot(-1));
+        moveSp(as, -1);
+        test(as, rax);
+        branch(as, ins.opcode == op_ifnull ? equal : not_equal, ins.target);
+        break;
+    case op_goto:
+        branch(as, -1, ins.target);
+        break;
+    case op_pop:
+        moveSp(as, -1);
+        break;
+    case op_pop2:
+        moveSp(as, -2);
+        break;
+    case op_dup:
+        shuffle(as, 1, {0, 0});
+        break;
+    case op_dup_x1:
+        shuffle(as, 2, {1, 0, 1});
+        break;
+    case op_dup_x2:
+        shuffle(as, 3, {2, 0, 1, 2});
+        break;
+    case op_dup2:
+        shuffle(as, 2, {0, 1, 0, 1});
+        break;
+    case op_dup2_x1:
+        shuffle(as, 3, {1, 2, 0, 1, 2});
+        break;
+    case op_dup2_x2:
+        shuffle(as, 4, {2, 3, 0, 1, 2, 3});
+        break;
+    case op_swap:
+        shuffle(as, 2, {1, 0});
+        break;
+    case op_getstatic_quick:
+        as.movImm(rax, reinterpret_cast<intptr_t>(ins.ref.static_slot));
+        load(as, rax, rax, 0);
+        store(as, sp_reg, slot(0), rax);
+        moveSp(as, ins.b);
+        break;
+    case op_putstatic_quick:
+        load(as, rcx, sp_reg, slot(-ins.b));
+        as.movImm(rax, reinterpret_cast<intptr_t>(ins.ref.static_slot));
+        store(as, rax, 0, rcx);
+        moveSp(as, -ins.b);
+        break;
+    case op_getfield_quick:
+        load(as, rax, sp_reg, slot(-1));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rax, rax, elements + slot(ins.a));
+        store(as, sp_reg, slot(-1), rax);
+        moveSp(as, ins.b - 1);
+        break;
+    case op_putfield_quick:
+        load(as, rax, sp_reg, slot(-ins.b - 1));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rcx, sp_reg, slot(-ins.b));
+        store(as, rax, elements + slot(ins.a), rcx);
+        moveSp(as, -ins.b - 1);
+        break;
+    case op_nullcheck:
+        load(as, rax, sp_reg, slot(-ins.a));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        break;
+    // a receiver of another class is left to the interpreter, which
+    // deoptimizes the frame
+    case op_guard_class:
+        load(as, rax, sp_reg, slot(-ins.a));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rax, rax, runtimeClassOffset());
+        as.movImm(rcx, reinterpret_cast<intptr_t>(ins.ref.runtime_class));
+        as.regs({0x3b}, rax, rcx, true);
+        exitIf(as, not_equal, pc);
+        break;
+    // frame of a call inlined in a trace, its arguments are its first
+    // locals and sp moves past the others and the frame header
+    case op_trace_enter:
+        moveSp(as, ins.a);
+        break;
+    // the result of a call inlined in a trace goes where its arguments were,
+    // at the locals of the returning frame
+    case op_trace_return:
+        for (int k = 0; k < ins.b; k++) {
+            load(as, rax, sp_reg, slot(k - ins.b));
+            store(as, lva_reg, slot(ins.a + k), rax);
+        }
+        as.mem({0x8d}, sp_reg, lva_reg, slot(ins.a + ins.b), true); // lea
+        break;
+    case op_arraylength:
+        load(as, rax, sp_reg, slot(-1));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rax, rax, length, false);
+        store(as, sp_reg, slot(-1), rax, false);
+        break;
+    // the array in rax and the index in rcx, checked against null and the
+    // bounds of the array
+    case op_iaload:
+    case op_laload:
+    case op_faload:
+    case op_daload:
+    case op_aaload:
+    case op_baload:
+    case op_caload:
+    case op_saload: {
+        load(as, rax, sp_reg, slot(-2));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rcx, sp_reg, slot(-1), false);
+        as.mem({0x3b}, rcx, rax, length, false);
+        exitIf(as, above_equal, pc);
+        bool wide = ins.opcode == op_laload || ins.opcode == op_daload ||
+                    ins.opcode == op_aaload;
+        switch (ins.opcode) {
+        case op_baload:
+            as.mem({0x0f, 0xbe}, rdx, rax, elements, false, 0, rcx, 1);
+            break;
+        case op_caload:
+            as.mem({0x0f, 0xb7}, rdx, rax, elements, false, 0, rcx, 2);
+            break;
+        case op_saload:
+            as.mem({0x0f, 0xbf}, rdx, rax, elements, false, 0, rcx, 2);
+            break;
+        default:
+            as.mem({0x8b}, rdx, rax, elements, wide, 0, rcx, wide ? 8 : 4);
+            break;
+        }
+        store(as, sp_reg, slot(-2), rdx, wide);
+        moveSp(as, ins.opcode == op_laload || ins.opcode == op_daload ? 0
+                                                                      : -1);
+    } break;
+    case op_iastore:
+    case op_lastore:
+    case op_fastore:
+    case op_dastore:
+    case op_aastore:
+    case op_castore:
+    case op_sastore: {
+        int n = ins.opcode == op_lastore || ins.opcode == op_dastore ? 2 : 1;
+        load(as, rax, sp_reg, slot(-n - 2));
+        test(as, rax);
+        exitIf(as, equal, pc);
+        load(as, rcx, sp_reg, slot(-n - 1), false);
+        as.mem({0x3b}, rcx, rax, length, false);
+        exitIf(as, above_equal, pc);
+        load(as, rdx, sp_reg, slot(-n));
+        if (ins.opcode == op_castore || ins.opcode == op_sastore) {
+            as.mem({0x89}, rdx, rax, elements, false, 0x66, rcx, 2);
+        } else {
+            bool wide = n == 2 || ins.opcode == op_aastore;
+            as.mem({0x89}, rdx, rax, elements, wide, 0, rcx, wide ? 8 : 4);
+        }
+        moveSp(as, -n - 2);
+    } break;
+    default:
+        return false;
+    }
+    return true;
+}
+
+///
+/// Compiles the instructions of a method into result, false when the code
+/// could not be mapped. code is only read, so it may be a copy of the
+/// instructions of a method that keeps running in the interpreter
+///
+bool JitCompiler::compile(const std::vector<Instruction> &code,
+                          JitCode &result) {
+    X86Assembler as;
+    branches.clear();
+    exits.clear();
+    // CompiledExit (*)(Slot *lva, Slot *sp, int pc)
+    as.push(lva_reg);
+    as.push(sp_reg);
+    as.regs({0x8b}, lva_reg, rdi, true);
+    as.regs({0x8b}, sp_reg, rsi, true);
+    as.regs({0x63}, rdx, rdx, true); // movsxd
+    int table_fixup = as.leaRip(rcx);
+    as.mem({0xff}, 4, rcx, 0, false, 0, rdx, 8);
+    // returns sp in rax and pc in rdx
+    int epilogue = as.size();
+    as.regs({0x8b}, rax, sp_reg, true);
+    as.pop(sp_reg);
+    as.pop(lva_reg);
+    as.ret();
+    std::vector<int> offsets(code.size() + 1);
+    auto &compiled = result.compiled;
+    compiled.assign(code.size(), false);
+    for (int pc = 0; pc < code.size(); pc++) {
+        offsets[pc]  = as.size();
+        compiled[pc] = emit(as, code[pc], pc);
+        if (!compiled[pc]) {
+            leave(as, pc, epilogue);
+        }
+    }
+    offsets[code.size()] = as.size();
+    leave(as, code.size(), epilogue);
+    for (auto &fixup : branches) {
+        as.bind(fixup.first, offsets[fixup.second]);
+    }
+    std::map<int, int> stubs; // slow path exit of each instruction
+    for (auto &fixup : exits) {
+        if (!stubs.count(fixup.second)) {
+            stubs[fixup.second] = as.size();
+            leave(as, fixup.second, epilogue);
+        }
+        as.bind(fixup.first, stubs[fixup.second]);
+    }
+    while (as.size() % 8 != 0) {
+        as.byte(0xcc);
+    }
+    int table = as.size();
+    as.bind(table_fixup, table);
+    for (auto offset : offsets) {
+        as.qword(offset);
+    }
+    // written while writable, then only executable
+    size_t bytes = as.size();
+    void *memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    auto base = static_cast<uint8_t *>(memory);
+    std::memcpy(base, as.code.data(), bytes);
+    auto targets = reinterpret_cast<uintptr_t *>(base + table);
+    for (int pc = 0; pc < offsets.size(); pc++) {
+        targets[pc] += reinterpret_cast<uintptr_t>(base);
+    }
+    if (mprotect(memory, bytes, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, bytes);
+        return false;
+    }
+    regions.push_back(std::make_pair(memory, bytes));
+    result.entry = reinterpret_cast<CompiledCode>(memory);
+    result.size  = bytes;
+    return true;
+}
+
+///
+/// Makes method run code, compiled from its instructions, by setting the
+/// handler of the instructions that got a template to entry, the handler
+/// that enters the compiled code
+///
+void JitCompiler::install(DecodedMethod *method, const JitCode &code,
+                          const void *entry) {
+    method->compiled = code.entry;
+    for (int pc = 0; pc < code.compiled.size(); pc++) {
+        if (code.compiled[pc]) {
+            method->code[pc].handler = entry;
+        }
+    }
+}
+
+#endif
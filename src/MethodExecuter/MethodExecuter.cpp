@@ -1,1918 +1,2894 @@
 #include <JVM/structures/FieldMap.hpp>
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <MethodExecuter/IrBuilder.hpp>
+#include <MethodExecuter/IrLowering.hpp>
 #include <MethodExecuter/MethodExecuter.hpp>
+#include <MethodExecuter/PassManager.hpp>
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
 #include <math.h>
-
-MethodExecuter::MethodExecuter(
-    std::map<std::string, ConstantPool *> cp,
-    std::map<std::string, ClassMethods> *cm,
-    std::map<std::string, ClassFields> *cf,
-    std::function<int(std::string, std::string)> getArgsLen,
-    std::string class_name, std::map<std::string, std::string> super_class) {
+#include <sstream>
+
+MethodExecuter::MethodExecuter(std::map<std::string, ConstantPool *> cp,
+                               std::map<std::string, ClassMethods> *cm,
+                               std::map<std::string, ClassFields> *cf,
+                               std::string class_name,
+                               std::map<std::string, std::string> super_class,
+                               std::map<std::string, RuntimeClass> *classes,
+                               Heap *heap, VMOptions options)
+    : natives(heap), stack(options.stack_size),
+      inliner(cp, cm, &this->super_class, classes, options),
+      ir_interpreter(
+          [this](const FieldRef &field) { return staticField(field); }),
+      broker(options, [this](const CompileTask &task) {
+          return decodeCode(*task.method->info, task.method->class_name,
+                            &task.speculation);
+      }) {
+    this->options     = options;
     this->cm          = cm;
     this->cf          = cf;
-    this->getArgsLen  = getArgsLen;
     this->class_name  = class_name;
     this->cp          = cp;
     this->super_class = super_class;
+    this->classes     = classes;
+    this->heap        = heap;
+    // throwables raised by the VM are not loaded, their hierarchy is known
+    this->super_class.insert(ThrowableHierarchy.begin(),
+                             ThrowableHierarchy.end());
+#ifdef HAS_JIT
+    if (options.jit && !options.aot_library.empty()) {
+        try {
+            aot.open(options.aot_library, [this](const AotLink &link) {
+                FieldRef field{link.class_name, link.name, "", 1};
+                if (link.kind == AotLink::Static) {
+                    return static_cast<void *>(staticField(field));
+                }
+                return reinterpret_cast<void *>(
+                    static_cast<intptr_t>(linkField(field)));
+            });
+        } catch (std::runtime_error &error) {
+            std::cerr << "Cannot load " << options.aot_library << ": "
+                      << error.what() << ", its methods are interpreted"
+                      << std::endl;
+        }
+    }
+#endif
 }
 
-/**
- * MethodExecuter implements and executes all the instructions of the JVM. It
- * sets up the StackFrame, and instructions context to be used with ease. It
- * returns a ContextEntry type when recursive.
- */
-std::shared_ptr<ContextEntry>
-MethodExecuter::Exec(std::vector<unsigned char> bytecode,
-                     std::vector<std::shared_ptr<ContextEntry>> *ce) {
-    auto sf_local = new StackFrame(*ce);
-    std::vector<int> args;
-    auto cf_val      = *(this->cf);
-    int args_counter = 0;
-    bool wide        = false;
-    int i            = 0;
-    for (auto byte = bytecode.begin(); byte < bytecode.end(); byte++) {
-        i = byte - bytecode.begin();
-        switch (*byte) {
-        case 0x32: // aaload
-        {
-            auto index = sf_local->operand_stack.top()->context_value.i;
-            sf_local->operand_stack.pop();
-            if (sf_local->operand_stack.top()->isArray) {
-                auto arrayRef = sf_local->operand_stack.top()->getArray();
-                sf_local->operand_stack.pop();
-                if (index >= arrayRef->size()) {
-                    throw std::runtime_error("ArrayIndexOutOfBoundsException");
-                }
-                sf_local->operand_stack.push(arrayRef->at(index));
-            } else {
-                throw std::runtime_error(
-                    "Stack operand is not an array reference");
-            }
-        } break;
-        case 0x53: // aastore
-        {
-            auto value = sf_local->operand_stack.top();
-            std::shared_ptr<ContextEntry> value_ref(
-                std::shared_ptr<ContextEntry>(
-                    new ContextEntry(std::move(*value))));
-            sf_local->operand_stack.pop();
-            auto index = sf_local->operand_stack.top()->context_value.i;
-            sf_local->operand_stack.pop();
-            if (sf_local->operand_stack.top()->isArray) {
-                sf_local->operand_stack.top()->addToArray(index, value_ref);
-                sf_local->operand_stack.pop();
-            } else {
-                throw std::runtime_error(
-                    "Stack operand is not an array reference");
-            }
-        } break;
-        case 0x01: // aconst_null
-        {
-            sf_local->operand_stack.push(
-                std::shared_ptr<ContextEntry>(new ContextEntry()));
-        } break;
-        case 0x19: // aload
-        {
-            int index        = -1;
-            const int index1 = *(++byte);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(++byte);
-                index            = (index1 << 8) | index2;
-            } else {
-                index = index1;
-            }
-            auto load = sf_local->lva.at(index);
-            if (load->isReference() && !load->isReturnAddress()) {
-                sf_local->operand_stack.push(load);
-            } else {
-                throw std::runtime_error("aload of non-reference object or "
-                                         "load on a return address");
-            }
-        } break;
-        case 0x2a: // aload_0
-        case 0x2b: // aload_1
-        case 0x2c: // aload_2
-        case 0x2d: // aload_3
-        {
-            auto index = *byte - 0x2a;
-            auto load  = sf_local->lva.at(index);
-            if (load->isReference() && !load->isReturnAddress()) {
-                sf_local->operand_stack.push(load);
-            } else {
-                throw std::runtime_error("aload of non-reference object or "
-                                         "load on a return address");
-            }
-        } break;
-        case 0xbd: // anewarray
-        {
-            int count = sf_local->operand_stack.top()->context_value.b;
-            sf_local->operand_stack.pop();
-            const int index1 = *(++byte);
-            const int index2 = *(++byte);
-            int index        = index1 << 8 | index2;
-            if (count < 0) {
-                throw std::runtime_error("NegativeArraySizeException");
-            }
-            // do we need to save this into a heap? Idk
-            sf_local->operand_stack.push(
-                std::shared_ptr<ContextEntry>(new ContextEntry(
-                    cp.at(class_name)->getNameByIndex(index), L, count)));
-        } break;
-        case 0xb0: // areturn
-        {
-            auto retval = sf_local->operand_stack.top();
-            while (!sf_local->operand_stack.empty()) {
-                sf_local->operand_stack.pop();
-            }
-            if (!retval->isReference())
-                throw std::runtime_error(
-                    "areturn cannot return a non-reference value");
-            return retval;
-        } break;
-        case 0xbe: // arraylength
-        {
-            auto arrRef = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (!arrRef->isReference()) {
-                std::runtime_error(
-                    "arraylength called over a non-reference object");
-            }
+///
+/// Decodes the Code attribute of method against the constant pool of
+/// class_name. The optimized version, built with a speculation, has its
+/// trivial calls inlined and, with -XX:+UseIR, goes through the IR
+///
+std::shared_ptr<DecodedMethod>
+MethodExecuter::decodeCode(MethodInfoCte &method, const std::string &class_name,
+                           const Speculation *speculation) {
+    if (method.attributes.empty()) {
+        throw std::runtime_error("Method " + method.name +
+                                 " has no Code attribute");
+    }
+    BytecodeDecoder decoder(cp.at(class_name), class_name);
+    auto decoded     = decoder.decode(method.attributes[0]);
+    auto &descriptor = method.descriptor;
+    decoded->arg_slots =
+        BytecodeDecoder::countArgSlots(std::string(
+            descriptor.begin() + 1,
+            descriptor.begin() + descriptor.find_first_of(')'))) +
+        ((method.access_flags & 0x0008) ? 0 : 1); // ACC_STATIC
+    decoded->info = &method;
+    if (speculation != nullptr) {
+        auto name = class_name + "." + method.name + method.descriptor;
+        if (options.inline_calls) {
+            inliner.inlineCalls(decoded.get(), name, *speculation);
+        }
+        if (options.use_ir && decoded->dependencies.empty()) {
+            optimizeIr(decoded.get(), name);
+        }
+    }
+    BytecodeDecoder::numberLoops(decoded.get());
+    if (options.use_superinstructions) {
+        Superinstructions::fuse(*decoded);
+    }
+    if (options.print_ngrams) {
+        // every instruction is counted before its own handler runs it
+        decoded->dispatches.assign(decoded->code.size(), 0);
+        for (auto &ins : decoded->code) {
+            ins.handler = count_entry;
+        }
+    }
+    return decoded;
+}
 
-            auto length     = arrRef->arrayLength();
-            auto length_ptr = std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(length)));
-            sf_local->operand_stack.push(length_ptr);
-        } break;
-        case 0x3a: // astore
-        {
-            int index        = -1;
-            const int index1 = *(byte + 1);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(byte + 2);
-                index            = (index1 << 8) | index2;
-                byte++;
-            } else {
-                index = index1;
-            }
-            byte++;
-            auto objRef = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (!objRef->isReference() || !objRef->isReturnAddress()) {
-                std::runtime_error("astore called over a non-reference or "
-                                   "returnAddress object");
-            }
-            // return address type??
-            if (index > sf_local->lva.size()) {
-                while (index > sf_local->lva.size())
-                    sf_local->lva.push_back(std::make_shared<ContextEntry>());
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(objRef);
-            } else {
-                sf_local->lva[index] = objRef;
-            }
-        } break;
-        case 0x4b: // astore_0
-        case 0x4c: // astore_1
-        case 0x4d: // astore_2
-        case 0x4e: // astore_3
-        {
-            unsigned int index = *byte - 0x4b;
-            auto objRef        = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (!objRef->isReference() || !objRef->isReturnAddress()) {
-                std::runtime_error("astore called over a non-reference or "
-                                   "returnAddress object");
-            }
-            while (index > sf_local->lva.size()) {
-                sf_local->lva.push_back(std::shared_ptr<ContextEntry>());
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(objRef);
-            } else {
-                sf_local->lva[index] = objRef;
-            }
-        } break;
-        case 0xbb: // new
-        {
-            if (byte + 2 >= bytecode.end()) {
-                throw std::runtime_error(
-                    "New instruction missing missing parameters, code ends "
-                    "before two next args");
-            }
-            int classNameIndex = (static_cast<int>(*(byte + 1)) << 8) +
-                                 static_cast<int>(*(byte + 2));
-            std::string className =
-                cp.at(class_name)->getNameByIndex(classNameIndex);
-            if (className.find("java/", 0) == std::string::npos) {
-                auto entry = std::shared_ptr<ContextEntry>(
-                    new ContextEntry(cf->at(className), className));
-                sf_local->operand_stack.push(entry);
-            }
-            byte += 2;
-        } break;
-        case 0x59: // dup
-        {
-            if (!sf_local->operand_stack.empty()) {
-                auto top = sf_local->operand_stack.top();
-                sf_local->operand_stack.push(top);
-            }
-        } break;
-        case 0x33: // baload
-        case 0x34: // caload
-        case 0x31: // daload
-        case 0x30: // faload
-        case 0x2e: // iaload
-        case 0x2f: // laload
-        case 0x35: // saload
-        {
-            auto index = sf_local->operand_stack.top()->context_value.b;
-            sf_local->operand_stack.pop();
-            auto arrayref = sf_local->operand_stack.top()->getArray();
-            sf_local->operand_stack.pop();
-            auto arrayrefv = *arrayref;
-            if (index >= arrayrefv.size())
-                throw std::runtime_error("ArrayIndexOutOfBoundsException");
-            auto value = arrayref->at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x54: // bastore
-        case 0x55: // castore
-        case 0x52: // dastore
-        case 0x51: // fastore
-        case 0x4f: // iastore
-        case 0x50: // lastore
-        case 0x56: // sastore
-        {
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto index = sf_local->operand_stack.top()->context_value.b;
-            sf_local->operand_stack.pop();
-            auto arrayref = sf_local->operand_stack.top()->getArray();
-            sf_local->operand_stack.pop();
-
-            std::shared_ptr<ContextEntry> value_ref(
-                std::shared_ptr<ContextEntry>(
-                    new ContextEntry(std::move(*value))));
-            if (index > arrayref->size())
-                throw std::runtime_error("ArrayIndexOutOfBoundsException");
-            if (index == arrayref->size())
-                arrayref->push_back(value_ref);
-            else {
-                arrayref->operator[](index) = value_ref;
-            }
-        } break;
-        case 0x10: // bipush
-        {
-            int value = *(++byte);
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", B, reinterpret_cast<void *>(&value))));
-        } break;
-        case 0xc0: // checkcast
-        {
-            auto indexbyte1    = *(++byte);
-            auto indexbyte2    = *(++byte);
-            unsigned int index = (indexbyte1 << 8) + indexbyte2;
-            auto objref        = sf_local->operand_stack.top();
-            if (!objref->isNull) {
-                sf_local->operand_stack.pop();
-                if (objref->class_name ==
-                    cp.at(class_name)->getNameByIndex(index)) {
-                    sf_local->operand_stack.push(objref);
-                } else {
-                    throw std::runtime_error("ClassCastException");
-                }
-            }
-        } break;
-        case 0x90: // d2f
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = F;
-            value.context_value.f = (float)value.context_value.d;
-
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.f)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x86: // i2f
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = F;
-            value.context_value.f = (float)value.context_value.i;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.f)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x89: // l2f
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type = F;
-
-            value.context_value.f = (float)value.context_value.j;
-
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.f)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x88: // l2i
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = I;
-            value.context_value.i = (int)value.context_value.j;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.i)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x8e: // d2i
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = I;
-            value.context_value.i = (int)value.context_value.d;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.i)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x85: // i2l
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = J;
-            value.context_value.j = (long)value.context_value.i;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.j)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x8f: // d2l
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = J;
-            value.context_value.j = (long)value.context_value.d;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.j)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x63: // dadd
-        case 0x62: // fadd
-        case 0x60: // iadd
-        case 0x61: // ladd
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto result = value1 + value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x98: // dcmp<op> dcmpg
-        case 0x97: // dcmp<op> dcmpl
-        {
-            int i       = 1;
-            int n       = *(byte)-0x97;
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto entry = std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&i)));
-            if (value1->context_value.d > value2->context_value.d) {
-                entry->context_value.i = 1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.d < value2->context_value.d) {
-                entry->context_value.i = -1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.d > value2->context_value.d) {
-                entry->context_value.i = 0;
-                sf_local->operand_stack.push(entry);
-            } else if (isnan(value1->context_value.d) ||
-                       isnan(value2->context_value.d)) {
-                if (n == 1) {
-                    entry->context_value.i = 1;
-                    sf_local->operand_stack.push(entry);
-                } else if (n == 0) {
-                    entry->context_value.i = -1;
-                    sf_local->operand_stack.push(entry);
-                }
-            }
-        } break;
-        case 0xe: // dconst_<d> dconst_0
-        case 0xf: // dconst_<d> dconst_1
-        {
-            double e = (double)*byte - 0xe;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", D, reinterpret_cast<void *>(&e))));
-
-        } break;
-        case 0x6f: // ddiv
-        case 0x6e: // fdiv
-        case 0x6d: // ldiv
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value2.context_value.d == 0) {
-                throw std::runtime_error("ArithmeticException");
-            } else {
-                auto result = value1 / value2;
-                sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                    new ContextEntry(std::move(result))));
-            }
-        } break;
-        case 0x18: // dload
-        case 0x16: // lload
-        {
-            int index        = -1;
-            const int index1 = *(byte + 1);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(byte + 2);
-                index            = (index1 << 8) | index2;
-                byte++;
-            } else {
-                index = index1;
-            }
-            byte++;
-            auto value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x26: // dload_0
-        case 0x27: // dload_1
-        case 0x28: // dload_2
-        case 0x29: // dload_3
-        {
-            auto index = *(byte)-0x26;
-            auto value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x6b: // dmul
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value1.entry_type == B) {
-                value1.entry_type      = D;
-                value1.context_value.i = (double)value1.context_value.b;
-            }
-            if (value2.entry_type == B) {
-                value2.entry_type      = D;
-                value2.context_value.i = (double)value2.context_value.b;
-            }
-            auto result = value1 * value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x6a: // fmul
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value1.entry_type == B) {
-                value1.entry_type      = F;
-                value1.context_value.i = (float)value1.context_value.b;
-            }
-            if (value2.entry_type == B) {
-                value2.entry_type      = F;
-                value2.context_value.i = (float)value2.context_value.b;
-            }
-            auto result = value1 * value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x68: // imul
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value1.entry_type == B) {
-                value1.entry_type      = I;
-                value1.context_value.i = (int)value1.context_value.b;
-            }
-            if (value2.entry_type == B) {
-                value2.entry_type      = I;
-                value2.context_value.i = (int)value2.context_value.b;
-            }
-            auto result = value1 * value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x69: // lmul
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto result = value1 * value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x77: // dneg
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            double d = -1;
-            auto result =
-                value * ContextEntry("", D, reinterpret_cast<void *>(&d));
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x73: // drem
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto result =
-                fmod(value1->context_value.d, value2->context_value.d);
-
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", D, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0xaf: // dreturn
-        case 0xae: // freturn
-
-        {
-            auto retval = sf_local->operand_stack.top();
-            while (!sf_local->operand_stack.empty()) {
-                sf_local->operand_stack.pop();
-            }
-            return retval;
-        } break;
-        case 0x39: // dstore
-        case 0x37: // lstore
-
-        {
-            int index        = -1;
-            const int index1 = *(byte + 1);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(byte + 2);
-                index            = (index1 << 8) | index2;
-                byte++;
-            } else {
-                index = index1;
-                byte++;
-            }
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (index > sf_local->lva.size()) {
-                while (index > sf_local->lva.size()) {
-                    sf_local->lva.push_back(std::make_shared<ContextEntry>());
+///
+/// Replaces the code of method, an optimized version named name, with the
+/// lowering of its IR once the passes of VMOptions::ir_passes ran over it.
+/// The code stays as it is when the IR cannot translate it
+///
+void MethodExecuter::optimizeIr(DecodedMethod *method,
+                                const std::string &name) {
+    std::ostringstream report;
+    IrBuilder builder(*method);
+    std::shared_ptr<IrFunction> function = builder.build(name);
+    if (function == nullptr) {
+        if (options.print_ir) {
+            std::cerr << "No IR for " << name << ": it " << builder.reason()
+                      << std::endl;
+        }
+        return;
+    }
+    int before = function->size();
+    PassManager passes(options.ir_passes);
+    passes.run(*function);
+    int instructions = method->code.size();
+    IrLowering lowering(*function, *method);
+    if (!lowering.lower()) {
+        if (options.print_ir) {
+            std::cerr << "No IR for " << name << ": it " << lowering.reason()
+                      << std::endl;
+        }
+        return;
+    }
+    method->ir = function;
+    if (options.print_ir) {
+        report << "IR of " << name << ", " << before << " values, "
+               << function->size() << " after " << passes.report()
+               << std::endl;
+        function->print(report);
+        report << "  " << instructions << " instructions lowered into "
+               << method->code.size() << std::endl;
+        std::cerr << report.str();
+    }
+}
+
+///
+/// Returns the baseline version of method, decoding it the first time with
+/// the profile it records
+///
+DecodedMethod *MethodExecuter::decode(MethodInfoCte &method,
+                                      const std::string &class_name) {
+    if (method.decoded == nullptr) {
+        method.decoded = decodeCode(method, class_name, nullptr);
+        limitTier(method.decoded.get());
+        methods_at_tier[0]++;
+#ifdef HAS_JIT
+        auto compiled = aot.find(class_name, method);
+        if (compiled != nullptr &&
+            std::strlen(compiled->compiled) == method.decoded->code.size()) {
+            // the last tier from the first call, with nothing to profile
+            JitCode code;
+            code.entry = compiled->entry;
+            for (auto flag = compiled->compiled; *flag != '\0'; flag++) {
+                code.compiled.push_back(*flag == '1');
+            }
+            JitCompiler::install(method.decoded.get(), code, jit_entry);
+            methods_at_tier[0]--;
+            methods_at_tier[2]++;
+            method.decoded->tier = 2;
+            limitTier(method.decoded.get());
+            if (options.print_tiers) {
+                std::cerr << class_name << "." << method.name
+                          << method.descriptor << " is compiled ahead of time"
+                          << std::endl;
+            }
+            return method.decoded.get();
+        }
+#endif
+        if (options.profile_interpreter) {
+            method.profile = std::make_shared<MethodProfile>(*method.decoded);
+            method.decoded->profile = method.profile.get();
+            profiled.push_back(&method);
+        }
+    }
+    return method.decoded.get();
+}
+
+///
+/// Sets the invocations of method, a baseline version, that take it to the
+/// next tier and the iterations of a loop that do the same from the version
+/// calls run. Frames left running the baseline version once there is an
+/// optimized one move to it at their next loop iteration
+///
+void MethodExecuter::limitTier(DecodedMethod *method) {
+    const unsigned never = std::numeric_limits<unsigned>::max();
+    auto current         = method->optimized != nullptr
+                               ? method->optimized.get()
+                               : method;
+    if (method->tier == 0) {
+        method->invocation_limit = options.tier1_threshold;
+        current->back_edge_limit = options.tier1_back_edge_threshold;
+    } else if (method->tier == 1 && options.jit) {
+        method->invocation_limit = options.compile_threshold;
+        current->back_edge_limit = options.back_edge_threshold;
+    } else {
+        method->invocation_limit = never;
+        current->back_edge_limit = never;
+    }
+    if (current != method) {
+        method->back_edge_limit = 0;
+    }
+}
+
+///
+/// Starts moving method, a baseline version, to the next tier. Tier 1
+/// decodes it again with its trivial calls inlined and calls run this
+/// optimized version from then on, tier 2 compiles the version calls run.
+/// Both are built by the compile broker and installed by installCompiled,
+/// the method stays in its tier meanwhile. Its counter stays past the
+/// limit, so each of its calls and loop iterations comes back here to
+/// install what is built. back_edges is the count of the loop that made
+/// method hot, 0 when it was its invocations
+///
+void MethodExecuter::promote(DecodedMethod *method, unsigned back_edges) {
+    if (broker.hasBuilt()) {
+        installCompiled();
+    }
+    do {
+        if (method->promoting) {
+            return;
+        }
+        if (method->tier == 0 && !options.inline_calls && !options.use_ir) {
+            // tier 1 keeps the code of tier 0, there is nothing to build
+            // (neither inlined calls nor code lowered from the IR)
+            reachTier(method, back_edges);
+            continue;
+        }
+        if (method->tier > 1 || (method->tier == 1 && !options.jit)) {
+            return; // a counter of the last tier went around
+        }
+        std::unique_ptr<CompileTask> task(new CompileTask());
+        task->method     = method;
+        task->version    = method->optimized != nullptr
+                               ? method->optimized.get()
+                               : method;
+        task->tier       = method->tier + 1;
+        task->back_edges = back_edges;
+        if (task->tier == 2) {
+            task->code = task->version->code;
+        } else if (method->deoptimizations < options.per_method_trap_limit) {
+            // what the method has seen so far, as the workers cannot read
+            // what the interpreter goes on changing
+            task->speculation.instantiated = instantiated;
+            for (int index = 0; index < method->code.size(); index++) {
+                auto &ins = method->code[index];
+                if (ins.opcode == op_invokevirtual_mono) {
+                    task->speculation.receivers[index] =
+                        ins.ref.cache->classes[0];
                 }
             }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-                sf_local->lva.push_back(value);
-            } else {
-                auto position = sf_local->lva.begin() + index;
-                sf_local->lva.insert(position, value);
-                sf_local->lva.insert(position + 1, value);
-            }
-        } break;
-        case 0x47: // dstore_0
-        case 0x48: // dstore_1
-        case 0x49: // dstore_2
-        case 0x4a: // dstore_3
-        {
-            auto index = *(byte)-0x47;
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else if (index > sf_local->lva.size()) {
-                throw std::runtime_error("ArrayIndexOutOfBoundsException");
-            } else {
-                sf_local->lva.erase(sf_local->lva.begin() + index);
-                sf_local->lva.insert(sf_local->lva.begin() + index, value);
-            }
-            if ((index + 1) == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else if ((index + 1) > sf_local->lva.size()) {
-                throw std::runtime_error("ArrayIndexOutOfBoundsException");
-            } else {
-                sf_local->lva.erase(sf_local->lva.begin() + index);
-                sf_local->lva.insert(sf_local->lva.begin() + index, value);
-            }
+        }
+        if (!broker.submit(task.get())) {
+            return; // the queue is full, the next count submits it again
+        }
+        task.release();
+        method->promoting = true;
+        // tasks built by this thread are ready now
+        installCompiled();
+    } while (method->invocations >= method->invocation_limit);
+}
 
-        } break;
-
-        case 0x66: // fsub
-        case 0x67: // dsub
-        case 0x64: // isub
-        case 0x65: // lsub
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            ContextEntry result = value1 - value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x5a: // dup_x1
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            sf_local->operand_stack.push(value1);
-            sf_local->operand_stack.push(value2);
-            sf_local->operand_stack.push(value1);
-        } break;
-        case 0x5b: // dup_x2
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value2->entry_type == D) {
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            } else {
-                auto value3 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value3);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            }
-        } break;
-
-        case 0x5c: // dup2
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (category(value1->entry_type) == 2) {
-                auto value = value1;
-                sf_local->operand_stack.push(value);
-                sf_local->operand_stack.push(value);
-            } else {
-                auto value2 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            }
-        } break;
-        case 0x5d: // dup2_x1
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (category(value1->entry_type) == 2) {
-                auto value2 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            } else {
-                auto value2 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                auto value3 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value3);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            }
-        } break;
-        case 0x5e: // dup2_x2
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (category(value1->entry_type) == 2 &&
-                category(value2->entry_type) ==
-                    2) { // Form 4: value2, value1 -> value1, value2, value1
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value2);
-                sf_local->operand_stack.push(value1);
-            } else if (category(value1->entry_type) == 1 &&
-                       category(value2->entry_type) == 1) {
-                auto value3 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                if (category(value3->entry_type) ==
-                    2) { // Form 3: value3, value2, value1 -> value2,
-                         // value1, value3, value2, value1
-                    sf_local->operand_stack.push(value2);
-                    sf_local->operand_stack.push(value1);
-                    sf_local->operand_stack.push(value3);
-                    sf_local->operand_stack.push(value2);
-                    sf_local->operand_stack.push(value1);
-                } else { // Form 1
-                    auto value4 = sf_local->operand_stack.top();
-                    sf_local->operand_stack.pop();
-                    if (category(value4->entry_type) == 1) {
-                        sf_local->operand_stack.push(value2);
-                        sf_local->operand_stack.push(value1);
-                        sf_local->operand_stack.push(value4);
-                        sf_local->operand_stack.push(value3);
-                        sf_local->operand_stack.push(value2);
-                        sf_local->operand_stack.push(value1);
-                    }
-                }
-            } else if (category(value1->entry_type) == 2 &&
-                       category(value2->entry_type) == 1) {
-                auto value3 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                if (value3->entry_type ==
-                    1) { // Form 2: value3, value2, value1 →
-                         // value1, value3, value2, value1
-                    sf_local->operand_stack.push(value1);
-                    sf_local->operand_stack.push(value3);
-                    sf_local->operand_stack.push(value2);
-                    sf_local->operand_stack.push(value1);
+///
+/// Moves method, a baseline version, to the tier after its own, whatever
+/// it needs for it being installed
+///
+void MethodExecuter::reachTier(DecodedMethod *method, unsigned back_edges) {
+    static const char *const tier_names[] = {"interpreted", "inlined",
+                                             "compiled"};
+    methods_at_tier[method->tier]--;
+    methods_at_tier[++method->tier]++;
+    limitTier(method);
+    if (options.print_tiers) {
+        std::cerr << method->class_name << "." << method->info->name
+                  << method->info->descriptor << " reaches tier "
+                  << method->tier << " (" << tier_names[method->tier]
+                  << ") after " << method->invocations << " calls";
+        if (back_edges > 0) {
+            std::cerr << " and " << back_edges << " loop iterations";
+        }
+        std::cerr << std::endl;
+    }
+}
+
+///
+/// Installs the promotions the compile broker has built. It runs between
+/// two instructions of the interpreter, so no frame sees a method half
+/// promoted: frames running the version that is compiled go on in the
+/// compiled code from their next instruction, calls run the optimized
+/// version from the next one. Tasks for a version invalidated meanwhile,
+/// or built on dependencies a class instantiated meanwhile breaks, are
+/// dropped and the method is promoted again
+///
+void MethodExecuter::installCompiled() {
+    while (auto built = broker.nextBuilt()) {
+        std::unique_ptr<CompileTask> task(built);
+        auto method       = task->method;
+        method->promoting = false;
+        bool stale        = task->tier != method->tier + 1;
+        if (!stale && task->tier == 1 && !task->failed) {
+            for (auto &dependency : task->optimized->dependencies) {
+                for (auto runtime_class : instantiated) {
+                    stale = stale || breaks(runtime_class, dependency);
                 }
             }
-        } break;
-        case 0x87: // i2d
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = D;
-            value.context_value.d = (double)value.context_value.i;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.d)));
-            sf_local->operand_stack.push(valptr);
-
-        } break;
-        case 0x8d: // f2d
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = D;
-            value.context_value.d = (double)value.context_value.f;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.d)));
-            sf_local->operand_stack.push(valptr);
-
-        } break;
-        case 0x8a: // l2d
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = D;
-            value.context_value.d = (double)value.context_value.j;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.d)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x8b: // f2i
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = I;
-            value.context_value.i = (int)value.context_value.f;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.i)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x8c: // f2l
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value.entry_type      = J;
-            value.context_value.j = (long)value.context_value.f;
-            std::shared_ptr<ContextEntry> valptr(new ContextEntry(
-                "", value.entry_type,
-                reinterpret_cast<void *>(&value.context_value.j)));
-            sf_local->operand_stack.push(valptr);
-        } break;
-        case 0x96: // fcmpg
-        case 0x95: // fcmpl
-        {
-            int i       = 1;
-            int n       = *(byte)-0x95;
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto entry = std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&i)));
-            if (value1->context_value.d > value2->context_value.d) {
-                entry->context_value.i = 1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.d < value2->context_value.d) {
-                entry->context_value.i = -1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.d == value2->context_value.d) {
-                entry->context_value.i = 0;
-                sf_local->operand_stack.push(entry);
-            } else if (isnan(value1->context_value.d) ||
-                       isnan(value2->context_value.d)) {
-                if (n == 1) {
-                    entry->context_value.i = 1;
-                    sf_local->operand_stack.push(entry);
-                } else if (n == 0) {
-                    entry->context_value.i = -1;
-                    sf_local->operand_stack.push(entry);
+        }
+        if (stale) {
+            continue;
+        }
+        if (task->failed) {
+            // the method stays in its tier for good
+            const unsigned never     = std::numeric_limits<unsigned>::max();
+            method->invocation_limit = never;
+            task->version->back_edge_limit = never;
+            if (options.print_tiers) {
+                std::cerr << method->class_name << "." << method->info->name
+                          << method->info->descriptor
+                          << " cannot reach tier " << task->tier << ": "
+                          << task->error << std::endl;
+            }
+            continue;
+        }
+        if (task->tier == 1) {
+            method->optimized           = task->optimized;
+            method->optimized->baseline = method;
+            if (!method->optimized->dependencies.empty()) {
+                speculating.push_back(method);
+            }
+        } else {
+#ifdef HAS_JIT
+            if (recorder.watches(task->version)) {
+                abortTrace("a method it runs is compiled");
+            }
+            JitCompiler::install(task->version, task->jit, jit_entry);
+            broker.counters.code_bytes += task->jit.size;
+#endif
+        }
+        reachTier(method, task->back_edges);
+    }
+}
+
+///
+/// Handles a hot loop of the method running in frame: the back-edge
+/// counter of branch, which goes back to the loop header, reached its limit
+/// with the operand stack at sp. The loop promotes the method when frame
+/// runs the version calls run. When frame runs an older version, because
+/// the loop or the calls promoted the method to an optimized version, the
+/// frame is replaced on the stack by a frame of the current version that
+/// continues from the same loop header (on-stack replacement). Both
+/// versions come from the same bytecode and share its locals, and the
+/// header is the first instruction of the current version at the same
+/// bytecode offset, as inlined code takes the offset of its call. Returns
+/// the frame that goes on, with its sp and pc set
+///
+StackFrame *MethodExecuter::hotLoop(StackFrame *frame, Slot *sp,
+                                    const Instruction &branch) {
+    int header   = branch.target;
+    auto version = frame->method;
+    auto method  = version->baseline;
+    auto current = [method]() {
+        return method->optimized != nullptr ? method->optimized.get()
+                                            : method;
+    };
+    frame->sp = sp;
+    frame->pc = header;
+#ifdef HAS_JIT
+    if (traceLoop(frame, branch)) {
+        return frame;
+    }
+#endif
+    if (broker.hasBuilt()) {
+        installCompiled();
+    }
+    if (version == current()) {
+        promote(method, version->back_edges[branch.b]);
+    }
+    auto replacement = current();
+    if (version == replacement) {
+        return frame;
+    }
+    if (replacement->ir != nullptr || !stack.fits(replacement, frame->lva)) {
+        // the frame stays in its version, the loop is not counted again. The
+        // code lowered from the IR has locals of its own
+        version->back_edge_limit = std::numeric_limits<unsigned>::max();
+        return frame;
+    }
+    int bci    = version->code[header].bci;
+    auto entry = std::lower_bound(
+        replacement->code.begin(), replacement->code.end(), bci,
+        [](const Instruction &ins, int bci) { return ins.bci < bci; });
+    // the operand stack moves up as the locals of replacement may be more
+    std::vector<Slot> operands(frame->stack, sp);
+    auto replaced = stack.push(frame->caller, replacement, frame->lva);
+    replaced->sp  = std::copy(operands.begin(), operands.end(), replaced->sp);
+    replaced->pc  = entry - replacement->code.begin();
+    if (options.print_tiers) {
+        std::cerr << method->class_name << "." << method->info->name
+                  << method->info->descriptor << " replaces its frame at bci "
+                  << bci << " with tier " << method->tier << std::endl;
+    }
+    return replaced;
+}
+
+#ifdef HAS_JIT
+///
+/// Recordings a loop aborts before it promotes its method instead, and side
+/// exits of a trace after which it is dropped when they are more than half
+/// of its runs
+///
+static const int trace_attempts       = 3;
+static const unsigned side_exit_limit = 1000;
+
+static std::string loopName(const DecodedMethod *version, int header) {
+    return version->class_name + "." + version->info->name +
+           version->info->descriptor + " at bci " +
+           std::to_string(version->code[header].bci);
+}
+
+///
+/// Handles a hot loop with -XX:+UseTraceJIT: its next iteration is recorded
+/// when it has no trace yet. Returns false when the loop promotes its method
+/// instead, as traces are off or the last attempts to record it aborted
+///
+bool MethodExecuter::traceLoop(StackFrame *frame, const Instruction &branch) {
+    auto version = frame->method;
+    int header   = branch.target;
+    if (!options.trace_jit || !options.jit ||
+        trace_aborts[std::make_pair(version, header)] >= trace_attempts) {
+        return false;
+    }
+    version->back_edges[branch.b] = 0;
+    if (recorder.recording() || (!version->trace_entries.empty() &&
+                                 version->trace_entries[header].first)) {
+        return true;
+    }
+    if (!recorder.start(frame, header, record_entry,
+                        options.max_trace_length)) {
+        traceAborted(version, header, recorder.reason());
+    }
+    return true;
+}
+
+///
+/// Records the instruction pc of frame, about to run while a trace is
+/// recorded, and installs the trace once the iteration is complete
+///
+void MethodExecuter::recordStep(StackFrame *frame, int pc) {
+    switch (recorder.record(frame, pc)) {
+    case TraceRecorder::Recording:
+        break;
+    case TraceRecorder::Complete:
+        installTrace();
+        break;
+    case TraceRecorder::Aborted:
+        abortTrace(recorder.reason());
+        break;
+    }
+}
+
+///
+/// Stops recording the trace for reason
+///
+void MethodExecuter::abortTrace(const std::string &reason) {
+    auto version = recorder.version();
+    int header   = recorder.loopHeader();
+    recorder.stop();
+    traceAborted(version, header, reason);
+}
+
+///
+/// Counts a trace of the loop at header of version given up for reason,
+/// the loop tries again the next time it is hot
+///
+void MethodExecuter::traceAborted(const DecodedMethod *version, int header,
+                                  const std::string &reason) {
+    trace_aborts[std::make_pair(version, header)]++;
+    trace_counters.aborted++;
+    if (options.print_traces) {
+        std::cerr << "Trace of " << loopName(version, header)
+                  << " aborted: " << reason << std::endl;
+    }
+}
+
+///
+/// Compiles the trace recorded and makes the instructions of the loop it
+/// can be entered at enter it
+///
+void MethodExecuter::installTrace() {
+    auto trace = recorder.build();
+    recorder.stop();
+    if (!trace_jit.compile(trace->code, trace->jit)) {
+        traceAborted(trace->version, trace->header,
+                     "its code cannot be mapped");
+        return;
+    }
+    auto version  = trace->version;
+    auto &entries = version->trace_entries;
+    if (entries.empty()) {
+        entries.resize(version->code.size(), std::make_pair(nullptr, 0));
+    }
+    for (auto &point : trace->entry_points) {
+        auto &entry = entries[point.first];
+        if (entry.first != nullptr) {
+            continue; // entering the trace of an inner loop
+        }
+        entry   = std::make_pair(trace.get(), point.second);
+        auto ins = &version->code[point.first];
+        if (trace->jit.compiled[point.second]) {
+            trace->handlers.push_back(std::make_pair(ins, ins->handler));
+            ins->handler = trace_entry;
+        }
+    }
+    trace_counters.recorded++;
+    if (options.print_traces) {
+        std::cerr << "Trace of " << loopName(trace->version, trace->header)
+                  << " recorded: "
+                  << trace->code.size() << " instructions, "
+                  << trace->frames.size() - 1 << " calls inlined"
+                  << std::endl;
+    }
+    traces.push_back(std::move(trace));
+}
+
+///
+/// Drops the traces running code of version, which is invalidated for
+/// reason. Their loops are interpreted again and record a new trace
+///
+void MethodExecuter::dropTraces(const DecodedMethod *version,
+                                const std::string &reason) {
+    for (auto &trace : traces) {
+        if (!trace->dropped && trace->uses(version)) {
+            dropTrace(*trace, reason);
+        }
+    }
+}
+
+///
+/// Gives the instructions entering trace their handler back for reason
+///
+void MethodExecuter::dropTrace(Trace &trace, const std::string &reason) {
+    for (auto &handler : trace.handlers) {
+        if (handler.first->handler == trace_entry) {
+            handler.first->handler = handler.second;
+        }
+    }
+    for (auto &point : trace.entry_points) {
+        auto &entry = trace.version->trace_entries[point.first];
+        if (entry.first == &trace) {
+            entry = std::make_pair(nullptr, 0);
+        }
+    }
+    trace.dropped = true;
+    trace_counters.dropped++;
+    if (options.print_traces) {
+        std::cerr << "Trace of " << loopName(trace.version, trace.header)
+                  << " dropped: " << reason << std::endl;
+    }
+}
+
+///
+/// Runs the trace the instruction pc of frame enters, with the operand
+/// stack at sp, until it leaves. The frames of the inlined calls it left
+/// in are pushed as the interpreter would have. Returns the frame that goes
+/// on, with its sp and pc set to the instruction the interpreter runs next
+///
+StackFrame *MethodExecuter::runTrace(StackFrame *frame, Slot *sp, int pc) {
+    auto &entry = frame->method->trace_entries[pc];
+    auto trace  = entry.first;
+    frame->sp   = sp;
+    frame->pc   = pc;
+    if (!stack.contains(frame->lva + trace->extent)) {
+        return frame;
+    }
+    trace->entries++;
+    auto exit    = trace->jit.entry(frame->lva, sp, entry.second);
+    auto &target = trace->exits[exit.pc];
+    if (target.side && ++trace->side_exits >= side_exit_limit &&
+        trace->side_exits > trace->runs() / 2) {
+        // the recorded path is not the usual one, the loop promotes its
+        // method instead
+        trace_aborts[std::make_pair(trace->version, trace->header)] =
+            trace_attempts;
+        dropTrace(*trace, "leaves through a guard in " +
+                              std::to_string(trace->side_exits) + " of " +
+                              std::to_string(trace->runs()) + " runs");
+    }
+    frame     = materialize(*trace, target.frame, frame);
+    frame->sp = exit.sp;
+    frame->pc = target.pc;
+    return frame;
+}
+
+///
+/// Frame index of trace, pushed with the ones it is called from above
+/// root, the frame running the loop
+///
+StackFrame *MethodExecuter::materialize(const Trace &trace, int index,
+                                        StackFrame *root) {
+    if (index == 0) {
+        return root;
+    }
+    auto &inlined = trace.frames[index];
+    auto caller   = materialize(trace, inlined.parent, root);
+    auto lva      = root->lva + inlined.lva;
+    caller->sp    = lva;
+    caller->pc    = inlined.return_pc;
+    return stack.push(caller, inlined.method, lva);
+}
+#endif
+
+///
+/// Pushes the frame of a call to callee, a baseline version, counting the
+/// invocation. The frame runs the optimized version of callee if it has one
+///
+StackFrame *MethodExecuter::enter(StackFrame *caller, DecodedMethod *callee,
+                                  Slot *args) {
+    if (++callee->invocations >= callee->invocation_limit) {
+        promote(callee, 0);
+    }
+    if (callee->optimized != nullptr) {
+        callee = callee->optimized.get();
+    }
+    return stack.push(caller, callee, args);
+}
+
+///
+/// Whether an instance of runtime_class breaks dependency: the class is the
+/// one of the dependency or a subclass of it and runs another method
+///
+bool MethodExecuter::breaks(const RuntimeClass *runtime_class,
+                            const Dependency &dependency) const {
+    for (auto current = runtime_class; current != nullptr;
+         current      = current->super) {
+        if (current == dependency.runtime_class) {
+            return runtime_class->vtable[dependency.index].method !=
+                   dependency.method;
+        }
+    }
+    return false;
+}
+
+///
+/// Invalidates the optimized version of method, a baseline version, for
+/// reason: calls run the baseline version again, which starts over from
+/// tier 0 and builds a new optimized version from what it sees next. After
+/// VMOptions::per_method_trap_limit invalidations it is optimized without
+/// speculating. Frames running the invalidated version may be anywhere in
+/// it: each instruction they can resume at (one of the caller, not of an
+/// inlined call) becomes a deoptimize, which moves the frame to the
+/// baseline version when it runs
+///
+void MethodExecuter::invalidate(DecodedMethod *method,
+                                const std::string &reason) {
+    auto version = method->optimized;
+    if (version == nullptr) {
+        return;
+    }
+#ifdef HAS_JIT
+    if (recorder.watches(version.get())) {
+        abortTrace("a method it runs is invalidated");
+    }
+    dropTraces(version.get(), reason);
+#endif
+    auto &code = version->code;
+    if (!version->dispatches.empty()) {
+        // the counts so far are of the instructions it had
+        auto counted        = std::make_shared<DecodedMethod>();
+        counted->code       = code;
+        counted->handlers   = version->handlers;
+        counted->dispatches = version->dispatches;
+        counted_versions.push_back(counted);
+        std::fill(version->dispatches.begin(), version->dispatches.end(), 0);
+    }
+    for (int index = 0; index < code.size(); index++) {
+        if (version->interpreter_index.empty() ||
+            version->interpreter_index[index] >= 0) {
+            code[index].opcode  = op_deoptimize;
+            code[index].handler = deopt_entry;
+            code[index].fused   = super_none;
+        }
+    }
+    version->back_edge_limit = std::numeric_limits<unsigned>::max();
+    // its call sites must not be turned back into invokevirtual
+    devirtualized.erase(
+        std::remove_if(devirtualized.begin(), devirtualized.end(),
+                       [&](const DevirtualizedCall &call) {
+                           return call.instruction >= code.data() &&
+                                  call.instruction < code.data() + code.size();
+                       }),
+        devirtualized.end());
+    speculating.erase(
+        std::remove(speculating.begin(), speculating.end(), method),
+        speculating.end());
+    invalidated.push_back(version);
+    method->optimized.reset();
+    if (options.print_deoptimization) {
+        std::cerr << "Deoptimizing " << method->class_name << "."
+                  << method->info->name << method->info->descriptor
+                  << " (tier " << method->tier << "): " << reason
+                  << std::endl;
+    }
+    methods_at_tier[method->tier]--;
+    methods_at_tier[0]++;
+    method->tier        = 0;
+    method->invocations = 0;
+    std::fill(method->back_edges.begin(), method->back_edges.end(), 0);
+    method->deoptimizations++;
+    deoptimizations++;
+    limitTier(method);
+}
+
+///
+/// Moves frame, which runs an optimized version, to the baseline version
+/// of its method. The operand stack is at sp and the frame resumes at the
+/// instruction pc, one of the caller, whose interpreter index is the
+/// instruction of the baseline version with the same locals and operand
+/// stack. The locals of inlined calls are not live there and are dropped.
+/// Returns the frame that goes on, with its sp and pc set
+///
+StackFrame *MethodExecuter::deoptimize(StackFrame *frame, Slot *sp, int pc) {
+    auto version = frame->method;
+    auto method  = version->baseline;
+    int index    = version->interpreter_index.empty()
+                       ? pc
+                       : version->interpreter_index[pc];
+    if (index < 0) {
+        throw std::runtime_error("Deoptimization inside an inlined call");
+    }
+    std::vector<Slot> operands(frame->stack, sp);
+    auto replaced = stack.push(frame->caller, method, frame->lva);
+    replaced->sp  = std::copy(operands.begin(), operands.end(), replaced->sp);
+    replaced->pc  = index;
+    deoptimized_frames++;
+    if (options.print_deoptimization) {
+        std::cerr << method->class_name << "." << method->info->name
+                  << method->info->descriptor
+                  << " goes back to the interpreter at bci "
+                  << method->code[index].bci << std::endl;
+    }
+    return replaced;
+}
+
+///
+/// Static field slot, looked up in the class that declares it (the class of
+/// the reference or one of its super classes)
+///
+Slot *MethodExecuter::staticField(const FieldRef &field) {
+    for (auto name = field.class_name; cf->count(name);) {
+        auto &fields = cf->at(name);
+        auto found   = fields.find(field.name);
+        if (found != fields.end()) {
+            return &found->second;
+        }
+        auto super = super_class.find(name);
+        if (super == super_class.end()) {
+            break;
+        }
+        name = super->second;
+    }
+    auto &slot = (*cf)[field.class_name][field.name];
+    slot.ref   = natives.getStatic(field);
+    return &slot;
+}
+
+///
+/// Creates an instance of class_name with all of its fields, inherited ones
+/// included, set to zero or null. The first instance of a class may break
+/// the assumptions of devirtualized calls and the dependencies of
+/// optimized versions
+///
+ContextEntry *MethodExecuter::newObject(const std::string &class_name) {
+    auto runtime_class = classes->find(class_name);
+    if (runtime_class == classes->end()) {
+        return heap->allocateObject(nullptr, class_name);
+    }
+    auto created = &runtime_class->second;
+    if (instantiated.insert(created).second) {
+        invalidateDevirtualized();
+        auto methods = speculating; // invalidate removes them
+        for (auto method : methods) {
+            for (auto &dependency : method->optimized->dependencies) {
+                if (breaks(created, dependency)) {
+                    auto inlined = dependency.method;
+                    invalidate(method,
+                               "class " + class_name + " overrides " +
+                                   dependency.runtime_class->name + "." +
+                                   inlined->name + inlined->descriptor +
+                                   " inlined at bci " +
+                                   std::to_string(dependency.bci));
+                    break;
                 }
             }
-        } break;
-        case 0xb: // fconst_0
-        case 0xc: // fconst_1
-        case 0xd: // fconst_2
-        {
-            float e    = static_cast<float>(static_cast<int>(*byte - 0xb));
-            auto entry = std::shared_ptr<ContextEntry>(
-                new ContextEntry("", F, reinterpret_cast<void *>(&e)));
-            sf_local->operand_stack.push(entry);
-        } break;
-        case 0x17: // fload
-        case 0x15: // iload
-        {
-            int index        = -1;
-            const int index1 = *(++byte);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(++byte);
-                index            = (index1 << 8) | index2;
-            } else {
-                index = index1;
-            }
-            auto value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x22: // fload_0
-        case 0x23: // fload_1
-        case 0x24: // fload_2
-        case 0x25: // fload_3
-        {
-            auto index = *(byte)-0x22;
-            auto value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x76: // fneg
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            float f = -1;
-            auto result =
-                value * ContextEntry("", F, reinterpret_cast<void *>(&f));
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-
-        } break;
-        case 0x72: // frem
-        {
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto result =
-                fmod(value1->context_value.f, value2->context_value.f);
-
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", F, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0x38: // fstore
-        case 0x36: // istore
-        {
-            int index        = -1;
-            const int index1 = *(++byte);
-            if (wide) {
-                wide             = false;
-                const int index2 = *(++byte);
-                index            = (index1 << 8) | index2;
-            } else {
-                index = index1;
-            }
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            while (index > sf_local->lva.size()) {
-                sf_local->lva.push_back(std::make_shared<ContextEntry>());
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else {
-                sf_local->lva[index] = value;
-            }
-        } break;
-        case 0x43: // fstore_0
-        case 0x44: // fstore_1
-        case 0x45: // fstore_2
-        case 0x46: // fstore_3
-        {
-            auto index = *(byte)-0x43;
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            while (index > sf_local->lva.size()) {
-                sf_local->lva.push_back(std::make_shared<ContextEntry>());
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else {
-                sf_local->lva[index] = value;
+        }
+    }
+    return heap->allocateObject(&runtime_class->second, class_name);
+}
+
+///
+/// Resolves the slot offset of an instance field in the layout of the class
+/// of the reference, which is the same in all of its subclasses
+///
+int MethodExecuter::linkField(const FieldRef &field) {
+    auto runtime_class = classes->find(field.class_name);
+    if (runtime_class != classes->end()) {
+        auto &offsets = runtime_class->second.field_offsets;
+        auto offset   = offsets.find(field.name);
+        if (offset != offsets.end()) {
+            return offset->second;
+        }
+    }
+    throw JavaException("java/lang/NoSuchFieldError",
+                        field.class_name + "." + field.name);
+}
+
+///
+/// Tells if object can be assigned to class_name by walking its super class
+/// chain or, for loaded interfaces, by looking for it in the itable of its
+/// class. Library classes and interfaces out of the known hierarchy are
+/// accepted as there is no information about them
+///
+bool MethodExecuter::isInstance(ContextEntry *object,
+                                const std::string &class_name) {
+    if (object->isArray || class_name == "java/lang/Object" ||
+        (!cm->count(class_name) && !ThrowableHierarchy.count(class_name))) {
+        return true;
+    }
+    for (auto name = object->class_name;;) {
+        if (name == class_name) {
+            return true;
+        }
+        auto super = super_class.find(name);
+        if (super == super_class.end()) {
+            break;
+        }
+        name = super->second;
+    }
+    if (object->runtime_class != nullptr) {
+        for (auto &table : object->runtime_class->itable) {
+            if (table.interface->name == class_name) {
+                return true;
             }
-        } break;
-        case 0xb4: // getfield
-        {
-            auto indexbyte1 = *(++byte);
-            auto indexbyte2 = *(++byte);
-            int index       = (indexbyte1 << 8) | indexbyte2;
-            auto objref     = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto field_name = cp.at(class_name)->getFieldByIndex(index);
-            if (objref->isNull)
-                throw std::runtime_error("NullPointerException");
-            auto value = objref->cf.at(field_name);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0xb2: // getstatic
-        {
-            auto indexbyte1 = *(++byte);
-            auto indexbyte2 = *(++byte);
-            auto index      = (indexbyte1 << 8) | indexbyte2;
-            auto field_name = cp.at(class_name)->getFieldByIndex(index);
-            if (cf->at(class_name).find(field_name) !=
-                cf->at(class_name).end()) {
-                sf_local->operand_stack.push(cf->at(class_name).at(field_name));
+        }
+    }
+    return false;
+}
+
+static ContextEntry *checkNull(ContextEntry *ref) {
+    if (ref == nullptr) {
+        throw JavaException("java/lang/NullPointerException");
+    }
+    return ref;
+}
+
+///
+/// Floating point to integer conversion: NaN gives zero and values out of
+/// range saturate at the limits of the integer type
+///
+template <typename To, typename From> static To saturate(From value) {
+    if (isnan(value)) {
+        return 0;
+    }
+    if (value >= static_cast<From>(std::numeric_limits<To>::max())) {
+        return std::numeric_limits<To>::max();
+    }
+    if (value <= static_cast<From>(std::numeric_limits<To>::min())) {
+        return std::numeric_limits<To>::min();
+    }
+    return static_cast<To>(value);
+}
+
+///
+/// fcmpl, fcmpg, dcmpl and dcmpg, nan is the result when any value is NaN
+///
+template <typename T> static int compare(T value1, T value2, int nan) {
+    if (value1 > value2) {
+        return 1;
+    }
+    if (value1 < value2) {
+        return -1;
+    }
+    if (value1 == value2) {
+        return 0;
+    }
+    return nan;
+}
+
+///
+/// Number of call sites replaced by the code of the method they call
+///
+int MethodExecuter::inlinedCalls() const { return inliner.inlinedCalls(); }
+
+///
+/// Number of decoded methods whose last promotion took them to tier
+///
+int MethodExecuter::methodsAtTier(int tier) const {
+    return methods_at_tier[tier];
+}
+
+///
+/// Counters of the compile broker
+///
+const CompileCounters &MethodExecuter::compileCounters() const {
+    return broker.counters;
+}
+
+///
+/// Number of optimized versions invalidated
+///
+unsigned MethodExecuter::deoptimizationCount() const {
+    return deoptimizations;
+}
+
+///
+/// Number of frames moved from an invalidated version to the interpreter
+///
+unsigned MethodExecuter::deoptimizedFrames() const {
+    return deoptimized_frames;
+}
+
+///
+/// Counters of the traces, with the entries and side exits of all of them
+///
+TraceCounters MethodExecuter::traceCounters() const {
+    auto counters = trace_counters;
+#ifdef HAS_JIT
+    for (auto &trace : traces) {
+        counters.entries += trace->entries;
+        counters.runs += trace->runs();
+        counters.side_exits += trace->side_exits;
+    }
+#endif
+    return counters;
+}
+
+///
+/// Writes the profile of every method that ran, in the order they were
+/// first called
+///
+void MethodExecuter::printMethodData(std::ostream &out) const {
+    for (auto method : profiled) {
+        method->profile->print(out, method->decoded->class_name + "." +
+                                        method->name + method->descriptor);
+    }
+}
+
+///
+/// Writes each trace with the times it was entered and left through a
+/// guard, in the order they were recorded
+///
+void MethodExecuter::printTraces(std::ostream &out) const {
+#ifdef HAS_JIT
+    for (auto &trace : traces) {
+        out << "  " << loopName(trace->version, trace->header) << ": "
+            << trace->code.size() << " instructions, " << trace->entries
+            << " entries, " << trace->runs() << " runs, "
+            << trace->side_exits << " side exits"
+            << (trace->dropped ? ", dropped" : "") << std::endl;
+    }
+#endif
+}
+
+///
+/// Writes the report of -XX:+PrintBytecodeNGrams over every version of the
+/// methods that ran, the invalidated ones included
+///
+void MethodExecuter::printBytecodeNGrams(std::ostream &out) const {
+    std::vector<const DecodedMethod *> versions;
+    for (auto &loaded : *cm) {
+        for (auto &method : loaded.second) {
+            auto baseline = method.second.decoded.get();
+            if (baseline != nullptr) {
+                versions.push_back(baseline);
+            }
+            if (baseline != nullptr && baseline->optimized != nullptr) {
+                versions.push_back(baseline->optimized.get());
             }
-        } break;
-        case 0xa7: // goto
-        {
-            unsigned short int branchbyte1 = *(byte + 1);
-            unsigned short int branchbyte2 = *(byte + 2);
-
-            short int offset = (signed int)(branchbyte1 << 8) | branchbyte2;
-            byte += offset;
-            byte--;
-        } break;
-        case 0xc8: // goto_w
-        {
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-            auto branchbyte3 = *(++byte);
-            auto branchbyte4 = *(++byte);
-
-            auto offset = (branchbyte1 << 24) | (branchbyte2 << 16) |
-                          (branchbyte3 << 8) | branchbyte4;
-
-            byte += offset;
-        } break;
-        case 0x91: // i2b
-        case 0x92: // i2c
-        {
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value->entry_type = C;
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x93: // i2s
-        {
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            value->entry_type = S;
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x7e: // iand
-        case 0x7f: // land
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto result = value1 & value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-
-        case 0x6c: // idiv
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value2.context_value.i == 0) {
-                throw std::runtime_error("ArithmeticException");
-            } else {
-                auto value3 = value1 / value2;
-                sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                    new ContextEntry(std::move(value3))));
+        }
+    }
+    for (auto &version : invalidated) {
+        versions.push_back(version.get());
+    }
+    for (auto &version : counted_versions) {
+        versions.push_back(version.get());
+    }
+    Superinstructions::printNGrams(out, versions, options.ngram_length);
+}
+
+/**
+ * MethodExecuter implements and executes all the instructions of the JVM.
+ * Exec runs method and every method it calls in one interpreter loop: calls
+ * push a StackFrame on the VM stack and returns pop it, so the C++ stack does
+ * not grow with the Java one. The bytecode is decoded once per method (see
+ * BytecodeDecoder) and the interpreter runs over the decoded instructions, so
+ * operands, constant pool entries and branch targets are never parsed again.
+ * args points to the arguments (receiver first) copied to the local
+ * variables of method, and the return value of method is returned.
+ */
+Slot MethodExecuter::Exec(MethodInfoCte &method, Slot *args) {
+#ifdef HAS_COMPUTED_GOTO
+    if (options.dispatch == VMOptions::Threaded) {
+        return run<true>(method, args);
+    }
+#endif
+    return run<false>(method, args);
+}
+
+///
+/// CASE opens the handler of an opcode and NEXT closes it. With the switch
+/// engine NEXT just leaves the switch and the loop fetches the next
+/// instruction. With direct threading every decoded instruction keeps the
+/// address of its handler label, so NEXT jumps straight into the handler of
+/// the following instruction and each handler gets its own indirect branch.
+///
+#define CASE(op) case op_##op:
+
+#ifdef HAS_COMPUTED_GOTO
+#define LABEL(op) L_##op:
+#define LABEL_ADDRESS(name, code) &&L_##name,
+#define DISPATCH()                                                             \
+    do {                                                                       \
+        if (pc >= dm->code.size())                                             \
+            goto end_of_code;                                                  \
+        ins = &dm->code[pc++];                                                 \
+        goto *ins->handler;                                                    \
+    } while (0)
+#define NEXT                                                                   \
+    if (Threaded)                                                              \
+        DISPATCH();                                                            \
+    break
+#undef CASE
+#define CASE(op) case op_##op: LABEL(op)
+#define THREAD_CODE(method)                                                    \
+    if (Threaded && !(method)->threaded)                                       \
+    threadCode(method)
+#define SUPERINSTRUCTION_ADDRESS(name, ...) &&L_super_##name,
+// moves a superinstruction on to its next instruction, without dispatching
+#define FUSED() ins = &dm->code[pc++]
+#else
+#define NEXT break
+#define THREAD_CODE(method)
+#endif
+
+///
+/// Stores the values cached in state (see StackCache) to the operand stack
+/// and loads them back from it. The switch engine caches nothing
+///
+#define SPILL(state)                                                           \
+    do {                                                                       \
+        switch (state) {                                                       \
+        case cache_narrow:                                                     \
+            *sp++ = tos;                                                       \
+            break;                                                             \
+        case cache_wide:                                                       \
+            *sp = tos;                                                         \
+            sp += 2;                                                           \
+            break;                                                             \
+        case cache_narrow2:                                                    \
+            sp[0] = nos;                                                       \
+            sp[1] = tos;                                                       \
+            sp += 2;                                                           \
+            break;                                                             \
+        case cache_wide2:                                                      \
+            sp[0] = nos;                                                       \
+            sp[2] = tos;                                                       \
+            sp += 4;                                                           \
+            break;                                                             \
+        }                                                                      \
+    } while (0)
+#define FILL(state)                                                            \
+    do {                                                                       \
+        switch (state) {                                                       \
+        case cache_narrow:                                                     \
+            tos = *--sp;                                                       \
+            break;                                                             \
+        case cache_wide:                                                       \
+            sp -= 2;                                                           \
+            tos = *sp;                                                         \
+            break;                                                             \
+        case cache_narrow2:                                                    \
+            sp -= 2;                                                           \
+            nos = sp[0];                                                       \
+            tos = sp[1];                                                       \
+            break;                                                             \
+        case cache_wide2:                                                      \
+            sp -= 4;                                                           \
+            nos = sp[0];                                                       \
+            tos = sp[2];                                                       \
+            break;                                                             \
+        }                                                                      \
+    } while (0)
+
+///
+/// Goes on in replacement, a frame that took the place of the running one
+/// with its sp and pc set, with the values its instruction expects cached
+///
+#define REPLACE_FRAME(replacement)                                             \
+    do {                                                                       \
+        frame = (replacement);                                                 \
+        dm    = frame->method;                                                 \
+        lva   = frame->lva;                                                    \
+        sp    = frame->sp;                                                     \
+        pc    = frame->pc;                                                     \
+        THREAD_CODE(dm);                                                       \
+        if (pc < dm->code.size()) {                                            \
+            FILL(dm->code[pc].cache);                                          \
+        }                                                                      \
+    } while (0)
+
+///
+/// Takes the branch of the running instruction. A branch going back counts
+/// an iteration of its loop, and the frame may continue in a new version of
+/// its method once the loop is hot
+///
+#define BRANCH()                                                               \
+    do {                                                                       \
+        if (ins->target < pc &&                                                \
+            ++dm->back_edges[ins->b] >= dm->back_edge_limit) {                 \
+            REPLACE_FRAME(hotLoop(frame, sp, *ins));                           \
+        } else {                                                               \
+            pc = ins->target;                                                  \
+        }                                                                      \
+    } while (0)
+
+///
+/// Applies update to the ProfileData of the running instruction, when it
+/// has one
+///
+#define PROFILE(update)                                                        \
+    do {                                                                       \
+        if (ins->profile >= 0) {                                               \
+            dm->profile->data[ins->profile].update;                            \
+        }                                                                      \
+    } while (0)
+
+///
+/// Takes the branch of the running conditional branch if condition holds,
+/// profiling its outcome
+///
+#define BRANCH_IF(condition)                                                   \
+    do {                                                                       \
+        bool taken = (condition);                                              \
+        PROFILE(branch(taken));                                                \
+        if (taken) {                                                           \
+            BRANCH();                                                          \
+        }                                                                      \
+    } while (0)
+
+///
+/// Handler of the instructions -XX:+PrintBytecodeNGrams counts with the
+/// switch engine
+///
+static const char count_marker = 0;
+
+#ifdef HAS_JIT
+///
+/// Handlers of the compiled instructions, of the instructions a trace
+/// records and of the ones entering a trace with the switch engine
+///
+static const char jit_marker    = 0;
+static const char record_marker = 0;
+static const char trace_marker  = 0;
+
+///
+/// Makes the instructions of a method called while a trace is recorded
+/// record themselves too
+///
+#define WATCH_CALLEE(method)                                                   \
+    if (recorder.recording() && !recorder.watch(method))                       \
+    abortTrace(recorder.reason())
+#define RECORDING() recorder.recording()
+#else
+#define WATCH_CALLEE(method)
+#define RECORDING() false
+#endif
+
+///
+/// Whether the IrInterpreter runs the frame of method instead: it has an
+/// IrFunction and -XX:+InterpretIR is on, until it is compiled. A trace
+/// being recorded follows the lowered code
+///
+#define RUNS_IR(method)                                                        \
+    ((method)->ir != nullptr && options.interpret_ir &&                        \
+     (method)->compiled == nullptr && !RECORDING())
+
+///
+/// Saves the state of the running frame and continues in the callee frame
+///
+#define CALL(callee)                                                           \
+    do {                                                                       \
+        auto next = (callee);                                                  \
+        frame->sp = sp;                                                        \
+        frame->pc = pc;                                                        \
+        frame     = next;                                                      \
+        dm        = frame->method;                                             \
+        lva       = frame->lva;                                                \
+        sp        = frame->stack;                                              \
+        pc        = 0;                                                         \
+        if (RUNS_IR(dm)) {                                                     \
+            result       = ir_interpreter.run(*dm->ir, lva);                   \
+            result_slots = dm->ir->return_slots;                               \
+            goto method_exit;                                                  \
+        }                                                                      \
+        THREAD_CODE(dm);                                                       \
+        WATCH_CALLEE(dm);                                                      \
+    } while (0)
+
+#ifdef HAS_COMPUTED_GOTO
+///
+/// Spills of the values cached in each state, see SPILL
+///
+#define SPILL_narrow() *sp++ = tos
+#define SPILL_wide() (*sp = tos, sp += 2)
+#define SPILL_narrow2() (sp[0] = nos, sp[1] = tos, sp += 2)
+#define SPILL_wide2() (sp[0] = nos, sp[2] = tos, sp += 4)
+
+///
+/// Entry of the handler at target for the frames arriving with values
+/// cached in state, which it spills first, and its address
+///
+#define SPILL_ENTRY(state, name, target)                                       \
+    L_spill_##state##_##name : SPILL_##state();                                \
+    goto target;
+#define SPILL_ENTRY_narrow(name, ...) SPILL_ENTRY(narrow, name, L_##name)
+#define SPILL_ENTRY_wide(name, ...) SPILL_ENTRY(wide, name, L_##name)
+#define SPILL_ENTRY_narrow2(name, ...) SPILL_ENTRY(narrow2, name, L_##name)
+#define SPILL_ENTRY_wide2(name, ...) SPILL_ENTRY(wide2, name, L_##name)
+#define SUPER_SPILL_ENTRY_narrow(name, ...)                                    \
+    SPILL_ENTRY(narrow, super_##name, L_super_##name)
+#define SUPER_SPILL_ENTRY_wide(name, ...)                                      \
+    SPILL_ENTRY(wide, super_##name, L_super_##name)
+#define SUPER_SPILL_ENTRY_narrow2(name, ...)                                   \
+    SPILL_ENTRY(narrow2, super_##name, L_super_##name)
+#define SUPER_SPILL_ENTRY_wide2(name, ...)                                     \
+    SPILL_ENTRY(wide2, super_##name, L_super_##name)
+#define SPILL_ADDRESS_narrow(name, ...) &&L_spill_narrow_##name,
+#define SPILL_ADDRESS_wide(name, ...) &&L_spill_wide_##name,
+#define SPILL_ADDRESS_narrow2(name, ...) &&L_spill_narrow2_##name,
+#define SPILL_ADDRESS_wide2(name, ...) &&L_spill_wide2_##name,
+#define SUPER_SPILL_ADDRESS_narrow(name, ...) &&L_spill_narrow_super_##name,
+#define SUPER_SPILL_ADDRESS_wide(name, ...) &&L_spill_wide_super_##name,
+#define SUPER_SPILL_ADDRESS_narrow2(name, ...) &&L_spill_narrow2_super_##name,
+#define SUPER_SPILL_ADDRESS_wide2(name, ...) &&L_spill_wide2_super_##name,
+
+///
+/// Cached handlers of JVM_CACHED_HANDLERS, one macro per CacheShape. Each
+/// opens the handler of name for every state the shape is entered in,
+/// L_cached_<name>_<state>, running load, store, op or condition on the
+/// cached values tos and nos. The handlers entered with more or fewer
+/// values than the shape takes spill or load the others and fall through
+/// into the one with as many
+///
+#define CACHED_PUSH_NARROW(name, load)                                         \
+    L_cached_##name##_narrow2:                                                 \
+        *sp++ = nos;                                                           \
+    L_cached_##name##_narrow:                                                  \
+        nos = tos;                                                             \
+        load;                                                                  \
+        DISPATCH();                                                            \
+    L_cached_##name##_wide2:                                                   \
+        *sp = nos;                                                             \
+        sp += 2;                                                               \
+    L_cached_##name##_wide:                                                    \
+        *sp = tos;                                                             \
+        sp += 2;                                                               \
+    L_cached_##name##_none:                                                    \
+        load;                                                                  \
+        DISPATCH();
+#define CACHED_PUSH_WIDE(name, load)                                           \
+    L_cached_##name##_wide2:                                                   \
+        *sp = nos;                                                             \
+        sp += 2;                                                               \
+    L_cached_##name##_wide:                                                    \
+        nos = tos;                                                             \
+        load;                                                                  \
+        DISPATCH();                                                            \
+    L_cached_##name##_narrow2:                                                 \
+        *sp++ = nos;                                                           \
+    L_cached_##name##_narrow:                                                  \
+        *sp++ = tos;                                                           \
+    L_cached_##name##_none:                                                    \
+        load;                                                                  \
+        DISPATCH();
+#define CACHED_POP_NARROW(name, store)                                         \
+    L_cached_##name##_narrow2:                                                 \
+        store;                                                                 \
+        tos = nos;                                                             \
+        DISPATCH();                                                            \
+    L_cached_##name##_narrow:                                                  \
+        store;                                                                 \
+        DISPATCH();
+#define CACHED_POP_WIDE(name, store)                                           \
+    L_cached_##name##_wide2:                                                   \
+        store;                                                                 \
+        tos = nos;                                                             \
+        DISPATCH();                                                            \
+    L_cached_##name##_wide:                                                    \
+        store;                                                                 \
+        DISPATCH();
+#define CACHED_UNARY_NARROW(name, op)                                          \
+    L_cached_##name##_narrow:                                                  \
+    L_cached_##name##_narrow2:                                                 \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_UNARY_WIDE(name, op)                                            \
+    L_cached_##name##_wide:                                                    \
+    L_cached_##name##_wide2:                                                   \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_TO_WIDE(name, op)                                               \
+    L_cached_##name##_narrow:                                                  \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_TO_NARROW(name, op)                                             \
+    L_cached_##name##_wide:                                                    \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_BINARY_NARROW(name, op)                                         \
+    L_cached_##name##_narrow:                                                  \
+        nos = *--sp;                                                           \
+    L_cached_##name##_narrow2:                                                 \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_BINARY_WIDE(name, op)                                           \
+    L_cached_##name##_wide:                                                    \
+        sp -= 2;                                                               \
+        nos = *sp;                                                             \
+    L_cached_##name##_wide2:                                                   \
+        op;                                                                    \
+        DISPATCH();
+#define CACHED_COMPARE_WIDE CACHED_BINARY_WIDE
+#define CACHED_BRANCH_NARROW(name, condition)                                  \
+    L_cached_##name##_narrow2:                                                 \
+        *sp++ = nos;                                                           \
+    L_cached_##name##_narrow:                                                  \
+        BRANCH_IF(condition);                                                  \
+        DISPATCH();
+#define CACHED_BRANCH_BINARY(name, condition)                                  \
+    L_cached_##name##_narrow:                                                  \
+        nos = *--sp;                                                           \
+    L_cached_##name##_narrow2:                                                 \
+        BRANCH_IF(condition);                                                  \
+        DISPATCH();
+#define CACHED_ARRAY_STORE(name, store)                                        \
+    L_cached_##name##_narrow:                                                  \
+        nos = *--sp;                                                           \
+    L_cached_##name##_narrow2:                                                 \
+        sp--;                                                                  \
+        store;                                                                 \
+        DISPATCH();
+#define CACHED_RETURN_NARROW(name)                                             \
+    L_cached_##name##_narrow:                                                  \
+    L_cached_##name##_narrow2:                                                 \
+        result       = tos;                                                    \
+        result_slots = 1;                                                      \
+        goto method_exit;
+#define CACHED_RETURN_WIDE(name)                                               \
+    L_cached_##name##_wide:                                                    \
+    L_cached_##name##_wide2:                                                   \
+        result       = tos;                                                    \
+        result_slots = 2;                                                      \
+        goto method_exit;
+
+///
+/// Addresses of the cached handlers of name by CacheState, for each shape
+///
+#define CACHED_LABEL(name, state) &&L_cached_##name##_##state
+#define CACHED_ADDRESSES_shape_push_narrow(name)                               \
+    CACHED_LABEL(name, none), CACHED_LABEL(name, narrow),                      \
+    CACHED_LABEL(name, wide), CACHED_LABEL(name, narrow2),                     \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_push_wide(name)                                 \
+    CACHED_LABEL(name, none), CACHED_LABEL(name, narrow),                      \
+    CACHED_LABEL(name, wide), CACHED_LABEL(name, narrow2),                     \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_pop_narrow(name)                                \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_pop_wide(name)                                  \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr,                       \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_unary_narrow(name)                              \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_unary_wide(name)                                \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr,                       \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_to_wide(name)                                   \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, nullptr, nullptr
+#define CACHED_ADDRESSES_shape_to_narrow(name)                                 \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr, nullptr
+#define CACHED_ADDRESSES_shape_binary_narrow(name)                             \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_binary_wide(name)                               \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr,                       \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_compare_wide(name)                              \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr,                       \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES_shape_branch_narrow(name)                             \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_branch_binary(name)                             \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_array_store(name)                               \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_return_narrow(name)                             \
+    nullptr, CACHED_LABEL(name, narrow), nullptr, CACHED_LABEL(name, narrow2), \
+    nullptr
+#define CACHED_ADDRESSES_shape_return_wide(name)                               \
+    nullptr, nullptr, CACHED_LABEL(name, wide), nullptr,                       \
+    CACHED_LABEL(name, wide2)
+#define CACHED_ADDRESSES(name, shape, ...) {CACHED_ADDRESSES_##shape(name)},
+#endif
+
+///
+/// Interpreter loop, instantiated once per dispatch engine. Operands live in
+/// the slots of the frame: sp points to the first free slot of the operand
+/// stack, a value of category 2 takes sp[-2] and sp[-1] and is read from the
+/// lower slot. The threaded engine keeps the top one or two of them in tos
+/// and nos instead, as StackCache planned for each instruction. int and
+/// long arithmetic wraps around as in Java. A thrown JavaException unwinds
+/// the frames until the exception table of one of them has a handler for
+/// it, and the loop resumes there.
+///
+template <bool Threaded>
+Slot MethodExecuter::run(MethodInfoCte &method, Slot *args) {
+#ifdef HAS_JIT
+    // the threaded engine jumps to the handler of compiled instructions, the
+    // switch engine compares it with the markers
+    jit_entry    = Threaded ? &&L_jit : &jit_marker;
+    record_entry = Threaded ? &&L_record : &record_marker;
+    trace_entry  = Threaded ? &&L_trace : &trace_marker;
+#endif
+#ifdef HAS_COMPUTED_GOTO
+    deopt_entry = Threaded ? &&L_deoptimize : nullptr;
+    count_entry = Threaded ? &&L_count : &count_marker;
+#else
+    deopt_entry = nullptr;
+    count_entry = &count_marker;
+#endif
+    auto frame       = enter(nullptr, decode(method, class_name),
+                             stack.bottom());
+    auto dm          = frame->method;
+    Instruction *ins = nullptr;
+    Slot *lva        = frame->lva;
+    Slot *sp         = frame->stack;
+    int pc           = 0;
+    Slot result;
+    int result_slots;
+    Slot tos, nos; // values cached out of the operand stack
+    std::copy(args, args + dm->arg_slots, lva);
+#ifdef HAS_COMPUTED_GOTO
+    // handlers of the opcodes of class files, then of the _quick forms, by
+    // the CacheState they are entered in
+    static const void *const labels[][op_jsr_w + 2 + op_trace_exit -
+                                      op_ldc_quick + 1] = {
+        {JVM_OPCODES(LABEL_ADDRESS) && L_unknown,
+         JVM_QUICK_OPCODES(LABEL_ADDRESS)},
+        {JVM_OPCODES(SPILL_ADDRESS_narrow) && L_spill_narrow_unknown,
+         JVM_QUICK_OPCODES(SPILL_ADDRESS_narrow)},
+        {JVM_OPCODES(SPILL_ADDRESS_wide) && L_spill_wide_unknown,
+         JVM_QUICK_OPCODES(SPILL_ADDRESS_wide)},
+        {JVM_OPCODES(SPILL_ADDRESS_narrow2) && L_spill_narrow2_unknown,
+         JVM_QUICK_OPCODES(SPILL_ADDRESS_narrow2)},
+        {JVM_OPCODES(SPILL_ADDRESS_wide2) && L_spill_wide2_unknown,
+         JVM_QUICK_OPCODES(SPILL_ADDRESS_wide2)}};
+    static_assert(sizeof(labels) / sizeof(labels[0]) == CacheStates,
+                  "labels must have handlers for every CacheState");
+    auto label = [](unsigned short opcode, int state) {
+        if (opcode >= op_ldc_quick) {
+            return labels[state][opcode - op_ldc_quick + op_jsr_w + 2];
+        }
+        return labels[state][std::min<int>(opcode, op_jsr_w + 1)];
+    };
+    // handlers of the superinstructions, by CacheState and Superinstruction
+    static const void *const super_labels[][super_count] = {
+        {nullptr, JVM_SUPERINSTRUCTIONS(SUPERINSTRUCTION_ADDRESS)},
+        {nullptr, JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ADDRESS_narrow)},
+        {nullptr, JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ADDRESS_wide)},
+        {nullptr, JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ADDRESS_narrow2)},
+        {nullptr, JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ADDRESS_wide2)}};
+    // cached handlers, by JVM_CACHED_HANDLERS entry and CacheState
+    static const void *const cached_labels[][CacheStates] = {
+        JVM_CACHED_HANDLERS(CACHED_ADDRESSES)};
+    // handler the instruction runs from, as StackCache planned it. A
+    // deoptimized instruction leaves from the handler that spills
+    auto planned = [&](const Instruction *instruction) {
+        int state = instruction->cache;
+        if (instruction->opcode == op_deoptimize) {
+            return label(op_deoptimize, cache_none);
+        }
+        switch (instruction->variant) {
+        case variant_fused:
+            return super_labels[state][instruction->fused];
+        case variant_cached:
+            return cached_labels[StackCache::handler(instruction->opcode)]
+                                [state];
+        default:
+            return label(instruction->opcode, state);
+        }
+    };
+    // handler that runs the instruction on its own, without the rest of its
+    // superinstruction
+    auto unfused = [&](const Instruction *instruction) {
+        return instruction->variant == variant_fused
+                   ? label(instruction->opcode, instruction->cache)
+                   : planned(instruction);
+    };
+    // handler of every instruction, set the first time a method runs. The
+    // instructions compiled or counted before that already have theirs.
+    // The instructions counted are dispatched one by one
+    auto threadCode = [&](DecodedMethod *method) {
+        StackCache::plan(*method, !options.print_ngrams,
+                         options.use_stack_caching);
+        for (auto &instruction : method->code) {
+            if (instruction.handler == nullptr) {
+                instruction.handler = planned(&instruction);
             }
-        } break;
-        case 0x2: // iconst_m1
-        case 0x3: // iconst_0
-        case 0x4: // iconst_1
-        case 0x5: // iconst_2
-        case 0x6: // iconst_3
-        case 0x7: // iconst_4
-        case 0x8: // iconst_5
-        {
-            int e = static_cast<int>(*byte - 0x3);
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&e))));
-        } break;
-        case 0xa5: // if_acmpeq
-        case 0xa6: // if_acmpne
-        {
-            auto index  = *(byte)-0xa5;
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-            if (index == 0) {
-                if (value1.l == value2.l) {
-                    auto offset = (branchbyte1 << 8) | branchbyte2;
-                    byte += offset;
+        }
+        method->threaded = true;
+    };
+#endif
+    // rewrites the running instruction into its _quick form, the operands
+    // of the quick form must be already set. A trace being recorded would
+    // miss the next runs of the instruction, it records again later
+    auto quicken = [&](Opcode opcode) {
+#ifdef HAS_JIT
+        if (recorder.recording()) {
+            abortTrace("an instruction is quickened");
+        }
+#endif
+        ins->opcode = opcode;
+#ifdef HAS_COMPUTED_GOTO
+        if (Threaded && ins->handler != count_entry) {
+            ins->handler = planned(ins);
+        }
+#endif
+    };
+    // selects the method for receiver from its vtable when the inline cache
+    // of the running invokevirtual misses, recording it while there is room
+    auto cacheMiss = [&](ContextEntry *receiver) {
+        auto cache  = ins->ref.cache;
+        auto target = selectVirtual(receiver, *cache);
+        if (receiver->runtime_class == nullptr) {
+            return target; // library classes are not cached
+        }
+        if (cache->size == InlineCache::Polymorphic) {
+            quicken(op_invokevirtual_mega);
+            return target;
+        }
+        cache->classes[cache->size] = receiver->runtime_class;
+        cache->targets[cache->size] = target;
+        quicken(++cache->size == 1 ? op_invokevirtual_mono
+                                   : op_invokevirtual_poly);
+        return target;
+    };
+    THREAD_CODE(dm);
+resume:
+    try {
+#ifdef HAS_COMPUTED_GOTO
+        if (Threaded) {
+            DISPATCH();
+        }
+#endif
+        while (pc < dm->code.size()) {
+            ins = &dm->code[pc++];
+            // only the markers set the handler with the switch engine
+            if (ins->handler != nullptr) {
+                if (ins->handler == count_entry) {
+                    dm->dispatches[pc - 1]++;
                 }
-            } else if (index == 1) {
-                if (value1.l != value2.l) {
-                    auto offset = (branchbyte1 << 8) | branchbyte2;
-                    byte += offset;
+#ifdef HAS_JIT
+                if (ins->handler == record_entry) {
+                    recordStep(frame, pc - 1);
                 }
-            }
-        } break;
-        case 0x9f: // if_icmpeq
-        case 0xa0: // if_icmpne
-        case 0xa1: // if_icmplt
-        case 0xa2: // if_icmpge
-        case 0xa3: // if_icmpgt
-        case 0xa4: // if_icmple
-        {
-            auto index  = *(byte)-0x9f;
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto branchbyte1 = *(byte + 1);
-            auto branchbyte2 = *(byte + 2);
-            int offset       = 0;
-            if (index == 0) { // if_icmpeq
-                if (value1->context_value.b == value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+                if (ins->handler == trace_entry) {
+                    REPLACE_FRAME(runTrace(frame, sp, pc - 1));
+                    ins = &dm->code[pc++];
+                } else if (ins->handler == jit_entry) {
+                    auto exit = dm->compiled(lva, sp, pc - 1);
+                    sp        = exit.sp;
+                    pc        = exit.pc;
+                    if (pc >= dm->code.size()) {
+                        break;
+                    }
+                    ins = &dm->code[pc++];
                 }
-            } else if (index == 1) { // if_icmpne
-                if (value1->context_value.b != value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+#endif
+            }
+            switch (ins->opcode) {
+            CASE(nop) {
+            } NEXT;
+            CASE(aconst_null) {
+                (sp++)->ref = nullptr;
+            } NEXT;
+            CASE(iconst_m1)
+            CASE(iconst_0)
+            CASE(iconst_1)
+            CASE(iconst_2)
+            CASE(iconst_3)
+            CASE(iconst_4)
+            CASE(iconst_5)
+            CASE(bipush)
+            CASE(sipush) {
+                (sp++)->i = ins->a;
+            } NEXT;
+            CASE(lconst_0)
+            CASE(lconst_1) {
+                sp->j = ins->a;
+                sp += 2;
+            } NEXT;
+            CASE(fconst_0)
+            CASE(fconst_1)
+            CASE(fconst_2) {
+                (sp++)->f = ins->a;
+            } NEXT;
+            CASE(dconst_0)
+            CASE(dconst_1) {
+                sp->d = ins->a;
+                sp += 2;
+            } NEXT;
+            // the first run of an instruction that refers to the constant
+            // pool resolves it and falls through into its quick form
+            CASE(ldc) {
+                auto constant = ins->ref.constant;
+                Slot value{};
+                if (constant->value.t == R) {
+                    value.ref = heap->allocate(constant->value.str_value);
+                } else if (constant->value.t == F) {
+                    value.f = constant->value.val.f;
+                } else {
+                    value.i = constant->value.val.i;
                 }
-            } else if (index == 2) { // if_icmplt
-                if (value1->context_value.b < value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+                ins->ref.value = value;
+                quicken(op_ldc_quick);
+            }
+            CASE(ldc_quick) {
+                *sp++ = ins->ref.value;
+            } NEXT;
+            CASE(ldc2_w) {
+                auto constant = ins->ref.constant;
+                Slot value;
+                if (constant->wide_value.t == D) {
+                    value.d = constant->wide_value.val.d;
+                } else {
+                    value.j = constant->wide_value.val.l;
                 }
-            } else if (index == 3) { // if_icmpge
-                if (value1->context_value.b >= value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+                ins->ref.value = value;
+                quicken(op_ldc2_w_quick);
+            }
+            CASE(ldc2_w_quick) {
+                *sp = ins->ref.value;
+                sp += 2;
+            } NEXT;
+            CASE(iload)
+            CASE(fload)
+            CASE(aload) {
+                *sp++ = lva[ins->a];
+            } NEXT;
+            CASE(lload)
+            CASE(dload) {
+                sp[0] = lva[ins->a];
+                sp[1] = lva[ins->a + 1];
+                sp += 2;
+            } NEXT;
+            CASE(istore)
+            CASE(fstore)
+            CASE(astore) {
+                lva[ins->a] = *--sp;
+            } NEXT;
+            CASE(lstore)
+            CASE(dstore) {
+                sp -= 2;
+                lva[ins->a]     = sp[0];
+                lva[ins->a + 1] = sp[1];
+            } NEXT;
+            CASE(iaload) {
+                sp[-2].i = checkNull(sp[-2].ref)->at<int32_t>(sp[-1].i);
+                sp--;
+            } NEXT;
+            CASE(faload) {
+                sp[-2].f = checkNull(sp[-2].ref)->at<float>(sp[-1].i);
+                sp--;
+            } NEXT;
+            CASE(aaload) {
+                sp[-2].ref =
+                    checkNull(sp[-2].ref)->at<ContextEntry *>(sp[-1].i);
+                sp--;
+                PROFILE(types.record(sp[-1].ref));
+            } NEXT;
+            CASE(baload) {
+                sp[-2].i = checkNull(sp[-2].ref)->at<int8_t>(sp[-1].i);
+                sp--;
+            } NEXT;
+            CASE(caload) {
+                sp[-2].i = checkNull(sp[-2].ref)->at<uint16_t>(sp[-1].i);
+                sp--;
+            } NEXT;
+            CASE(saload) {
+                sp[-2].i = checkNull(sp[-2].ref)->at<int16_t>(sp[-1].i);
+                sp--;
+            } NEXT;
+            CASE(laload) {
+                sp[-2].j = checkNull(sp[-2].ref)->at<int64_t>(sp[-1].i);
+            } NEXT;
+            CASE(daload) {
+                sp[-2].d = checkNull(sp[-2].ref)->at<double>(sp[-1].i);
+            } NEXT;
+            CASE(iastore) {
+                checkNull(sp[-3].ref)->at<int32_t>(sp[-2].i) = sp[-1].i;
+                sp -= 3;
+            } NEXT;
+            CASE(fastore) {
+                checkNull(sp[-3].ref)->at<float>(sp[-2].i) = sp[-1].f;
+                sp -= 3;
+            } NEXT;
+            CASE(aastore) {
+                PROFILE(types.record(sp[-1].ref));
+                checkNull(sp[-3].ref)->at<ContextEntry *>(sp[-2].i) =
+                    sp[-1].ref;
+                sp -= 3;
+            } NEXT;
+            CASE(bastore) {
+                auto array = checkNull(sp[-3].ref);
+                array->at<int8_t>(sp[-2].i) =
+                    array->entry_type == Z ? sp[-1].i & 1 : sp[-1].i;
+                sp -= 3;
+            } NEXT;
+            CASE(castore) {
+                checkNull(sp[-3].ref)->at<uint16_t>(sp[-2].i) = sp[-1].i;
+                sp -= 3;
+            } NEXT;
+            CASE(sastore) {
+                checkNull(sp[-3].ref)->at<int16_t>(sp[-2].i) = sp[-1].i;
+                sp -= 3;
+            } NEXT;
+            CASE(lastore) {
+                checkNull(sp[-4].ref)->at<int64_t>(sp[-3].i) = sp[-2].j;
+                sp -= 4;
+            } NEXT;
+            CASE(dastore) {
+                checkNull(sp[-4].ref)->at<double>(sp[-3].i) = sp[-2].d;
+                sp -= 4;
+            } NEXT;
+            CASE(pop) {
+                sp--;
+            } NEXT;
+            CASE(pop2) {
+                sp -= 2;
+            } NEXT;
+            CASE(dup) {
+                sp[0] = sp[-1];
+                sp++;
+            } NEXT;
+            CASE(dup_x1) {
+                sp[0]  = sp[-1];
+                sp[-1] = sp[-2];
+                sp[-2] = sp[0];
+                sp++;
+            } NEXT;
+            CASE(dup_x2) {
+                sp[0]  = sp[-1];
+                sp[-1] = sp[-2];
+                sp[-2] = sp[-3];
+                sp[-3] = sp[0];
+                sp++;
+            } NEXT;
+            CASE(dup2) {
+                sp[0] = sp[-2];
+                sp[1] = sp[-1];
+                sp += 2;
+            } NEXT;
+            CASE(dup2_x1) {
+                sp[1]  = sp[-1];
+                sp[0]  = sp[-2];
+                sp[-1] = sp[-3];
+                sp[-3] = sp[0];
+                sp[-2] = sp[1];
+                sp += 2;
+            } NEXT;
+            CASE(dup2_x2) {
+                sp[1]  = sp[-1];
+                sp[0]  = sp[-2];
+                sp[-1] = sp[-3];
+                sp[-2] = sp[-4];
+                sp[-4] = sp[0];
+                sp[-3] = sp[1];
+                sp += 2;
+            } NEXT;
+            CASE(swap) {
+                std::swap(sp[-1], sp[-2]);
+            } NEXT;
+            CASE(iadd) {
+                sp[-2].i = static_cast<uint32_t>(sp[-2].i) + sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(ladd) {
+                sp[-4].j = static_cast<uint64_t>(sp[-4].j) + sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(fadd) {
+                sp[-2].f += sp[-1].f;
+                sp--;
+            } NEXT;
+            CASE(dadd) {
+                sp[-4].d += sp[-2].d;
+                sp -= 2;
+            } NEXT;
+            CASE(isub) {
+                sp[-2].i = static_cast<uint32_t>(sp[-2].i) - sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(lsub) {
+                sp[-4].j = static_cast<uint64_t>(sp[-4].j) - sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(fsub) {
+                sp[-2].f -= sp[-1].f;
+                sp--;
+            } NEXT;
+            CASE(dsub) {
+                sp[-4].d -= sp[-2].d;
+                sp -= 2;
+            } NEXT;
+            CASE(imul) {
+                sp[-2].i = static_cast<uint32_t>(sp[-2].i) * sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(lmul) {
+                sp[-4].j = static_cast<uint64_t>(sp[-4].j) * sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(fmul) {
+                sp[-2].f *= sp[-1].f;
+                sp--;
+            } NEXT;
+            CASE(dmul) {
+                sp[-4].d *= sp[-2].d;
+                sp -= 2;
+            } NEXT;
+            CASE(idiv) {
+                if (sp[-1].i == 0) {
+                    throw JavaException("java/lang/ArithmeticException",
+                                        "/ by zero");
                 }
-            } else if (index == 4) { // if_ifmpgt
-                if (value1->context_value.b > value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+                // MIN_VALUE / -1 overflows back to MIN_VALUE
+                if (sp[-1].i != -1) {
+                    sp[-2].i /= sp[-1].i;
+                } else {
+                    sp[-2].i = 0u - static_cast<uint32_t>(sp[-2].i);
                 }
-            } else if (index == 5) { // if_icmple
-                if (value1->context_value.b <= value2->context_value.b) {
-                    offset = (branchbyte1 << 8) | branchbyte2;
-                    byte--;
+                sp--;
+            } NEXT;
+            CASE(ldiv) {
+                if (sp[-2].j == 0) {
+                    throw JavaException("java/lang/ArithmeticException",
+                                        "/ by zero");
                 }
-            }
-            if (!offset)
-                byte += 2;
-            byte += offset;
-
-        } break;
-        case 0x99: // ifeq
-        case 0x9a: // ifne
-        case 0x9b: // iflt
-        case 0x9c: // ifge
-        case 0x9d: // ifgt
-        case 0x9e: // ifle
-        {
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            int n = *(byte)-0x99;
-            if (n == 0) { // ifeq
-                if (!value->context_value.i) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
+                if (sp[-2].j != -1) {
+                    sp[-4].j /= sp[-2].j;
                 } else {
-                    byte++;
+                    sp[-4].j = 0u - static_cast<uint64_t>(sp[-4].j);
                 }
-            } else if (n == 1) { // ifne
-                if (value->context_value.i) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
-                } else {
-                    byte++;
+                sp -= 2;
+            } NEXT;
+            CASE(fdiv) {
+                sp[-2].f /= sp[-1].f;
+                sp--;
+            } NEXT;
+            CASE(ddiv) {
+                sp[-4].d /= sp[-2].d;
+                sp -= 2;
+            } NEXT;
+            CASE(irem) {
+                if (sp[-1].i == 0) {
+                    throw JavaException("java/lang/ArithmeticException",
+                                        "/ by zero");
                 }
-            } else if (n == 2) { // iflt
-                if (value->context_value.i < 0) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
-                } else {
-                    byte++;
+                sp[-2].i = sp[-1].i == -1 ? 0 : sp[-2].i % sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(lrem) {
+                if (sp[-2].j == 0) {
+                    throw JavaException("java/lang/ArithmeticException",
+                                        "/ by zero");
                 }
-            } else if (n == 3) { // ifge
-                if (value->context_value.i >= 0) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
+                sp[-4].j = sp[-2].j == -1 ? 0 : sp[-4].j % sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(frem) {
+                sp[-2].f = fmodf(sp[-2].f, sp[-1].f);
+                sp--;
+            } NEXT;
+            CASE(drem) {
+                sp[-4].d = fmod(sp[-4].d, sp[-2].d);
+                sp -= 2;
+            } NEXT;
+            CASE(ineg) {
+                sp[-1].i = 0u - static_cast<uint32_t>(sp[-1].i);
+            } NEXT;
+            CASE(lneg) {
+                sp[-2].j = 0u - static_cast<uint64_t>(sp[-2].j);
+            } NEXT;
+            CASE(fneg) {
+                sp[-1].f = -sp[-1].f;
+            } NEXT;
+            CASE(dneg) {
+                sp[-2].d = -sp[-2].d;
+            } NEXT;
+            CASE(ishl) {
+                sp[-2].i = static_cast<uint32_t>(sp[-2].i) << (sp[-1].i & 31);
+                sp--;
+            } NEXT;
+            CASE(lshl) {
+                sp[-3].j = static_cast<uint64_t>(sp[-3].j) << (sp[-1].i & 63);
+                sp--;
+            } NEXT;
+            CASE(ishr) {
+                sp[-2].i >>= sp[-1].i & 31;
+                sp--;
+            } NEXT;
+            CASE(lshr) {
+                sp[-3].j >>= sp[-1].i & 63;
+                sp--;
+            } NEXT;
+            CASE(iushr) {
+                sp[-2].i = static_cast<uint32_t>(sp[-2].i) >> (sp[-1].i & 31);
+                sp--;
+            } NEXT;
+            CASE(lushr) {
+                sp[-3].j = static_cast<uint64_t>(sp[-3].j) >> (sp[-1].i & 63);
+                sp--;
+            } NEXT;
+            CASE(iand) {
+                sp[-2].i &= sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(land) {
+                sp[-4].j &= sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(ior) {
+                sp[-2].i |= sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(lor) {
+                sp[-4].j |= sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(ixor) {
+                sp[-2].i ^= sp[-1].i;
+                sp--;
+            } NEXT;
+            CASE(lxor) {
+                sp[-4].j ^= sp[-2].j;
+                sp -= 2;
+            } NEXT;
+            CASE(iinc) {
+                lva[ins->a].i = static_cast<uint32_t>(lva[ins->a].i) + ins->b;
+            } NEXT;
+            CASE(i2l) {
+                sp[-1].j = sp[-1].i;
+                sp++;
+            } NEXT;
+            CASE(i2f) {
+                sp[-1].f = sp[-1].i;
+            } NEXT;
+            CASE(i2d) {
+                sp[-1].d = sp[-1].i;
+                sp++;
+            } NEXT;
+            CASE(l2i) {
+                sp[-2].i = static_cast<int32_t>(sp[-2].j);
+                sp--;
+            } NEXT;
+            CASE(l2f) {
+                sp[-2].f = sp[-2].j;
+                sp--;
+            } NEXT;
+            CASE(l2d) {
+                sp[-2].d = sp[-2].j;
+            } NEXT;
+            CASE(f2i) {
+                sp[-1].i = saturate<int32_t>(sp[-1].f);
+            } NEXT;
+            CASE(f2l) {
+                sp[-1].j = saturate<int64_t>(sp[-1].f);
+                sp++;
+            } NEXT;
+            CASE(f2d) {
+                sp[-1].d = sp[-1].f;
+                sp++;
+            } NEXT;
+            CASE(d2i) {
+                sp[-2].i = saturate<int32_t>(sp[-2].d);
+                sp--;
+            } NEXT;
+            CASE(d2l) {
+                sp[-2].j = saturate<int64_t>(sp[-2].d);
+            } NEXT;
+            CASE(d2f) {
+                sp[-2].f = sp[-2].d;
+                sp--;
+            } NEXT;
+            CASE(i2b) {
+                sp[-1].i = static_cast<int8_t>(sp[-1].i);
+            } NEXT;
+            CASE(i2c) {
+                sp[-1].i = static_cast<uint16_t>(sp[-1].i);
+            } NEXT;
+            CASE(i2s) {
+                sp[-1].i = static_cast<int16_t>(sp[-1].i);
+            } NEXT;
+            CASE(lcmp) {
+                sp[-4].i = (sp[-4].j > sp[-2].j) - (sp[-4].j < sp[-2].j);
+                sp -= 3;
+            } NEXT;
+            CASE(fcmpl)
+            CASE(fcmpg) {
+                sp[-2].i = compare(sp[-2].f, sp[-1].f,
+                                   ins->opcode == op_fcmpg ? 1 : -1);
+                sp--;
+            } NEXT;
+            CASE(dcmpl)
+            CASE(dcmpg) {
+                sp[-4].i = compare(sp[-4].d, sp[-2].d,
+                                   ins->opcode == op_dcmpg ? 1 : -1);
+                sp -= 3;
+            } NEXT;
+            CASE(ifeq) {
+                BRANCH_IF((--sp)->i == 0);
+            } NEXT;
+            CASE(ifne) {
+                BRANCH_IF((--sp)->i != 0);
+            } NEXT;
+            CASE(iflt) {
+                BRANCH_IF((--sp)->i < 0);
+            } NEXT;
+            CASE(ifge) {
+                BRANCH_IF((--sp)->i >= 0);
+            } NEXT;
+            CASE(ifgt) {
+                BRANCH_IF((--sp)->i > 0);
+            } NEXT;
+            CASE(ifle) {
+                BRANCH_IF((--sp)->i <= 0);
+            } NEXT;
+            CASE(if_icmpeq) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i == sp[1].i);
+            } NEXT;
+            CASE(if_icmpne) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i != sp[1].i);
+            } NEXT;
+            CASE(if_icmplt) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i < sp[1].i);
+            } NEXT;
+            CASE(if_icmpge) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i >= sp[1].i);
+            } NEXT;
+            CASE(if_icmpgt) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i > sp[1].i);
+            } NEXT;
+            CASE(if_icmple) {
+                sp -= 2;
+                BRANCH_IF(sp[0].i <= sp[1].i);
+            } NEXT;
+            CASE(if_acmpeq) {
+                sp -= 2;
+                BRANCH_IF(sp[0].ref == sp[1].ref);
+            } NEXT;
+            CASE(if_acmpne) {
+                sp -= 2;
+                BRANCH_IF(sp[0].ref != sp[1].ref);
+            } NEXT;
+            CASE(ifnull) {
+                BRANCH_IF((--sp)->ref == nullptr);
+            } NEXT;
+            CASE(ifnonnull) {
+                BRANCH_IF((--sp)->ref != nullptr);
+            } NEXT;
+            CASE(goto) {
+                BRANCH();
+            } NEXT;
+            CASE(jsr) {
+                // the return address is the index of the next instruction
+                (sp++)->i = pc;
+                pc        = ins->target;
+            } NEXT;
+            CASE(ret) {
+                pc = lva[ins->a].i;
+            } NEXT;
+            CASE(tableswitch) {
+                auto table  = ins->ref.table;
+                long offset = static_cast<long>((--sp)->i) - table->low;
+                if (offset < 0 || offset >= table->targets.size()) {
+                    offset = table->targets.size();
+                    pc     = table->default_target;
                 } else {
-                    byte++;
+                    pc = table->targets[offset];
                 }
-            } else if (n == 4) { // ifgt
-                if (value->context_value.i > 0) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
+                PROFILE(cases[offset]++);
+            } NEXT;
+            CASE(lookupswitch) {
+                auto table = ins->ref.table;
+                int key    = (--sp)->i;
+                // keys are sorted in increasing order by the compiler
+                auto found = std::lower_bound(table->keys.begin(),
+                                              table->keys.end(), key);
+                long match = found - table->keys.begin();
+                if (found != table->keys.end() && *found == key) {
+                    pc = table->targets[match];
                 } else {
-                    byte++;
+                    match = table->keys.size();
+                    pc    = table->default_target;
                 }
-            } else if (n == 5) { // ifle
-                if (value->context_value.i <= 0) {
-                    auto branchbyte1 = *(byte + 1);
-                    auto branchbyte2 = *(byte + 2);
-                    auto offset      = (branchbyte1 << 8) | branchbyte2;
-                    byte             = byte + offset;
-                    byte--;
-                } else {
-                    byte++;
+                PROFILE(cases[match]++);
+            } NEXT;
+            CASE(ireturn)
+            CASE(freturn)
+            CASE(areturn) {
+                result       = sp[-1];
+                result_slots = 1;
+            }
+                goto method_exit;
+            CASE(lreturn)
+            CASE(dreturn) {
+                result       = sp[-2];
+                result_slots = 2;
+            }
+                goto method_exit;
+            CASE(return) {
+                result_slots = 0;
+            }
+                goto method_exit;
+            // a field takes one slot even when its value takes two on the
+            // operand stack
+            CASE(getstatic) {
+                auto field           = ins->ref.field;
+                ins->ref.static_slot = staticField(*field);
+                ins->b               = field->slots;
+                quicken(op_getstatic_quick);
+            }
+            CASE(getstatic_quick) {
+                *sp = *ins->ref.static_slot;
+                sp += ins->b;
+            } NEXT;
+            CASE(putstatic) {
+                auto field           = ins->ref.field;
+                ins->ref.static_slot = staticField(*field);
+                ins->b               = field->slots;
+                quicken(op_putstatic_quick);
+            }
+            CASE(putstatic_quick) {
+                sp -= ins->b;
+                *ins->ref.static_slot = *sp;
+            } NEXT;
+            CASE(getfield) {
+                auto field = ins->ref.field;
+                ins->a     = linkField(*field);
+                ins->b     = field->slots;
+                quicken(op_getfield_quick);
+            }
+            CASE(getfield_quick) {
+                sp[-1] = checkNull(sp[-1].ref)->fields[ins->a];
+                sp += ins->b - 1;
+            } NEXT;
+            CASE(putfield) {
+                auto field = ins->ref.field;
+                ins->a     = linkField(*field);
+                ins->b     = field->slots;
+                quicken(op_putfield_quick);
+            }
+            CASE(putfield_quick) {
+                sp -= ins->b + 1;
+                checkNull(sp[0].ref)->fields[ins->a] = sp[1];
+            } NEXT;
+            CASE(invokestatic)
+            CASE(invokespecial) {
+                auto callee = invoke(*ins, sp, frame);
+                if (callee != nullptr) {
+                    ins->ref.callee = callee->method->baseline;
+                    quicken(ins->opcode == op_invokestatic
+                                ? op_invokestatic_quick
+                                : op_invoke_quick);
+                    CALL(callee);
                 }
-            }
-        }
-
-        break;
-        case 0xc6: // ifnull
-        case 0xc7: // ifnonnull
-        {
-            auto pc    = byte - 1;
-            auto index = *(byte)-0xc6;
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-            int offset       = (branchbyte1 << 8) | branchbyte2;
-
-            if (index == 0) {
-                if (value.isNull) {
-                    byte = pc + offset;
+            } NEXT;
+            // receiver of an inlined call, below the ins->a slots of the
+            // call on the operand stack
+            CASE(nullcheck) {
+                checkNull(sp[-ins->a].ref);
+            } NEXT;
+            // receiver of a call inlined for the only class the call saw.
+            // Another one invalidates the version running and the frame
+            // makes the call in the baseline version
+            CASE(guard_class) {
+                auto receiver = sp[-ins->a].ref;
+                if (receiver == nullptr ||
+                    receiver->runtime_class != ins->ref.runtime_class) {
+                    invalidate(dm->baseline,
+                               "guard failed at bci " +
+                                   std::to_string(ins->bci) + ", receiver " +
+                                   (receiver == nullptr
+                                        ? std::string("null")
+                                        : receiver->class_name) +
+                                   " is not " + ins->ref.runtime_class->name);
+                    REPLACE_FRAME(deoptimize(frame, sp, pc - 1));
                 }
-            } else {
-                if (!value.isNull) {
-                    byte = pc + offset;
+            } NEXT;
+            // set from outside the threaded code, so entered with the values
+            // of the instruction it replaced cached
+            CASE(deoptimize) {
+                SPILL(ins->cache);
+                REPLACE_FRAME(deoptimize(frame, sp, pc - 1));
+            } NEXT;
+            CASE(invokestatic_quick) {
+                sp -= ins->ref.callee->arg_slots;
+                CALL(enter(frame, ins->ref.callee, sp));
+            } NEXT;
+            CASE(invoke_quick) {
+                sp -= ins->ref.callee->arg_slots;
+                PROFILE(types.record(checkNull(sp[0].ref)));
+                CALL(enter(frame, ins->ref.callee, sp));
+            } NEXT;
+            // the method of invokevirtual and invokeinterface depends on the
+            // class of the receiver, ins->a is the number of slots of the
+            // arguments. Both share the inline cached quick forms
+            CASE(invokevirtual)
+            CASE(invokeinterface) {
+                auto ref = ins->ref.method;
+                if (ref->kind != MethodRef::User) {
+                    invoke(*ins, sp, frame);
+                    NEXT;
                 }
-            }
-        } break;
-        case 0x84: // iinc
-        {
-            int index   = -1;
-            auto index1 = *(++byte);
-            if (wide) {
-                auto index2 = *(++byte);
-                index       = (index1 << 8) | index2;
-            } else {
-                index = index1;
-            }
-
-            int constant   = 0;
-            char constant1 = *(++byte);
-            if (wide) {
-                char constant2 = *(++byte);
-                constant       = (constant1 << 8) | constant2;
-                wide           = false;
-            } else {
-                constant = constant1;
-            }
-            sf_local->lva[index]->context_value.i += constant;
-
-        } break;
-        case 0xc1: // instanceof
-        {
-            // I'm not sure about if this will work or not;
-            auto indexbyte1    = *(++byte);
-            auto indexbyte2    = *(++byte);
-            unsigned int index = (indexbyte1 << 8) + indexbyte2;
-            auto objref        = sf_local->operand_stack.top();
-            int zero           = 0;
-            int one            = 1;
-            sf_local->operand_stack.pop();
-            if (objref->isNull) {
-                // push 0 into the stack
-                sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                    new ContextEntry("", I, reinterpret_cast<void *>(&zero))));
-            } else {
-                if (objref->class_name ==
-                    cp.at(class_name)->getNameByIndex(index)) {
-                    sf_local->operand_stack.push(
-                        std::shared_ptr<ContextEntry>(new ContextEntry(
-                            "", I, reinterpret_cast<void *>(&one))));
+                auto cache =
+                    newInlineCache(*ref, ins->opcode == op_invokeinterface);
+                ins->a = ref->arg_slots + 1;
+                sp -= ins->a;
+                auto receiver = checkNull(sp[0].ref);
+                PROFILE(types.record(receiver));
+                auto target   = devirtualize(*ins, cache);
+                if (target != nullptr) {
+                    ins->ref.callee = target;
+                    quicken(op_invoke_quick);
                 } else {
-                    sf_local->operand_stack.push(
-                        std::shared_ptr<ContextEntry>(new ContextEntry(
-                            "", I, reinterpret_cast<void *>(&zero))));
-                }
-            }
-        } break;
-        case 0x1a: // iload_0
-        case 0x1b: // iload_1
-        case 0x1c: // iload_2
-        case 0x1d: // iload_3
-        {
-            auto index = *(byte)-0x1a;
-
-            std::shared_ptr<ContextEntry> value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-        } break;
-        case 0x74: // ineg
-        {
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            if (value->entry_type == B) {
-                value->entry_type      = I;
-                value->context_value.i = (int)value->context_value.b;
-            }
-
-            int i = -1;
-            auto result =
-                *value * ContextEntry("", I, reinterpret_cast<void *>(&i));
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x80: // ior
-        case 0x81: // lor
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto result = value1 || value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-
-        } break;
-        case 0x70: // irem
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto result = value1.context_value.i % value2.context_value.i;
-
-            if (value1.context_value.i == 0) {
-                throw std::runtime_error("ArithmeticException");
-            }
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0xac: // ireturn
-        case 0xad: // lreturn
-        {
-            auto retval = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            while (!sf_local->operand_stack.empty()) {
-                sf_local->operand_stack.pop();
-            }
-
-            return retval;
-        } break;
-        case 0x78: // ishl
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            int shift        = value1.context_value.i;
-            short int value2 = sf_local->operand_stack.top()->context_value.s;
-            sf_local->operand_stack.pop();
-
-            auto result = value2 << shift;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0x7a: // ishr
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            int shift  = value1.context_value.i;
-            int value2 = sf_local->operand_stack.top()->context_value.s;
-            sf_local->operand_stack.pop();
-
-            auto result = value2 >> shift;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0xb8: // invokestatic
-        case 0xb7: // invokespecial
-        case 0xb6: // invokevirtual
-        {
-            auto old_lva       = sf_local->lva;
-            auto invokeType    = *(byte);
-            auto indexbyte1    = *(++byte);
-            auto indexbyte2    = *(++byte);
-            unsigned int index = (indexbyte1 << 8) | indexbyte2;
-            auto class_name_at_cp =
-                cp.at(class_name)->getClassNameFromMethodByIndex(index);
-            std::shared_ptr<ContextEntry> exec_return;
-            auto cm_index    = cp.at(class_name)->getMethodNameIndex(index);
-            auto method_name = cp.at(class_name)->getMethodNameByIndex(index);
-
-            if (class_name_at_cp.find("java/lang/StringBuilder", 0) ==
-                std::string::npos) {
-                if (cm_index == -1) {
-                    // init method from java object no need to call
-                    break;
+                    dm->caches.push_back(cache);
+                    ins->ref.cache = &dm->caches.back();
+                    target         = cacheMiss(receiver);
                 }
-                auto cmval = *cm;
-                cmval.find(class_name);
-                if (cm_index == -2) {
-                    auto name_and_type =
-                        cp.at(class_name)->getNameAndTypeByIndex(index);
-                    auto found = name_and_type.find("println");
-                    if (found != std::string::npos) {
-                        auto args = std::string(
-                            name_and_type.begin() +
-                                name_and_type.find_first_of('(') + 1,
-                            name_and_type.begin() +
-                                name_and_type.find_first_of(')'));
-                        auto args_size = countArgs(args);
-                        std::vector<std::shared_ptr<ContextEntry>> prints(
-                            args_size);
-                        if (args_size > 0) {
-                            for (auto &print : prints) {
-                                print = sf_local->operand_stack.top();
-                                sf_local->operand_stack.pop();
-                            }
-                            for (auto it = prints.end() - 1;
-                                 it >= prints.begin(); it--) {
-                                auto type = TypeMap.find(args)->second;
-                                if (args != "Ljava/lang/String;") {
-                                    it->get()->entry_type = type;
-                                }
-                                it->get()->PrintValue();
-                                std::cout << std::endl;
-                            }
-                        } else {
-                            std::cout << std::endl;
-                        }
-                    }
-                } else if (cm_index > 0) {
-                    auto old_class_name = class_name;
-                    class_name          = class_name_at_cp;
-
-                    auto args_length =
-                        getArgsLen(class_name_at_cp, method_name);
-                    auto a = cm->at(class_name_at_cp);
-                    std::vector<unsigned char> code;
-                    if (a.find(method_name) != a.end()) {
-                        code = a.at(method_name).attributes[0].code;
-                    } else {
-                        a          = cm->at(super_class[class_name_at_cp]);
-                        class_name = super_class[class_name_at_cp];
-                        code       = a.at(method_name).attributes[0].code;
-                    }
-                    std::vector<std::shared_ptr<ContextEntry>> lva;
-                    for (int i = 0; i < args_length; i++) {
-                        lva.push_back(sf_local->operand_stack.top());
-                        if (category(
-                                sf_local->operand_stack.top()->entry_type) ==
-                            2) {
-                            lva.push_back(sf_local->operand_stack.top());
-                        }
-                        sf_local->operand_stack.pop();
+                CALL(enter(frame, target, sp));
+            } NEXT;
+            CASE(invokevirtual_mono) {
+                sp -= ins->a;
+                auto receiver = checkNull(sp[0].ref);
+                PROFILE(types.record(receiver));
+                auto cache    = ins->ref.cache;
+                CALL(enter(frame,
+                           receiver->runtime_class == cache->classes[0]
+                               ? cache->targets[0]
+                               : cacheMiss(receiver),
+                           sp));
+            } NEXT;
+            CASE(invokevirtual_poly) {
+                sp -= ins->a;
+                auto receiver         = checkNull(sp[0].ref);
+                PROFILE(types.record(receiver));
+                auto cache            = ins->ref.cache;
+                DecodedMethod *target = nullptr;
+                for (int k = 0; k < cache->size; k++) {
+                    if (cache->classes[k] == receiver->runtime_class) {
+                        target = cache->targets[k];
+                        break;
                     }
-                    if (invokeType != 0xb8) {
-                        // case static we dont need to get reference from stack
-                        auto objectRef = sf_local->operand_stack.top();
-                        lva.push_back(objectRef);
-                        sf_local->operand_stack.pop(); // object ref
-                    }
-                    std::reverse(lva.begin(), lva.end());
-                    auto old_os             = sf_local->operand_stack;
-                    exec_return             = Exec(code, &lva);
-                    class_name              = old_class_name;
-                    sf_local->operand_stack = old_os;
                 }
-                if (exec_return != nullptr) {
-                    if (exec_return->isReturnAddress()) {
-                        byte = bytecode.begin() + exec_return->context_value.i;
-                    } else {
-                        sf_local->operand_stack.push(exec_return);
-                    }
+                if (target == nullptr) {
+                    target = cacheMiss(receiver);
                 }
-            } else {
-                if (method_name == "<init>")
-                    str = "";
-                else if (method_name == "append") {
-                    auto str_to_append =
-                        sf_local->operand_stack.top()->string_instance;
-                    sf_local->operand_stack.pop();
-                    str += str_to_append;
-                    sf_local->operand_stack.push(std::make_shared<ContextEntry>(
-                        "", R, reinterpret_cast<void *>(&str)));
-                } else if (method_name == "println") {
-                    std::cout << sf_local->operand_stack.top()->string_instance
-                              << std::endl;
-                    sf_local->operand_stack.pop();
+                CALL(enter(frame, target, sp));
+            } NEXT;
+            CASE(invokevirtual_mega) {
+                sp -= ins->a;
+                auto receiver = checkNull(sp[0].ref);
+                PROFILE(types.record(receiver));
+                CALL(enter(frame, selectVirtual(receiver, *ins->ref.cache),
+                           sp));
+            } NEXT;
+            CASE(athrow) {
+                auto object = checkNull(sp[-1].ref);
+                throw JavaException(object->class_name, object->string_instance,
+                                    object);
+            } NEXT;
+            CASE(new) {
+                auto object = newObject(*ins->ref.class_name);
+                // library classes have no RuntimeClass to quicken with
+                if (object->runtime_class != nullptr) {
+                    ins->ref.runtime_class = object->runtime_class;
+                    quicken(op_new_quick);
                 }
-            }
-        } break;
-        case 0x3b: // istore_0
-        case 0x3c: // istore_1
-        case 0x3d: // istore_2
-        case 0x3e: // istore_3
-        {
-            auto index = *(byte)-0x3b;
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto lva_size = sf_local->lva.size();
-            if (index > lva_size) {
-                while (index > lva_size) {
-                    sf_local->lva.push_back(std::make_shared<ContextEntry>());
-                    lva_size = sf_local->lva.size();
+                (sp++)->ref = object;
+            } NEXT;
+            CASE(new_quick) {
+                auto runtime_class = ins->ref.runtime_class;
+                (sp++)->ref =
+                    heap->allocateObject(runtime_class, runtime_class->name);
+            } NEXT;
+            CASE(newarray) {
+                sp[-1].ref =
+                    heap->allocateArray("", ATypeMap.at(ins->a), sp[-1].i);
+            } NEXT;
+            CASE(anewarray) {
+                sp[-1].ref =
+                    heap->allocateArray(*ins->ref.class_name, L, sp[-1].i);
+            } NEXT;
+            CASE(multianewarray) {
+                sp -= ins->a;
+                for (int dimension = 0; dimension < ins->a; dimension++) {
+                    if (sp[dimension].i < 0) {
+                        throw JavaException(
+                            "java/lang/NegativeArraySizeException",
+                            std::to_string(sp[dimension].i));
+                    }
                 }
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else {
-                sf_local->lva[index] = value;
-            }
-        } break;
-        case 0x7c: // iushr
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top()->context_value.i & 0x1f;
-            sf_local->operand_stack.pop();
-
-            auto result = value1->context_value.i >> value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0x82: // ixor
-        case 0x83: // lxor
-        {
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto result = value1 ^ value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0xa8: // jsr
-        {
-            int index = (++byte) - bytecode.begin();
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(index))));
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-
-            auto offset         = (branchbyte1 << 8) | branchbyte2;
-            int nextInstruction = ++byte - bytecode.begin();
-            auto ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                "", I, reinterpret_cast<void *>(nextInstruction)));
-            ce->setAsRetAddress();
-            sf_local->operand_stack.push(ce);
-            byte += offset;
-
-        } break;
-        case 0xc9: // jsr_w
-        {
-            int index = (++byte) - bytecode.begin();
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(index))));
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-            auto branchbyte3 = *(++byte);
-            auto branchbyte4 = *(++byte);
-
-            auto offset = (branchbyte1 << 24) | (branchbyte2 << 16) |
-                          (branchbyte3 << 8) | branchbyte4;
-            int nextInstruction = ++byte - bytecode.begin();
-            auto ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                "", I, reinterpret_cast<void *>(nextInstruction)));
-            ce->setAsRetAddress();
-            sf_local->operand_stack.push(ce);
-            byte += offset;
-        } break;
-        case 0x94: // lcmp
-        {
-            int i       = 1;
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto entry = std::shared_ptr<ContextEntry>(
-                new ContextEntry("", I, reinterpret_cast<void *>(&i)));
-            if (value1->context_value.j > value2->context_value.j) {
-                entry->context_value.i = 1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.j < value2->context_value.j) {
-                entry->context_value.i = -1;
-                sf_local->operand_stack.push(entry);
-            } else if (value1->context_value.j == value2->context_value.j) {
-                entry->context_value.i = 0;
-                sf_local->operand_stack.push(entry);
-            }
-        } break;
-        case 0x9: // lconst_0
-        case 0xa: // lconst_1
-        {
-            long e = (long)*byte - 0x9;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", J, reinterpret_cast<void *>(&e))));
-
-        } break;
-        case 0x12: // ldc
-        {
-            auto index       = *(++byte);
-            auto intfloatref = cp.at(class_name)->getValueByIndex(index);
-            std::shared_ptr<ContextEntry> ce;
-            if (intfloatref.t == R) {
-                ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                    "java/lang/String", R,
-                    reinterpret_cast<void *>(&intfloatref.str_value)));
-            } else {
-                ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                    class_name, intfloatref.t,
-                    reinterpret_cast<void *>(&intfloatref.val)));
-            }
-            sf_local->operand_stack.push(ce);
-        } break;
-        case 0x13: // ldc_w
-        {
-            auto branchbyte1 = *(++byte);
-            auto branchbyte2 = *(++byte);
-            auto index       = (branchbyte1 << 8) | branchbyte2;
-            auto intfloatref = cp.at(class_name)->getValueByIndex(index);
-            std::shared_ptr<ContextEntry> ce;
-            if (intfloatref.t == R) {
-                ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                    "", R, reinterpret_cast<void *>(&intfloatref.str_value)));
-            } else {
-                ce = std::shared_ptr<ContextEntry>(new ContextEntry(
-                    "", intfloatref.t,
-                    reinterpret_cast<void *>(&intfloatref.val)));
-            }
-            sf_local->operand_stack.push(ce);
-        } break;
-        case 0x14: // ldc2_w
-        {
-            auto index1   = *(++byte);
-            auto index2   = *(++byte);
-            auto index    = (index1 << 8) | index2;
-            DoubleLong dl = cp.at(class_name)->getNumberByIndex(index);
-            auto cte      = std::shared_ptr<ContextEntry>(
-                new ContextEntry("", dl.t, reinterpret_cast<void *>(&dl.val)));
-            sf_local->operand_stack.push(cte);
-        } break;
-        case 0x1e: // lload_0
-        case 0x1f: // lload_1
-        case 0x20: // lload_2
-        case 0x21: // lload_3
-        {
-            auto index = *(byte)-0x1e;
-            auto value = sf_local->lva.at(index);
-            sf_local->operand_stack.push(value);
-
-        } break;
-        case 0x75: // lneg
-        {
-            auto value = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            long j      = -1 * value.context_value.j;
-            auto result = ContextEntry("", J, reinterpret_cast<void *>(&j));
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry(std::move(result))));
-        } break;
-        case 0x71: // lrem
-        {
-            auto value2 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-
-            auto result = value1.context_value.j % value2.context_value.j;
-
-            if (value1.context_value.j == 0) {
-                throw std::runtime_error("ArithmeticException");
-            }
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", J, reinterpret_cast<void *>(&result))));
-
-        } break;
-
-        case 0x79: // lshl
-        {
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            int sll = value2->context_value.j;
-
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            long int operand = static_cast<long int>(value1.context_value.j);
-
-            auto result = value1.context_value.j << sll;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", J, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0x7b: // lshr
-        {
-            auto value2 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            int srl = value2->context_value.j;
-
-            auto value1 = *sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            long int operand = static_cast<long int>(value1.context_value.j);
-
-            auto result = value1.context_value.j >> srl;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", J, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0x3f: // lstore_0
-        case 0x40: // lstore_1
-        case 0x41: // lstore_2
-        case 0x42: // lstore_3
-        {
-            auto index = *(byte)-0x3f;
-            auto value = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto lva_size = sf_local->lva.size();
-            if (index > lva_size) {
-                while (index > lva_size) {
-                    sf_local->lva.push_back(std::make_shared<ContextEntry>());
-                    lva_size = sf_local->lva.size();
+                sp->ref = heap->allocateMultiArray(*ins->ref.class_name, sp,
+                                                   ins->a);
+                sp++;
+            } NEXT;
+            CASE(arraylength) {
+                sp[-1].i = checkNull(sp[-1].ref)->arrayLength();
+            } NEXT;
+            CASE(checkcast) {
+                auto object      = sp[-1].ref;
+                auto &class_name = *ins->ref.class_name;
+                PROFILE(types.record(object));
+                if (object != nullptr && !isInstance(object, class_name)) {
+                    throw JavaException("java/lang/ClassCastException",
+                                        object->class_name +
+                                            " cannot be cast to " +
+                                            class_name);
                 }
-            }
-            if (index == sf_local->lva.size()) {
-                sf_local->lva.push_back(value);
-            } else {
-                sf_local->lva[index] = value;
-            }
-        } break;
-        case 0x7d: // lushr
-        {
-            auto value1 = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto value2 = sf_local->operand_stack.top()->context_value.i & 0x3f;
-            sf_local->operand_stack.pop();
-
-            auto result = value1->context_value.i >> value2;
-            sf_local->operand_stack.push(std::shared_ptr<ContextEntry>(
-                new ContextEntry("", J, reinterpret_cast<void *>(&result))));
-        } break;
-        case 0xc5: // multianewarray
-        {
-            auto indexbyte1 = *(++byte);
-            auto indexbyte2 = *(++byte);
-            int index       = (indexbyte1 << 8) | indexbyte2;
-            auto dimensions = *(++byte);
-            auto array_desc = cp.at(class_name)->getNameByIndex(index);
-            std::vector<unsigned int> counters;
-            for (auto i = 0; i < dimensions; i++) {
-                counters.push_back(
-                    sf_local->operand_stack.top()->context_value.i);
-                sf_local->operand_stack.pop();
-            }
-            auto type_index  = array_desc.find_first_not_of('[');
-            std::string type = {array_desc.at(type_index)};
-            std::shared_ptr<ContextEntry> array_operator = nullptr;
-            array_operator =
-                std::make_shared<ContextEntry>("", TypeMap.at(type), 1);
-            std::shared_ptr<ContextEntry> init = array_operator;
-            for (auto i = 0; i < dimensions - 1; i++) {
-                auto newarray =
-                    std::make_shared<ContextEntry>("", TypeMap.at(type), 1);
-                array_operator->addToArray(0, newarray);
-                array_operator = std::move(array_operator->arrayRef[0]);
-            }
-            sf_local->operand_stack.push(init);
-        } break;
-        case 0xbc: // newarray
-        {
-            auto atype = static_cast<int>(*(++byte));
-            auto count = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            std::shared_ptr<ContextEntry> ce(new ContextEntry(
-                "", ATypeMap.at(atype), count->context_value.b));
-            sf_local->operand_stack.push(ce);
-        } break;
-        case 0x0: // nop
+            } NEXT;
+            CASE(instanceof) {
+                auto object      = sp[-1].ref;
+                auto &class_name = *ins->ref.class_name;
+                PROFILE(types.record(object));
+                sp[-1].i = object != nullptr && isInstance(object, class_name);
+            } NEXT;
+            CASE(monitorenter)
+            CASE(monitorexit) {
+                // single threaded, only the null check is left
+                checkNull((--sp)->ref);
+            } NEXT;
+#ifdef HAS_COMPUTED_GOTO
+            // short forms and prefixes rewritten by BytecodeDecoder, opcodes
+            // without a handler yet and the ones of traces, which only run
+            // compiled, they all land on the error below
+            LABEL(iload_0) LABEL(iload_1) LABEL(iload_2) LABEL(iload_3)
+            LABEL(lload_0) LABEL(lload_1) LABEL(lload_2) LABEL(lload_3)
+            LABEL(fload_0) LABEL(fload_1) LABEL(fload_2) LABEL(fload_3)
+            LABEL(dload_0) LABEL(dload_1) LABEL(dload_2) LABEL(dload_3)
+            LABEL(aload_0) LABEL(aload_1) LABEL(aload_2) LABEL(aload_3)
+            LABEL(istore_0) LABEL(istore_1) LABEL(istore_2) LABEL(istore_3)
+            LABEL(lstore_0) LABEL(lstore_1) LABEL(lstore_2) LABEL(lstore_3)
+            LABEL(fstore_0) LABEL(fstore_1) LABEL(fstore_2) LABEL(fstore_3)
+            LABEL(dstore_0) LABEL(dstore_1) LABEL(dstore_2) LABEL(dstore_3)
+            LABEL(astore_0) LABEL(astore_1) LABEL(astore_2) LABEL(astore_3)
+            LABEL(ldc_w) LABEL(goto_w) LABEL(jsr_w) LABEL(wide)
+            LABEL(invokedynamic) LABEL(trace_enter) LABEL(trace_return)
+            LABEL(trace_exit)
+            LABEL(unknown)
+#endif
+            default:
+                throw std::runtime_error("Instruction " +
+                                         std::string(opcodeName(ins->opcode)) +
+                                         " not implemented");
+            }
+            continue;
+        method_exit:
+            if (frame->caller == nullptr) {
+                return result;
+            }
+            frame = frame->caller;
+            dm    = frame->method;
+            lva   = frame->lva;
+            sp    = frame->sp;
+            pc    = frame->pc;
+            std::copy(&result, &result + (result_slots > 0), sp);
+            sp += result_slots;
+#ifdef HAS_COMPUTED_GOTO
+            if (Threaded) {
+                DISPATCH();
+            }
+#endif
+        }
+#ifdef HAS_JIT
+        // runs the compiled code from the instruction being dispatched up
+        // to one it leaves to the interpreter, which is run from its handler.
+        // Compiled code and traces take the operand stack with nothing
+        // cached
+        if (Threaded) {
+        L_jit:
+            SPILL(ins->cache);
+            auto exit = dm->compiled(lva, sp, pc - 1);
+            sp        = exit.sp;
+            pc        = exit.pc;
+            if (pc >= dm->code.size()) {
+                goto end_of_code;
+            }
+            ins = &dm->code[pc++];
+            FILL(ins->cache);
+            goto *unfused(ins);
+        // records the instruction being dispatched and runs it, from the
+        // trace that starts there if recording completed
+        L_record:
+            recordStep(frame, pc - 1);
+            if (recorder.recording()) {
+                goto *unfused(ins);
+            }
+            goto *ins->handler;
+        // runs the trace entered at the instruction being dispatched, then
+        // the instruction it left at from its handler
+        L_trace:
+            SPILL(ins->cache);
+            REPLACE_FRAME(runTrace(frame, sp, pc - 1));
+            ins = &dm->code[pc++];
+            goto *unfused(ins);
+        }
+#endif
+#ifdef HAS_COMPUTED_GOTO
+        if (Threaded) {
+        // counts the instruction being dispatched and runs it, on its own
+        L_count:
+            dm->dispatches[pc - 1]++;
+            goto *unfused(ins);
+        // superinstructions, see Superinstructions. Each one runs its
+        // instructions as their handlers do, FUSED moving ins and pc on to
+        // the next one as a dispatch would, and dispatches the instruction
+        // after the last one
+        L_super_iload_iload:
+            sp[0] = lva[ins->a];
+            FUSED();
+            sp[1] = lva[ins->a];
+            sp += 2;
+            DISPATCH();
+        L_super_iload_iload_iadd_istore: {
+            int32_t left = lva[ins->a].i;
+            FUSED();
+            int32_t right = lva[ins->a].i;
+            FUSED();
+            FUSED();
+            lva[ins->a].i = static_cast<uint32_t>(left) + right;
+            DISPATCH();
+        }
+        L_super_iload_iload_if_icmpge: {
+            int32_t left = lva[ins->a].i;
+            FUSED();
+            int32_t right = lva[ins->a].i;
+            FUSED();
+            BRANCH_IF(left >= right);
+            DISPATCH();
+        }
+        L_super_iload_iconst_if_icmpge: {
+            int32_t left = lva[ins->a].i;
+            FUSED();
+            int32_t right = ins->a;
+            FUSED();
+            BRANCH_IF(left >= right);
+            DISPATCH();
+        }
+        L_super_iload_ldc_if_icmpge: {
+            int32_t left = lva[ins->a].i;
+            FUSED();
+            if (ins->opcode != op_ldc_quick) {
+                (sp++)->i = left;
+                goto *ins->handler; // resolves the constant first
+            }
+            int32_t right = ins->ref.value.i;
+            FUSED();
+            BRANCH_IF(left >= right);
+            DISPATCH();
+        }
+        L_super_iinc_goto:
+            lva[ins->a].i = static_cast<uint32_t>(lva[ins->a].i) + ins->b;
+            FUSED();
+            BRANCH();
+            DISPATCH();
+        L_super_iadd_istore: {
+            int32_t sum = static_cast<uint32_t>(sp[-2].i) + sp[-1].i;
+            sp -= 2;
+            FUSED();
+            lva[ins->a].i = sum;
+            DISPATCH();
+        }
+        L_super_aload_iload_iaload: {
+            auto array = lva[ins->a].ref;
+            FUSED();
+            int32_t index = lva[ins->a].i;
+            FUSED();
+            (sp++)->i = checkNull(array)->at<int32_t>(index);
+            DISPATCH();
+        }
+        L_super_aload_getfield:
+            *sp++ = lva[ins->a];
+            FUSED();
+            if (ins->opcode != op_getfield_quick) {
+                goto *ins->handler; // links the field first
+            }
+            sp[-1] = checkNull(sp[-1].ref)->fields[ins->a];
+            sp += ins->b - 1;
+            DISPATCH();
+        // cached handlers, see StackCache. They run their instruction as
+        // its own handler does, on the values in tos and nos
+        CACHED_PUSH_NARROW(load, tos = lva[ins->a]);
+        CACHED_PUSH_NARROW(iconst, tos.i = ins->a);
+        CACHED_PUSH_NARROW(fconst, tos.f = ins->a);
+        CACHED_PUSH_NARROW(aconst_null, tos.ref = nullptr);
+        CACHED_PUSH_WIDE(load2, tos = lva[ins->a]);
+        CACHED_PUSH_WIDE(lconst, tos.j = ins->a);
+        CACHED_PUSH_WIDE(dconst, tos.d = ins->a);
+        CACHED_POP_NARROW(store, lva[ins->a] = tos);
+        CACHED_POP_NARROW(pop, (void)0);
+        CACHED_POP_WIDE(store2, lva[ins->a] = tos);
+        CACHED_BINARY_NARROW(iadd,
+                             tos.i = static_cast<uint32_t>(nos.i) + tos.i);
+        CACHED_BINARY_NARROW(isub,
+                             tos.i = static_cast<uint32_t>(nos.i) - tos.i);
+        CACHED_BINARY_NARROW(imul,
+                             tos.i = static_cast<uint32_t>(nos.i) * tos.i);
+        CACHED_BINARY_NARROW(iand, tos.i = nos.i & tos.i);
+        CACHED_BINARY_NARROW(ior, tos.i = nos.i | tos.i);
+        CACHED_BINARY_NARROW(ixor, tos.i = nos.i ^ tos.i);
+        CACHED_BINARY_NARROW(ishl,
+                             tos.i = static_cast<uint32_t>(nos.i)
+                                     << (tos.i & 31));
+        CACHED_BINARY_NARROW(ishr, tos.i = nos.i >> (tos.i & 31));
+        CACHED_BINARY_NARROW(iushr,
+                             tos.i = static_cast<uint32_t>(nos.i) >>
+                                     (tos.i & 31));
+        CACHED_BINARY_NARROW(fadd, tos.f = nos.f + tos.f);
+        CACHED_BINARY_NARROW(fsub, tos.f = nos.f - tos.f);
+        CACHED_BINARY_NARROW(fmul, tos.f = nos.f * tos.f);
+        CACHED_BINARY_NARROW(fdiv, tos.f = nos.f / tos.f);
+        CACHED_BINARY_NARROW(fcmp,
+                             tos.i = compare(nos.f, tos.f,
+                                             ins->opcode == op_fcmpg ? 1
+                                                                     : -1));
+        CACHED_BINARY_NARROW(iaload,
+                             tos.i = checkNull(nos.ref)->at<int32_t>(tos.i));
+        CACHED_BINARY_NARROW(faload,
+                             tos.f = checkNull(nos.ref)->at<float>(tos.i));
+        CACHED_BINARY_WIDE(ladd, tos.j = static_cast<uint64_t>(nos.j) + tos.j);
+        CACHED_BINARY_WIDE(lsub, tos.j = static_cast<uint64_t>(nos.j) - tos.j);
+        CACHED_BINARY_WIDE(lmul, tos.j = static_cast<uint64_t>(nos.j) * tos.j);
+        CACHED_BINARY_WIDE(land, tos.j = nos.j & tos.j);
+        CACHED_BINARY_WIDE(lor, tos.j = nos.j | tos.j);
+        CACHED_BINARY_WIDE(lxor, tos.j = nos.j ^ tos.j);
+        CACHED_BINARY_WIDE(dadd, tos.d = nos.d + tos.d);
+        CACHED_BINARY_WIDE(dsub, tos.d = nos.d - tos.d);
+        CACHED_BINARY_WIDE(dmul, tos.d = nos.d * tos.d);
+        CACHED_BINARY_WIDE(ddiv, tos.d = nos.d / tos.d);
+        CACHED_BINARY_WIDE(drem, tos.d = fmod(nos.d, tos.d));
+        CACHED_COMPARE_WIDE(lcmp, tos.i = (nos.j > tos.j) - (nos.j < tos.j));
+        CACHED_COMPARE_WIDE(dcmp,
+                            tos.i = compare(nos.d, tos.d,
+                                            ins->opcode == op_dcmpg ? 1 : -1));
+        CACHED_UNARY_NARROW(ineg, tos.i = 0u - static_cast<uint32_t>(tos.i));
+        CACHED_UNARY_NARROW(fneg, tos.f = -tos.f);
+        CACHED_UNARY_NARROW(i2f, tos.f = tos.i);
+        CACHED_UNARY_NARROW(f2i, tos.i = saturate<int32_t>(tos.f));
+        CACHED_UNARY_NARROW(i2b, tos.i = static_cast<int8_t>(tos.i));
+        CACHED_UNARY_NARROW(i2c, tos.i = static_cast<uint16_t>(tos.i));
+        CACHED_UNARY_NARROW(i2s, tos.i = static_cast<int16_t>(tos.i));
+        CACHED_UNARY_WIDE(lneg, tos.j = 0u - static_cast<uint64_t>(tos.j));
+        CACHED_UNARY_WIDE(dneg, tos.d = -tos.d);
+        CACHED_UNARY_WIDE(l2d, tos.d = tos.j);
+        CACHED_UNARY_WIDE(d2l, tos.j = saturate<int64_t>(tos.d));
+        CACHED_TO_WIDE(i2l, tos.j = tos.i);
+        CACHED_TO_WIDE(i2d, tos.d = tos.i);
+        CACHED_TO_WIDE(f2l, tos.j = saturate<int64_t>(tos.f));
+        CACHED_TO_WIDE(f2d, tos.d = tos.f);
+        CACHED_TO_NARROW(l2i, tos.i = static_cast<int32_t>(tos.j));
+        CACHED_TO_NARROW(l2f, tos.f = tos.j);
+        CACHED_TO_NARROW(d2i, tos.i = saturate<int32_t>(tos.d));
+        CACHED_TO_NARROW(d2f, tos.f = tos.d);
+        CACHED_BRANCH_NARROW(ifeq, tos.i == 0);
+        CACHED_BRANCH_NARROW(ifne, tos.i != 0);
+        CACHED_BRANCH_NARROW(iflt, tos.i < 0);
+        CACHED_BRANCH_NARROW(ifge, tos.i >= 0);
+        CACHED_BRANCH_NARROW(ifgt, tos.i > 0);
+        CACHED_BRANCH_NARROW(ifle, tos.i <= 0);
+        CACHED_BRANCH_NARROW(ifnull, tos.ref == nullptr);
+        CACHED_BRANCH_NARROW(ifnonnull, tos.ref != nullptr);
+        CACHED_BRANCH_BINARY(if_icmpeq, nos.i == tos.i);
+        CACHED_BRANCH_BINARY(if_icmpne, nos.i != tos.i);
+        CACHED_BRANCH_BINARY(if_icmplt, nos.i < tos.i);
+        CACHED_BRANCH_BINARY(if_icmpge, nos.i >= tos.i);
+        CACHED_BRANCH_BINARY(if_icmpgt, nos.i > tos.i);
+        CACHED_BRANCH_BINARY(if_icmple, nos.i <= tos.i);
+        CACHED_BRANCH_BINARY(if_acmpeq, nos.ref == tos.ref);
+        CACHED_BRANCH_BINARY(if_acmpne, nos.ref != tos.ref);
+        CACHED_ARRAY_STORE(iastore,
+                           checkNull(sp->ref)->at<int32_t>(nos.i) = tos.i);
+        CACHED_ARRAY_STORE(fastore,
+                           checkNull(sp->ref)->at<float>(nos.i) = tos.f);
+        CACHED_RETURN_NARROW(ireturn);
+        CACHED_RETURN_WIDE(lreturn);
+        // the handlers entered with values cached that their instruction
+        // expects in the operand stack
+        JVM_OPCODES(SPILL_ENTRY_narrow)
+        SPILL_ENTRY_narrow(unknown, 0)
+        JVM_QUICK_OPCODES(SPILL_ENTRY_narrow)
+        JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ENTRY_narrow)
+        JVM_OPCODES(SPILL_ENTRY_wide)
+        SPILL_ENTRY_wide(unknown, 0)
+        JVM_QUICK_OPCODES(SPILL_ENTRY_wide)
+        JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ENTRY_wide)
+        JVM_OPCODES(SPILL_ENTRY_narrow2)
+        SPILL_ENTRY_narrow2(unknown, 0)
+        JVM_QUICK_OPCODES(SPILL_ENTRY_narrow2)
+        JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ENTRY_narrow2)
+        JVM_OPCODES(SPILL_ENTRY_wide2)
+        SPILL_ENTRY_wide2(unknown, 0)
+        JVM_QUICK_OPCODES(SPILL_ENTRY_wide2)
+        JVM_SUPERINSTRUCTIONS(SUPER_SPILL_ENTRY_wide2)
+        }
+    end_of_code:
+#endif
+        // falling off the end of the code returns as a void method
+        result_slots = 0;
+        goto method_exit;
+    } catch (JavaException &exception) {
+#ifdef HAS_JIT
+        if (recorder.recording()) {
+            abortTrace("throws " + exception.class_name);
+        }
+#endif
+        auto object = exception.object;
+        if (object == nullptr) {
+            object = heap->allocateObject(nullptr, exception.class_name);
+            object->string_instance = exception.message;
+        }
+        // unwinds the frames until one of them has a matching handler
+        int handler;
+        while ((handler = findHandler(frame->method, pc - 1, object)) < 0) {
+            if (frame->caller == nullptr) {
+                throw JavaException(object->class_name,
+                                    object->string_instance, object);
+            }
+            frame = frame->caller;
+            pc    = frame->pc;
+        }
+        dm          = frame->method;
+        lva         = frame->lva;
+        sp          = frame->stack;
+        (sp++)->ref = object;
+        pc          = handler;
+        goto resume;
+    }
+}
+
+#undef CASE
+#undef NEXT
+
+///
+/// Handles invokestatic, invokespecial and invokevirtual. The arguments are
+/// popped from the operand stack at sp. Calls to library classes are
+/// emulated by NativeMethods and their return value, if any, is pushed back
+/// at sp. Methods of loaded classes get a new frame on the VM stack, which is
+/// returned to the interpreter loop. The locals of the callee start at the
+/// arguments on the operand stack of the caller, so they are never copied
+///
+StackFrame *MethodExecuter::invoke(const Instruction &ins, Slot *&sp,
+                                   StackFrame *frame) {
+    auto ref = ins.ref.method;
+    sp -= ref->arg_slots + (ins.opcode != op_invokestatic);
+    if (ref->kind != MethodRef::User) {
+        auto result = natives.invoke(*ref, sp);
+        std::copy(&result, &result + (ref->return_slots > 0), sp);
+        sp += ref->return_slots;
+        return nullptr;
+    }
+    if (ins.opcode != op_invokestatic) {
+        checkNull(sp[0].ref);
+    }
+    return enter(frame, findMethod(ref->class_name, *ref), sp);
+}
+
+///
+/// Finds the method of ref in class_name or, when it does not declare it, in
+/// the nearest super class that does
+///
+DecodedMethod *MethodExecuter::findMethod(std::string class_name,
+                                          const MethodRef &ref) {
+    while (cm->count(class_name)) {
+        auto &methods = cm->at(class_name);
+        auto method   = methods.find(ref.name_and_type);
+        if (method != methods.end()) {
+            if (method->second.access_flags & 0x0400) { // ACC_ABSTRACT
+                throw JavaException("java/lang/AbstractMethodError",
+                                    class_name + "." + ref.name_and_type);
+            }
+            return decode(method->second, class_name);
+        }
+        auto super = super_class.find(class_name);
+        if (super == super_class.end()) {
             break;
+        }
+        class_name = super->second;
+    }
+    throw JavaException("java/lang/NoSuchMethodError",
+                        ref.class_name + "." + ref.name_and_type);
+}
 
-        case 0x57: // pop
-        {
-            if (category(sf_local->operand_stack.top()->entry_type) == 1) {
-                sf_local->operand_stack.pop();
-            }
-        } break;
-        case 0x58: // pop2
-        {
-            if (category(sf_local->operand_stack.top()->entry_type) == 2) {
-                sf_local->operand_stack.pop();
-            } else if (category(sf_local->operand_stack.top()->entry_type) ==
-                       1) {
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.pop();
-            }
-        } break;
-        case 0xb5: // putfield
-        {
-            auto indexbyte1 = *(++byte);
-            auto indexbyte2 = *(++byte);
-            auto index      = (indexbyte1 << 8) | indexbyte2;
-            auto field_name = cp.at(class_name)->getFieldByIndex(index);
-            auto value      = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            auto objRef = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            objRef->cf[field_name] = value;
-        } break;
-        case 0xb3: // putstatic
-        {
-            auto indexbyte1 = *(++byte);
-            auto indexbyte2 = *(++byte);
-            auto index      = (indexbyte1 << 8) | indexbyte2;
-            auto field_name = cp.at(class_name)->getFieldByIndex(index);
-            auto value      = sf_local->operand_stack.top();
-            sf_local->operand_stack.pop();
-            cf->operator[](class_name)[field_name] = value;
-
-        } break;
-        case 0xa9: // ret
-        {
-            auto index1        = *(++byte);
-            unsigned int index = -1;
-            if (wide) {
-                wide        = false;
-                auto index2 = *(++byte);
-                index       = (index1 << 8) | (index2);
-            } else {
-                index = index1;
-            }
-            auto loadedValue = sf_local->lva.at(index);
-            loadedValue->setAsRetAddress();
-
-            return loadedValue;
-        } break;
-        case 0xb1: // return
-        {
-            while (!sf_local->operand_stack.empty())
-                sf_local->operand_stack.pop();
-        } break;
-        case 0x11: // sipush
-        {
-            auto byte1  = *(++byte);
-            auto byte2  = *(++byte);
-            auto short_ = (byte1 << 8) | byte2;
-            std::shared_ptr<ContextEntry> ce(
-                new ContextEntry("", I, reinterpret_cast<void *>(&short_)));
-            sf_local->operand_stack.push(ce);
-        } break;
-        case 0x5f: // swap
-        {
-            if (category(sf_local->operand_stack.top()->entry_type) == 1) {
-                auto value1 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                auto value2 = sf_local->operand_stack.top();
-                sf_local->operand_stack.pop();
-                sf_local->operand_stack.push(value1);
-                sf_local->operand_stack.push(value2);
-            }
-        } break;
-        case 0xaa: { // tableswitch
-            auto inital_pc      = byte;
-            int tableswitchline = i;
-            int padding         = i;
-            auto index1         = sf_local->operand_stack.top();
-            auto index = static_cast<signed int>(index1->context_value.b);
-            while (padding % 4 != 0) {
-                byte++; // removes padding bytes (up to 3)
-                padding++;
-            }
-            signed int default_ = 0;
-            for (int k = 0; k < 4; k++) { // gets default value
-                auto default1 = static_cast<unsigned short int>(*byte);
-                int sll       = 24 - (8 * k);
-                default_      = (default1 << sll) | default_;
-                byte++;
-            }
+///
+/// Empty inline cache for a call site of ref, which resolves the method once
+/// to its vtable index in the class of the Methodref or, for interfaces, to
+/// its index in the interface that declares it (the one of the Methodref or
+/// one of its superinterfaces). The index is -1 when the class is not loaded
+/// or the method is not virtual (a private method)
+///
+InlineCache MethodExecuter::newInlineCache(const MethodRef &ref,
+                                           bool interface) {
+    InlineCache cache{&ref, nullptr, -1, 0};
+    auto runtime_class = classes->find(ref.class_name);
+    if (runtime_class == classes->end()) {
+        return cache;
+    }
+    std::vector<const RuntimeClass *> declaring{&runtime_class->second};
+    if (interface) {
+        for (auto &table : runtime_class->second.itable) {
+            declaring.push_back(table.interface);
+        }
+    }
+    for (auto klass : declaring) {
+        auto index = klass->vtable_index.find(ref.name_and_type);
+        if (index != klass->vtable_index.end()) {
+            cache.interface = interface ? klass : nullptr;
+            cache.index     = index->second;
+            break;
+        }
+    }
+    return cache;
+}
 
-            signed int low = 0;
-            for (int k = 0; k < 4; k++) { // gets low value
-                auto lowbyte = static_cast<unsigned short int>(*byte);
-                int sll      = 24 - (8 * k);
-                low          = (lowbyte << sll) | low;
-                byte++;
+///
+/// Method run for receiver by the call site of cache: the entry of the
+/// vtable of its class, which subclasses of the class of the Methodref share
+/// the index of, or the entry of its itable for the interface
+///
+DecodedMethod *MethodExecuter::selectVirtual(ContextEntry *receiver,
+                                             const InlineCache &cache) {
+    auto runtime_class = receiver->runtime_class;
+    if (runtime_class == nullptr || cache.index < 0) {
+        return findMethod(receiver->class_name, *cache.method);
+    }
+    const VirtualMethod *entry = nullptr;
+    if (cache.interface == nullptr) {
+        if (cache.index < runtime_class->vtable.size()) {
+            entry = &runtime_class->vtable[cache.index];
+        }
+    } else {
+        for (auto &table : runtime_class->itable) {
+            if (table.interface == cache.interface) {
+                entry = &table.methods[cache.index];
+                break;
             }
+        }
+        if (entry == nullptr) {
+            throw JavaException("java/lang/IncompatibleClassChangeError",
+                                "Class " + runtime_class->name +
+                                    " does not implement the interface " +
+                                    cache.interface->name);
+        }
+    }
+    if (entry == nullptr) {
+        return findMethod(receiver->class_name, *cache.method);
+    }
+    if (entry->method->access_flags & 0x0400) { // ACC_ABSTRACT
+        throw JavaException("java/lang/AbstractMethodError",
+                            runtime_class->name + "." +
+                                cache.method->name_and_type);
+    }
+    return decode(*entry->method, entry->declaring_class);
+}
 
-            signed int high = 0;
-            for (int k = 0; k < 4; k++) { // gets high value
-                auto highbyte = static_cast<unsigned short int>(*byte);
-                int sll       = 24 - (8 * k);
-                high          = (highbyte << sll) | high;
-                byte++;
-            }
+///
+/// Class hierarchy analysis: the method at index of the vtable of every
+/// instantiated class that is runtime_class or one of its subclasses, when
+/// they all share the same one, else nullptr. Classes never instantiated
+/// cannot be the class of a receiver
+///
+DecodedMethod *MethodExecuter::uniqueTarget(const RuntimeClass *runtime_class,
+                                            int index) {
+    const VirtualMethod *unique = nullptr;
+    std::vector<const RuntimeClass *> pending{runtime_class};
+    while (!pending.empty()) {
+        auto current = pending.back();
+        pending.pop_back();
+        if (instantiated.count(current)) {
+            auto &entry = current->vtable[index];
+            if (unique != nullptr && unique->method != entry.method) {
+                return nullptr;
+            }
+            unique = &entry;
+        }
+        pending.insert(pending.end(), current->subclasses.begin(),
+                       current->subclasses.end());
+    }
+    if (unique == nullptr || (unique->method->access_flags & 0x0400)) {
+        return nullptr;
+    }
+    return decode(*unique->method, unique->declaring_class);
+}
 
-            if ((index < low) || (index > high)) { // sends to default address
-                byte = inital_pc;
-                byte += default_;
-            } else {
-                int k = 0;
-                std::map<unsigned int, signed int> jumptable;
-                while (k < high) {
-                    int jumpoffset = 0;
-                    for (int l = 0; l < 4; l++) { // gets offset
-                        auto value = static_cast<unsigned short int>(*byte);
-                        int sll = 24 - (8 * l); // value = byte1<<24 | byte2<<16
-                                                // | byte3<<8 | byte4<<0
-                        jumpoffset = (value << sll) | jumpoffset;
-                        byte++;
-                    }
-                    jumptable.insert(std::make_pair(k + 1, jumpoffset));
-                    k++;
-                }
-                byte--;
-                int op = jumptable.at(1);
-                byte -= op; // voltar pc para endereco de tableswitch
-                int offset = jumptable.at(index);
-                byte += offset;
-            }
-        } break;
-        case 0xc4: // wide
-        {
-            wide = true;
-        } break;
-        default:
-            throw std::runtime_error("Instruction not implemented");
-            break;
+///
+/// Binds the invokevirtual ins to the method of cache when no instantiated
+/// class overrides it, recording the call so it can be invalidated later.
+/// Returns nullptr when the call has to stay virtual
+///
+DecodedMethod *MethodExecuter::devirtualize(Instruction &ins,
+                                            const InlineCache &cache) {
+    if (cache.interface != nullptr || cache.index < 0) {
+        return nullptr;
+    }
+#ifdef HAS_JIT
+    if (recorder.recording()) {
+        // the handler kept for the call has to be the one of invokevirtual
+        abortTrace("an instruction is quickened");
+    }
+#endif
+    auto runtime_class = &classes->at(cache.method->class_name);
+    auto target        = uniqueTarget(runtime_class, cache.index);
+    if (target != nullptr) {
+        devirtualized.push_back(DevirtualizedCall{
+            &ins, cache.method, runtime_class, cache.index, target,
+            ins.handler});
+    }
+    return target;
+}
+
+///
+/// Turns the devirtualized calls a newly instantiated class overrides the
+/// method of back into invokevirtual, which selects the method again the
+/// next time they run
+///
+void MethodExecuter::invalidateDevirtualized() {
+    for (auto call = devirtualized.begin(); call != devirtualized.end();) {
+        if (uniqueTarget(call->runtime_class, call->index) == call->target) {
+            call++;
+            continue;
         }
+#ifdef HAS_JIT
+        if (recorder.recording()) {
+            abortTrace("a devirtualized call is made virtual again");
+        }
+#endif
+        call->instruction->opcode     = op_invokevirtual;
+        call->instruction->ref.method = call->method;
+        call->instruction->handler    = call->handler;
+        call = devirtualized.erase(call);
     }
-    return nullptr;
 }
 
-unsigned int MethodExecuter::countArgs(std::string argument_str) {
-    unsigned int args_number = 0;
-    for (auto arg = argument_str.begin(); arg < argument_str.end(); arg++) {
-        switch (*arg) {
-        case 'B':
-        case 'C':
-        case 'D':
-        case 'F':
-        case 'I':
-        case 'J':
-        case 'S':
-        case 'Z':
-            args_number++;
-            break;
-        case 'L': {
-            auto end_arg_pos = argument_str.find_first_of(
-                ";", std::distance(argument_str.begin(), arg));
-            args_number++;
-            arg += end_arg_pos;
-        } break;
-        default:
-            break;
+///
+/// Index of the instruction that handles exception when it is thrown by the
+/// instruction at index of method, -1 if no handler covers it
+///
+int MethodExecuter::findHandler(DecodedMethod *method, int index,
+                                ContextEntry *exception) {
+    for (auto &handler : method->handlers) {
+        if (index >= handler.start && index < handler.end &&
+            (handler.catch_type.empty() ||
+             isInstance(exception, handler.catch_type))) {
+            return handler.handler;
         }
     }
-    return args_number;
-}
\ No newline at end of file
+    return -1;
+}
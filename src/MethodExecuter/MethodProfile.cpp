@@ -0,0 +1,94 @@
+#include <MethodExecuter/MethodProfile.hpp>
+#include <iomanip>
+
+///
+/// Gives a ProfileData to each instruction of method, a baseline version,
+/// that records one
+///
+MethodProfile::MethodProfile(DecodedMethod &method) {
+    for (auto &ins : method.code) {
+        switch (ins.opcode) {
+        case op_ifeq:
+        case op_ifne:
+        case op_iflt:
+        case op_ifge:
+        case op_ifgt:
+        case op_ifle:
+        case op_if_icmpeq:
+        case op_if_icmpne:
+        case op_if_icmplt:
+        case op_if_icmpge:
+        case op_if_icmpgt:
+        case op_if_icmple:
+        case op_if_acmpeq:
+        case op_if_acmpne:
+        case op_ifnull:
+        case op_ifnonnull:
+        case op_tableswitch:
+        case op_lookupswitch:
+        case op_invokevirtual:
+        case op_invokeinterface:
+        case op_checkcast:
+        case op_instanceof:
+        case op_aaload:
+        case op_aastore:
+            break;
+        default:
+            continue;
+        }
+        ins.profile = data.size();
+        data.emplace_back();
+        data.back().opcode = ins.opcode;
+        data.back().bci    = ins.bci;
+        if (ins.opcode == op_tableswitch || ins.opcode == op_lookupswitch) {
+            data.back().table = ins.ref.table;
+            data.back().cases.resize(ins.ref.table->targets.size() + 1);
+        }
+    }
+}
+
+///
+/// Writes the profile of the method called name, one line per instruction
+/// that recorded something. Nothing when none did
+///
+void MethodProfile::print(std::ostream &out, const std::string &name) const {
+    bool named = false;
+    for (auto &entry : data) {
+        auto &types = entry.types;
+        unsigned seen = types.counts[0] + types.counts[1] + types.others +
+                        types.nulls + entry.taken + entry.not_taken;
+        for (auto count : entry.cases) {
+            seen += count;
+        }
+        if (seen == 0) {
+            continue;
+        }
+        if (!named) {
+            out << name << std::endl;
+            named = true;
+        }
+        out << "  bci " << std::left << std::setw(5) << entry.bci
+            << std::setw(16) << opcodeName(entry.opcode) << std::right;
+        if (!entry.cases.empty()) {
+            auto table = entry.table;
+            for (int k = 0; k + 1 < entry.cases.size(); k++) {
+                out << " case "
+                    << (table->keys.empty() ? table->low + k : table->keys[k])
+                    << ": " << entry.cases[k];
+            }
+            out << " default: " << entry.cases.back();
+        } else if (entry.taken + entry.not_taken > 0) {
+            out << " taken " << entry.taken << " not taken "
+                << entry.not_taken;
+        } else {
+            for (int row = 0; row < TypeProfile::Rows; row++) {
+                if (types.classes[row] != nullptr) {
+                    out << " " << types.classes[row]->name << " "
+                        << types.counts[row];
+                }
+            }
+            out << " others " << types.others << " nulls " << types.nulls;
+        }
+        out << std::endl;
+    }
+}
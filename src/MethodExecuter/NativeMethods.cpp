@@ -0,0 +1,206 @@
+#include <MethodExecuter/NativeMethods.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+NativeMethods::NativeMethods(Heap *heap) { this->heap = heap; }
+
+///
+/// Formats value with the shortest digits that read back to the same value,
+/// using plain notation for 10^-3 <= |value| < 10^7 and computerized
+/// scientific notation otherwise, like Double.toString and Float.toString
+///
+template <typename T>
+static std::string javaFloating(T value, int max_digits,
+                                T (*parse)(const char *, char **)) {
+    if (std::isnan(value)) {
+        return "NaN";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "Infinity" : "-Infinity";
+    }
+    if (value == 0) {
+        return std::signbit(value) ? "-0.0" : "0.0";
+    }
+    char buffer[40];
+    for (int precision = 1; precision <= max_digits; precision++) {
+        snprintf(buffer, sizeof(buffer), "%.*e", precision - 1,
+                 static_cast<double>(value));
+        if (parse(buffer, nullptr) == value) {
+            break;
+        }
+    }
+    std::string text(buffer);
+    std::string result = text[0] == '-' ? "-" : "";
+    auto e             = text.find('e');
+    int exponent       = std::atoi(text.c_str() + e + 1);
+    std::string digits;
+    for (auto c = text.begin(); c < text.begin() + e; c++) {
+        if (*c >= '0' && *c <= '9') {
+            digits += *c;
+        }
+    }
+    while (digits.size() > 1 && digits.back() == '0') {
+        digits.pop_back();
+    }
+    if (exponent >= -3 && exponent < 7) {
+        if (exponent < 0) {
+            return result + "0." + std::string(-exponent - 1, '0') + digits;
+        }
+        while (digits.size() <= exponent + 1) {
+            digits += '0';
+        }
+        return result + digits.substr(0, exponent + 1) + "." +
+               digits.substr(exponent + 1);
+    }
+    std::string fraction = digits.size() > 1 ? digits.substr(1) : "0";
+    return result + digits[0] + "." + fraction + "E" +
+           std::to_string(exponent);
+}
+
+std::string NativeMethods::doubleToString(double value) {
+    return javaFloating<double>(value, 17, std::strtod);
+}
+
+std::string NativeMethods::floatToString(float value) {
+    return javaFloating<float>(value, 9, std::strtof);
+}
+
+///
+/// UTF-8 encoding of one UTF-16 code unit
+///
+static std::string charToString(unsigned short c) {
+    std::string text;
+    if (c < 0x80) {
+        text += static_cast<char>(c);
+    } else if (c < 0x800) {
+        text += static_cast<char>(0xc0 | (c >> 6));
+        text += static_cast<char>(0x80 | (c & 0x3f));
+    } else {
+        text += static_cast<char>(0xe0 | (c >> 12));
+        text += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+        text += static_cast<char>(0x80 | (c & 0x3f));
+    }
+    return text;
+}
+
+///
+/// String.valueOf of the value at slot for a field descriptor type
+///
+std::string NativeMethods::stringOf(const Slot *value,
+                                    const std::string &type) {
+    switch (type[0]) {
+    case 'B':
+    case 'I':
+    case 'S':
+        return std::to_string(value->i);
+    case 'J':
+        return std::to_string(value->j);
+    case 'F':
+        return floatToString(value->f);
+    case 'D':
+        return doubleToString(value->d);
+    case 'Z':
+        return value->i ? "true" : "false";
+    case 'C':
+        return charToString(value->i);
+    }
+    auto entry = value->ref;
+    if (entry == nullptr) {
+        return "null";
+    }
+    if (type == "[C") {
+        std::string text;
+        for (int index = 0; index < entry->length; index++) {
+            text += charToString(entry->at<uint16_t>(index));
+        }
+        return text;
+    }
+    if (entry->entry_type == R ||
+        entry->class_name == "java/lang/StringBuilder") {
+        return entry->string_instance;
+    }
+    std::stringstream ss;
+    ss << std::hex << (reinterpret_cast<uintptr_t>(entry) >> 3 & 0x7fffffff);
+    std::string name = entry->class_name;
+    for (auto &c : name) {
+        c = c == '/' ? '.' : c;
+    }
+    return (entry->isArray ? "[" : "") + name + "@" + ss.str();
+}
+
+///
+/// Runs ref over args (receiver first) and returns the result, if any
+///
+Slot NativeMethods::invoke(const MethodRef &ref, Slot *args) {
+    Slot result{};
+    if (ref.kind == MethodRef::JavaObject) {
+        if (ref.name == "<init>") {
+            return result;
+        }
+    } else if (args[0].ref == nullptr) {
+        throw JavaException("java/lang/NullPointerException",
+                            ref.class_name + "." + ref.name +
+                                " on a null reference");
+    } else if (ref.kind == MethodRef::PrintStream) {
+        if (ref.name == "println" || ref.name == "print") {
+            std::ostream &out =
+                args[0].ref->string_instance == "err" ? std::cerr : std::cout;
+            if (!ref.args.empty()) {
+                out << stringOf(&args[1], ref.args);
+            }
+            if (ref.name == "println") {
+                out << std::endl;
+            }
+            return result;
+        }
+    } else if (ref.kind == MethodRef::StringBuilder) {
+        auto &text = args[0].ref->string_instance;
+        if (ref.name == "<init>") {
+            text = ref.args.empty() ? "" : stringOf(&args[1], ref.args);
+            return result;
+        } else if (ref.name == "append") {
+            text += stringOf(&args[1], ref.args);
+            return args[0];
+        } else if (ref.name == "toString") {
+            result.ref = heap->allocate(text);
+            return result;
+        } else if (ref.name == "length") {
+            result.i = text.size();
+            return result;
+        }
+    } else if (ref.kind == MethodRef::Throwable) {
+        // the message of a throwable is kept as its string_instance
+        auto &message = args[0].ref->string_instance;
+        if (ref.name == "<init>") {
+            message = ref.args.empty() ? "" : stringOf(&args[1], ref.args);
+            return result;
+        } else if (ref.name == "getMessage") {
+            result.ref = message.empty() ? nullptr : heap->allocate(message);
+            return result;
+        } else if (ref.name == "toString") {
+            result.ref = heap->allocate(
+                JavaException::describe(args[0].ref->class_name, message));
+            return result;
+        }
+    }
+    throw JavaException("java/lang/UnsatisfiedLinkError",
+                        ref.class_name + "." + ref.name_and_type +
+                            " is not emulated");
+}
+
+///
+/// Static fields of library classes, only System.out and System.err
+///
+ContextEntry *NativeMethods::getStatic(const FieldRef &field) {
+    if (field.class_name == "java/lang/System" &&
+        (field.name == "out" || field.name == "err")) {
+        auto stream = heap->allocateObject(nullptr, "java/io/PrintStream");
+        stream->string_instance = field.name;
+        return stream;
+    }
+    throw JavaException("java/lang/NoSuchFieldError",
+                        field.class_name + "." + field.name);
+}
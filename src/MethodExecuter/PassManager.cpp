@@ -0,0 +1,545 @@
+#include <MethodExecuter/PassManager.hpp>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+const char *const PassManager::default_pipeline =
+    "constfold,copyprop,gvn,licm,dse";
+
+///
+/// Rewrites value into a copy of one of its arguments or into zero when a
+/// constant argument, or using the same value twice, makes the integer
+/// operation trivial: x + 0, x * 1, x / 1, x << 0, x * 0, x - x...
+///
+static bool simplify(IrFunction &function, IrValue &value) {
+    if (value.args.size() != 2 ||
+        (value.type != IrType::Int && value.type != IrType::Long)) {
+        return false;
+    }
+    auto &values = function.values;
+    auto is      = [&](int arg, int64_t expected) {
+        auto &constant = values[value.args[arg]];
+        if (constant.opcode != ir_const) {
+            return false;
+        }
+        return (constant.type == IrType::Long ? constant.constant.j
+                                              : constant.constant.i) ==
+               expected;
+    };
+    bool same = value.args[0] == value.args[1];
+    int keep  = -1;    // argument the value is a copy of
+    bool zero = false; // whether the value is zero
+    switch (value.opcode) {
+    case op_iadd:
+    case op_ladd:
+        keep = is(1, 0) ? 0 : is(0, 0) ? 1 : -1;
+        break;
+    case op_ior:
+    case op_lor:
+        keep = is(1, 0) || same ? 0 : is(0, 0) ? 1 : -1;
+        break;
+    case op_ixor:
+    case op_lxor:
+        keep = is(1, 0) ? 0 : is(0, 0) ? 1 : -1;
+        zero = same;
+        break;
+    case op_isub:
+    case op_lsub:
+        keep = is(1, 0) ? 0 : -1;
+        zero = same;
+        break;
+    case op_imul:
+    case op_lmul:
+        keep = is(1, 1) ? 0 : is(0, 1) ? 1 : -1;
+        zero = is(0, 0) || is(1, 0);
+        break;
+    case op_iand:
+    case op_land:
+        keep = same ? 0 : -1;
+        zero = is(0, 0) || is(1, 0);
+        break;
+    case op_idiv:
+    case op_ldiv:
+        keep = is(1, 1) ? 0 : -1;
+        break;
+    case op_ishl:
+    case op_ishr:
+    case op_iushr:
+    case op_lshl:
+    case op_lshr:
+    case op_lushr: {
+        auto &shift = values[value.args[1]];
+        int mask    = value.type == IrType::Int ? 31 : 63;
+        if (shift.opcode == ir_const && (shift.constant.i & mask) == 0) {
+            keep = 0;
+        }
+    } break;
+    }
+    if (zero) {
+        value.opcode   = ir_const;
+        value.constant = Slot{};
+        value.args.clear();
+        return true;
+    }
+    if (keep >= 0) {
+        value.opcode = ir_copy;
+        value.args   = {value.args[keep]};
+        return true;
+    }
+    return false;
+}
+
+///
+/// constfold: evaluates the values whose arguments are all constants, turns
+/// the conditional branches on constants into gotos and simplifies the
+/// trivial integer operations
+///
+static int foldConstants(IrFunction &function) {
+    auto &values  = function.values;
+    int folded    = 0;
+    bool branches = false;
+    for (int block : function.order()) {
+        for (int index : function.blocks[block].code) {
+            auto &value = values[index];
+            if (value.args.empty() || value.opcode == ir_phi ||
+                value.opcode == ir_copy) {
+                continue;
+            }
+            Slot args[2];
+            bool constant = value.args.size() <= 2;
+            for (int k = 0; constant && k < value.args.size(); k++) {
+                constant = values[value.args[k]].opcode == ir_const;
+                args[k]  = values[value.args[k]].constant;
+            }
+            if (constant && irIsBranch(value.opcode)) {
+                bool taken  = irTaken(value.opcode, args);
+                auto &succs = function.blocks[block].succs;
+                function.removeEdge(block, succs[taken ? 1 : 0]);
+                value.opcode = op_goto;
+                value.args.clear();
+                branches = true;
+                folded++;
+            } else if (constant && irIsPure(function, value)) {
+                value.constant = irEvaluate(value.opcode, args);
+                value.opcode   = ir_const;
+                value.args.clear();
+                folded++;
+            } else if (simplify(function, value)) {
+                folded++;
+            }
+        }
+    }
+    if (branches) {
+        function.removeUnreachable();
+    }
+    return folded;
+}
+
+///
+/// copyprop: replaces the uses of each copy with the value it copies, and
+/// of each phi whose arguments are all one value (or the phi itself) with
+/// that value
+///
+static int propagateCopies(IrFunction &function) {
+    auto &values = function.values;
+    std::vector<int> replacement(values.size(), -1);
+    auto find = [&replacement](int value) {
+        while (replacement[value] >= 0) {
+            value = replacement[value];
+        }
+        return value;
+    };
+    for (int index = 0; index < values.size(); index++) {
+        if (values[index].block >= 0 && values[index].opcode == ir_copy) {
+            replacement[index] = values[index].args[0];
+        }
+    }
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (int index = 0; index < values.size(); index++) {
+            auto &value = values[index];
+            if (value.block < 0 || value.opcode != ir_phi ||
+                replacement[index] >= 0) {
+                continue;
+            }
+            int single = -1;
+            for (int arg : value.args) {
+                arg = find(arg);
+                if (arg == index || arg == single) {
+                    continue;
+                }
+                if (single != -1) {
+                    single = -1;
+                    break;
+                }
+                single = arg;
+            }
+            if (single >= 0) {
+                replacement[index] = single;
+                changed            = true;
+            }
+        }
+    }
+    function.replaceUses(replacement);
+    int removed = 0;
+    for (int index = 0; index < values.size(); index++) {
+        if (replacement[index] >= 0 && values[index].block >= 0) {
+            function.remove(index);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+///
+/// Key under which gvn finds the values equal to value: its operation,
+/// type, arguments (sorted when the operation commutes) and constant. Phis
+/// are only equal to the phis of their block
+///
+static std::vector<int64_t> valueKey(const IrValue &value) {
+    std::vector<int64_t> key{value.opcode, static_cast<int>(value.type),
+                             value.opcode == ir_const ? value.constant.j : 0,
+                             value.opcode == ir_phi ? value.block : -1};
+    key.insert(key.end(), value.args.begin(), value.args.end());
+    switch (value.opcode) {
+    case op_iadd:
+    case op_ladd:
+    case op_imul:
+    case op_lmul:
+    case op_iand:
+    case op_land:
+    case op_ior:
+    case op_lor:
+    case op_ixor:
+    case op_lxor:
+        std::sort(key.end() - 2, key.end());
+    }
+    return key;
+}
+
+///
+/// Numbers the values of block and of the blocks it dominates, children
+/// holding the blocks each one immediately dominates. available maps the
+/// keys of the values computed by the blocks dominating block
+///
+static int numberValues(IrFunction &function, int block,
+                        const std::vector<std::vector<int>> &children,
+                        std::map<std::vector<int64_t>, int> &available,
+                        std::vector<int> &replacement) {
+    auto &values = function.values;
+    int merged   = 0;
+    std::vector<std::vector<int64_t>> added;
+    for (int index : function.blocks[block].code) {
+        auto &value = values[index];
+        if (value.opcode == ir_copy ||
+            (value.opcode != ir_phi && !irIsPure(function, value))) {
+            continue;
+        }
+        for (auto &arg : value.args) {
+            while (replacement[arg] >= 0) {
+                arg = replacement[arg];
+            }
+        }
+        auto key   = valueKey(value);
+        auto found = available.find(key);
+        if (found != available.end()) {
+            replacement[index] = found->second;
+            merged++;
+        } else {
+            available.emplace(key, index);
+            added.push_back(std::move(key));
+        }
+    }
+    for (int child : children[block]) {
+        merged += numberValues(function, child, children, available,
+                               replacement);
+    }
+    for (auto &key : added) {
+        available.erase(key);
+    }
+    return merged;
+}
+
+///
+/// gvn: drops each value equal to one computed by a block dominating it,
+/// walking the dominator tree from the entry
+///
+static int numberValues(IrFunction &function) {
+    auto order = function.order();
+    auto idom  = function.dominators(order);
+    std::vector<std::vector<int>> children(function.blocks.size());
+    for (int block : order) {
+        if (block != 0) {
+            children[idom[block]].push_back(block);
+        }
+    }
+    std::map<std::vector<int64_t>, int> available;
+    std::vector<int> replacement(function.values.size(), -1);
+    int merged =
+        numberValues(function, 0, children, available, replacement);
+    function.replaceUses(replacement);
+    for (int index = 0; index < replacement.size(); index++) {
+        if (replacement[index] >= 0) {
+            function.remove(index);
+        }
+    }
+    return merged;
+}
+
+///
+/// Block through which every path from outside the loop made of the blocks
+/// in body enters its header, splitting the edges coming from outside into
+/// a new block when there is none. The phis of the header take a single
+/// argument from it, merged by a phi of the new block when needed
+///
+static int preheader(IrFunction &function, int header,
+                     const std::vector<bool> &body) {
+    auto &values = function.values;
+    std::vector<int> outside, inside; // indices in the preds of the header
+    for (int k = 0; k < function.blocks[header].preds.size(); k++) {
+        int pred = function.blocks[header].preds[k];
+        (body[pred] ? inside : outside).push_back(k);
+    }
+    if (outside.size() == 1) {
+        int pred = function.blocks[header].preds[outside[0]];
+        if (function.blocks[pred].succs.size() == 1) {
+            return pred;
+        }
+    }
+    int bci = values[function.blocks[header].code.front()].bci;
+    int pre = function.newBlock(function.blocks[header].start);
+    std::vector<int> preds{pre};
+    for (int k : outside) {
+        int from    = function.blocks[header].preds[k];
+        auto &succs = function.blocks[from].succs;
+        *std::find(succs.begin(), succs.end(), header) = pre;
+        function.blocks[pre].preds.push_back(from);
+    }
+    for (int k : inside) {
+        preds.push_back(function.blocks[header].preds[k]);
+    }
+    auto code = function.blocks[header].code;
+    for (int phi : code) {
+        if (values[phi].opcode != ir_phi) {
+            break;
+        }
+        std::vector<int> entering, args;
+        for (int k : outside) {
+            entering.push_back(values[phi].args[k]);
+        }
+        for (int k : inside) {
+            args.push_back(values[phi].args[k]);
+        }
+        int arg = entering[0];
+        if (std::count(entering.begin(), entering.end(), arg) !=
+            entering.size()) {
+            arg = function.add(pre, ir_phi, values[phi].type, entering,
+                               values[phi].bci);
+        }
+        args.insert(args.begin(), arg);
+        values[phi].args = args;
+    }
+    function.blocks[header].preds = preds;
+    function.add(pre, op_goto, IrType::Void, {}, bci);
+    function.blocks[pre].succs = {header};
+    return pre;
+}
+
+///
+/// licm: moves the values of the loops that only use values defined outside
+/// of them to their preheader, innermost loops first
+///
+static int hoistInvariants(IrFunction &function) {
+    auto &values = function.values;
+    int hoisted  = 0;
+    std::set<int> done; // loop headers
+    for (;;) {
+        auto order = function.order();
+        auto idom  = function.dominators(order);
+        std::map<int, std::vector<int>> latches; // by loop header
+        for (int block : order) {
+            for (int succ : function.blocks[block].succs) {
+                if (!done.count(succ) &&
+                    function.dominates(idom, succ, block)) {
+                    latches[succ].push_back(block);
+                }
+            }
+        }
+        int header = -1;
+        std::vector<bool> body;
+        int body_size = 0;
+        for (auto &loop : latches) {
+            std::vector<bool> blocks(function.blocks.size(), false);
+            blocks[loop.first] = true;
+            int size           = 1;
+            auto work          = loop.second;
+            while (!work.empty()) {
+                int block = work.back();
+                work.pop_back();
+                if (!blocks[block]) {
+                    blocks[block] = true;
+                    size++;
+                    auto &preds = function.blocks[block].preds;
+                    work.insert(work.end(), preds.begin(), preds.end());
+                }
+            }
+            if (header < 0 || size < body_size) {
+                header    = loop.first;
+                body      = blocks;
+                body_size = size;
+            }
+        }
+        if (header < 0) {
+            return hoisted;
+        }
+        done.insert(header);
+        int pre = preheader(function, header, body);
+        body.resize(function.blocks.size(), false);
+        for (int block : order) {
+            if (!body[block]) {
+                continue;
+            }
+            auto code = function.blocks[block].code;
+            for (int index : code) {
+                auto &value = values[index];
+                if (value.opcode == ir_phi || !irIsPure(function, value)) {
+                    continue;
+                }
+                bool invariant = true;
+                for (int arg : value.args) {
+                    invariant = invariant && !body[values[arg].block];
+                }
+                if (invariant) {
+                    function.remove(index);
+                    auto &target = function.blocks[pre].code;
+                    target.insert(target.end() - 1, index);
+                    value.block = pre;
+                    hoisted++;
+                }
+            }
+        }
+    }
+}
+
+///
+/// dse: drops the putstatic overwritten by a later one in the same block
+/// with nothing reading a field or throwing in between, then the values
+/// that neither a branch, a return, a store nor a value that may throw
+/// needs
+///
+static int eliminateDeadStores(IrFunction &function) {
+    auto &values = function.values;
+    int removed  = 0;
+    for (int block : function.order()) {
+        std::map<const FieldRef *, int> pending; // stores not read yet
+        auto code = function.blocks[block].code;
+        for (int index : code) {
+            auto &value = values[index];
+            if (value.opcode == op_putstatic) {
+                for (auto &store : pending) {
+                    if (store.first->class_name == value.field->class_name &&
+                        store.first->name == value.field->name) {
+                        function.remove(store.second);
+                        pending.erase(store.first);
+                        removed++;
+                        break;
+                    }
+                }
+                pending[value.field] = index;
+            } else if (value.opcode == op_getstatic ||
+                       irCanThrow(function, value)) {
+                pending.clear();
+            }
+        }
+    }
+    std::vector<bool> live(values.size(), false);
+    std::vector<int> work;
+    for (int index = 0; index < values.size(); index++) {
+        auto &value = values[index];
+        if (value.block >= 0 &&
+            (value.type == IrType::Void || irCanThrow(function, value))) {
+            live[index] = true;
+            work.push_back(index);
+        }
+    }
+    while (!work.empty()) {
+        int index = work.back();
+        work.pop_back();
+        for (int arg : values[index].args) {
+            if (!live[arg]) {
+                live[arg] = true;
+                work.push_back(arg);
+            }
+        }
+    }
+    for (int index = 0; index < values.size(); index++) {
+        if (values[index].block >= 0 && !live[index]) {
+            function.remove(index);
+            removed++;
+        }
+    }
+    return removed;
+}
+
+static const struct {
+    const char *name;
+    int (*run)(IrFunction &function);
+} pass_table[] = {
+    {"constfold", foldConstants}, {"copyprop", propagateCopies},
+    {"gvn", numberValues},        {"licm", hoistInvariants},
+    {"dse", eliminateDeadStores},
+};
+
+///
+/// Pipeline of the passes pipeline names, separated by commas, in that
+/// order. Throws invalid_argument for a name no pass has
+///
+PassManager::PassManager(const std::string &pipeline) {
+    std::istringstream in(pipeline);
+    std::string name;
+    while (std::getline(in, name, ',')) {
+        if (name.empty()) {
+            continue;
+        }
+        auto pass = std::find_if(
+            std::begin(pass_table), std::end(pass_table),
+            [&name](const auto &pass) { return name == pass.name; });
+        if (pass == std::end(pass_table)) {
+            throw std::invalid_argument("Unknown IR pass: " + name);
+        }
+        names.push_back(name);
+        passes.push_back(pass->run);
+    }
+    changes.assign(passes.size(), 0);
+}
+
+///
+/// Runs the pipeline over function until a round changes nothing
+///
+void PassManager::run(IrFunction &function) {
+    changes.assign(passes.size(), 0);
+    for (int round = 0; round < Rounds; round++) {
+        bool changed = false;
+        for (int k = 0; k < passes.size(); k++) {
+            int count = passes[k](function);
+            changes[k] += count;
+            changed = changed || count > 0;
+        }
+        if (!changed) {
+            break;
+        }
+    }
+}
+
+///
+/// Values each pass changed in the last run, as "constfold 3, gvn 1"
+///
+std::string PassManager::report() const {
+    std::ostringstream out;
+    for (int k = 0; k < names.size(); k++) {
+        out << (k > 0 ? ", " : "") << names[k] << " " << changes[k];
+    }
+    return out.str();
+}
@@ -0,0 +1,201 @@
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <MethodExecuter/StackCache.hpp>
+#include <MethodExecuter/Superinstructions.hpp>
+
+#include <array>
+#include <limits>
+#include <vector>
+
+///
+/// Shapes of the cached handlers, in the order of JVM_CACHED_HANDLERS
+///
+static const CacheShape shapes[] = {
+#define CACHED_SHAPE(name, shape, ...) shape,
+    JVM_CACHED_HANDLERS(CACHED_SHAPE)
+#undef CACHED_SHAPE
+};
+
+///
+/// Index in JVM_CACHED_HANDLERS of the entry listing opcode, -1 if none
+/// does
+///
+int StackCache::handler(unsigned short opcode) {
+    static std::vector<int> handler_of;
+    if (handler_of.empty()) {
+        handler_of.assign(op_trace_exit + 1, -1);
+        int index = 0;
+#define CACHED_INDEX(name, shape, ...)                                         \
+    for (auto cached : {__VA_ARGS__}) {                                        \
+        handler_of[cached] = index;                                            \
+    }                                                                          \
+    index++;
+        JVM_CACHED_HANDLERS(CACHED_INDEX)
+#undef CACHED_INDEX
+    }
+    return opcode < handler_of.size() ? handler_of[opcode] : -1;
+}
+
+///
+/// Cost of storing the values cached in state to the operand stack before
+/// a handler that expects them there, including the jump to it
+///
+int StackCache::spillCost(int state) {
+    static const int costs[] = {0, 2, 2, 3, 3};
+    return costs[state];
+}
+
+///
+/// Whether the cached handlers of shape have one entered in state, setting
+/// the state it leaves in out and the slots it reads or writes in the
+/// operand stack in cost. A handler entered with more values than it takes
+/// spills the ones under them, one with fewer reads the others from the
+/// stack
+///
+bool StackCache::transition(CacheShape shape, int state, int &out,
+                            int &cost) {
+    struct Transition {
+        int in, out, cost;
+    };
+    static const std::vector<Transition> table[] = {
+        // shape_push_narrow
+        {{cache_none, cache_narrow, 0},
+         {cache_narrow, cache_narrow2, 0},
+         {cache_wide, cache_narrow, 1},
+         {cache_narrow2, cache_narrow2, 1},
+         {cache_wide2, cache_narrow, 2}},
+        // shape_push_wide
+        {{cache_none, cache_wide, 0},
+         {cache_wide, cache_wide2, 0},
+         {cache_narrow, cache_wide, 1},
+         {cache_narrow2, cache_wide, 2},
+         {cache_wide2, cache_wide2, 1}},
+        // shape_pop_narrow
+        {{cache_narrow, cache_none, 0}, {cache_narrow2, cache_narrow, 0}},
+        // shape_pop_wide
+        {{cache_wide, cache_none, 0}, {cache_wide2, cache_wide, 0}},
+        // shape_unary_narrow
+        {{cache_narrow, cache_narrow, 0}, {cache_narrow2, cache_narrow2, 0}},
+        // shape_unary_wide
+        {{cache_wide, cache_wide, 0}, {cache_wide2, cache_wide2, 0}},
+        // shape_to_wide
+        {{cache_narrow, cache_wide, 0}},
+        // shape_to_narrow
+        {{cache_wide, cache_narrow, 0}},
+        // shape_binary_narrow
+        {{cache_narrow2, cache_narrow, 0}, {cache_narrow, cache_narrow, 1}},
+        // shape_binary_wide
+        {{cache_wide2, cache_wide, 0}, {cache_wide, cache_wide, 1}},
+        // shape_compare_wide
+        {{cache_wide2, cache_narrow, 0}, {cache_wide, cache_narrow, 1}},
+        // shape_branch_narrow
+        {{cache_narrow, cache_none, 0}, {cache_narrow2, cache_none, 1}},
+        // shape_branch_binary
+        {{cache_narrow2, cache_none, 0}, {cache_narrow, cache_none, 1}},
+        // shape_array_store
+        {{cache_narrow2, cache_none, 1}, {cache_narrow, cache_none, 2}},
+        // shape_return_narrow
+        {{cache_narrow, cache_none, 0}, {cache_narrow2, cache_none, 0}},
+        // shape_return_wide
+        {{cache_wide, cache_none, 0}, {cache_wide2, cache_none, 0}},
+    };
+    for (auto &entry : table[shape]) {
+        if (entry.in == state) {
+            out  = entry.out;
+            cost = entry.cost;
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Whether opcode has a cached handler entered in state, see transition
+///
+bool StackCache::cached(unsigned short opcode, int state, int &out,
+                        int &cost) {
+    int index = handler(opcode);
+    return index >= 0 && transition(shapes[index], state, out, cost);
+}
+
+///
+/// Plans the state each instruction of method is entered in and the
+/// variant of its handler, moving the fewest slots through the operand
+/// stack for the dispatches it makes. Only the first instruction of a
+/// superinstruction (when fuse) is dispatched, the others are entered with
+/// nothing cached. Without cache every instruction is, and runs from the
+/// handler of its opcode or of its superinstruction
+///
+void StackCache::plan(DecodedMethod &method, bool fuse, bool cache) {
+    auto &code  = method.code;
+    auto starts = BytecodeDecoder::blockStarts(method);
+    int size    = code.size();
+    // the cheapest way to reach each instruction in each state, the
+    // instruction dispatched before it and the state and variant of that
+    struct Step {
+        unsigned cost;
+        int from;
+        unsigned char state;
+        unsigned char variant;
+    };
+    const unsigned unreached = std::numeric_limits<unsigned>::max();
+    std::vector<std::array<Step, CacheStates>> steps(size + 1);
+    for (auto &step : steps) {
+        step.fill(Step{unreached, -1, cache_none, variant_generic});
+    }
+    steps[0][cache_none].cost = 0;
+    auto reach = [&](int index, int state, unsigned cost, int from,
+                     int from_state, int variant) {
+        auto &step = steps[index][state];
+        if (cost < step.cost) {
+            step = Step{cost, from, static_cast<unsigned char>(from_state),
+                        static_cast<unsigned char>(variant)};
+        }
+    };
+    for (int index = 0; index < size; index++) {
+        if (starts[index]) {
+            // a branch gets there with nothing cached
+            for (int state = cache_none + 1; state < CacheStates; state++) {
+                steps[index][state].cost = unreached;
+            }
+        }
+        auto &ins = code[index];
+        int fused = fuse ? Superinstructions::length(
+                               static_cast<Superinstruction>(ins.fused))
+                         : 0;
+        for (int state = cache_none; state < CacheStates; state++) {
+            unsigned cost = steps[index][state].cost;
+            if (cost == unreached) {
+                continue;
+            }
+            unsigned spilled = cost + Dispatch + spillCost(state);
+            reach(index + 1, cache_none, spilled + Generic, index, state,
+                  variant_generic);
+            if (fused > 0) {
+                reach(index + fused, cache_none, spilled + Generic, index,
+                      state, variant_fused);
+            }
+            int out, moved;
+            if (cache && cached(ins.opcode, state, out, moved)) {
+                reach(index + 1, out, cost + Dispatch + moved, index, state,
+                      variant_cached);
+            }
+        }
+    }
+    int state = cache_none;
+    for (int last = cache_none; last < CacheStates; last++) {
+        if (steps[size][last].cost < steps[size][state].cost) {
+            state = last;
+        }
+    }
+    for (auto &ins : code) {
+        ins.cache   = cache_none;
+        ins.variant = variant_generic;
+    }
+    for (int index = size; index > 0;) {
+        auto &step              = steps[index][state];
+        code[step.from].cache   = step.state;
+        code[step.from].variant = step.variant;
+        state                   = step.state;
+        index                   = step.from;
+    }
+}
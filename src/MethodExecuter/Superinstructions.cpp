@@ -0,0 +1,196 @@
+#include <MethodExecuter/BytecodeDecoder.hpp>
+#include <MethodExecuter/Superinstructions.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+
+///
+/// Names and opcode sequences of the superinstructions, by Superinstruction
+///
+static const char *const names[] = {
+    "none",
+#define SUPERINSTRUCTION_NAME(name, ...) #name,
+    JVM_SUPERINSTRUCTIONS(SUPERINSTRUCTION_NAME)
+#undef SUPERINSTRUCTION_NAME
+};
+
+static const std::vector<unsigned short> sequences[] = {
+    {},
+#define SUPERINSTRUCTION_SEQUENCE(name, ...) {__VA_ARGS__},
+    JVM_SUPERINSTRUCTIONS(SUPERINSTRUCTION_SEQUENCE)
+#undef SUPERINSTRUCTION_SEQUENCE
+};
+
+///
+/// Returns the opcode that stands for opcode and the other opcodes the
+/// interpreter runs with the same handler
+///
+static unsigned short sharedHandler(unsigned short opcode) {
+    switch (opcode) {
+    case op_fload:
+    case op_aload:
+        return op_iload;
+    case op_fstore:
+    case op_astore:
+        return op_istore;
+    case op_iconst_m1:
+    case op_iconst_1:
+    case op_iconst_2:
+    case op_iconst_3:
+    case op_iconst_4:
+    case op_iconst_5:
+    case op_bipush:
+    case op_sipush:
+        return op_iconst_0;
+    default:
+        return opcode;
+    }
+}
+
+const char *Superinstructions::name(Superinstruction super) {
+    return names[super];
+}
+
+///
+/// Number of instructions super runs in one dispatch
+///
+int Superinstructions::length(Superinstruction super) {
+    return sequences[super].size();
+}
+
+///
+/// Whether the instructions of method from index on are the sequence of
+/// super, none of them but the first starting a block. They are either all
+/// instructions frames resume at when the method is invalidated or none of
+/// them, so a deoptimize replaces the first whenever it replaces another
+///
+bool Superinstructions::matches(Superinstruction super,
+                                const DecodedMethod &method,
+                                const std::vector<bool> &starts, int index) {
+    auto &sequence = sequences[super];
+    auto &code     = method.code;
+    auto &resumes  = method.interpreter_index;
+    if (index + sequence.size() > code.size()) {
+        return false;
+    }
+    for (int k = 0; k < sequence.size(); k++) {
+        if (sharedHandler(code[index + k].opcode) !=
+                sharedHandler(sequence[k]) ||
+            (k > 0 && starts[index + k]) ||
+            (!resumes.empty() &&
+             (resumes[index + k] >= 0) != (resumes[index] >= 0))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+/// Sets the superinstruction each instruction of method starts, taking
+/// the longest sequence at each instruction from the first one on
+///
+void Superinstructions::fuse(DecodedMethod &method) {
+    auto &code  = method.code;
+    auto starts = BytecodeDecoder::blockStarts(method);
+    for (auto &ins : code) {
+        ins.fused = super_none;
+    }
+    for (int index = 0; index < code.size();) {
+        auto longest = super_none;
+        for (int super = super_none + 1;
+             super < sizeof(sequences) / sizeof(sequences[0]); super++) {
+            auto candidate = static_cast<Superinstruction>(super);
+            if (length(candidate) > length(longest) &&
+                matches(candidate, method, starts, index)) {
+                longest = candidate;
+            }
+        }
+        code[index].fused = longest;
+        index += std::max(length(longest), 1);
+    }
+}
+
+///
+/// Writes the opcode sequences of 2 up to max_length instructions the
+/// interpreter dispatched the most in methods, Top of each length, then
+/// how many dispatches the superinstructions fused in them take away. A
+/// sequence is counted inside a basic block, as often as its last
+/// instruction ran. The counts are of instructions run one by one, the
+/// superinstructions are left out while the interpreter counts them
+///
+void Superinstructions::printNGrams(
+    std::ostream &out, const std::vector<const DecodedMethod *> &methods,
+    int max_length) {
+    typedef std::vector<unsigned short> NGram;
+    std::vector<std::map<NGram, unsigned long>> ngrams(max_length + 1);
+    std::vector<unsigned long> runs(sizeof(sequences) / sizeof(sequences[0]));
+    std::map<NGram, bool> fused; // the sequence of a superinstruction
+    unsigned long dispatches = 0;
+    unsigned long saved      = 0;
+    int sites                = 0;
+    for (auto method : methods) {
+        auto &code  = method->code;
+        auto &count = method->dispatches;
+        if (count.empty()) {
+            continue;
+        }
+        auto starts = BytecodeDecoder::blockStarts(*method);
+        for (int index = 0; index < code.size(); index++) {
+            dispatches += count[index];
+            NGram ngram{code[index].opcode};
+            for (int last = index + 1;
+                 last < code.size() && ngram.size() < max_length &&
+                 !starts[last];
+                 last++) {
+                ngram.push_back(code[last].opcode);
+                ngrams[ngram.size()][ngram] += count[last];
+            }
+            auto super = static_cast<Superinstruction>(code[index].fused);
+            if (super != super_none) {
+                sites++;
+                runs[super] += count[index];
+                saved += count[index] * (length(super) - 1);
+                NGram sequence;
+                for (int k = 0; k < length(super); k++) {
+                    sequence.push_back(code[index + k].opcode);
+                }
+                fused[sequence] = true;
+            }
+        }
+    }
+    out << "Bytecode n-grams, " << dispatches << " instructions dispatched"
+        << std::endl;
+    for (int size = 2; size <= max_length; size++) {
+        std::vector<std::pair<unsigned long, NGram>> top;
+        for (auto &entry : ngrams[size]) {
+            top.push_back(std::make_pair(entry.second, entry.first));
+        }
+        int shown = std::min<int>(Top, top.size());
+        std::partial_sort(top.begin(), top.begin() + shown, top.end(),
+                          std::greater<std::pair<unsigned long, NGram>>());
+        out << "  " << size << " instructions" << std::endl;
+        for (int k = 0; k < shown && top[k].first > 0; k++) {
+            out << "    " << std::setw(12) << top[k].first << " " << std::fixed
+                << std::setprecision(2) << std::setw(6)
+                << (dispatches > 0 ? 100.0 * top[k].first / dispatches : 0.0)
+                << "% ";
+            for (auto opcode : top[k].second) {
+                out << " " << opcodeName(opcode);
+            }
+            out << (fused.count(top[k].second) ? " (fused)" : "")
+                << std::endl;
+        }
+    }
+    out << "Superinstructions: " << sites << " sites, " << dispatches
+        << " dispatches, " << dispatches - saved << " with them ("
+        << std::fixed << std::setprecision(2)
+        << (dispatches > 0 ? 100.0 * saved / dispatches : 0.0)
+        << "% fewer)" << std::endl;
+    for (int super = super_none + 1; super < runs.size(); super++) {
+        out << "  " << std::left << std::setw(28)
+            << name(static_cast<Superinstruction>(super)) << std::right
+            << runs[super] << " runs" << std::endl;
+    }
+}
@@ -0,0 +1,309 @@
+#include <JVM/structures/ContextEntry.hpp>
+#include <MethodExecuter/TraceRecorder.hpp>
+#include <algorithm>
+#include <initializer_list>
+
+///
+/// Whether the trace runs code of method, inlined or not
+///
+bool Trace::uses(const DecodedMethod *method) const {
+    for (auto &frame : frames) {
+        if (frame.method == method) {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+/// Times the code of the trace started over, from an entry or its end
+///
+unsigned long Trace::runs() const { return entries + iterations.j; }
+
+static std::string methodName(const DecodedMethod *method) {
+    return method->class_name + "." + method->info->name +
+           method->info->descriptor;
+}
+
+static bool isConditional(unsigned short opcode) {
+    return (opcode >= op_ifeq && opcode <= op_if_acmpne) ||
+           opcode == op_ifnull || opcode == op_ifnonnull;
+}
+
+///
+/// Conditional branch taken when opcode is not, conditions come in pairs
+/// of opposites in the opcode table
+///
+static unsigned short inverted(unsigned short opcode) {
+    int first = opcode >= op_ifnull ? op_ifnull : op_ifeq;
+    return first + ((opcode - first) ^ 1);
+}
+
+///
+/// Slots of the value returned by a return opcode, -1 for other opcodes
+///
+static int returnSlots(unsigned short opcode) {
+    switch (opcode) {
+    case op_ireturn:
+    case op_freturn:
+    case op_areturn:
+        return 1;
+    case op_lreturn:
+    case op_dreturn:
+        return 2;
+    case op_return:
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+static bool usesLocal(unsigned short opcode) {
+    return (opcode >= op_iload && opcode <= op_aload) ||
+           (opcode >= op_istore && opcode <= op_astore) || opcode == op_iinc;
+}
+
+bool TraceRecorder::fail(const std::string &reason) {
+    failure = reason;
+    return false;
+}
+
+///
+/// Starts recording an iteration of the loop of frame, whose header is the
+/// instruction header, with entry as the recording handler and up to limit
+/// instructions. False, with the reason, when the method of frame cannot
+/// be recorded
+///
+bool TraceRecorder::start(StackFrame *frame, int header, const void *entry,
+                          int limit) {
+    root          = frame;
+    this->header  = header;
+    this->entry   = entry;
+    this->limit   = limit;
+    frames        = {TraceFrame{frame->method, -1, 0, 0, nullptr}};
+    active        = {frame};
+    active_index  = {0};
+    failure.clear();
+    if (!watch(frame->method)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+///
+/// Makes the instructions of method record themselves, compiled ones
+/// included, which the interpreter runs meanwhile. False, with the reason,
+/// when it was invalidated, as its frames move to another version
+///
+bool TraceRecorder::watch(DecodedMethod *method) {
+    if (watched.count(method)) {
+        return true;
+    }
+    for (auto &ins : method->code) {
+        if (ins.opcode == op_deoptimize) {
+            return fail(methodName(method) + " was invalidated");
+        }
+    }
+    for (auto &ins : method->code) {
+        patched.push_back(std::make_pair(&ins, ins.handler));
+        ins.handler = entry;
+    }
+    watched.insert(method);
+    return true;
+}
+
+bool TraceRecorder::watches(const DecodedMethod *method) const {
+    return watched.count(const_cast<DecodedMethod *>(method)) > 0;
+}
+
+///
+/// Records the instruction pc of frame, which the interpreter is about to
+/// run. frame is the one recorded last, a callee it pushed or the caller it
+/// returned to
+///
+TraceRecorder::Result TraceRecorder::record(StackFrame *frame, int pc) {
+    if (frame == root && pc == header && !steps.empty()) {
+        return Complete;
+    }
+    if (frame != active.back()) {
+        if (frame->caller == active.back()) {
+            TraceFrame callee{frame->method, active_index.back(),
+                              frame->caller->pc,
+                              static_cast<int>(frame->lva - root->lva),
+                              nullptr};
+            if (!(frame->method->info->access_flags & 0x0008)) { // ACC_STATIC
+                callee.receiver = frame->lva[0].ref->runtime_class;
+                if (callee.receiver == nullptr) {
+                    fail("calls a method on an instance of a library class");
+                    return Aborted;
+                }
+            }
+            frames.push_back(callee);
+            active.push_back(frame);
+            active_index.push_back(frames.size() - 1);
+        } else if (active.size() > 1 && frame == active[active.size() - 2]) {
+            active.pop_back();
+            active_index.pop_back();
+        } else {
+            fail("leaves the frames it recorded");
+            return Aborted;
+        }
+    }
+    int index = active_index.back();
+    if (frame->method != frames[index].method) {
+        fail("replaces the frame of " + methodName(frames[index].method));
+        return Aborted;
+    }
+    if (!seen.insert(std::make_pair(index, pc)).second) {
+        fail("runs an inner loop at bci " +
+             std::to_string(frame->method->code[pc].bci) + " of " +
+             methodName(frame->method));
+        return Aborted;
+    }
+    if (steps.size() >= limit) {
+        fail("is longer than " + std::to_string(limit) + " instructions");
+        return Aborted;
+    }
+    auto opcode = frame->method->code[pc].opcode;
+    if (opcode == op_athrow) {
+        fail("throws");
+        return Aborted;
+    }
+    if (opcode == op_jsr || opcode == op_ret) {
+        fail("runs a subroutine");
+        return Aborted;
+    }
+    if (index == 0 && returnSlots(opcode) >= 0) {
+        fail("returns from the method of the loop");
+        return Aborted;
+    }
+    steps.push_back(std::make_pair(index, pc));
+    return Recording;
+}
+
+///
+/// Trace of the iteration recorded, from the instructions as they are now
+/// that each one ran once and is quickened
+///
+std::unique_ptr<Trace> TraceRecorder::build() const {
+    const int header_slots = sizeof(StackFrame) / sizeof(Slot);
+    std::unique_ptr<Trace> trace(new Trace());
+    trace->version = frames[0].method;
+    trace->header  = header;
+    trace->frames  = frames;
+    auto &code     = trace->code;
+    auto &exits    = trace->exits;
+    // guards of the conditional branches, with the exit they jump to
+    std::vector<std::pair<int, TraceExit>> guards;
+    int created = 0; // last frame inlined
+    for (int k = 0; k < steps.size(); k++) {
+        int index    = steps[k].first;
+        int pc       = steps[k].second;
+        auto &frame  = frames[index];
+        auto ins     = frame.method->code[pc];
+        bool last    = k + 1 == steps.size();
+        int next     = last ? 0 : steps[k + 1].first;
+        int next_pc  = last ? header : steps[k + 1].second;
+        TraceExit exit{index, pc, false};
+        if (index == 0) {
+            trace->entry_points.push_back(std::make_pair(pc, code.size()));
+        }
+        if (next > created) {
+            // a call followed into its method
+            created      = next;
+            auto &callee = frames[next];
+            if (callee.receiver != nullptr) {
+                auto guard              = ins;
+                guard.opcode            = op_guard_class;
+                guard.a                 = callee.method->arg_slots;
+                guard.target            = -1;
+                guard.ref.runtime_class = callee.receiver;
+                code.push_back(guard);
+                exits.push_back(TraceExit{index, pc, true});
+            }
+            ins.opcode = op_trace_enter;
+            ins.a      = callee.method->max_locals + header_slots -
+                    callee.method->arg_slots;
+            ins.target = -1;
+        } else if (isConditional(ins.opcode)) {
+            bool taken = next_pc == ins.target && next_pc != pc + 1;
+            if (taken) {
+                ins.opcode = inverted(ins.opcode);
+            }
+            guards.push_back(std::make_pair(
+                code.size(),
+                TraceExit{index, taken ? pc + 1 : ins.target, true}));
+        } else if (ins.opcode == op_goto) {
+            ins.opcode = op_nop;
+            ins.target = -1;
+        } else if (returnSlots(ins.opcode) >= 0) {
+            ins.b      = returnSlots(ins.opcode);
+            ins.a      = frame.lva;
+            ins.opcode = op_trace_return;
+        } else if (usesLocal(ins.opcode)) {
+            ins.a += frame.lva;
+        } else {
+            exit.side = ins.opcode == op_guard_class;
+        }
+        code.push_back(ins);
+        exits.push_back(exit);
+    }
+    // counts the iteration as a static long field incremented, then goes
+    // back to the header
+    Instruction back{};
+    back.bci             = frames[0].method->code[header].bci;
+    back.target          = -1;
+    back.profile         = -1;
+    back.b               = 2;
+    back.ref.static_slot = &trace->iterations;
+    for (auto opcode : {op_getstatic_quick, op_lconst_1, op_ladd,
+                        op_putstatic_quick, op_goto}) {
+        back.opcode = opcode;
+        back.a      = opcode == op_lconst_1;
+        if (opcode == op_goto) {
+            back.target = 0;
+        }
+        code.push_back(back);
+        exits.push_back(TraceExit{0, header, false});
+    }
+    for (auto &guard : guards) {
+        Instruction stub{};
+        stub.opcode  = op_trace_exit;
+        stub.bci     = code[guard.first].bci;
+        stub.target  = -1;
+        stub.profile = -1;
+        code[guard.first].target = code.size();
+        code.push_back(stub);
+        exits.push_back(guard.second);
+    }
+    // the count takes 4 slots over the operand stack of the root frame
+    trace->extent = frames[0].method->max_locals + header_slots +
+                    frames[0].method->max_stack + 4;
+    for (auto &frame : frames) {
+        trace->extent = std::max(trace->extent,
+                                 frame.lva + frame.method->max_locals +
+                                     header_slots + frame.method->max_stack);
+    }
+    return trace;
+}
+
+///
+/// Stops recording and gives the instructions it watched their handler
+/// back, unless it changed meanwhile (an instruction quickened as it ran)
+///
+void TraceRecorder::stop() {
+    for (auto &patch : patched) {
+        if (patch.first->handler == entry) {
+            patch.first->handler = patch.second;
+        }
+    }
+    patched.clear();
+    watched.clear();
+    frames.clear();
+    steps.clear();
+    active.clear();
+    active_index.clear();
+    seen.clear();
+    root = nullptr;
+}
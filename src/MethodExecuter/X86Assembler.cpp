@@ -0,0 +1,130 @@
+#include <MethodExecuter/X86Assembler.hpp>
+#include <cstring>
+
+int X86Assembler::size() const { return code.size(); }
+
+void X86Assembler::byte(int value) { code.push_back(value & 0xff); }
+
+void X86Assembler::dword(int32_t value) {
+    for (int k = 0; k < 4; k++) {
+        byte(value >> (8 * k));
+    }
+}
+
+void X86Assembler::qword(int64_t value) {
+    dword(static_cast<int32_t>(value));
+    dword(static_cast<int32_t>(value >> 32));
+}
+
+void X86Assembler::mem(std::initializer_list<int> opcode, int reg, Reg base,
+                       int disp, bool wide, int prefix, int index, int scale) {
+    if (prefix) {
+        byte(prefix);
+    }
+    int rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (base >> 3);
+    if (index >= 0) {
+        rex |= (index >> 3) << 1;
+    }
+    if (rex != 0x40) {
+        byte(rex);
+    }
+    for (auto op : opcode) {
+        byte(op);
+    }
+    // rbp and r13 as base always take a displacement
+    int mod = 2;
+    if (disp == 0 && (base & 7) != rbp) {
+        mod = 0;
+    } else if (disp >= -128 && disp < 128) {
+        mod = 1;
+    }
+    bool sib = index >= 0 || (base & 7) == rsp;
+    byte((mod << 6) | ((reg & 7) << 3) | (sib ? rsp : base & 7));
+    if (sib) {
+        int bits = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+        byte((bits << 6) | ((index >= 0 ? index & 7 : rsp) << 3) | (base & 7));
+    }
+    if (mod == 1) {
+        byte(disp);
+    } else if (mod == 2) {
+        dword(disp);
+    }
+}
+
+void X86Assembler::regs(std::initializer_list<int> opcode, int reg, int rm,
+                        bool wide, int prefix) {
+    if (prefix) {
+        byte(prefix);
+    }
+    int rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | (rm >> 3);
+    if (rex != 0x40) {
+        byte(rex);
+    }
+    for (auto op : opcode) {
+        byte(op);
+    }
+    byte(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void X86Assembler::movImm(Reg reg, int64_t value) {
+    bool wide = value != static_cast<uint32_t>(value);
+    if (wide || reg >= r8) {
+        byte(0x40 | (wide << 3) | (reg >> 3));
+    }
+    byte(0xb8 + (reg & 7));
+    if (wide) {
+        qword(value);
+    } else {
+        dword(static_cast<int32_t>(value));
+    }
+}
+
+void X86Assembler::addImm(Reg reg, int32_t value, bool wide) {
+    if (value >= -128 && value < 128) {
+        regs({0x83}, 0, reg, wide);
+        byte(value);
+    } else {
+        regs({0x81}, 0, reg, wide);
+        dword(value);
+    }
+}
+
+void X86Assembler::push(Reg reg) {
+    if (reg >= r8) {
+        byte(0x41);
+    }
+    byte(0x50 + (reg & 7));
+}
+
+void X86Assembler::pop(Reg reg) {
+    if (reg >= r8) {
+        byte(0x41);
+    }
+    byte(0x58 + (reg & 7));
+}
+
+void X86Assembler::ret() { byte(0xc3); }
+
+int X86Assembler::leaRip(Reg reg) {
+    byte(0x48 | ((reg >> 3) << 2));
+    byte(0x8d);
+    byte(((reg & 7) << 3) | rbp); // mod 00 rm 101 is rip relative
+    dword(0);
+    return size() - 4;
+}
+
+int X86Assembler::jump(int cond) {
+    if (cond < 0) {
+        byte(0xe9);
+    } else {
+        byte(0x0f);
+        byte(0x80 | cond);
+    }
+    dword(0);
+    return size() - 4;
+}
+
+void X86Assembler::bind(int fixup, int target) {
+    int32_t rel = target - (fixup + 4);
+    std::memcpy(&code[fixup], &rel, sizeof(rel));
+}
@@ -1,9 +1,11 @@
 #include <DotClassReader/ClassFile.hpp>
 #include <JVM/JVM.hpp>
+#include <JVM/VMOptions.hpp>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <sstream>
+#include <stdexcept>
 #include <vector>
 
 using namespace std;
@@ -11,33 +13,55 @@ using namespace std;
 int main(int argc, char const *argv[]) {
     ifstream file;
     string option;
+    VMOptions vm_options;
     option = "";
-    if (argc < 2 || argc > 3) {
+    if (argc < 2) {
         cout << "You must pass ONE file as argument!" << endl;
         return 0;
-    } else if (argc == 2) {
-        file = ifstream(argv[1], ios::binary);
-    } else if (argc == 3) {
-        file   = ifstream(argv[1], ios::binary);
-        option = argv[2];
+    }
+    if (string(argv[1]) == "--aot") {
+        if (argc != 5 || string(argv[3]) != "-o") {
+            cout << "Usage: " << argv[0] << " --aot program.class -o program.so"
+                 << endl;
+            return 0;
+        }
+        file    = ifstream(argv[2], ios::binary);
+        auto cf = ClassFile(&file, argv[2]);
+        cf.seek();
+        try {
+            JVM(&cf, vm_options).Compile(argv[4]);
+        } catch (runtime_error &error) {
+            cerr << error.what() << endl;
+            return 1;
+        }
+        return 0;
+    }
+    file = ifstream(argv[1], ios::binary);
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if ((arg == "-i" || arg == "-l") && option == "") {
+            option = arg;
+        } else if (!vm_options.parse(arg)) {
+            cout << "You must pass -l (leitor) or -i (interpretador) as "
+                    "options! VM options:"
+                 << endl
+                 << VMOptions::usage();
+            return 0;
+        }
     }
 
     auto cf = ClassFile(&file, argv[1]);
     cf.seek();
     if (option == "-i") {
-        auto jvm = JVM(&cf);
+        auto jvm = JVM(&cf, vm_options);
         jvm.Run();
     } else if (option == "-l") {
         cf.show();
     } else if (option == "") {
         cf.show();
 
-        auto jvm = JVM(&cf);
+        auto jvm = JVM(&cf, vm_options);
         jvm.Run();
-    } else {
-        cout << "You must pass -l (leitor) or -i (interpretador) as options!"
-             << endl;
-        return 0;
     }
 
     return 0;